@@ -55,26 +55,271 @@
  */
 #define DEFAULT_DECIMAL_PRECISION	10
 
+/* flags of a parsed % conversion */
+#define SPEC_PREFIX		0x01		/* # to add 0x or 0 prefix */
+#define SPEC_ZERO_PAD		0x02		/* 0 to pad with zeros */
+#define SPEC_LEFT		0x04		/* - to pad on the right */
+#define SPEC_LONG		0x08		/* l for a long argument */
+
+/* width or precision which is taken from the arguments with a * */
+#define SPEC_FROM_ARG		-2
+
+/* largest width or precision that we will parse */
+#define SPEC_LEN_MAX		4096
+
+/* pairs of decimal digits so we can convert two digits per division */
+static	const char	dec_pairs[] =
+  "00010203040506070809"
+  "10111213141516171819"
+  "20212223242526272829"
+  "30313233343536373839"
+  "40414243444546474849"
+  "50515253545556575859"
+  "60616263646566676869"
+  "70717273747576777879"
+  "80818283848586878889"
+  "90919293949596979899";
+
+/* pairs of hexadecimal digits so we can convert a byte at a time */
+static	const char	hex_pairs[] =
+  "000102030405060708090a0b0c0d0e0f"
+  "101112131415161718191a1b1c1d1e1f"
+  "202122232425262728292a2b2c2d2e2f"
+  "303132333435363738393a3b3c3d3e3f"
+  "404142434445464748494a4b4c4d4e4f"
+  "505152535455565758595a5b5c5d5e5f"
+  "606162636465666768696a6b6c6d6e6f"
+  "707172737475767778797a7b7c7d7e7f"
+  "808182838485868788898a8b8c8d8e8f"
+  "909192939495969798999a9b9c9d9e9f"
+  "a0a1a2a3a4a5a6a7a8a9aaabacadaeaf"
+  "b0b1b2b3b4b5b6b7b8b9babbbcbdbebf"
+  "c0c1c2c3c4c5c6c7c8c9cacbcccdcecf"
+  "d0d1d2d3d4d5d6d7d8d9dadbdcdddedf"
+  "e0e1e2e3e4e5e6e7e8e9eaebecedeeef"
+  "f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff";
+
+/* digits for the other bases */
+static	const char	letters[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+
 /*
- * Internal method to process a long or int number and write into a buffer.
+ * Returns the number of significant bits in value or 1 if it is 0.
  */
-static	char	*handle_decimal(char *buf, char *limit, const long num, const int base)
+static	int	bit_width(unsigned long value)
 {
-  char *buf_p = buf;
-  buf_p = append_long(buf_p, limit, num, base);
-  append_null(buf_p, limit);
-  return buf_p;
+#if defined(__GNUC__)
+  if (value == 0) {
+    return 1;
+  }
+  return sizeof(unsigned long) * 8 - __builtin_clzl(value);
+#else
+  int	bits = 1;
+  
+  while ((value >>= 1) != 0) {
+    bits++;
+  }
+  return bits;
+#endif
 }
 
 /*
- * Internal method to process a long or int number and write into a buffer.
+ * Write the digits of value in base backwards so the last digit is
+ * just before end_p.  Returns a pointer to the first digit.
  */
-static	char	*handle_pointer(char *buf, char *limit, const PNT_ARITH_TYPE num, const int base)
+static	char	*convert_ulong(char *end_p, unsigned long value, const int base)
 {
-  char *buf_p = buf;
-  buf_p = append_pointer(buf_p, limit, num, base);
-  append_null(buf_p, limit);
-  return buf_p;
+  char	*digit_p = end_p;
+  int	pair;
+  
+  if (base == 10) {
+    while (value >= 100) {
+      pair = (value % 100) * 2;
+      value /= 100;
+      *--digit_p = dec_pairs[pair + 1];
+      *--digit_p = dec_pairs[pair];
+    }
+    if (value >= 10) {
+      pair = value * 2;
+      *--digit_p = dec_pairs[pair + 1];
+      *--digit_p = dec_pairs[pair];
+    }
+    else {
+      *--digit_p = '0' + value;
+    }
+  }
+  else if (base == 16) {
+    while (value >= 0x100) {
+      pair = (value & 0xff) * 2;
+      value >>= 8;
+      *--digit_p = hex_pairs[pair + 1];
+      *--digit_p = hex_pairs[pair];
+    }
+    if (value >= 0x10) {
+      pair = value * 2;
+      *--digit_p = hex_pairs[pair + 1];
+      *--digit_p = hex_pairs[pair];
+    }
+    else {
+      *--digit_p = letters[value];
+    }
+  }
+  else if (base == 8) {
+    do {
+      *--digit_p = '0' + (value & 07);
+      value >>= 3;
+    } while (value != 0);
+  }
+  else {
+    do {
+      *--digit_p = letters[value % base];
+      value /= base;
+    } while (value != 0);
+  }
+  
+  return digit_p;
+}
+
+/*
+ * Append the digits of value in base, with a '-' in front if neg_b,
+ * to destination up to limit pointer.  Pointer to the end of the
+ * added characters will be returned.  No \0 character will be added.
+ */
+static	char	*append_digits(char *dest, char *limit,
+			       const unsigned long value, const int base,
+			       const int neg_b)
+{
+  char		buf[72], *buf_end = buf + sizeof(buf), *digit_p;
+  unsigned long	test;
+  int		len;
+  
+  /* size the common bases up front so we can write them in place */
+  if (base == 10 || base == 16 || base == 8) {
+    if (base == 16) {
+      len = (bit_width(value) + 3) / 4;
+    }
+    else if (base == 8) {
+      len = (bit_width(value) + 2) / 3;
+    }
+    else {
+      for (len = 1, test = value; test >= 100; test /= 100) {
+	len += 2;
+      }
+      if (test >= 10) {
+	len++;
+      }
+    }
+    if (neg_b) {
+      len++;
+    }
+    if (limit - dest >= len) {
+      digit_p = convert_ulong(dest + len, value, base);
+      if (neg_b) {
+	*--digit_p = '-';
+      }
+      return dest + len;
+    }
+  }
+  
+  digit_p = convert_ulong(buf_end, value, base);
+  if (neg_b) {
+    *--digit_p = '-';
+  }
+  while (dest < limit && digit_p < buf_end) {
+    *dest++ = *digit_p++;
+  }
+  return dest;
+}
+
+/*
+ * Parse the literal text and the following % conversion at the start
+ * of format_p into spec_p.  Returns a pointer to the rest of the
+ * format.
+ */
+static	const char	*parse_spec(const char *format_p, append_spec_t *spec_p)
+{
+  int	trunc_b = 0;
+  char	ch;
+  
+  spec_p->as_literal = format_p;
+  while (*format_p != '\0' && *format_p != '%') {
+    format_p++;
+  }
+  spec_p->as_literal_len = format_p - spec_p->as_literal;
+  spec_p->as_conv = '\0';
+  spec_p->as_flags = 0;
+  spec_p->as_width = -1;
+  spec_p->as_trunc = -1;
+  if (*format_p == '\0') {
+    return format_p;
+  }
+  format_p++;
+  
+  while (*format_p != '\0') {
+    ch = *format_p++;
+    if (ch == '%') {
+      spec_p->as_conv = '%';
+      break;
+    }
+    if (ch == '#') {
+      spec_p->as_flags |= SPEC_PREFIX;
+    } else if (ch == '0' && spec_p->as_width < 0 && spec_p->as_trunc < 0) {
+      spec_p->as_flags |= SPEC_ZERO_PAD;
+    } else if (ch == '-') {
+      spec_p->as_flags |= SPEC_LEFT;
+    } else if (ch == '.') {
+      trunc_b = 1;
+    } else if (ch == '*') {
+      if (trunc_b) {
+	spec_p->as_trunc = SPEC_FROM_ARG;
+      } else {
+	spec_p->as_width = SPEC_FROM_ARG;
+      }
+    } else if (ch >= '0' && ch <= '9') {
+      if (trunc_b) {
+	if (spec_p->as_trunc < 0) {
+	  spec_p->as_trunc = (ch - '0');
+	} else if (spec_p->as_trunc < SPEC_LEN_MAX) {
+	  spec_p->as_trunc = spec_p->as_trunc * 10 + (ch - '0');
+	}
+      } else {
+	if (spec_p->as_width < 0) {
+	  spec_p->as_width = (ch - '0');
+	} else if (spec_p->as_width < SPEC_LEN_MAX) {
+	  spec_p->as_width = spec_p->as_width * 10 + (ch - '0');
+	}
+      }
+    } else if (ch == 'l') {
+      spec_p->as_flags |= SPEC_LONG;
+    } else if (ch == 'c' || ch == 'd' || ch == 'f' || ch == 'o' || ch == 'p'
+	       || ch == 's' || ch == 'u' || ch == 'x') {
+      spec_p->as_conv = ch;
+      break;
+    }
+    /* other characters are ignored */
+  }
+  
+  return format_p;
+}
+
+/*
+ * Parse all of format into desc_p.  If there are too many
+ * conversions then af_spec_n is set to -1.
+ */
+static	void	parse_format(append_format_t *desc_p, const char *format)
+{
+  const char	*format_p = format;
+  int		spec_c = 0;
+  
+  while (*format_p != '\0') {
+    if (spec_c >= APPEND_FORMAT_SPEC_MAX) {
+      spec_c = -1;
+      break;
+    }
+    format_p = parse_spec(format_p, desc_p->af_specs + spec_c);
+    spec_c++;
+  }
+  desc_p->af_spec_n = spec_c;
+  desc_p->af_format = format;
 }
 
 /*
@@ -146,100 +391,58 @@ char	*append_string(char *dest, const char *limit, const char *value)
 /*
  * Append long value argument to destination up to limit pointer.
  * Pointer to the end of the added characters will be returned.  No \0
- * character will be added.  Variant of itoa() written by Lukas
- * Chmela which is released under GPLv3.
+ * character will be added.
  */
 char	*append_long(char *dest, char *limit, long value, int base)
 {
-  char buf[30];
-  char *ptr = buf;
-  char *ptr1 = buf;
-  char tmp_char;
-  long tmp_value;
-
-  /* letters that handle both negative and positive values */
-  char *letters =
-    "zyxwvutsrqponmlkjihgfedcba9876543210123456789abcdefghijklmnopqrstuvwxyz";
-  int mid = 35;
-  /* build the string with low order digits first: 100 => "001" */
-  do {
-    tmp_value = value;
-    value /= base;
-    *ptr++ = letters[mid + tmp_value - (value * base)];
-  } while (value != 0);
-
-  /* apply negative sign */
-  if (tmp_value < 0) {
-    *ptr++ = '-';
+  if (value < 0) {
+    /* NOTE: this works even with the most negative long */
+    return append_digits(dest, limit, 0UL - (unsigned long)value, base, 1);
   }
-  *ptr-- = '\0';
-  /* now we swap the characters to move high order digits first */
-  while (ptr1 < ptr) {
-    tmp_char = *ptr;
-    *ptr--= *ptr1;
-    *ptr1++ = tmp_char;
+  else {
+    return append_digits(dest, limit, value, base, 0);
   }
-  return append_string(dest, limit, buf);
 }
 
 /*
  * Append unsigned long value argument to destination up to limit
  * pointer.  Pointer to the end of the added characters will be
- * returned.  No \0 character will be added.  Variant of itoa()
- * written by Lukas Chmela. Released under GPLv3.
+ * returned.  No \0 character will be added.
  */
 char	*append_ulong(char *dest, char *limit, unsigned long value, int base)
 {
-  char buf[30];
-  char *ptr = buf;
-  char *ptr1 = buf;
-  char tmp_char;
-  unsigned long tmp_value;
-
-  /* letters that handle both negative and positive values */
-  char *letters =
-    "zyxwvutsrqponmlkjihgfedcba9876543210123456789abcdefghijklmnopqrstuvwxyz";
-  int mid = 35;
-  /* build the string with low order digits first: 100 => "001" */
-  do {
-    tmp_value = value;
-    value /= base;
-    *ptr++ = letters[mid + tmp_value - (value * base)];
-  } while (value != 0);
-
-  *ptr-- = '\0';
-  /* now we swap the characters to move high order digits first */
-  while (ptr1 < ptr) {
-    tmp_char = *ptr;
-    *ptr--= *ptr1;
-    *ptr1++ = tmp_char;
-  }
-  return append_string(dest, limit, buf);
+  return append_digits(dest, limit, value, base, 0);
 }
 
 /*
  * Append pointer value argument to destination up to limit pointer.
  * Pointer to the end of the added characters will be returned.  No \0
- * character will be added.  Variant of itoa() written by Lukas
- * Chmela which is released under GPLv3.
+ * character will be added.  The value is converted as an unsigned
+ * long unless that is too small to hold it.  The other case is a
+ * variant of itoa() written by Lukas Chmela which is released under
+ * GPLv3.
  */
 char	*append_pointer(char *dest, char *limit, PNT_ARITH_TYPE value, int base)
 {
-  char buf[30];
+  char buf[72];
   char *ptr = buf;
   char *ptr1 = buf;
   char tmp_char;
   PNT_ARITH_TYPE tmp_value;
-
+  
+  if (sizeof(PNT_ARITH_TYPE) <= sizeof(unsigned long)) {
+    return append_digits(dest, limit, (unsigned long)value, base, 0);
+  }
+  
   /* letters that handle both negative and positive values */
-  char *letters =
+  char *sign_letters =
     "zyxwvutsrqponmlkjihgfedcba9876543210123456789abcdefghijklmnopqrstuvwxyz";
   int mid = 35;
   /* build the string with low order digits first: 100 => "001" */
   do {
     tmp_value = value;
     value /= base;
-    *ptr++ = letters[mid + tmp_value - (value * base)];
+    *ptr++ = sign_letters[mid + tmp_value - (value * base)];
   } while (value != 0);
 
   /* apply negative sign */
@@ -257,208 +460,254 @@ char	*append_pointer(char *dest, char *limit, PNT_ARITH_TYPE value, int base)
 }
 
 /*
- * Append a varargs format to destination.  Pointer to the end of the
- * characters added will be returned.  No \0 character will be added.
+ * Append a varargs format to destination using the pre-parsed pieces
+ * in desc_p or, if it is NULL, parsing the format as we go.  Pointer
+ * to the end of the characters added will be returned.  No \0
+ * character will be added.
  */
-char	*append_vformat(char *dest, char *limit, const char *format,
-			va_list args)
+static	char	*vformat(char *dest, char *limit, const char *format,
+			 const append_format_t *desc_p, va_list args)
 {
   const char *format_p = format;
   char value_buf[64];
   char *value_limit = value_buf + sizeof(value_buf);
   char *dest_p = dest;
-  int format_prefix, neg_pad, trunc, long_arg;
-  char pad_char;
-  char *prefix, *prefix_p;
-  int width_len, trunc_len, prefix_len;
+  append_spec_t spec;
+  const append_spec_t *spec_p;
+  const char *value, *prefix;
+  char *str_limit;
+  int spec_c = 0, width_len, trunc_len, prefix_len, value_len, pad;
+  int conv, flags, base;
+  long num;
+  unsigned long unsigned_num;
   
-  while (*format_p != '\0' && dest_p < limit) {
-    if (*format_p != '%') {
-      *dest_p++ = *format_p++;
-      continue;
-    }
-    format_p++;
-
-    format_prefix = 0; 
-    neg_pad = 0;
-    trunc = 0;
-    long_arg = 0;
-    pad_char = ' ';
-    prefix = "";
-    width_len = -1;
-    trunc_len = -1;
-    prefix_len = 0;
-    while (1) {
-      char ch = *format_p++;
-      if (ch == '\0') {
+  while (dest_p < limit) {
+    if (desc_p != NULL) {
+      if (spec_c >= desc_p->af_spec_n) {
 	break;
       }
-      if (ch == '%') {
-	if (dest_p < limit) {
-	  *dest_p++ = '%';
-	}
+      spec_p = desc_p->af_specs + spec_c++;
+      /* copy the text up to the % in one go */
+      value_len = spec_p->as_literal_len;
+      if (value_len > limit - dest_p) {
+	value_len = limit - dest_p;
+      }
+      memcpy(dest_p, spec_p->as_literal, value_len);
+      dest_p += value_len;
+    }
+    else {
+      /* copy the text up to the % as we scan it */
+      while (*format_p != '\0' && *format_p != '%' && dest_p < limit) {
+	*dest_p++ = *format_p++;
+      }
+      if (*format_p != '%') {
 	break;
       }
-      if (ch == '#') {
-	format_prefix = 1;
-      } else if (ch == '0' && width_len < 0 && trunc_len < 0) {
-	pad_char = '0';
-      } else if (ch == '-') {
-	neg_pad = 1;
-      } else if (ch == '.') {
-	trunc = 1;
-      } else if (ch == '*') {
-	if (trunc) {
-	  trunc_len = va_arg(args, int);
-	} else {
-	  width_len = va_arg(args, int);
-	}
-      } else if (ch >= '0' && ch <= '9') {
-	if (trunc) {
-	  if (trunc_len < 0) {
-	    trunc_len = (ch - '0');
-	  } else {
-	    trunc_len = trunc_len * 10 + (ch - '0');
-	  }
-	} else {
-	  if (width_len < 0) {
-	    width_len = (ch - '0');
-	  } else {
-	    width_len = width_len * 10 + (ch - '0');
-	  }
-	}
-      } else if (ch == 'l') {
-	long_arg = 1;
-      } else if (ch != 'c' && ch != 'd' && ch != 'f' && ch != 'o' && ch != 'p'
-		 && ch != 's' && ch != 'u' && ch != 'x') {
-	continue;
+      format_p = parse_spec(format_p, &spec);
+      spec_p = &spec;
+    }
+    
+    /* local copies since writing to dest_p could alias the spec */
+    conv = spec_p->as_conv;
+    flags = spec_p->as_flags;
+    
+    if (conv == '\0') {
+      continue;
+    }
+    if (conv == '%') {
+      if (dest_p < limit) {
+	*dest_p++ = '%';
       }
+      continue;
+    }
+    
+    width_len = spec_p->as_width;
+    if (width_len == SPEC_FROM_ARG) {
+      width_len = va_arg(args, int);
+    }
+    trunc_len = spec_p->as_trunc;
+    if (trunc_len == SPEC_FROM_ARG) {
+      trunc_len = va_arg(args, int);
+    }
+    prefix = "";
+    prefix_len = 0;
+    value = value_buf;
+    
+    /* process the % format character */
+    switch (conv) {
       
-      /* process the % format character */
+    case 'c':
+      value_buf[0] = (char)va_arg(args, int);
+      value_len = (value_buf[0] == '\0' ? 0 : 1);
+      break;
       
-      const char *value;
-      if (ch == 'c') {
-	value_buf[0] = (char)va_arg(args, int);
-	value_buf[1] = '\0';
-	value = value_buf;
-      } else if (ch == 'd') {
-	long num;
-	if (long_arg) {
-	  num = va_arg(args, long);
-	} else {
-	  num = va_arg(args, int);
-	}
-	handle_decimal(value_buf, value_limit, num, 10);
-	value = value_buf;
-      } else if (ch == 'f') {
-	double num = va_arg(args, double);
-	if (trunc_len < 0) {
-	  handle_float(value_buf, value_limit, num, DEFAULT_DECIMAL_PRECISION, 1);
-	} else {
-	  handle_float(value_buf, value_limit, num, trunc_len, 0);
-	}
-	value = value_buf;
-	/* special case here, the trunc length is really decimal precision */
-	trunc_len = -1;
-      } else if (ch == 'o') {
-	long num;
-	if (long_arg) {
-	  num = va_arg(args, long);
-	} else {
-	  num = va_arg(args, int);
-	}
-	handle_decimal(value_buf, value_limit, num, 8);
-	value = value_buf;
-	if (format_prefix) {
+    case 'd':
+    case 'o':
+    case 'x':
+      if (flags & SPEC_LONG) {
+	num = va_arg(args, long);
+      } else {
+	num = va_arg(args, int);
+      }
+      if (conv == 'd') {
+	base = 10;
+      }
+      else if (conv == 'o') {
+	base = 8;
+	if (flags & SPEC_PREFIX) {
 	  prefix = "0";
 	  prefix_len = 1;
 	}
-      } else if (ch == 'p') {
-	DMALLOC_PNT pnt = va_arg(args, DMALLOC_PNT);
-	PNT_ARITH_TYPE num = (PNT_ARITH_TYPE)pnt;
-	handle_pointer(value_buf, value_limit, num, 16);
-	value = value_buf;
-	// because %#p throws a gcc warning, I've decreed that %p has a 0x hex prefix
-	prefix = "0x";
-	prefix_len = 2;
-      } else if (ch == 's') {
-	value = va_arg(args, char *);
-      } else if (ch == 'u') {
-	unsigned long num;
-	if (long_arg) {
-	  num = va_arg(args, unsigned long);
-	} else {
-	  num = va_arg(args, unsigned int);
-	}
-	char *value_buf_p = value_buf;
-	value_buf_p = append_ulong(value_buf_p, value_limit, num, 10);
-	append_null(value_buf_p, value_limit);
-	value = value_buf;
-      } else if (ch == 'x') {
-	long num;
-	if (long_arg) {
-	  num = va_arg(args, long);
-	} else {
-	  num = va_arg(args, int);
-	}
-	handle_decimal(value_buf, value_limit, num, 16);
-	if (format_prefix) {
+      }
+      else {
+	base = 16;
+	if (flags & SPEC_PREFIX) {
 	  prefix = "0x";
 	  prefix_len = 2;
 	}
-	value = value_buf;
+      }
+      if (width_len < 0 && trunc_len < 0) {
+	/* without any padding the number goes right into the destination */
+	dest_p = append_string(dest_p, limit, prefix);
+	dest_p = append_long(dest_p, limit, num, base);
+	continue;
+      }
+      value_len = append_long(value_buf, value_limit, num, base) - value_buf;
+      break;
+      
+    case 'f':
+      if (trunc_len < 0) {
+	value_len = handle_float(value_buf, value_limit, va_arg(args, double),
+				 DEFAULT_DECIMAL_PRECISION, 1) - value_buf;
       } else {
+	value_len = handle_float(value_buf, value_limit, va_arg(args, double),
+				 trunc_len, 0) - value_buf;
+      }
+      /* special case here, the trunc length is really decimal precision */
+      trunc_len = -1;
+      break;
+      
+    case 'p':
+      value_len = append_pointer(value_buf, value_limit,
+				 (PNT_ARITH_TYPE)va_arg(args, DMALLOC_PNT),
+				 16) - value_buf;
+      // because %#p throws a gcc warning, I've decreed that %p has a 0x hex prefix
+      prefix = "0x";
+      prefix_len = 2;
+      break;
+      
+    case 's':
+      value = va_arg(args, char *);
+      if (width_len < 0 && trunc_len < 0) {
+	dest_p = append_string(dest_p, limit, value);
 	continue;
       }
-
-      /* prepend optional numeric prefix which has to come before padding */
-      if (prefix_len > 0) {
-	prefix_p = prefix;
-	while (*prefix_p != '\0' && dest_p < limit) {
-	  *dest_p++ = *prefix_p++;
-	}
+      value_len = -1;
+      break;
+      
+    case 'u':
+    default:
+      if (flags & SPEC_LONG) {
+	unsigned_num = va_arg(args, unsigned long);
+      } else {
+	unsigned_num = va_arg(args, unsigned int);
       }
-
-      /* handle our pre-padding with spaces or 0s */
-      int pad = 0;
-      if (width_len >= 0) {
+      if (width_len < 0 && trunc_len < 0) {
+	dest_p = append_ulong(dest_p, limit, unsigned_num, 10);
+	continue;
+      }
+      value_len = append_ulong(value_buf, value_limit, unsigned_num, 10)
+	- value_buf;
+      break;
+    }
+    
+    /* prepend optional numeric prefix which has to come before padding */
+    while (*prefix != '\0' && dest_p < limit) {
+      *dest_p++ = *prefix++;
+    }
+    
+    /* handle our pre-padding with spaces or 0s */
+    pad = 0;
+    if (width_len >= 0) {
+      if (value_len < 0) {
 	if (trunc_len >= 0) {
-	  pad = width_len - strnlen(value, trunc_len) - prefix_len;
+	  value_len = strnlen(value, trunc_len);
 	} else {
-	  pad = width_len - strlen(value) - prefix_len;
-	}
-	if (!neg_pad) {
-	  while (pad-- > 0 && dest_p < limit) {
-	    *dest_p++ = pad_char;
-	  }
+	  value_len = strlen(value);
 	}
       }
-
-      /* change the limit if we are truncating the string */
-      char *str_limit = limit;
-      if (trunc_len >= 0) {
-	str_limit = dest_p + trunc_len;
-	if (str_limit > limit) {
-	  str_limit = limit;
+      if (trunc_len >= 0 && value_len > trunc_len) {
+	pad = width_len - trunc_len - prefix_len;
+      } else {
+	pad = width_len - value_len - prefix_len;
+      }
+      if (! (flags & SPEC_LEFT)) {
+	while (pad-- > 0 && dest_p < limit) {
+	  *dest_p++ = ((flags & SPEC_ZERO_PAD) ? '0' : ' ');
 	}
       }
-
-      /* copy the value watching our limit */
+    }
+    
+    /* change the limit if we are truncating the string */
+    str_limit = limit;
+    if (trunc_len >= 0 && trunc_len < limit - dest_p) {
+      str_limit = dest_p + trunc_len;
+    }
+    
+    /* copy the value watching our limit */
+    if (value_len < 0) {
       while (*value != '\0' && dest_p < str_limit) {
 	*dest_p++ = *value++;
       }
-      
-      /* maybe handle left over padding which would be negative padding */
-      while (pad-- > 0 && dest_p < limit) {
-	/* always pad at the end with a space */
-	*dest_p++ = ' ';
+    }
+    else {
+      for (; value_len > 0 && dest_p < str_limit; value_len--) {
+	*dest_p++ = *value++;
       }
-      break;
+    }
+    
+    /* maybe handle left over padding which would be negative padding */
+    while (pad-- > 0 && dest_p < limit) {
+      /* always pad at the end with a space */
+      *dest_p++ = ' ';
     }
   }
+  
   return dest_p;
 }
 
+/*
+ * Append a varargs format to destination.  Pointer to the end of the
+ * characters added will be returned.  No \0 character will be added.
+ */
+char	*append_vformat(char *dest, char *limit, const char *format,
+			va_list args)
+{
+  return vformat(dest, limit, format, NULL, args);
+}
+
+/*
+ * Append a varargs format to destination like append_vformat but
+ * with the format parsed only once into desc_p which the caller
+ * keeps, usually in a static variable.  The caller must make sure
+ * that only one thread uses desc_p at a time.  Pointer to the end of
+ * the characters added will be returned.  No \0 character will be
+ * added.
+ */
+char	*append_vformat_desc(char *dest, char *limit, append_format_t *desc_p,
+			     const char *format, va_list args)
+{
+  if (desc_p->af_format != format) {
+    parse_format(desc_p, format);
+  }
+  if (desc_p->af_spec_n < 0) {
+    return vformat(dest, limit, format, NULL, args);
+  }
+  else {
+    return vformat(dest, limit, format, desc_p, args);
+  }
+}
+
 /*
  * Append a varargs format to destination.  Pointer to the end of the
  * added characters will be returned.  No \0 character will be added.
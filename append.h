@@ -31,6 +31,33 @@
 
 #include "conf.h"
 
+/* maximum number of pieces in a format that can be pre-parsed */
+#define APPEND_FORMAT_SPEC_MAX	16
+
+/*
+ * A piece of a format: the literal text up to a % and the parsed
+ * conversion that follows it.
+ */
+typedef struct {
+  const char	*as_literal;		/* literal text before the % */
+  int		as_literal_len;		/* length of the literal text */
+  char		as_conv;		/* conversion char, %, or \0 if none */
+  char		as_flags;		/* flags of the conversion */
+  short		as_width;		/* field width or -1 if none */
+  short		as_trunc;		/* precision or -1 if none */
+} append_spec_t;
+
+/*
+ * Format that has been parsed into pieces so that it does not have to
+ * be parsed again each time it is used.  A zeroed structure is ready
+ * to be used.
+ */
+typedef struct {
+  const char	*af_format;		/* format that was parsed */
+  int		af_spec_n;		/* pieces parsed or -1 if too many */
+  append_spec_t	af_specs[APPEND_FORMAT_SPEC_MAX]; /* the pieces */
+} append_format_t;
+
 /*<<<<<<<<<<  The below prototypes are auto-generated by fillproto */
 
 /*
@@ -44,8 +71,7 @@ char	*append_string(char *dest, const char *limit, const char *value);
 /*
  * Append long value argument to destination up to limit pointer.
  * Pointer to the end of the added characters will be returned.  No \0
- * character will be added.  Variant of itoa() written by Lukas
- * Chmela which is released under GPLv3.
+ * character will be added.
  */
 extern
 char	*append_long(char *dest, char *limit, long value, int base);
@@ -53,8 +79,7 @@ char	*append_long(char *dest, char *limit, long value, int base);
 /*
  * Append unsigned long value argument to destination up to limit
  * pointer.  Pointer to the end of the added characters will be
- * returned.  No \0 character will be added.  Variant of itoa()
- * written by Lukas Chmela. Released under GPLv3.
+ * returned.  No \0 character will be added.
  */
 extern
 char	*append_ulong(char *dest, char *limit, unsigned long value, int base);
@@ -62,8 +87,10 @@ char	*append_ulong(char *dest, char *limit, unsigned long value, int base);
 /*
  * Append pointer value argument to destination up to limit pointer.
  * Pointer to the end of the added characters will be returned.  No \0
- * character will be added.  Variant of itoa() written by Lukas
- * Chmela which is released under GPLv3.
+ * character will be added.  The value is converted as an unsigned
+ * long unless that is too small to hold it.  The other case is a
+ * variant of itoa() written by Lukas Chmela which is released under
+ * GPLv3.
  */
 extern
 char	*append_pointer(char *dest, char *limit, PNT_ARITH_TYPE value, int base);
@@ -76,6 +103,18 @@ extern
 char	*append_vformat(char *dest, char *limit, const char *format,
 			va_list args);
 
+/*
+ * Append a varargs format to destination like append_vformat but
+ * with the format parsed only once into desc_p which the caller
+ * keeps, usually in a static variable.  The caller must make sure
+ * that only one thread uses desc_p at a time.  Pointer to the end of
+ * the characters added will be returned.  No \0 character will be
+ * added.
+ */
+extern
+char	*append_vformat_desc(char *dest, char *limit, append_format_t *desc_p,
+			     const char *format, va_list args);
+
 /*
  * Append a varargs format to destination.  Pointer to the end of the
  * added characters will be returned.  No \0 character will be added.
@@ -0,0 +1,220 @@
+/*
+ * Benchmark of the append formatting routines against the system printf
+ *
+ * Copyright 2020 by Gray Watson
+ *
+ * This file is part of the dmalloc package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ *
+ * The author may be contacted via https://dmalloc.com/
+ */
+
+/*
+ * This is not linked with the library so the numbers measure only the
+ * formatting code.  The formats below are the ones the library writes
+ * for every transaction when log-trans is enabled.
+ */
+
+#include <stdio.h>				/* for snprintf */
+#include <time.h>				/* for clock */
+
+#if HAVE_STDLIB_H
+# include <stdlib.h>				/* for atol */
+#endif
+#if HAVE_STRING_H
+# include <string.h>
+#endif
+
+#include "conf.h"
+#include "append.h"				/* for loc_snprintf */
+
+#define DEFAULT_ITERATIONS	1000000
+#define BUF_SIZE		256
+
+#define ALLOC_FORMAT	"*** %s: at '%s' for %ld bytes, got '%s'\n"
+#define FREE_FORMAT	"*** free: at '%s' pnt '%s': size %ld, alloced at '%s'\n"
+#define NUMBER_FORMAT	"%ld %lu %#lx %08lx %-6d|\n"
+
+/* the different ways to format */
+#define METHOD_APPEND	0			/* append_format every time */
+#define METHOD_CACHED	1			/* pre-parsed format descriptor */
+#define METHOD_LIBC	2			/* system snprintf */
+#define METHOD_N	3
+
+static	char	*method_names[] = { "append", "cached", "snprintf" };
+
+/* format descriptors which are parsed on their first use */
+static	append_format_t	descs[3];
+
+/*
+ * static char *desc_format
+ *
+ * Format a string with one of our cached descriptors.
+ *
+ * RETURNS:
+ *
+ * Pointer to the end of the formatted string.
+ *
+ * ARGUMENTS:
+ *
+ * buf -> Buffer to write into.
+ *
+ * limit -> Limit pointer of the buffer.
+ *
+ * desc_p -> Cached format descriptor.
+ *
+ * format -> Printf-style format.
+ *
+ * ... -> Arguments for the format.
+ */
+static	char	*desc_format(char *buf, char *limit, append_format_t *desc_p,
+			     const char *format, ...)
+{
+  va_list	args;
+  char		*buf_p;
+  
+  va_start(args, format);
+  buf_p = append_vformat_desc(buf, limit, desc_p, format, args);
+  va_end(args);
+  return buf_p;
+}
+
+/*
+ * static int format_one
+ *
+ * Format one of the benchmark strings with a method.
+ *
+ * RETURNS:
+ *
+ * The length of the formatted string.
+ *
+ * ARGUMENTS:
+ *
+ * method -> Which formatting method to use.
+ *
+ * which -> Which of the formats to write.
+ *
+ * iter_c -> Iteration count to vary the numbers.
+ *
+ * buf -> Buffer to write into.
+ */
+static	int	format_one(const int method, const int which,
+			   const unsigned long iter_c, char *buf)
+{
+  char	*limit = buf + BUF_SIZE, *buf_p;
+  long	size = (long)(iter_c % 100000) + 1;
+  
+  switch (which) {
+  
+  case 0:
+    if (method == METHOD_CACHED) {
+      buf_p = desc_format(buf, limit, &descs[0], ALLOC_FORMAT, "malloc",
+			  "dmalloc_t.c:1234", size, "0x7f1234567890|s3");
+      return buf_p - buf;
+    }
+    else if (method == METHOD_APPEND) {
+      return loc_snprintf(buf, BUF_SIZE, ALLOC_FORMAT, "malloc",
+			  "dmalloc_t.c:1234", size, "0x7f1234567890|s3");
+    }
+    else {
+      return snprintf(buf, BUF_SIZE, ALLOC_FORMAT, "malloc",
+		      "dmalloc_t.c:1234", size, "0x7f1234567890|s3");
+    }
+  
+  case 1:
+    if (method == METHOD_CACHED) {
+      buf_p = desc_format(buf, limit, &descs[1], FREE_FORMAT,
+			  "chunk.c:88", "0x7f1234567890|s3", size,
+			  "dmalloc_t.c:1234");
+      return buf_p - buf;
+    }
+    else if (method == METHOD_APPEND) {
+      return loc_snprintf(buf, BUF_SIZE, FREE_FORMAT, "chunk.c:88",
+			  "0x7f1234567890|s3", size, "dmalloc_t.c:1234");
+    }
+    else {
+      return snprintf(buf, BUF_SIZE, FREE_FORMAT, "chunk.c:88",
+		      "0x7f1234567890|s3", size, "dmalloc_t.c:1234");
+    }
+  
+  default:
+    if (method == METHOD_CACHED) {
+      buf_p = desc_format(buf, limit, &descs[2], NUMBER_FORMAT, -size,
+			  (unsigned long)iter_c * 2654435761UL,
+			  (unsigned long)iter_c + 1, (unsigned long)size,
+			  (int)(iter_c & 0xff));
+      return buf_p - buf;
+    }
+    else if (method == METHOD_APPEND) {
+      return loc_snprintf(buf, BUF_SIZE, NUMBER_FORMAT, -size,
+			  (unsigned long)iter_c * 2654435761UL,
+			  (unsigned long)iter_c + 1, (unsigned long)size,
+			  (int)(iter_c & 0xff));
+    }
+    else {
+      return snprintf(buf, BUF_SIZE, NUMBER_FORMAT, -size,
+		      (unsigned long)iter_c * 2654435761UL,
+		      (unsigned long)iter_c + 1, (unsigned long)size,
+		      (int)(iter_c & 0xff));
+    }
+  }
+}
+
+int	main(int argc, char **argv)
+{
+  char		buf[BUF_SIZE], expected[BUF_SIZE];
+  unsigned long	iter_c, iter_n = DEFAULT_ITERATIONS, total;
+  int		method, which, len, exp_len, final = 0;
+  clock_t	start;
+  double	nsecs;
+  
+  if (argc > 1) {
+    iter_n = (unsigned long)atol(argv[1]);
+    if (iter_n == 0) {
+      iter_n = 1;
+    }
+  }
+  
+  /* first make sure all of the methods agree with the system snprintf */
+  for (iter_c = 0; iter_c < 1000; iter_c++) {
+    for (which = 0; which < 3; which++) {
+      exp_len = format_one(METHOD_LIBC, which, iter_c * 7919, expected);
+      for (method = 0; method < METHOD_LIBC; method++) {
+	len = format_one(method, which, iter_c * 7919, buf);
+	if (len != exp_len || memcmp(buf, expected, len) != 0) {
+	  (void)fprintf(stderr, "%s output '%.*s' != snprintf '%.*s'\n",
+			method_names[method], len, buf, exp_len, expected);
+	  final = 1;
+	}
+      }
+    }
+  }
+  if (final != 0) {
+    exit(final);
+  }
+  
+  for (which = 0; which < 3; which++) {
+    for (method = 0; method < METHOD_N; method++) {
+      total = 0;
+      start = clock();
+      for (iter_c = 0; iter_c < iter_n; iter_c++) {
+	total += format_one(method, which, iter_c, buf);
+      }
+      nsecs = (double)(clock() - start) * 1000000000.0 / CLOCKS_PER_SEC;
+      (void)printf("format %d %-8s %8.1f ns/op (%lu bytes)\n",
+		   which, method_names[method], nsecs / (double)iter_n, total);
+    }
+  }
+  
+  exit(0);
+}
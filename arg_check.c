@@ -41,31 +41,51 @@
 #include "dmalloc.h"
 
 #include "chunk.h"
+#include "compat.h"				/* for strnlen */
 #include "debug_tok.h"
 #include "error.h"
 #include "dmalloc_loc.h"
 #include "arg_check.h"
 
 /*
- * Dummy function for checking strlen's arguments.
+ * Dummy function for checking strlen's arguments.  The string is
+ * checked and measured in the same pass.
  */
 static	int	loc_strlen(const char *file, const int line,
 			   const char *func, const char *str)
 {
-  int		len = 0;
-  const	char	*str_p;
+  DMALLOC_SIZE	len;
   
   if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_FUNCS)) {
-    if (! dmalloc_verify_pnt(file, line, func, str, 0 /* not exact */, -1)) {
+    if (! _dmalloc_verify_strlen(file, line, func, str, 0 /* no max */, 0,
+				 &len)) {
       dmalloc_message("bad pointer argument found in %s", func);
     }
+    return len;
   }
   
-  for (str_p = str; *str_p != '\0'; str_p++) {
-    len++;
+  return strlen(str);
+}
+
+/*
+ * Dummy function for checking strnlen's arguments.  The string is
+ * checked and measured up to max_len in the same pass.
+ */
+static	int	loc_strnlen(const char *file, const int line,
+			    const char *func, const char *str,
+			    const DMALLOC_SIZE max_len)
+{
+  DMALLOC_SIZE	len;
+  
+  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_FUNCS)) {
+    if (! _dmalloc_verify_strlen(file, line, func, str, 1 /* max */, max_len,
+				 &len)) {
+      dmalloc_message("bad pointer argument found in %s", func);
+    }
+    return len;
   }
   
-  return len;
+  return strnlen(str, max_len);
 }
 
 #if HAVE_ATOI
@@ -352,12 +372,11 @@ char	*_dmalloc_strcat(const char *file, const int line,
 			 char *to, const char *from)
 {
   if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_FUNCS)) {
-    if ((! dmalloc_verify_pnt(file, line, "strcat", to,
-			      0 /* not exact */,
-			      loc_strlen(file, line, "strcat", to)
-			      + loc_strlen(file, line, "strcat", from) + 1))
-	|| (! dmalloc_verify_pnt(file, line, "strcat", from,
-				 0 /* not exact */, -1))) {
+    /* loc_strlen checks the pointers while it measures them */
+    if (! dmalloc_verify_pnt(file, line, "strcat", to,
+			     0 /* not exact */,
+			     loc_strlen(file, line, "strcat", to)
+			     + loc_strlen(file, line, "strcat", from) + 1)) {
       dmalloc_message("bad pointer argument found in strcat");
     }
   }
@@ -409,11 +428,10 @@ char	*_dmalloc_strcpy(const char *file, const int line,
 			 char *to, const char *from)
 {
   if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_FUNCS)) {
-    if ((! dmalloc_verify_pnt(file, line, "strcpy", to,
-			      0 /* not exact */,
-			      loc_strlen(file, line, "strcpy", from) + 1))
-	|| (! dmalloc_verify_pnt(file, line, "strcpy", from,
-				 0 /* not exact */, -1))) {
+    /* loc_strlen checks the from pointer while it measures it */
+    if (! dmalloc_verify_pnt(file, line, "strcpy", to,
+			     0 /* not exact */,
+			     loc_strlen(file, line, "strcpy", from) + 1)) {
       dmalloc_message("bad pointer argument found in strcpy");
     }
   }
@@ -447,13 +465,6 @@ int	_dmalloc_strcspn(const char *file, const int line,
 DMALLOC_SIZE	_dmalloc_strlen(const char *file, const int line,
 				const char *str)
 {
-  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_FUNCS)) {
-    if (! dmalloc_verify_pnt(file, line, "strlen", str,
-			     0 /* not exact */, -1)) {
-      dmalloc_message("bad pointer argument found in strlen");
-    }
-  }
-  
   return loc_strlen(file, line, "strlen", str);
 }
 #endif
@@ -498,25 +509,14 @@ char	*_dmalloc_strncat(const char *file, const int line,
 			  char *to, const char *from, const DMALLOC_SIZE len)
 {
   if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_FUNCS)) {
-    const char	*from_p;
     int		min_size;
     
-    /* so we have to figure out the max length of the buffers directly here */
-    for (from_p = from; from_p < from + len; from_p++) {
-      if (*from_p == '\0') {
-	/* no need to do ++ here because we +1 for the \0 anyway */
-	break;
-      }
-    }
-    min_size = from_p - from;
-    
-    /* either len or nullc */
-    if ((! dmalloc_verify_pnt(file, line, "strncat", to,
-			      0 /* not exact */,
-			      loc_strlen(file, line, "strncat", to) + min_size
-			      + 1))
-	|| (! dmalloc_verify_pnt(file, line, "strncat", from,
-				 0 /* not exact */, min_size))) {
+    /* either len or nullc, the from pointer is checked while measured */
+    min_size = loc_strnlen(file, line, "strncat", from, len);
+    if (! dmalloc_verify_pnt(file, line, "strncat", to,
+			     0 /* not exact */,
+			     loc_strlen(file, line, "strncat", to) + min_size
+			     + 1)) {
       dmalloc_message("bad pointer argument found in strncat");
     }
   }
@@ -565,23 +565,15 @@ char	*_dmalloc_strncpy(const char *file, const int line,
 			  char *to, const char *from, const DMALLOC_SIZE len)
 {
   if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_FUNCS)) {
-    const char	*from_p;
     int		min_size;
     
-    /* so we have to figure out the max length of the buffers directly here */
-    for (from_p = from; from_p < from + len; from_p++) {
-      if (*from_p == '\0') {
-	from_p++;
-	break;
-      }
+    /* len or until nullc, the from pointer is checked while measured */
+    min_size = loc_strnlen(file, line, "strncpy", from, len);
+    if ((DMALLOC_SIZE)min_size < len) {
+      min_size++;
     }
-    min_size = from_p - from;
-    
-    /* len or until nullc */
-    if ((! dmalloc_verify_pnt(file, line, "strncpy", to,
-			      0 /* not exact */, min_size))
-	|| (! dmalloc_verify_pnt(file, line, "strncpy", from,
-				 0 /* not exact */, min_size))) {
+    if (! dmalloc_verify_pnt(file, line, "strncpy", to,
+			     0 /* not exact */, min_size)) {
       dmalloc_message("bad pointer argument found in strncpy");
     }
   }
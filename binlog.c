@@ -0,0 +1,489 @@
+/*
+ * Binary transaction log routines
+ *
+ * Copyright 2020 by Gray Watson
+ *
+ * This file is part of the dmalloc package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ *
+ * The author may be contacted via https://dmalloc.com/
+ */
+
+/*
+ * This file contains routines which write each allocation
+ * transaction to a log file as a fixed-size binary record instead of
+ * formatting a line of text for the log-trans token.  File-names are
+ * written once into a string table and the records refer to them by
+ * id.  The dmalloc utility can decode the log back into text.
+ */
+
+#include <fcntl.h>				/* for O_WRONLY, etc. */
+
+#if HAVE_STRING_H
+# include <string.h>
+#endif
+#if HAVE_UNISTD_H
+# include <unistd.h>				/* for write */
+#endif
+
+#define DMALLOC_DISABLE
+
+#include "conf.h"
+
+#if LOG_PNT_TIMEVAL
+# ifdef TIMEVAL_INCLUDE
+#  include TIMEVAL_INCLUDE
+# endif
+#else
+# if HAVE_TIME
+#  ifdef TIME_INCLUDE
+#   include TIME_INCLUDE
+#  endif
+# endif
+#endif
+
+#include "dmalloc.h"
+
+#include "binlog.h"
+#include "binlog_loc.h"
+#include "clock.h"
+#include "dmalloc_loc.h"
+#include "error.h"
+#include "leak.h"
+
+/* set to 1 when the transactions should be written to the binary log */
+int	_dmalloc_binlog_b = 0;
+
+/* local variables */
+static	char		binlog_path[512] = { '\0' }; /* path of the log */
+static	int		binlog_fd = -1;		/* fd of the log or -1 */
+static	binlog_rec_t	rec_buf[BINLOG_BUFFER_RECS]; /* records to write */
+static	int		rec_c = 0;		/* number of records in buf */
+static	const char	*file_keys[BINLOG_FILE_N]; /* file-names given ids */
+static	unsigned long	file_ids[BINLOG_FILE_N]; /* ids of the file-names */
+static	int		file_key_c = 0;		/* file-names in the table */
+static	unsigned long	file_id_c = 0;		/* last file-name id */
+
+/****************************** local utilities ******************************/
+
+/*
+ * static void close_log
+ *
+ * Close the log file if it is open and forget the file-name ids
+ * since they were defined in that file.
+ */
+static	void	close_log(void)
+{
+  if (binlog_fd >= 0) {
+    (void)close(binlog_fd);
+    binlog_fd = -1;
+  }
+  rec_c = 0;
+  memset(file_keys, 0, sizeof(file_keys));
+  file_key_c = 0;
+}
+
+/*
+ * static int open_log
+ *
+ * Open the log file and write the header.
+ *
+ * Returns 1 on success or 0 on failure.
+ */
+static	int	open_log(void)
+{
+  binlog_header_t	header;
+  
+  binlog_fd = open(binlog_path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (binlog_fd < 0) {
+    dmalloc_message("could not open binary log '%s'", binlog_path);
+    _dmalloc_binlog_b = 0;
+    return 0;
+  }
+  
+  memset(&header, 0, sizeof(header));
+  memcpy(header.bh_magic, BINLOG_MAGIC, BINLOG_MAGIC_SIZE);
+  header.bh_version = BINLOG_VERSION;
+  header.bh_byte_order = BINLOG_BYTE_ORDER;
+  header.bh_rec_size = sizeof(binlog_rec_t);
+  if (write(binlog_fd, &header, sizeof(header)) != sizeof(header)) {
+    dmalloc_message("could not write binary log '%s'", binlog_path);
+    close_log();
+    _dmalloc_binlog_b = 0;
+    return 0;
+  }
+  
+  return 1;
+}
+
+/*
+ * static void flush_recs
+ *
+ * Write the buffered records to the log file.
+ */
+static	void	flush_recs(void)
+{
+  int	size;
+  
+  if (rec_c == 0 || binlog_fd < 0) {
+    return;
+  }
+  
+  size = rec_c * sizeof(binlog_rec_t);
+  if (write(binlog_fd, rec_buf, size) != size) {
+    dmalloc_message("could not write binary log '%s'", binlog_path);
+    close_log();
+    _dmalloc_binlog_b = 0;
+    return;
+  }
+  rec_c = 0;
+}
+
+/*
+ * static binlog_rec_t *get_recs
+ *
+ * Get a number of clear records from the buffer, opening the log if
+ * needed and flushing it if the records do not fit.
+ *
+ * Returns a pointer to the first record or NULL on error.
+ *
+ * ARGUMENTS:
+ *
+ * rec_n -> Number of records we need.
+ */
+static	binlog_rec_t	*get_recs(const int rec_n)
+{
+  binlog_rec_t	*rec_p;
+  
+  if (binlog_fd < 0 && (! open_log())) {
+    return NULL;
+  }
+  if (rec_c + rec_n > BINLOG_BUFFER_RECS) {
+    flush_recs();
+    if (binlog_fd < 0) {
+      return NULL;
+    }
+  }
+  
+  rec_p = rec_buf + rec_c;
+  memset(rec_p, 0, rec_n * sizeof(binlog_rec_t));
+  rec_c += rec_n;
+  
+  return rec_p;
+}
+
+/*
+ * static unsigned long file_id
+ *
+ * Get the id of a file-name, writing a string entry into the log the
+ * first time that we see the file-name.
+ *
+ * Returns the id of the file-name or the return-address if there is
+ * no line-number.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address of the call-site.
+ *
+ * line -> Line-number of the call-site.
+ */
+static	unsigned long	file_id(const char *file, const unsigned int line)
+{
+  binlog_rec_t	*rec_p;
+  unsigned int	hash_c;
+  int		len;
+  
+  if (line == DMALLOC_DEFAULT_LINE) {
+    return (PNT_ARITH_TYPE)file;
+  }
+  if (file == DMALLOC_DEFAULT_FILE) {
+    return 0;
+  }
+  
+  /* the file-names are constant strings so we look them up by pointer */
+  hash_c = ((PNT_ARITH_TYPE)file >> 2) % BINLOG_FILE_N;
+  while (file_keys[hash_c] != NULL) {
+    if (file_keys[hash_c] == file) {
+      return file_ids[hash_c];
+    }
+    hash_c = (hash_c + 1) % BINLOG_FILE_N;
+  }
+  
+  /* forget the ids if the table gets full since we can write them again */
+  if (file_key_c >= BINLOG_FILE_N / 2) {
+    memset(file_keys, 0, sizeof(file_keys));
+    file_key_c = 0;
+    hash_c = ((PNT_ARITH_TYPE)file >> 2) % BINLOG_FILE_N;
+  }
+  
+  /* write the name after a file record padded to the record size */
+  len = strlen(file);
+  if (len > MAX_FILE_LENGTH) {
+    len = MAX_FILE_LENGTH;
+  }
+  rec_p = get_recs(1 + (len + sizeof(binlog_rec_t) - 1)
+		   / sizeof(binlog_rec_t));
+  if (rec_p == NULL) {
+    return 0;
+  }
+  file_id_c++;
+  rec_p->br_op = BINLOG_OP_FILE;
+  rec_p->br_file = file_id_c;
+  rec_p->br_size = len;
+  memcpy(rec_p + 1, file, len);
+  
+  file_keys[hash_c] = file;
+  file_ids[hash_c] = file_id_c;
+  file_key_c++;
+  
+  return file_id_c;
+}
+
+/*
+ * static binlog_rec_t *get_trans_rec
+ *
+ * Get a record for a transaction filled in with its call-sites,
+ * iteration, and time.
+ *
+ * Returns a pointer to the record or NULL on error.
+ *
+ * ARGUMENTS:
+ *
+ * op -> BINLOG_OP_ type of the transaction.
+ *
+ * func_id -> Function ID of the call.
+ *
+ * file -> File-name or return-address of the call-site.
+ *
+ * line -> Line-number of the call-site.
+ *
+ * old_file -> File-name or return-address of the original allocation.
+ *
+ * old_line -> Line-number of the original allocation.
+ */
+static	binlog_rec_t	*get_trans_rec(const int op, const int func_id,
+				       const char *file,
+				       const unsigned int line,
+				       const char *old_file,
+				       const unsigned int old_line)
+{
+  binlog_rec_t	*rec_p;
+  unsigned long	file_val, old_file_val = 0;
+#if LOG_PNT_TIMEVAL
+  TIMEVAL_TYPE	now;
+#endif
+  
+  /* NOTE: the file ids need to be found first since they may write records */
+  file_val = file_id(file, line);
+  if (op != BINLOG_OP_ALLOC) {
+    old_file_val = file_id(old_file, old_line);
+  }
+  
+  rec_p = get_recs(1);
+  if (rec_p == NULL) {
+    return NULL;
+  }
+  
+  rec_p->br_op = op;
+  rec_p->br_func_id = func_id;
+  rec_p->br_line = line;
+  rec_p->br_file = file_val;
+  rec_p->br_old_line = old_line;
+  rec_p->br_old_file = old_file_val;
+  rec_p->br_iter = _dmalloc_iter_c;
+#if LOG_PNT_TIMEVAL
+  _dmalloc_clock_timeval(&now);
+  rec_p->br_secs = now.tv_sec;
+  rec_p->br_usecs = now.tv_usec;
+#else
+#if HAVE_TIME
+  rec_p->br_secs = _dmalloc_clock_seconds();
+#endif
+#endif
+  
+  return rec_p;
+}
+
+/**************************** exported routines ******************************/
+
+/*
+ * void _dmalloc_binlog_setup
+ *
+ * Set the path of the binary transaction log.  If the path has
+ * changed then the current log is flushed and closed and the new one
+ * will be opened with the next transaction.
+ *
+ * ARGUMENTS:
+ *
+ * path -> Path of the log or NULL to not write one.
+ */
+void	_dmalloc_binlog_setup(const char *path)
+{
+  if (path == NULL) {
+    flush_recs();
+    close_log();
+    _dmalloc_binlog_b = 0;
+    binlog_path[0] = '\0';
+    return;
+  }
+  
+  if (strcmp(path, binlog_path) != 0) {
+    flush_recs();
+    close_log();
+    (void)strncpy(binlog_path, path, sizeof(binlog_path));
+    binlog_path[sizeof(binlog_path) - 1] = '\0';
+  }
+  /* the records are not roots of the leak scan */
+  _dmalloc_leak_skip(rec_buf, sizeof(rec_buf));
+  _dmalloc_binlog_b = 1;
+}
+
+/*
+ * void _dmalloc_binlog_flush
+ *
+ * Write any buffered records to the binary transaction log.
+ */
+void	_dmalloc_binlog_flush(void)
+{
+  flush_recs();
+}
+
+/*
+ * void _dmalloc_binlog_alloc
+ *
+ * Write an allocation transaction to the binary log.
+ *
+ * ARGUMENTS:
+ *
+ * func_id -> Function ID of the call.
+ *
+ * file -> File-name or return-address of the call-site.
+ *
+ * line -> Line-number of the call-site.
+ *
+ * pnt -> User pointer that was allocated.
+ *
+ * size -> Number of bytes that the user asked for.
+ *
+ * alignment -> Alignment that the user asked for or 0 if none.
+ *
+ * thread -> Id of the calling thread or 0 if not threaded.
+ */
+void	_dmalloc_binlog_alloc(const int func_id, const char *file,
+			      const unsigned int line, const void *pnt,
+			      const unsigned long size,
+			      const unsigned int alignment,
+			      const unsigned long thread)
+{
+  binlog_rec_t	*rec_p;
+  
+  rec_p = get_trans_rec(BINLOG_OP_ALLOC, func_id, file, line, NULL, 0);
+  if (rec_p == NULL) {
+    return;
+  }
+  rec_p->br_pnt = (PNT_ARITH_TYPE)pnt;
+  rec_p->br_size = size;
+  rec_p->br_align = alignment;
+  rec_p->br_thread = thread;
+}
+
+/*
+ * void _dmalloc_binlog_free
+ *
+ * Write a free transaction to the binary log.
+ *
+ * ARGUMENTS:
+ *
+ * func_id -> Function ID of the call.
+ *
+ * file -> File-name or return-address of the call-site.
+ *
+ * line -> Line-number of the call-site.
+ *
+ * pnt -> User pointer that was freed.
+ *
+ * size -> Number of bytes that the user had asked for.
+ *
+ * alloc_file -> File-name or return-address of the allocation.
+ *
+ * alloc_line -> Line-number of the allocation.
+ *
+ * thread -> Id of the calling thread or 0 if not threaded.
+ */
+void	_dmalloc_binlog_free(const int func_id, const char *file,
+			     const unsigned int line, const void *pnt,
+			     const unsigned long size, const char *alloc_file,
+			     const unsigned int alloc_line,
+			     const unsigned long thread)
+{
+  binlog_rec_t	*rec_p;
+  
+  rec_p = get_trans_rec(BINLOG_OP_FREE, func_id, file, line, alloc_file,
+			alloc_line);
+  if (rec_p == NULL) {
+    return;
+  }
+  rec_p->br_pnt = (PNT_ARITH_TYPE)pnt;
+  rec_p->br_size = size;
+  rec_p->br_thread = thread;
+}
+
+/*
+ * void _dmalloc_binlog_realloc
+ *
+ * Write a reallocation transaction to the binary log.
+ *
+ * ARGUMENTS:
+ *
+ * func_id -> Function ID of the call.
+ *
+ * file -> File-name or return-address of the call-site.
+ *
+ * line -> Line-number of the call-site.
+ *
+ * old_pnt -> User pointer that was passed in.
+ *
+ * old_size -> Number of bytes of the old pointer.
+ *
+ * old_file -> File-name or return-address of the old allocation.
+ *
+ * old_line -> Line-number of the old allocation.
+ *
+ * new_pnt -> User pointer that was returned.
+ *
+ * new_size -> Number of bytes that the user asked for.
+ *
+ * thread -> Id of the calling thread or 0 if not threaded.
+ */
+void	_dmalloc_binlog_realloc(const int func_id, const char *file,
+				const unsigned int line, const void *old_pnt,
+				const unsigned long old_size,
+				const char *old_file,
+				const unsigned int old_line,
+				const void *new_pnt,
+				const unsigned long new_size,
+				const unsigned long thread)
+{
+  binlog_rec_t	*rec_p;
+  
+  rec_p = get_trans_rec(BINLOG_OP_REALLOC, func_id, file, line, old_file,
+			old_line);
+  if (rec_p == NULL) {
+    return;
+  }
+  rec_p->br_pnt = (PNT_ARITH_TYPE)new_pnt;
+  rec_p->br_size = new_size;
+  rec_p->br_old_pnt = (PNT_ARITH_TYPE)old_pnt;
+  rec_p->br_old_size = old_size;
+  rec_p->br_thread = thread;
+}
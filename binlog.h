@@ -0,0 +1,150 @@
+/*
+ * Defines for the binary transaction log routines.
+ *
+ * Copyright 2020 by Gray Watson
+ *
+ * This file is part of the dmalloc package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ *
+ * The author may be contacted via https://dmalloc.com/
+ */
+
+#ifndef __BINLOG_H__
+#define __BINLOG_H__
+
+/*<<<<<<<<<<  The below prototypes are auto-generated by fillproto */
+
+/* set to 1 when the transactions should be written to the binary log */
+extern
+int	_dmalloc_binlog_b;
+
+/*
+ * void _dmalloc_binlog_setup
+ *
+ * Set the path of the binary transaction log.  If the path has
+ * changed then the current log is flushed and closed and the new one
+ * will be opened with the next transaction.
+ *
+ * ARGUMENTS:
+ *
+ * path -> Path of the log or NULL to not write one.
+ */
+extern
+void	_dmalloc_binlog_setup(const char *path);
+
+/*
+ * void _dmalloc_binlog_flush
+ *
+ * Write any buffered records to the binary transaction log.
+ */
+extern
+void	_dmalloc_binlog_flush(void);
+
+/*
+ * void _dmalloc_binlog_alloc
+ *
+ * Write an allocation transaction to the binary log.
+ *
+ * ARGUMENTS:
+ *
+ * func_id -> Function ID of the call.
+ *
+ * file -> File-name or return-address of the call-site.
+ *
+ * line -> Line-number of the call-site.
+ *
+ * pnt -> User pointer that was allocated.
+ *
+ * size -> Number of bytes that the user asked for.
+ *
+ * alignment -> Alignment that the user asked for or 0 if none.
+ *
+ * thread -> Id of the calling thread or 0 if not threaded.
+ */
+extern
+void	_dmalloc_binlog_alloc(const int func_id, const char *file,
+			      const unsigned int line, const void *pnt,
+			      const unsigned long size,
+			      const unsigned int alignment,
+			      const unsigned long thread);
+
+/*
+ * void _dmalloc_binlog_free
+ *
+ * Write a free transaction to the binary log.
+ *
+ * ARGUMENTS:
+ *
+ * func_id -> Function ID of the call.
+ *
+ * file -> File-name or return-address of the call-site.
+ *
+ * line -> Line-number of the call-site.
+ *
+ * pnt -> User pointer that was freed.
+ *
+ * size -> Number of bytes that the user had asked for.
+ *
+ * alloc_file -> File-name or return-address of the allocation.
+ *
+ * alloc_line -> Line-number of the allocation.
+ *
+ * thread -> Id of the calling thread or 0 if not threaded.
+ */
+extern
+void	_dmalloc_binlog_free(const int func_id, const char *file,
+			     const unsigned int line, const void *pnt,
+			     const unsigned long size, const char *alloc_file,
+			     const unsigned int alloc_line,
+			     const unsigned long thread);
+
+/*
+ * void _dmalloc_binlog_realloc
+ *
+ * Write a reallocation transaction to the binary log.
+ *
+ * ARGUMENTS:
+ *
+ * func_id -> Function ID of the call.
+ *
+ * file -> File-name or return-address of the call-site.
+ *
+ * line -> Line-number of the call-site.
+ *
+ * old_pnt -> User pointer that was passed in.
+ *
+ * old_size -> Number of bytes of the old pointer.
+ *
+ * old_file -> File-name or return-address of the old allocation.
+ *
+ * old_line -> Line-number of the old allocation.
+ *
+ * new_pnt -> User pointer that was returned.
+ *
+ * new_size -> Number of bytes that the user asked for.
+ *
+ * thread -> Id of the calling thread or 0 if not threaded.
+ */
+extern
+void	_dmalloc_binlog_realloc(const int func_id, const char *file,
+				const unsigned int line, const void *old_pnt,
+				const unsigned long old_size,
+				const char *old_file,
+				const unsigned int old_line,
+				const void *new_pnt,
+				const unsigned long new_size,
+				const unsigned long thread);
+
+/*<<<<<<<<<<   This is end of the auto-generated output from fillproto. */
+
+#endif /* ! __BINLOG_H__ */
@@ -0,0 +1,162 @@
+/*
+ * Local defines for the binary transaction log routines.
+ *
+ * Copyright 2020 by Gray Watson
+ *
+ * This file is part of the dmalloc package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ *
+ * The author may be contacted via https://dmalloc.com/
+ */
+
+#ifndef __BINLOG_LOC_H__
+#define __BINLOG_LOC_H__
+
+/*
+ * NOTE: this file is also used by the dmalloc utility to decode the
+ * log so it should only have the file format definitions.  The
+ * records are written in the native byte order and word size so a
+ * log needs to be decoded on a similar system.
+ */
+
+/* magic string at the start of the log and the version of the format */
+#define BINLOG_MAGIC		"DMBL"
+#define BINLOG_MAGIC_SIZE	4
+#define BINLOG_VERSION		2
+
+/* written into the header so the decoder can check the byte order */
+#define BINLOG_BYTE_ORDER	0x01020304
+
+/* number of records that we buffer before writing them to the log */
+#define BINLOG_BUFFER_RECS	256
+
+/* number of file-names whose string-table ids we remember */
+#define BINLOG_FILE_N		1024
+
+/* types of the records in the log */
+#define BINLOG_OP_FILE		1		/* file-name string entry */
+#define BINLOG_OP_ALLOC		2		/* malloc, calloc, etc. */
+#define BINLOG_OP_FREE		3		/* free, delete, etc. */
+#define BINLOG_OP_REALLOC	4		/* realloc or recalloc */
+
+/*
+ * Header at the very start of the log file.
+ */
+typedef struct {
+  char			bh_magic[BINLOG_MAGIC_SIZE]; /* BINLOG_MAGIC no null */
+  unsigned int		bh_version;		/* BINLOG_VERSION */
+  unsigned int		bh_byte_order;		/* BINLOG_BYTE_ORDER */
+  unsigned int		bh_rec_size;		/* sizeof(binlog_rec_t) */
+} binlog_header_t;
+
+/*
+ * Each transaction is written as one of these fixed-size records.
+ * The call-site of a transaction is a string-table id in br_file and
+ * a line-number or, if the line-number is 0, a return-address in
+ * br_file.  A BINLOG_OP_FILE record defines the file-name of id
+ * br_file.  It is followed by br_size bytes of name padded out to a
+ * multiple of the record size.  The alignment is 0 unless an
+ * allocation asked for one and the thread-id is 0 unless written by
+ * the threaded library.  This is enough to replay the transactions.
+ */
+typedef struct {
+  unsigned short	br_op;			/* BINLOG_OP_ type of record */
+  unsigned short	br_func_id;		/* DMALLOC_FUNC_ of the call */
+  unsigned int		br_usecs;		/* micro-secs of timestamp */
+  unsigned int		br_line;		/* line of the call-site */
+  unsigned int		br_old_line;		/* line of original alloc */
+  unsigned int		br_align;		/* alignment of memalign */
+  unsigned long		br_file;		/* file id or return-address */
+  unsigned long		br_old_file;		/* file of original alloc */
+  unsigned long		br_iter;		/* iteration of transaction */
+  unsigned long		br_secs;		/* seconds of timestamp */
+  unsigned long		br_pnt;			/* user pointer */
+  unsigned long		br_size;		/* user size */
+  unsigned long		br_old_pnt;		/* realloc old pointer */
+  unsigned long		br_old_size;		/* size of original alloc */
+  unsigned long		br_thread;		/* id of the calling thread */
+} binlog_rec_t;
+
+/*
+ * The flight recorder keeps the most recent transactions as the same
+ * records in a ring inside of a memory-mapped file.  The file starts
+ * with the header below followed by fh_name_n file-name entries of
+ * fh_name_size bytes each and then by the ring of fh_rec_n records.
+ * Id N in a br_file field refers to the N-1th file-name entry.
+ */
+#define FLIGHT_MAGIC		"DMFR"
+#define FLIGHT_VERSION		2
+
+/* number of file-names that the flight recorder holds and their size */
+#define FLIGHT_NAME_N		512
+#define FLIGHT_NAME_SIZE	64
+
+/*
+ * Header at the very start of the flight recorder file.
+ */
+typedef struct {
+  char			fh_magic[BINLOG_MAGIC_SIZE]; /* FLIGHT_MAGIC no null */
+  unsigned int		fh_version;		/* FLIGHT_VERSION */
+  unsigned int		fh_byte_order;		/* BINLOG_BYTE_ORDER */
+  unsigned int		fh_rec_size;		/* sizeof(binlog_rec_t) */
+  unsigned int		fh_name_n;		/* number of file-names */
+  unsigned int		fh_name_size;		/* size of each file-name */
+  unsigned long		fh_pid;			/* process that wrote it */
+  unsigned long		fh_rec_n;		/* records in the ring */
+  unsigned long		fh_written_c;		/* records ever written */
+} flight_header_t;
+
+/*
+ * A heap snapshot from dmalloc_snapshot() has the pointers in use at
+ * the time.  The file starts with the header below followed by the
+ * records.  A record with a 0 sr_pnt defines the file-name of id
+ * sr_file and is followed by sr_size bytes of name padded out to a
+ * multiple of the record size.  The call-site of a pointer is a
+ * file-name id in sr_file and a line-number or, if the line-number is
+ * 0, a return-address in sr_file.  The ids are only good inside of
+ * one snapshot.
+ */
+#define SNAPSHOT_MAGIC		"DMSS"
+#define SNAPSHOT_VERSION	1
+
+/* number of records that we buffer before writing them to the file */
+#define SNAPSHOT_BUFFER_RECS	256
+
+/*
+ * Header at the very start of the snapshot file.
+ */
+typedef struct {
+  char			sh_magic[BINLOG_MAGIC_SIZE]; /* SNAPSHOT_MAGIC no null */
+  unsigned int		sh_version;		/* SNAPSHOT_VERSION */
+  unsigned int		sh_byte_order;		/* BINLOG_BYTE_ORDER */
+  unsigned int		sh_rec_size;		/* sizeof(snapshot_rec_t) */
+  unsigned long		sh_pid;			/* process that wrote it */
+  unsigned long		sh_secs;		/* time it was taken */
+  unsigned long		sh_iter;		/* mark it was taken at */
+} snapshot_header_t;
+
+/*
+ * One pointer in use.  The flags are the library's internal flags of
+ * the slot.
+ */
+typedef struct {
+  unsigned long		sr_pnt;			/* user pointer or 0 */
+  unsigned long		sr_file;		/* file id or return-address */
+  unsigned long		sr_iter;		/* iteration of last change */
+  unsigned int		sr_size;		/* user size */
+  unsigned int		sr_total_size;		/* size with the overhead */
+  unsigned int		sr_line;		/* line of the call-site */
+  unsigned int		sr_flags;		/* flags of the slot */
+} snapshot_rec_t;
+
+#endif /* ! __BINLOG_LOC_H__ */
@@ -25,6 +25,7 @@
  */
 
 #include <ctype.h>
+#include <stddef.h>				/* for offsetof */
 
 #if HAVE_STRING_H
 # include <string.h>
@@ -49,11 +50,19 @@
 # endif
 #endif
 
+#if LOCK_THREADS
+# ifdef THREAD_INCLUDE
+#  include THREAD_INCLUDE
+# endif
+#endif
+
 #include "dmalloc.h"
 
 #include "append.h"
+#include "binlog.h"
 #include "chunk.h"
 #include "chunk_loc.h"
+#include "clock.h"
 #include "compat.h"
 #include "debug_tok.h"
 #include "dmalloc_loc.h"
@@ -61,7 +70,10 @@
 #include "dmalloc_tab.h"
 #include "error.h"
 #include "error_val.h"
+#include "flight.h"
 #include "heap.h"
+#include "leak.h"
+#include "profile.h"
 
 /*
  * Library Copyright and URL information for ident and what programs
@@ -84,6 +96,13 @@ static char *information = "@(#) $Information: lock-threads is enabled $";
 #endif
 #endif
 
+/* id of the calling thread for the binary log */
+#if LOCK_THREADS
+#define BINLOG_THREAD_ID()	((unsigned long)THREAD_GET_ID())
+#else
+#define BINLOG_THREAD_ID()	0
+#endif
+
 /*
  * exported variables
  */
@@ -93,6 +112,9 @@ unsigned long		_dmalloc_memory_limit = 0;
 /* total number of bytes that the heap has allocated */
 unsigned long		_dmalloc_alloc_total = 0;
 
+/* changed each time a pointer is freed or its size is changed */
+volatile unsigned long	_dmalloc_free_epoch = 0;
+
 /*
  * local variables
  */
@@ -121,6 +143,17 @@ static	entry_block_t	*entry_blocks[MAX_SKIP_LEVEL];
 /* linked list of freed blocks on hold waiting for the FREED_POINTER_DELAY */
 static	skip_alloc_t	*free_wait_list_head = NULL;
 static	skip_alloc_t	*free_wait_list_tail = NULL;
+/* list of the slots in the order they were last used, oldest first */
+static	skip_alloc_t	*recent_list_head = NULL;
+static	skip_alloc_t	*recent_list_tail = NULL;
+
+/* slots reached by the leak scan whose memory still needs scanning */
+static	skip_alloc_t	*mark_stack[MARK_STACK_SIZE];
+static	int		mark_stack_c = 0;
+static	int		mark_overflow_b = 0;	/* reached slots not stacked */
+
+/* pointers being sorted by dmalloc_verify_many */
+static	verify_pnt_t	verify_batch[VERIFY_BATCH_SIZE];
 
 /* administrative structures */
 static	char		fence_bottom[FENCE_BOTTOM_SIZE];
@@ -132,6 +165,11 @@ static	mem_table_t	mem_table_alloc;
 static	mem_entry_t	mem_table_alloc_entries[MEM_ALLOC_ENTRIES];
 static	mem_table_t	mem_table_changed;
 static	mem_entry_t	mem_table_changed_entries[MEM_ALLOC_ENTRIES];
+static	int		table_grow_failed_b = 0; /* could not grow a table */
+
+/* per file or per call-site memory budgets */
+static	budget_t	budgets[MEMORY_BUDGET_MAX];
+static	int		budget_n = 0;
 
 /* memory stats */
 static	unsigned long	alloc_current = 0;	/* current memory usage */
@@ -162,6 +200,13 @@ static	unsigned long	func_new_c = 0;		/* count the news */
 static	unsigned long	func_free_c = 0;	/* count the frees */
 static	unsigned long	func_delete_c = 0;	/* count the deletes */
 
+/* formats of the per-transaction messages so they are only parsed once */
+static	append_format_t	alloc_format;		/* log-trans alloc */
+static	append_format_t	free_format;		/* log-trans free */
+static	append_format_t	realloc_format;		/* log-trans realloc */
+static	append_format_t	changed_format;		/* log-changed pointer */
+static	append_format_t	unreachable_format;	/* log-unreachable pnt */
+
 /**************************** skip list routines *****************************/
 
 /*
@@ -201,47 +246,33 @@ static	int	random_level(const int max_level)
 }
 
 /*
- * static skip_alloc_t *find_address
+ * static skip_alloc_t *search_address
  *
- * Look for a specific address in the skip list.  If it exist then a
- * pointer to the matching slot is returned otherwise NULL.  Either
- * way, the links that were traversed to get there are set in the
- * update slot which has the maximum number of levels.
+ * Search down through the levels of a skip list from a slot for a
+ * specific address.  The links that were traversed are set in the
+ * update slot for the levels that we search.
  *
- * RETURNS:
+ * Returns a pointer to the slot that matches the address or NULL.
  *
- * Success - Pointer to the slot which matches the block-num and size
- * pair.
+ * ARGUMENTS:
  *
- * Failure - NULL and this will not set dmalloc_errno
+ * slot_p -> Slot before the address where we start the search.
  *
- * ARGUMENTS:
+ * level_c -> Level that we start the search at.
  *
  * address -> Address we are looking for.
  *
- * free_b -> Look on the free list otherwise look on the used list.
- *
  * exact_b -> Set to 1 to find the exact pointer.  If 0 then the
  * address could be inside a block.
  *
  * update_p -> Pointer to the skip_alloc entry we are using to hold
  * the update pointers.
  */
-static	skip_alloc_t	*find_address(const void *address, const int free_b,
-				      const int exact_b,
-				      skip_alloc_t *update_p)
+static	skip_alloc_t	*search_address(skip_alloc_t *slot_p, int level_c,
+					const void *address, const int exact_b,
+					skip_alloc_t *update_p)
 {
-  int		level_c;
-  skip_alloc_t 	*slot_p, *found_p = NULL, *next_p;
-  
-  /* skip_address_max_level */
-  level_c = MAX_SKIP_LEVEL - 1;
-  if (free_b) {
-    slot_p = skip_free_list;
-  }
-  else {
-    slot_p = skip_address_list;
-  }
+  skip_alloc_t 	*found_p = NULL, *next_p;
   
   /* traverse list to smallest entry */
   while (1) {
@@ -295,6 +326,181 @@ static	skip_alloc_t	*find_address(const void *address, const int free_b,
   return found_p;
 }
 
+/*
+ * static skip_alloc_t *find_address
+ *
+ * Look for a specific address in the skip list.  If it exist then a
+ * pointer to the matching slot is returned otherwise NULL.  Either
+ * way, the links that were traversed to get there are set in the
+ * update slot which has the maximum number of levels.
+ *
+ * RETURNS:
+ *
+ * Success - Pointer to the slot which matches the block-num and size
+ * pair.
+ *
+ * Failure - NULL and this will not set dmalloc_errno
+ *
+ * ARGUMENTS:
+ *
+ * address -> Address we are looking for.
+ *
+ * free_b -> Look on the free list otherwise look on the used list.
+ *
+ * exact_b -> Set to 1 to find the exact pointer.  If 0 then the
+ * address could be inside a block.
+ *
+ * update_p -> Pointer to the skip_alloc entry we are using to hold
+ * the update pointers.
+ */
+static	skip_alloc_t	*find_address(const void *address, const int free_b,
+				      const int exact_b,
+				      skip_alloc_t *update_p)
+{
+  skip_alloc_t 	*slot_p, *found_p;
+  unsigned long	cost;
+  
+  COST_START(cost);
+  
+  if (free_b) {
+    slot_p = skip_free_list;
+  }
+  else {
+    slot_p = skip_address_list;
+  }
+  
+  /* skip_address_max_level */
+  found_p = search_address(slot_p, MAX_SKIP_LEVEL - 1, address, exact_b,
+			   update_p);
+  
+  COST_STOP(DMALLOC_COST_SKIP, cost);
+  return found_p;
+}
+
+/*
+ * static skip_alloc_t *find_address_after
+ *
+ * Look for an address in the used list that is not below the address
+ * of the last find_address or find_address_after call with the same
+ * update slot.  We only climb as many levels as we need to from the
+ * links of the last search so a run of sorted addresses costs about
+ * as much as one walk of the list.
+ *
+ * Returns a pointer to the slot that holds the address or NULL.
+ *
+ * ARGUMENTS:
+ *
+ * address -> Address we are looking for.
+ *
+ * update_p -> Pointer to the skip_alloc entry with the update
+ * pointers from the last search which we update.
+ */
+static	skip_alloc_t	*find_address_after(const void *address,
+					    skip_alloc_t *update_p)
+{
+  skip_alloc_t 	*found_p, *next_p, **update_links, **next_links;
+  int		level_c;
+  unsigned long	cost;
+  
+  COST_START(cost);
+  
+  /*
+   * The update slot is SKIP_SLOT_SIZE(MAX_SKIP_LEVEL) bytes so its
+   * links run past the end of the declared sa_next_p array.
+   */
+  update_links = (skip_alloc_t **)((char *)update_p
+				   + offsetof(skip_alloc_t, sa_next_p));
+  
+  /* go up while the next slot on the level above is not past the address */
+  for (level_c = 0; level_c < MAX_SKIP_LEVEL - 1; level_c++) {
+    if (update_links[level_c + 1] == NULL) {
+      break;
+    }
+    next_links = (skip_alloc_t **)((char *)update_links[level_c + 1]
+				   + offsetof(skip_alloc_t, sa_next_p));
+    next_p = next_links[level_c + 1];
+    if (next_p == NULL || (char *)next_p->sa_mem > (char *)address) {
+      break;
+    }
+  }
+  
+  if (update_links[level_c] == NULL) {
+    /* we have nothing to go on from so start at the top */
+    found_p = search_address(skip_address_list, MAX_SKIP_LEVEL - 1, address,
+			     0 /* not exact */, update_p);
+  }
+  else {
+    found_p = search_address(update_links[level_c], level_c, address,
+			     0 /* not exact */, update_p);
+  }
+  
+  COST_STOP(DMALLOC_COST_SKIP, cost);
+  return found_p;
+}
+
+/*
+ * static void sift_pnts
+ *
+ * Move a pointer down the heap used by sort_pnts until the pointers
+ * below it are lower.
+ *
+ * ARGUMENTS:
+ *
+ * pnts <-> Array of the pointers in the heap.
+ *
+ * root_c -> Index of the pointer that we are moving down.
+ *
+ * end_c -> Number of the pointers in the heap.
+ */
+static	void	sift_pnts(verify_pnt_t *pnts, int root_c, const int end_c)
+{
+  verify_pnt_t	hold;
+  int		child_c;
+  
+  hold = pnts[root_c];
+  for (child_c = root_c * 2 + 1; child_c < end_c;
+       child_c = root_c * 2 + 1) {
+    if (child_c + 1 < end_c
+	&& (char *)pnts[child_c + 1].vp_pnt > (char *)pnts[child_c].vp_pnt) {
+      child_c++;
+    }
+    if ((char *)pnts[child_c].vp_pnt <= (char *)hold.vp_pnt) {
+      break;
+    }
+    pnts[root_c] = pnts[child_c];
+    root_c = child_c;
+  }
+  pnts[root_c] = hold;
+}
+
+/*
+ * static void sort_pnts
+ *
+ * Sort pointers by address with a heap-sort which needs no memory
+ * since we cannot allocate it here.
+ *
+ * ARGUMENTS:
+ *
+ * pnts <-> Array of the pointers that we sort.
+ *
+ * pnt_n -> Number of the pointers in the array.
+ */
+static	void	sort_pnts(verify_pnt_t *pnts, const int pnt_n)
+{
+  verify_pnt_t	hold;
+  int		pnt_c;
+  
+  for (pnt_c = pnt_n / 2 - 1; pnt_c >= 0; pnt_c--) {
+    sift_pnts(pnts, pnt_c, pnt_n);
+  }
+  for (pnt_c = pnt_n - 1; pnt_c > 0; pnt_c--) {
+    hold = pnts[0];
+    pnts[0] = pnts[pnt_c];
+    pnts[pnt_c] = hold;
+    sift_pnts(pnts, 0, pnt_c);
+  }
+}
+
 /*
  * static skip_alloc_t *find_free_size
  *
@@ -318,6 +524,9 @@ static	skip_alloc_t	*find_free_size(const unsigned int size,
 {
   int		level_c, cmp;
   skip_alloc_t 	*slot_p, *found_p = NULL, *next_p;
+  unsigned long	cost;
+  
+  COST_START(cost);
   
   /* skip_free_max_level */
   level_c = MAX_SKIP_LEVEL - 1;
@@ -358,6 +567,7 @@ static	skip_alloc_t	*find_free_size(const unsigned int size,
     }
     level_c--;
   }
+  COST_STOP(DMALLOC_COST_SKIP, cost);
   
   /* space should be free */
   if (found_p != NULL && (! BIT_IS_SET(found_p->sa_flags, ALLOC_FLAG_FREE))) {
@@ -388,6 +598,7 @@ static	int	insert_slot(skip_alloc_t *slot_p, const int free_b)
 {
   skip_alloc_t	*adjust_p, *update_p;
   int		level_c;
+  unsigned long	cost;
   
   update_p = skip_update;
   
@@ -410,6 +621,7 @@ static	int	insert_slot(skip_alloc_t *slot_p, const int free_b)
   }
   
   /* update the block skip list */
+  COST_START(cost);
   for (level_c = 0; level_c <= slot_p->sa_level_n; level_c++) {
     /*
      * We are inserting our new slot after each of the slots in the
@@ -421,6 +633,7 @@ static	int	insert_slot(skip_alloc_t *slot_p, const int free_b)
     slot_p->sa_next_p[level_c] = adjust_p->sa_next_p[level_c];
     adjust_p->sa_next_p[level_c] = slot_p;
   }
+  COST_STOP(DMALLOC_COST_SKIP, cost);
   
   return 1;
 }
@@ -514,8 +727,10 @@ static	int	remove_slot(skip_alloc_t *delete_p, skip_alloc_t *update_p)
 {
   skip_alloc_t	*adjust_p;
   int		level_c;
+  unsigned long	cost;
   
   /* update the block skip list */
+  COST_START(cost);
   for (level_c = 0; level_c <= MAX_SKIP_LEVEL; level_c++) {
     
     /*
@@ -542,6 +757,7 @@ static	int	remove_slot(skip_alloc_t *delete_p, skip_alloc_t *update_p)
      */
     adjust_p->sa_next_p[level_c] = delete_p->sa_next_p[level_c];
   }
+  COST_STOP(DMALLOC_COST_SKIP, cost);
   
   /*
    * Sanity check here, we should always have at least 1 pointer to
@@ -696,6 +912,96 @@ static	skip_alloc_t	*insert_address(void *address, const int free_b,
   return new_p;
 }
 
+/*
+ * static void recent_remove
+ *
+ * Take a slot out of the list of recently used slots if it is on it.
+ *
+ * ARGUMENTS:
+ *
+ * slot_p -> Slot that we are removing.
+ */
+static	void	recent_remove(skip_alloc_t *slot_p)
+{
+  if (slot_p->sa_older_p == NULL && recent_list_head != slot_p) {
+    /* not on the list */
+    return;
+  }
+  
+  if (slot_p->sa_older_p == NULL) {
+    recent_list_head = slot_p->sa_newer_p;
+  }
+  else {
+    slot_p->sa_older_p->sa_newer_p = slot_p->sa_newer_p;
+  }
+  if (slot_p->sa_newer_p == NULL) {
+    recent_list_tail = slot_p->sa_older_p;
+  }
+  else {
+    slot_p->sa_newer_p->sa_older_p = slot_p->sa_older_p;
+  }
+  slot_p->sa_older_p = NULL;
+  slot_p->sa_newer_p = NULL;
+}
+
+/*
+ * static void recent_touch
+ *
+ * Mark a slot as used at the current iteration and move it to the end
+ * of the list of recently used slots.  Since the iteration only goes
+ * up, the list stays sorted by the iteration of last use so the slots
+ * changed since a mark are the ones at the end of it.
+ *
+ * ARGUMENTS:
+ *
+ * slot_p -> Slot that we are marking as used.
+ */
+static	void	recent_touch(skip_alloc_t *slot_p)
+{
+  slot_p->sa_use_iter = _dmalloc_iter_c;
+  
+  if (recent_list_tail == slot_p) {
+    return;
+  }
+  recent_remove(slot_p);
+  
+  slot_p->sa_older_p = recent_list_tail;
+  if (recent_list_tail == NULL) {
+    recent_list_head = slot_p;
+  }
+  else {
+    recent_list_tail->sa_newer_p = slot_p;
+  }
+  recent_list_tail = slot_p;
+}
+
+/*
+ * static skip_alloc_t *recent_since
+ *
+ * Find the oldest slot that was used after a mark by walking back from
+ * the end of the list of recently used slots.  The cost is in the
+ * number of slots changed and not in the size of the heap.
+ *
+ * Returns the oldest slot used after the mark or NULL if none.  The
+ * rest follow it through the sa_newer_p pointers.
+ *
+ * ARGUMENTS:
+ *
+ * mark -> Dmalloc counter used to mark a specific time.
+ */
+static	skip_alloc_t	*recent_since(const unsigned long mark)
+{
+  skip_alloc_t	*slot_p, *since_p = NULL;
+  
+  for (slot_p = recent_list_tail;
+       slot_p != NULL && slot_p->sa_use_iter > mark;
+       slot_p = slot_p->sa_older_p) {
+    since_p = slot_p;
+  }
+  
+  return since_p;
+}
+
 /******************************* misc routines *******************************/
 
 /*
@@ -855,14 +1161,18 @@ static	char	*display_pnt(const void *user_pnt, const skip_alloc_t *alloc_p,
   buf_p = buf;
   bounds_p = buf_p + buf_size;
   
-  buf_p = append_format(buf_p, bounds_p, "%p", user_pnt);
+  /* NOTE: this is done for each logged transaction so we skip the formats */
+  buf_p = append_string(buf_p, bounds_p, "0x");
+  buf_p = append_pointer(buf_p, bounds_p, (PNT_ARITH_TYPE)user_pnt, 16);
   
 #if LOG_PNT_SEEN_COUNT
-  buf_p = append_format(buf_p, bounds_p, "|s%lu", alloc_p->sa_seen_c);
+  buf_p = append_string(buf_p, bounds_p, "|s");
+  buf_p = append_ulong(buf_p, bounds_p, alloc_p->sa_seen_c, 10);
 #endif
   
 #if LOG_PNT_ITERATION
-  buf_p = append_format(buf_p, bounds_p, "|i%lu", alloc_p->sa_iteration);
+  buf_p = append_string(buf_p, bounds_p, "|i");
+  buf_p = append_ulong(buf_p, bounds_p, alloc_p->sa_iteration, 10);
 #endif
   
   if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_ELAPSED_TIME)) {
@@ -1101,19 +1411,57 @@ static	void	log_error_info(const char *now_file,
  */
 static	int	fence_read(const pnt_info_t *info_p)
 {
+  unsigned long	cost;
+  int		ret = 1;
+  
+  COST_START(cost);
+  
   /* check magic numbers in bottom of allocation block */
   if (memcmp(fence_bottom, info_p->pi_fence_bottom, FENCE_BOTTOM_SIZE) != 0) {
     dmalloc_errno = DMALLOC_ERROR_UNDER_FENCE;
-    return 0;
+    ret = 0;
   }
-  
   /* check numbers at top of allocation block */
-  if (memcmp(fence_top, info_p->pi_fence_top, FENCE_TOP_SIZE) != 0) {
+  else if (memcmp(fence_top, info_p->pi_fence_top, FENCE_TOP_SIZE) != 0) {
     dmalloc_errno = DMALLOC_ERROR_OVER_FENCE;
-    return 0;
+    ret = 0;
   }
   
-  return 1;
+  COST_STOP(DMALLOC_COST_FENCE_CHECK, cost);
+  return ret;
+}
+
+/*
+ * static int blank_read
+ *
+ * Check that a region of memory is still filled with a blank
+ * character.
+ *
+ * Returns 1 if the bytes are all blank or 0 if any were overwritten.
+ *
+ * ARGUMENTS:
+ *
+ * start_p -> Start of the region that we are checking.
+ *
+ * bounds_p -> Bounds of the region that we are checking.
+ *
+ * blank_ch -> Character that the region should be filled with.
+ */
+static	int	blank_read(const char *start_p, const char *bounds_p,
+			   const char blank_ch)
+{
+  const char	*mem_p;
+  unsigned long	cost;
+  
+  COST_START(cost);
+  for (mem_p = start_p; mem_p < bounds_p; mem_p++) {
+    if (*mem_p != blank_ch) {
+      break;
+    }
+  }
+  COST_STOP(DMALLOC_COST_BLANK_CHECK, cost);
+  
+  return (mem_p >= bounds_p);
 }
 
 /*
@@ -1140,8 +1488,9 @@ static	int	fence_read(const pnt_info_t *info_p)
 static	void	clear_alloc(skip_alloc_t *slot_p, pnt_info_t *info_p,
 			    const unsigned int old_size, const int func_id)
 {
-  char	*start_p;
-  int	num;
+  char		*start_p;
+  int		num;
+  unsigned long	cost;
   
   /*
    * NOTE: The alloc blank flag is set so we blank a slot when it is
@@ -1167,7 +1516,9 @@ static	void	clear_alloc(skip_alloc_t *slot_p, pnt_info_t *info_p,
     num = (char *)info_p->pi_fence_bottom - (char *)info_p->pi_alloc_start;
     /* alloc-blank NOT free-blank */
     if (num > 0 && BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_BLANK)) {
+      COST_START(cost);
       memset(info_p->pi_alloc_start, ALLOC_BLANK_CHAR, num);
+      COST_STOP(DMALLOC_COST_BLANK_FILL, cost);
     }
   }
   
@@ -1183,14 +1534,18 @@ static	void	clear_alloc(skip_alloc_t *slot_p, pnt_info_t *info_p,
       memset(start_p, 0, num);
     }
     else if (BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_BLANK)) {
+      COST_START(cost);
       memset(start_p, ALLOC_BLANK_CHAR, num);
+      COST_STOP(DMALLOC_COST_BLANK_FILL, cost);
     }
   }
   
   /* write in fence-post info */
   if (info_p->pi_fence_b) {
+    COST_START(cost);
     memcpy(info_p->pi_fence_bottom, fence_bottom, FENCE_BOTTOM_SIZE);
     memcpy(info_p->pi_fence_top, fence_top, FENCE_TOP_SIZE);
+    COST_STOP(DMALLOC_COST_FENCE_WRITE, cost);
   }
   
   /*
@@ -1210,7 +1565,9 @@ static	void	clear_alloc(skip_alloc_t *slot_p, pnt_info_t *info_p,
     
     num = (char *)info_p->pi_alloc_bounds - start_p;
     if (num > 0) {
+      COST_START(cost);
       memset(start_p, ALLOC_BLANK_CHAR, num);
+      COST_STOP(DMALLOC_COST_BLANK_FILL, cost);
     }
   }
 }
@@ -1499,7 +1856,7 @@ static	int	check_used_slot(const skip_alloc_t *slot_p,
 				const void *user_pnt, const int exact_b,
 				const int strlen_b, const int min_size)
 {
-  const char	*file, *name_p, *bounds_p, *mem_p;
+  const char	*file, *name_p, *bounds_p, *mem_p, *nul_p;
   unsigned int	line, num;
   pnt_info_t	pnt_info;
   
@@ -1558,15 +1915,11 @@ static	int	check_used_slot(const skip_alloc_t *slot_p,
     /* now check the below space to make sure it is still clear */
     if (pnt_info.pi_fence_b && pnt_info.pi_blanked_b) {
       num = (char *)pnt_info.pi_fence_bottom - (char *)pnt_info.pi_alloc_start;
-      if (num > 0) {
-	for (mem_p = pnt_info.pi_alloc_start;
-	     mem_p < (char *)pnt_info.pi_fence_bottom;
-	     mem_p++) {
-	  if (*mem_p != ALLOC_BLANK_CHAR) {
-	    dmalloc_errno = DMALLOC_ERROR_FREE_OVERWRITTEN;
-	    return 0;
-	  }
-	}
+      if (num > 0
+	  && (! blank_read(pnt_info.pi_alloc_start, pnt_info.pi_fence_bottom,
+			   ALLOC_BLANK_CHAR))) {
+	dmalloc_errno = DMALLOC_ERROR_FREE_OVERWRITTEN;
+	return 0;
       }
     }
   }
@@ -1587,11 +1940,9 @@ static	int	check_used_slot(const skip_alloc_t *slot_p,
       mem_p = pnt_info.pi_user_bounds;
     }
     
-    for (; mem_p < (char *)pnt_info.pi_alloc_bounds; mem_p++) {
-      if (*mem_p != ALLOC_BLANK_CHAR) {
-	dmalloc_errno = DMALLOC_ERROR_FREE_OVERWRITTEN;
-	return 0;
-      }
+    if (! blank_read(mem_p, pnt_info.pi_alloc_bounds, ALLOC_BLANK_CHAR)) {
+      dmalloc_errno = DMALLOC_ERROR_FREE_OVERWRITTEN;
+      return 0;
     }
   }
 
@@ -1652,9 +2003,14 @@ static	int	check_used_slot(const skip_alloc_t *slot_p,
     } else {
       bounds_p = (char *)pnt_info.pi_user_bounds;
     }
-    for (; mem_p < bounds_p; mem_p++) {
-      if (*mem_p == '\0') {
-	break;
+    /* memchr is much faster than a byte loop and stops at the bounds */
+    if (mem_p < bounds_p) {
+      nul_p = memchr(mem_p, '\0', bounds_p - mem_p);
+      if (nul_p == NULL) {
+	mem_p = bounds_p;
+      }
+      else {
+	mem_p = nul_p;
       }
     }
     /* mem_p can == bounds_p (if equals-ok) if we hit the min_size but can't >= user_bounds */ 
@@ -1686,22 +2042,17 @@ static	int	check_used_slot(const skip_alloc_t *slot_p,
  */
 static	int	check_free_slot(const skip_alloc_t *slot_p)
 {
-  char	*check_p;
-  
   if (! BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_FREE)) {
     dmalloc_errno = DMALLOC_ERROR_SLOT_CORRUPT;
     return 0;
   }
   
-  if (BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_BLANK)) {
-    for (check_p = (char *)slot_p->sa_mem;
-	 check_p < (char *)slot_p->sa_mem + slot_p->sa_total_size;
-	 check_p++) {
-      if (*check_p != FREE_BLANK_CHAR) {
-	dmalloc_errno = DMALLOC_ERROR_FREE_OVERWRITTEN;
-	return 0;
-      }
-    }
+  if (BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_BLANK)
+      && (! blank_read(slot_p->sa_mem,
+		       (char *)slot_p->sa_mem + slot_p->sa_total_size,
+		       FREE_BLANK_CHAR))) {
+    dmalloc_errno = DMALLOC_ERROR_FREE_OVERWRITTEN;
+    return 0;
   }
   
 #if LOG_PNT_SEEN_COUNT
@@ -1720,32 +2071,210 @@ static	int	check_free_slot(const skip_alloc_t *slot_p)
   return 1;
 }
 
-/***************************** exported routines *****************************/
-
 /*
- * int _dmalloc_chunk_startup
- * 
- * Startup the low level malloc routines.
+ * static void table_grow
  *
- * Returns 1 on success or 0 on failure.
+ * Double the size of a memory table if it is getting full so new
+ * file/line locations do not get lumped into the other-pointers
+ * entry.  The entries are rehashed into administrative blocks from
+ * the heap.  The old entries are abandoned since we cannot give the
+ * heap memory back but since we double each time, the waste is never
+ * more than the size of the current table.
+ *
+ * ARGUMENTS:
+ *
+ * mem_table -> Memory table that we may grow.
  */
-int	_dmalloc_chunk_startup(void)
+static	void	table_grow(mem_table_t *mem_table)
 {
-  unsigned int	value;
-  char		*pos_p, *max_p;
-  int		bit_c, *bits_p;
+  mem_entry_t	*entries;
+  unsigned int	size;
+  int		entry_n, block_n;
   
-  value = FENCE_MAGIC_BOTTOM;
-  max_p = fence_bottom + FENCE_BOTTOM_SIZE;
-  for (pos_p = fence_bottom;
-       pos_p < max_p;
-       pos_p += sizeof(value)) {
-    if (pos_p + sizeof(value) <= max_p) {
-      memcpy(pos_p, (char *)&value, sizeof(value));
-    }
-    else {
-      memcpy(pos_p, (char *)&value, max_p - pos_p);
-    }
+  /* is the table still less than half full? */
+  if (mem_table->mt_in_use_c < mem_table->mt_entry_n / 2
+      || table_grow_failed_b) {
+    return;
+  }
+  
+  entry_n = mem_table->mt_entry_n * 2;
+  if (entry_n > MEMORY_TABLE_MAX_SIZE * 2) {
+    return;
+  }
+  
+  block_n = (sizeof(*entries) * entry_n + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  size = block_n * BLOCK_SIZE;
+  
+  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_ADMIN)) {
+    dmalloc_message("growing memory table to %d entries in %d blocks",
+		    entry_n, block_n);
+  }
+  
+  entries = _dmalloc_heap_alloc(size);
+  if (entries == NULL) {
+    /* error code set in _dmalloc_heap_alloc, don't try again */
+    table_grow_failed_b = 1;
+    return;
+  }
+  admin_block_c += block_n;
+  
+  /* use all of the blocks that we allocated */
+  _dmalloc_table_resize(mem_table, entries, size / sizeof(*entries));
+}
+
+/*
+ * static void record_lifetime
+ *
+ * Record how long a pointer was in use in the histograms of its
+ * memory table entry.
+ *
+ * ARGUMENTS:
+ *
+ * entry_p -> Entry returned by _dmalloc_table_delete.
+ *
+ * slot_p -> Slot of the pointer that is no longer in use.
+ *
+ * life_iter -> Number of iterations that the pointer was in use.
+ */
+static	void	record_lifetime(mem_entry_t *entry_p,
+				const skip_alloc_t *slot_p,
+				const unsigned long life_iter)
+{
+  unsigned long	life_usecs = MEM_LIFE_UNKNOWN;
+#if LOG_PNT_TIMEVAL
+  TIMEVAL_TYPE	now;
+  
+  /* the time is only stored if one of the time flags is enabled */
+  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_ELAPSED_TIME)
+      || BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_CURRENT_TIME)) {
+    _dmalloc_clock_timeval(&now);
+    life_usecs = ((now.tv_sec - slot_p->sa_timeval.tv_sec) * 1000000
+		  + now.tv_usec - slot_p->sa_timeval.tv_usec);
+  }
+#endif
+  
+  _dmalloc_table_lifetime(entry_p, life_iter, life_usecs);
+}
+
+/*
+ * static void mark_range
+ *
+ * Look at each aligned word in a range of memory and mark the user
+ * slot that it points into as reached.  Newly reached slots are put
+ * on the mark stack so that their memory is scanned in turn.
+ *
+ * ARGUMENTS:
+ *
+ * start -> Start of the memory to scan.
+ *
+ * bounds -> Just past the end of the memory to scan.
+ */
+static	void	mark_range(const void *start, const void *bounds)
+{
+  void		**word_p, **bounds_p;
+  skip_alloc_t	*slot_p;
+  
+  word_p = (void **)(((PNT_ARITH_TYPE)start + sizeof(void *) - 1)
+		     & ~(PNT_ARITH_TYPE)(sizeof(void *) - 1));
+  bounds_p = (void **)((PNT_ARITH_TYPE)bounds
+		       & ~(PNT_ARITH_TYPE)(sizeof(void *) - 1));
+  
+  for (; word_p < bounds_p; word_p++) {
+    if (! IS_IN_HEAP(*word_p)) {
+      continue;
+    }
+    
+    /* a pointer into the middle of a block also keeps it reachable */
+    slot_p = find_address(*word_p, 0 /* used list */, 0 /* not exact */,
+			  skip_update);
+    if (slot_p == NULL
+	|| (! BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_USER))
+	|| BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_MARK)) {
+      continue;
+    }
+    
+    BIT_SET(slot_p->sa_flags, ALLOC_FLAG_MARK);
+    if (mark_stack_c < MARK_STACK_SIZE) {
+      mark_stack[mark_stack_c++] = slot_p;
+    }
+    else {
+      /* the marked slots are rescanned later to find what this reaches */
+      mark_overflow_b = 1;
+    }
+  }
+}
+
+/*
+ * static void mark_stacked
+ *
+ * Scan the memory of the slots on the mark stack until it is empty.
+ */
+static	void	mark_stacked(void)
+{
+  skip_alloc_t	*slot_p;
+  pnt_info_t	pnt_info;
+  
+  while (mark_stack_c > 0) {
+    slot_p = mark_stack[--mark_stack_c];
+    get_pnt_info(slot_p, &pnt_info);
+    mark_range(pnt_info.pi_user_start, pnt_info.pi_user_bounds);
+  }
+}
+
+/*
+ * static void mark_finish
+ *
+ * Scan the reached slots until no more are reached.  If the mark
+ * stack overflowed then all of the marked slots are scanned again to
+ * find the slots that were reached from the ones we could not stack.
+ */
+static	void	mark_finish(void)
+{
+  skip_alloc_t	*slot_p;
+  pnt_info_t	pnt_info;
+  
+  mark_stacked();
+  
+  while (mark_overflow_b) {
+    mark_overflow_b = 0;
+    for (slot_p = skip_address_list->sa_next_p[0];
+	 slot_p != NULL;
+	 slot_p = slot_p->sa_next_p[0]) {
+      if (BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_MARK)) {
+	get_pnt_info(slot_p, &pnt_info);
+	mark_range(pnt_info.pi_user_start, pnt_info.pi_user_bounds);
+	mark_stacked();
+      }
+    }
+  }
+}
+
+/***************************** exported routines *****************************/
+
+/*
+ * int _dmalloc_chunk_startup
+ * 
+ * Startup the low level malloc routines.
+ *
+ * Returns 1 on success or 0 on failure.
+ */
+int	_dmalloc_chunk_startup(void)
+{
+  unsigned int	value;
+  char		*pos_p, *max_p;
+  int		bit_c, *bits_p;
+  
+  value = FENCE_MAGIC_BOTTOM;
+  max_p = fence_bottom + FENCE_BOTTOM_SIZE;
+  for (pos_p = fence_bottom;
+       pos_p < max_p;
+       pos_p += sizeof(value)) {
+    if (pos_p + sizeof(value) <= max_p) {
+      memcpy(pos_p, (char *)&value, sizeof(value));
+    }
+    else {
+      memcpy(pos_p, (char *)&value, max_p - pos_p);
+    }
   }
   
   value = FENCE_MAGIC_TOP;
@@ -1778,6 +2307,9 @@ int	_dmalloc_chunk_startup(void)
 		      sizeof(mem_table_changed_entries) /
 		      sizeof(*mem_table_changed_entries));
   
+  /* the pointers being verified are not roots of the leak scan */
+  _dmalloc_leak_skip(verify_batch, sizeof(verify_batch));
+  
   return 1;
 }
 
@@ -1812,7 +2344,20 @@ char	*_dmalloc_chunk_desc_pnt(char *buf, const int buf_size,
     (void)loc_snprintf(buf, buf_size, "ra=ERROR(line=%u)", line);
   }
   else {
-    (void)loc_snprintf(buf, buf_size, "%.*s:%u", MAX_FILE_LENGTH, file, line);
+    char	*buf_p = buf, *bounds_p = buf + buf_size;
+    int		len;
+    
+    /* this is done for each logged transaction so we skip the format */
+    for (len = 0;
+	 file[len] != '\0' && len < MAX_FILE_LENGTH && buf_p < bounds_p;
+	 len++) {
+      *buf_p++ = file[len];
+    }
+    if (buf_p < bounds_p) {
+      *buf_p++ = ':';
+    }
+    buf_p = append_ulong(buf_p, bounds_p, line, 10);
+    (void)append_null(buf_p, bounds_p);
   }
   
   return buf;
@@ -1921,13 +2466,14 @@ int	_dmalloc_chunk_read_info(const void *user_pnt, const char *where,
 /******************************* heap checking *******************************/
 
 /*
- * int _dmalloc_chunk_heap_check
+ * static int heap_check
  *
- * Run extensive tests on the entire heap.
+ * Run extensive tests on the entire heap.  See
+ * _dmalloc_chunk_heap_check.
  *
  * Returns 1 if the heap is okay or 0 if a problem was detected
  */
-int	_dmalloc_chunk_heap_check(void)
+static	int	heap_check(void)
 {
   skip_alloc_t	*slot_p;
   entry_block_t	*block_p;
@@ -2099,6 +2645,25 @@ int	_dmalloc_chunk_heap_check(void)
   return final;
 }
 
+/*
+ * int _dmalloc_chunk_heap_check
+ *
+ * Run extensive tests on the entire heap.
+ *
+ * Returns 1 if the heap is okay or 0 if a problem was detected
+ */
+int	_dmalloc_chunk_heap_check(void)
+{
+  unsigned long	cost;
+  int		ret;
+  
+  COST_START(cost);
+  ret = heap_check();
+  COST_STOP(DMALLOC_COST_HEAP_CHECK, cost);
+  
+  return ret;
+}
+
 /*
  * int _dmalloc_chunk_pnt_check
  *
@@ -2120,12 +2685,24 @@ int	_dmalloc_chunk_heap_check(void)
  *
  * min_size -> Make sure that pnt can hold at least that many bytes.
  * If 0 then ignore.
+ *
+ * start_p <- Pointer to the start of the user space of the allocation
+ * holding the pointer or NULL if it is not a user allocation.  Can be
+ * NULL.
+ *
+ * bounds_p <- Pointer to just past the end of the user space of the
+ * allocation holding the pointer or NULL.  Can be NULL.
  */
 int	_dmalloc_chunk_pnt_check(const char *func, const void *user_pnt,
 				 const int exact_b, const int strlen_b,
-				 const int min_size)
+				 const int min_size, const void **start_p,
+				 const void **bounds_p)
 {
   skip_alloc_t	*slot_p;
+  pnt_info_t	pnt_info;
+  
+  SET_POINTER(start_p, NULL);
+  SET_POINTER(bounds_p, NULL);
   
   if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_TRANS)) {
     if (func == NULL) {
@@ -2157,90 +2734,587 @@ int	_dmalloc_chunk_pnt_check(const char *func, const void *user_pnt,
     return 0;
   }
   
+  /* only the user allocations are handed back since they can be freed */
+  if (BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_USER)) {
+    get_pnt_info(slot_p, &pnt_info);
+    SET_POINTER(start_p, pnt_info.pi_user_start);
+    SET_POINTER(bounds_p, pnt_info.pi_user_bounds);
+  }
+  
   return 1;
 }
 
-/************************** low-level user functions *************************/
-
 /*
- * void *_dmalloc_chunk_malloc
+ * DMALLOC_SIZE _dmalloc_chunk_pnt_check_many
  *
- * Allocate a chunk of memory.
+ * Check that each of an array of pointers was handed back by an
+ * allocation.  The pointers are sorted in batches so each batch is
+ * found with one walk up the address list.
  *
- * Returns a valid pointer on success or NULL on failure.
+ * Returns the number of pointers that are not okay.
  *
  * ARGUMENTS:
  *
- * file -> File-name or return-address location of the allocation.
+ * pnts -> Array of the pointers we are checking.  NULL pointers are
+ * skipped.
  *
- * line -> Line-number location of the allocation.
+ * pnt_n -> Number of the pointers in the array.
  *
- * size -> Number of bytes to allocate.
+ * results <- Array that we set to 1 for each pointer that is okay or
+ * 0 if not.  Can be NULL.
+ */
+DMALLOC_SIZE	_dmalloc_chunk_pnt_check_many(const DMALLOC_PNT *pnts,
+					      const DMALLOC_SIZE pnt_n,
+					      int *results)
+{
+  skip_alloc_t		*slot_p;
+  const void		*pnt;
+  DMALLOC_SIZE		pnt_c, bad_c = 0;
+  int			batch_c, batch_n, ok_b;
+  
+  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_TRANS)) {
+    dmalloc_message("checking %lu pointers", (unsigned long)pnt_n);
+  }
+  
+  for (pnt_c = 0; pnt_c < pnt_n; ) {
+    
+    /* sort the next batch of pointers by address */
+    for (batch_n = 0; batch_n < VERIFY_BATCH_SIZE && pnt_c < pnt_n;
+	 pnt_c++) {
+      if (pnts[pnt_c] == NULL) {
+	if (results != NULL) {
+	  results[pnt_c] = 1;
+	}
+	continue;
+      }
+      verify_batch[batch_n].vp_pnt = pnts[pnt_c];
+      verify_batch[batch_n].vp_index = pnt_c;
+      batch_n++;
+    }
+    if (batch_n == 0) {
+      continue;
+    }
+    sort_pnts(verify_batch, batch_n);
+    
+    for (batch_c = 0; batch_c < batch_n; batch_c++) {
+      pnt = verify_batch[batch_c].vp_pnt;
+      if (batch_c == 0) {
+	slot_p = find_address(pnt, 0 /* used list */, 0 /* not exact pointer */,
+			      skip_update);
+      }
+      else {
+	/* the pointers are sorted so we go on from the last one */
+	slot_p = find_address_after(pnt, skip_update);
+      }
+      
+      if (slot_p == NULL) {
+	dmalloc_errno = DMALLOC_ERROR_NOT_FOUND;
+	log_error_info(NULL, 0, pnt, NULL, "pointer-check",
+		       "dmalloc_verify_many");
+	ok_b = 0;
+      }
+      else if (! check_used_slot(slot_p, pnt, 1 /* exact pnt */,
+				 0 /* no strlen */, 0 /* no min-size */)) {
+	/* dmalloc_error set in check_used_slot */
+	log_error_info(NULL, 0, pnt, slot_p, "pointer-check",
+		       "dmalloc_verify_many");
+	ok_b = 0;
+      }
+      else {
+	ok_b = 1;
+      }
+      
+      if (! ok_b) {
+	bad_c++;
+      }
+      if (results != NULL) {
+	results[verify_batch[batch_c].vp_index] = ok_b;
+      }
+    }
+  }
+  
+  return bad_c;
+}
+
+/******************************* budget routines *****************************/
+
+/*
+ * static int budget_match
  *
- * func_id -> Calling function-id as defined in dmalloc.h.
+ * See if an allocation location matches a budget.
  *
- * alignment -> If greater than 0 then try to align the returned
- * block.
+ * Returns 1 if it matches else 0.
+ *
+ * ARGUMENTS:
+ *
+ * budget_p -> Budget we are checking.
+ *
+ * file -> File-name or return-address location of the allocation.
+ *
+ * line -> Line-number location of the allocation.
  */
-void	*_dmalloc_chunk_malloc(const char *file, const unsigned int line,
-			       const unsigned long size, const int func_id,
-			       const unsigned int alignment)
+static	int	budget_match(const budget_t *budget_p, const char *file,
+			     const unsigned int line)
 {
-  unsigned long	needed_size;
-  int		valloc_b = 0, fence_b = 0;
-  char		where_buf[MAX_FILE_LENGTH + 64], disp_buf[64];
-  skip_alloc_t	*slot_p;
-  pnt_info_t	pnt_info;
-  const char	*trans_log;
+  const char	*base_p;
+  int		len;
   
-  // TOTO: is alignment used here appropriately?
+  /* return-addresses have no file-name to match against */
+  if (file == NULL || line == 0) {
+    return 0;
+  }
+  if (budget_p->bu_line != 0 && budget_p->bu_line != line) {
+    return 0;
+  }
   
-  /* counts calls to malloc */
-  if (func_id == DMALLOC_FUNC_CALLOC) {
-    func_calloc_c++;
+  base_p = strrchr(file, '/');
+  if (base_p == NULL) {
+    base_p = file;
   }
-  else if (alignment == BLOCK_SIZE) {
-    func_valloc_c++;
-    valloc_b = 1;
+  else {
+    base_p++;
   }
-  else if (alignment > 0) {
-    func_memalign_c++;
+  
+  /* a trailing '*' matches the prefix of the file */
+  len = strlen(budget_p->bu_file);
+  if (len > 0 && budget_p->bu_file[len - 1] == '*') {
+    len--;
+    return (strncmp(file, budget_p->bu_file, len) == 0
+	    || strncmp(base_p, budget_p->bu_file, len) == 0);
   }
-  else if (func_id == DMALLOC_FUNC_NEW) {
-    func_new_c++;
+  else {
+    return (strcmp(file, budget_p->bu_file) == 0
+	    || strcmp(base_p, budget_p->bu_file) == 0);
   }
-  else if (func_id != DMALLOC_FUNC_REALLOC
-	   && func_id != DMALLOC_FUNC_RECALLOC) {
-    func_malloc_c++;
+}
+
+/*
+ * static budget_t *find_budget
+ *
+ * Find the budget which applies to an allocation location.  A budget
+ * for a specific line takes precedence over one for the whole file.
+ * The result is cached in the memory-table entry if we have one so
+ * that subsequent lookups for the location are O(1).
+ *
+ * Returns the budget or NULL if none applies.
+ *
+ * ARGUMENTS:
+ *
+ * entry_p -> Memory-table entry of the location or NULL if none.
+ *
+ * file -> File-name or return-address location of the allocation.
+ *
+ * line -> Line-number location of the allocation.
+ */
+static	budget_t	*find_budget(mem_entry_t *entry_p, const char *file,
+				     const unsigned int line)
+{
+  budget_t	*budget_p, *found_p = NULL;
+  
+  if (budget_n == 0) {
+    return NULL;
   }
   
-#if ALLOW_ALLOC_ZERO_SIZE == 0
-  if (size == 0) {
-    dmalloc_errno = DMALLOC_ERROR_BAD_SIZE;
-    log_error_info(file, line, NULL, NULL, "bad zero byte allocation request",
-		   "malloc");
-    return MALLOC_ERROR;
+  /* the other-pointers entry has no file and holds many locations */
+  if (entry_p != NULL && entry_p->me_file != NULL && entry_p->me_budget_b) {
+    return entry_p->me_budget_p;
   }
-#endif
   
-#if LARGEST_ALLOCATION
-  /* have we exceeded the upper bounds */
-  if (size > LARGEST_ALLOCATION) {
-    dmalloc_errno = DMALLOC_ERROR_TOO_BIG;
-    log_error_info(file, line, NULL, NULL, "allocation too big", "malloc");
-    return MALLOC_ERROR;
+  for (budget_p = budgets; budget_p < budgets + budget_n; budget_p++) {
+    if (budget_match(budget_p, file, line)) {
+      found_p = budget_p;
+      if (budget_p->bu_line != 0) {
+	break;
+      }
+    }
   }
-#endif
   
-  needed_size = size;
+  if (entry_p != NULL && entry_p->me_file != NULL) {
+    entry_p->me_budget_p = found_p;
+    entry_p->me_budget_b = 1;
+  }
   
-  /* adjust the size */
-  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_FENCE)) {
-    needed_size += FENCE_OVERHEAD_SIZE;
-    fence_b = 1;
-    
-    /*
-     * If the user is requesting a page-aligned block of data then we
+  return found_p;
+}
+
+/*
+ * static budget_t *site_budget
+ *
+ * Find the budget which applies to an allocation location using the
+ * memory table to cache the lookup.
+ *
+ * Returns the budget or NULL if none applies.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address location of the allocation.
+ *
+ * line -> Line-number location of the allocation.
+ */
+static	budget_t	*site_budget(const char *file, const unsigned int line)
+{
+  if (budget_n == 0) {
+    return NULL;
+  }
+  
+#if MEMORY_TABLE_TOP_LOG
+  return find_budget(_dmalloc_table_find(&mem_table_alloc, file, line),
+		     file, line);
+#else
+  return find_budget(NULL, file, line);
+#endif
+}
+
+/*
+ * static const char *budget_func
+ *
+ * Returns the name of the allocation function for budget messages.
+ *
+ * ARGUMENTS:
+ *
+ * func_id -> Calling function-id as defined in dmalloc.h.
+ */
+static	const char	*budget_func(const int func_id)
+{
+  switch (func_id) {
+  case DMALLOC_FUNC_CALLOC:
+    return "calloc";
+  case DMALLOC_FUNC_REALLOC:
+    return "realloc";
+  case DMALLOC_FUNC_RECALLOC:
+    return "recalloc";
+  case DMALLOC_FUNC_MEMALIGN:
+    return "memalign";
+  case DMALLOC_FUNC_VALLOC:
+    return "valloc";
+  default:
+    return "malloc";
+  }
+}
+
+/*
+ * static int budget_allow
+ *
+ * See if an allocation fits inside of its budget and take the
+ * configured action if it does not.
+ *
+ * Returns 1 if the allocation should proceed else 0.
+ *
+ * ARGUMENTS:
+ *
+ * budget_p -> Budget the allocation is charged to.
+ *
+ * file -> File-name or return-address location of the allocation.
+ *
+ * line -> Line-number location of the allocation.
+ *
+ * func -> Name of the function doing the allocation for the logs.
+ *
+ * size -> Number of bytes being allocated.
+ *
+ * credit -> Number of bytes that will be released from the budget by
+ * the allocation such as with a realloc.
+ */
+static	int	budget_allow(budget_t *budget_p, const char *file,
+			     const unsigned int line, const char *func,
+			     const unsigned long size,
+			     const unsigned long credit)
+{
+  char	where_buf[MAX_FILE_LENGTH + 64];
+  
+  if (budget_p->bu_in_use - credit + size <= budget_p->bu_limit) {
+    return 1;
+  }
+  
+  budget_p->bu_over_c++;
+  
+  if (budget_p->bu_action == DMALLOC_BUDGET_FAIL) {
+    dmalloc_errno = DMALLOC_ERROR_OVER_BUDGET;
+    log_error_info(file, line, NULL, NULL,
+		   "allocation would exceed the call-site budget", func);
+    return 0;
+  }
+  
+  /* we only report the first time we go over the budget */
+  if (budget_p->bu_over_b) {
+    return 1;
+  }
+  budget_p->bu_over_b = 1;
+  
+  if (budget_p->bu_action == DMALLOC_BUDGET_ERROR) {
+    dmalloc_errno = DMALLOC_ERROR_OVER_BUDGET;
+    log_error_info(file, line, NULL, NULL,
+		   "allocation exceeds the call-site budget", func);
+  }
+  else {
+    dmalloc_message("budget for '%s:%u' of %lu bytes exceeded by %lu bytes from '%s'",
+		    budget_p->bu_file, budget_p->bu_line, budget_p->bu_limit,
+		    budget_p->bu_in_use - credit + size - budget_p->bu_limit,
+		    _dmalloc_chunk_desc_pnt(where_buf, sizeof(where_buf),
+					    file, line));
+  }
+  
+  return 1;
+}
+
+/*
+ * static void budget_charge
+ *
+ * Account for an allocation in its budget.
+ *
+ * ARGUMENTS:
+ *
+ * budget_p -> Budget the allocation is charged to or NULL if none.
+ *
+ * size -> Number of bytes allocated.
+ */
+static	void	budget_charge(budget_t *budget_p, const unsigned long size)
+{
+  if (budget_p == NULL) {
+    return;
+  }
+  
+  budget_p->bu_in_use += size;
+  budget_p->bu_max_in_use = MAX(budget_p->bu_max_in_use, budget_p->bu_in_use);
+}
+
+/*
+ * static void budget_release
+ *
+ * Account for a free in its budget.
+ *
+ * ARGUMENTS:
+ *
+ * budget_p -> Budget the allocation was charged to or NULL if none.
+ *
+ * size -> Number of bytes freed.
+ */
+static	void	budget_release(budget_t *budget_p, const unsigned long size)
+{
+  if (budget_p == NULL) {
+    return;
+  }
+  
+  if (budget_p->bu_in_use >= size) {
+    budget_p->bu_in_use -= size;
+  }
+  else {
+    budget_p->bu_in_use = 0;
+  }
+  if (budget_p->bu_in_use <= budget_p->bu_limit) {
+    budget_p->bu_over_b = 0;
+  }
+}
+
+/*
+ * static void budget_recount
+ *
+ * Recalculate the in-use bytes of our budgets after they change.
+ * This also clears the budgets cached in the memory table.
+ */
+static	void	budget_recount(void)
+{
+  budget_t	*budget_p;
+  mem_entry_t	*entry_p;
+  skip_alloc_t	*slot_p;
+  
+  for (budget_p = budgets; budget_p < budgets + budget_n; budget_p++) {
+    budget_p->bu_in_use = 0;
+  }
+  
+  for (entry_p = mem_table_alloc.mt_entries;
+       entry_p < mem_table_alloc.mt_bounds_p;
+       entry_p++) {
+    entry_p->me_budget_p = NULL;
+    entry_p->me_budget_b = 0;
+  }
+  
+  if (budget_n == 0) {
+    return;
+  }
+  
+  for (slot_p = skip_address_list->sa_next_p[0];
+       slot_p != NULL;
+       slot_p = slot_p->sa_next_p[0]) {
+    if (BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_USER)) {
+      budget_charge(find_budget(NULL, slot_p->sa_file, slot_p->sa_line),
+		    slot_p->sa_user_size);
+    }
+  }
+  
+  for (budget_p = budgets; budget_p < budgets + budget_n; budget_p++) {
+    budget_p->bu_over_b = (budget_p->bu_in_use > budget_p->bu_limit);
+  }
+}
+
+/*
+ * int _dmalloc_chunk_budget_set
+ *
+ * Set, change, or remove the memory budget for a file or a file/line
+ * call-site.
+ *
+ * Returns 1 on success or 0 on failure.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name to match against the allocations.  It can end
+ * with a '*' to match a prefix of the file.
+ *
+ * line -> Line-number to match or 0 for any line in the file.
+ *
+ * limit -> Maximum number of bytes in use by the matching allocations
+ * or 0 to remove the budget.
+ *
+ * action -> What to do when an allocation would go over the budget.
+ * One of the DMALLOC_BUDGET_ values from dmalloc.h.
+ */
+int	_dmalloc_chunk_budget_set(const char *file, const unsigned int line,
+				  const unsigned long limit, const int action)
+{
+  budget_t	*budget_p;
+  
+  if (file == NULL || *file == '\0' || strlen(file) >= BUDGET_FILE_LENGTH
+      || action < DMALLOC_BUDGET_LOG || action > DMALLOC_BUDGET_FAIL) {
+    dmalloc_errno = DMALLOC_ERROR_BAD_SETUP;
+    dmalloc_error("_dmalloc_chunk_budget_set");
+    return 0;
+  }
+  
+  for (budget_p = budgets; budget_p < budgets + budget_n; budget_p++) {
+    if (budget_p->bu_line == line && strcmp(budget_p->bu_file, file) == 0) {
+      break;
+    }
+  }
+  
+  if (limit == 0) {
+    /* remove the budget by shifting the others down */
+    if (budget_p < budgets + budget_n) {
+      budget_n--;
+      memmove(budget_p, budget_p + 1,
+	      (budgets + budget_n - budget_p) * sizeof(*budget_p));
+    }
+  }
+  else {
+    if (budget_p == budgets + budget_n) {
+      if (budget_n >= MEMORY_BUDGET_MAX) {
+	dmalloc_errno = DMALLOC_ERROR_BAD_SETUP;
+	dmalloc_error("_dmalloc_chunk_budget_set");
+	return 0;
+      }
+      memset(budget_p, 0, sizeof(*budget_p));
+      (void)strcpy(budget_p->bu_file, file);
+      budget_p->bu_line = line;
+      budget_n++;
+    }
+    budget_p->bu_limit = limit;
+    budget_p->bu_action = action;
+  }
+  
+  budget_recount();
+  return 1;
+}
+
+/*
+ * void _dmalloc_chunk_budget_clear
+ *
+ * Remove all of the memory budgets.
+ */
+void	_dmalloc_chunk_budget_clear(void)
+{
+  budget_n = 0;
+  budget_recount();
+}
+
+/************************** low-level user functions *************************/
+
+/*
+ * static void *chunk_malloc
+ *
+ * Allocate a chunk of memory.
+ *
+ * Returns a valid pointer on success or NULL on failure.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address location of the allocation.
+ *
+ * line -> Line-number location of the allocation.
+ *
+ * size -> Number of bytes to allocate.
+ *
+ * func_id -> Calling function-id as defined in dmalloc.h.
+ *
+ * alignment -> If greater than 0 then try to align the returned
+ * block.
+ *
+ * credit_budget_p -> Budget that will be credited after the
+ * allocation such as by the free of the old pointer in a realloc or
+ * NULL if none.
+ *
+ * credit -> Number of bytes that will be credited to credit_budget_p.
+ */
+static	void	*chunk_malloc(const char *file, const unsigned int line,
+			      const unsigned long size, const int func_id,
+			      const unsigned int alignment,
+			      const budget_t *credit_budget_p,
+			      const unsigned long credit)
+{
+  unsigned long	needed_size;
+  int		valloc_b = 0, fence_b = 0;
+  char		where_buf[MAX_FILE_LENGTH + 64], disp_buf[64];
+  skip_alloc_t	*slot_p;
+  pnt_info_t	pnt_info;
+  budget_t	*budget_p;
+  const char	*trans_log;
+  
+  // TOTO: is alignment used here appropriately?
+  
+  /* counts calls to malloc */
+  if (func_id == DMALLOC_FUNC_CALLOC) {
+    func_calloc_c++;
+  }
+  else if (alignment == BLOCK_SIZE) {
+    func_valloc_c++;
+    valloc_b = 1;
+  }
+  else if (alignment > 0) {
+    func_memalign_c++;
+  }
+  else if (func_id == DMALLOC_FUNC_NEW) {
+    func_new_c++;
+  }
+  else if (func_id != DMALLOC_FUNC_REALLOC
+	   && func_id != DMALLOC_FUNC_RECALLOC) {
+    func_malloc_c++;
+  }
+  
+#if ALLOW_ALLOC_ZERO_SIZE == 0
+  if (size == 0) {
+    dmalloc_errno = DMALLOC_ERROR_BAD_SIZE;
+    log_error_info(file, line, NULL, NULL, "bad zero byte allocation request",
+		   "malloc");
+    return MALLOC_ERROR;
+  }
+#endif
+  
+#if LARGEST_ALLOCATION
+  /* have we exceeded the upper bounds */
+  if (size > LARGEST_ALLOCATION) {
+    dmalloc_errno = DMALLOC_ERROR_TOO_BIG;
+    log_error_info(file, line, NULL, NULL, "allocation too big", "malloc");
+    return MALLOC_ERROR;
+  }
+#endif
+  
+  needed_size = size;
+  
+  /* adjust the size */
+  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_FENCE)) {
+    needed_size += FENCE_OVERHEAD_SIZE;
+    fence_b = 1;
+    
+    /*
+     * If the user is requesting a page-aligned block of data then we
      * will need another block below the allocation just for the fence
      * information.  Ugh.
      */
@@ -2257,6 +3331,15 @@ void	*_dmalloc_chunk_malloc(const char *file, const unsigned int line,
     needed_size = BLOCK_SIZE;
   }
   
+  /* will this allocation put its file or call-site over budget? */
+  budget_p = site_budget(file, line);
+  if (budget_p != NULL
+      && (! budget_allow(budget_p, file, line, budget_func(func_id), size,
+			 (budget_p == credit_budget_p ? credit : 0)))) {
+    /* errno set in budget_allow */
+    return MALLOC_ERROR;
+  }
+  
   /* get some space for our memory */
   slot_p = get_memory(needed_size);
   if (slot_p == NULL) {
@@ -2282,7 +3365,7 @@ void	*_dmalloc_chunk_malloc(const char *file, const unsigned int line,
   
   slot_p->sa_file = file;
   slot_p->sa_line = line;
-  slot_p->sa_use_iter = _dmalloc_iter_c;
+  recent_touch(slot_p);
 #if LOG_PNT_SEEN_COUNT
   slot_p->sa_seen_c++;
 #endif
@@ -2292,10 +3375,10 @@ void	*_dmalloc_chunk_malloc(const char *file, const unsigned int line,
   if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_ELAPSED_TIME)
       || BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_CURRENT_TIME)) {
 #if LOG_PNT_TIMEVAL
-    GET_TIMEVAL(slot_p->sa_timeval);
+    _dmalloc_clock_timeval(&slot_p->sa_timeval);
 #else
 #if LOG_PNT_TIME
-    slot_p->sa_time = time(NULL);
+    slot_p->sa_time = _dmalloc_clock_seconds();
 #endif
 #endif
   }
@@ -2320,17 +3403,27 @@ void	*_dmalloc_chunk_malloc(const char *file, const unsigned int line,
       trans_log = "alloc";
       break;
     }
-    dmalloc_message("*** %s: at '%s' for %ld bytes, got '%s'",
-		    trans_log,
-		    _dmalloc_chunk_desc_pnt(where_buf, sizeof(where_buf),
-					    file, line),
-		    size, display_pnt(pnt_info.pi_user_start, slot_p, disp_buf,
-				      sizeof(disp_buf)));
+    _dmalloc_desc_message(&alloc_format,
+			  "*** %s: at '%s' for %ld bytes, got '%s'",
+			  trans_log,
+			  _dmalloc_chunk_desc_pnt(where_buf, sizeof(where_buf),
+						  file, line),
+			  size, display_pnt(pnt_info.pi_user_start, slot_p,
+					    disp_buf, sizeof(disp_buf)));
+  }
+  if (_dmalloc_binlog_b) {
+    _dmalloc_binlog_alloc(func_id, file, line, pnt_info.pi_user_start, size,
+			  alignment, BINLOG_THREAD_ID());
+  }
+  if (_dmalloc_flight_b) {
+    _dmalloc_flight_alloc(func_id, file, line, pnt_info.pi_user_start, size);
   }
   
 #if MEMORY_TABLE_TOP_LOG
+  table_grow(&mem_table_alloc);
   _dmalloc_table_insert(&mem_table_alloc, file, line, size);
 #endif
+  budget_charge(budget_p, size);
   
   /* monitor current allocation level */
   alloc_current += size;
@@ -2346,6 +3439,34 @@ void	*_dmalloc_chunk_malloc(const char *file, const unsigned int line,
   return pnt_info.pi_user_start;
 }
 
+/*
+ * void *_dmalloc_chunk_malloc
+ *
+ * Allocate a chunk of memory.
+ *
+ * Returns a valid pointer on success or NULL on failure.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address location of the allocation.
+ *
+ * line -> Line-number location of the allocation.
+ *
+ * size -> Number of bytes to allocate.
+ *
+ * func_id -> Calling function-id as defined in dmalloc.h.
+ *
+ * alignment -> If greater than 0 then try to align the returned
+ * block.
+ */
+void	*_dmalloc_chunk_malloc(const char *file, const unsigned int line,
+			       const unsigned long size, const int func_id,
+			       const unsigned int alignment)
+{
+  return chunk_malloc(file, line, size, func_id, alignment,
+		      NULL /* no credit */, 0);
+}
+
 /*
  * int _dmalloc_chunk_free
  *
@@ -2369,6 +3490,8 @@ int	_dmalloc_chunk_free(const char *file, const unsigned int line,
   char		where_buf[MAX_FILE_LENGTH + 64];
   char		where_buf2[MAX_FILE_LENGTH + 64], disp_buf[64];
   skip_alloc_t	*slot_p, *update_p;
+  mem_entry_t	*entry_p;
+  unsigned long	life_iter, cost;
   
   /* counts calls to free */
   if (func_id == DMALLOC_FUNC_DELETE) {
@@ -2476,27 +3599,45 @@ int	_dmalloc_chunk_free(const char *file, const unsigned int line,
   }
   
   alloc_cur_pnts--;
+  _dmalloc_free_epoch++;
   
-  slot_p->sa_use_iter = _dmalloc_iter_c;
+  life_iter = _dmalloc_iter_c - slot_p->sa_use_iter;
+  recent_touch(slot_p);
 #if LOG_PNT_SEEN_COUNT
   slot_p->sa_seen_c++;
 #endif
   
   /* do we need to print transaction info? */
   if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_TRANS)) {
-    dmalloc_message("*** free: at '%s' pnt '%s': size %u, alloced at '%s'",
-		    _dmalloc_chunk_desc_pnt(where_buf, sizeof(where_buf), file,
-					    line),
-		    display_pnt(user_pnt, slot_p, disp_buf, sizeof(disp_buf)),
-		    slot_p->sa_user_size,
-		    _dmalloc_chunk_desc_pnt(where_buf2, sizeof(where_buf2),
-					    slot_p->sa_file, slot_p->sa_line));
+    _dmalloc_desc_message(&free_format,
+			  "*** free: at '%s' pnt '%s': size %u, alloced at '%s'",
+			  _dmalloc_chunk_desc_pnt(where_buf, sizeof(where_buf),
+						  file, line),
+			  display_pnt(user_pnt, slot_p, disp_buf,
+				      sizeof(disp_buf)),
+			  slot_p->sa_user_size,
+			  _dmalloc_chunk_desc_pnt(where_buf2, sizeof(where_buf2),
+						  slot_p->sa_file,
+						  slot_p->sa_line));
+  }
+  if (_dmalloc_binlog_b) {
+    _dmalloc_binlog_free(func_id, file, line, user_pnt, slot_p->sa_user_size,
+			 slot_p->sa_file, slot_p->sa_line, BINLOG_THREAD_ID());
+  }
+  if (_dmalloc_flight_b) {
+    _dmalloc_flight_free(func_id, file, line, user_pnt, slot_p->sa_user_size,
+			 slot_p->sa_file, slot_p->sa_line);
   }
   
 #if MEMORY_TABLE_TOP_LOG
-  _dmalloc_table_delete(&mem_table_alloc, slot_p->sa_file, slot_p->sa_line,
-			slot_p->sa_user_size);
+  entry_p = _dmalloc_table_delete(&mem_table_alloc, slot_p->sa_file,
+				  slot_p->sa_line, slot_p->sa_user_size);
+  record_lifetime(entry_p, slot_p, life_iter);
+#else
+  entry_p = NULL;
 #endif
+  budget_release(find_budget(entry_p, slot_p->sa_file, slot_p->sa_line),
+		 slot_p->sa_user_size);
   
   /* update the file/line -- must be after _dmalloc_table_delete */
   slot_p->sa_file = file;
@@ -2510,7 +3651,9 @@ int	_dmalloc_chunk_free(const char *file, const unsigned int line,
   /* clear the memory */
   if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_FREE_BLANK)
       || BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_BLANK)) {
+    COST_START(cost);
     memset(slot_p->sa_mem, FREE_BLANK_CHAR, slot_p->sa_total_size);
+    COST_STOP(DMALLOC_COST_BLANK_FILL, cost);
     /* set our slot blank flag */
     BIT_SET(slot_p->sa_flags, ALLOC_FLAG_BLANK);
   }
@@ -2546,6 +3689,10 @@ int	_dmalloc_chunk_free(const char *file, const unsigned int line,
     }
 #endif
   }
+  else {
+    /* the slot is on none of the lists now so it is not reported */
+    recent_remove(slot_p);
+  }
   
   return FREE_NOERROR;
 }
@@ -2578,7 +3725,9 @@ void	*_dmalloc_chunk_realloc(const char *file, const unsigned int line,
   skip_alloc_t	*slot_p;
   pnt_info_t	pnt_info;
   void		*new_user_pnt;
+  budget_t	*budget_p, *old_budget_p;
   unsigned int	old_size, old_line;
+  unsigned long	life_iter;
   
   /* counts calls to realloc */
   if (func_id == DMALLOC_FUNC_RECALLOC) {
@@ -2628,9 +3777,13 @@ void	*_dmalloc_chunk_realloc(const char *file, const unsigned int line,
       || BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_NEVER_REUSE)) {
     int	min_size;
     
-    /* allocate space for new chunk */
-    new_user_pnt = _dmalloc_chunk_malloc(file, line, new_size, func_id,
-				    0 /* no align */);
+    /*
+     * allocate space for new chunk crediting the budget with the old
+     * pointer which we free below
+     */
+    new_user_pnt = chunk_malloc(file, line, new_size, func_id,
+				0 /* no align */,
+				site_budget(old_file, old_line), old_size);
     if (new_user_pnt == MALLOC_ERROR) {
       return REALLOC_ERROR;
     }
@@ -2656,6 +3809,17 @@ void	*_dmalloc_chunk_realloc(const char *file, const unsigned int line,
     /* new pointer is the same as the old one */
     new_user_pnt = pnt_info.pi_user_start;
     
+    /* will the new size put its file or call-site over budget? */
+    budget_p = site_budget(file, line);
+    old_budget_p = site_budget(old_file, old_line);
+    if (budget_p != NULL
+	&& (! budget_allow(budget_p, file, line, budget_func(func_id),
+			   new_size,
+			   (budget_p == old_budget_p ? old_size : 0)))) {
+      /* errno set in budget_allow */
+      return REALLOC_ERROR;
+    }
+    
     /*
      * monitor current allocation level
      *
@@ -2672,55 +3836,303 @@ void	*_dmalloc_chunk_realloc(const char *file, const unsigned int line,
     
     /* change the slot information */
     slot_p->sa_user_size = new_size;
+    _dmalloc_free_epoch++;
     get_pnt_info(slot_p, &pnt_info);
     
     clear_alloc(slot_p, &pnt_info, old_size, func_id);
     
-    slot_p->sa_use_iter = _dmalloc_iter_c;
+    life_iter = _dmalloc_iter_c - slot_p->sa_use_iter;
+    recent_touch(slot_p);
 #if LOG_PNT_SEEN_COUNT
     /* we see in inbound and outbound so we need to increment by 2 */
     slot_p->sa_seen_c += 2;
 #endif
     
 #if MEMORY_TABLE_TOP_LOG
-    _dmalloc_table_delete(&mem_table_alloc, slot_p->sa_file, slot_p->sa_line,
-			  old_size);
+    record_lifetime(_dmalloc_table_delete(&mem_table_alloc, slot_p->sa_file,
+					  slot_p->sa_line, old_size),
+		    slot_p, life_iter);
+    table_grow(&mem_table_alloc);
     _dmalloc_table_insert(&mem_table_alloc, file, line, new_size);
 #endif
+    budget_release(old_budget_p, old_size);
+    budget_charge(budget_p, new_size);
+  
+    /*
+     * finally, we update the file/line info -- must be after
+     * _dmalloc_table functions
+     */
+    slot_p->sa_file = file;
+    slot_p->sa_line = line;
+  }
+  
+  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_TRANS)) {
+    const char	*trans_log;
+    char	where_buf[MAX_FILE_LENGTH + 64];
+    char	where_buf2[MAX_FILE_LENGTH + 64];
+    
+    if (func_id == DMALLOC_FUNC_RECALLOC) {
+      trans_log = "recalloc";
+    }
+    else {
+      trans_log = "realloc";
+    }
+    _dmalloc_desc_message(&realloc_format,
+			  "*** %s: at '%s' from '%p' (%u bytes) file '%s' to '%p' (%lu bytes)",
+			  trans_log,
+			  _dmalloc_chunk_desc_pnt(where_buf, sizeof(where_buf),
+						  file, line),
+			  old_user_pnt, old_size,
+			  _dmalloc_chunk_desc_pnt(where_buf2, sizeof(where_buf2),
+						  old_file, old_line),
+			  new_user_pnt, new_size);
+  }
+  if (_dmalloc_binlog_b) {
+    _dmalloc_binlog_realloc(func_id, file, line, old_user_pnt, old_size,
+			    old_file, old_line, new_user_pnt, new_size,
+			    BINLOG_THREAD_ID());
+  }
+  if (_dmalloc_flight_b) {
+    _dmalloc_flight_realloc(func_id, file, line, old_user_pnt, old_size,
+			    old_file, old_line, new_user_pnt, new_size);
+  }
+  
+  return new_user_pnt;
+}
+
+/***************************** diagnostic routines ***************************/
+
+/*
+ * static dmalloc_frag_class_t *frag_class
+ *
+ * Find the fragmentation size class for a slot.
+ *
+ * Returns a pointer to the class.
+ *
+ * ARGUMENTS:
+ *
+ * frag_p -> Fragmentation information we are filling in.
+ *
+ * total_size -> Total size of the slot.
+ */
+static	dmalloc_frag_class_t	*frag_class(dmalloc_frag_t *frag_p,
+					    const unsigned int total_size)
+{
+  unsigned int	block_n;
+  int		class_c;
+  
+  /* divided slots have one of the bit sizes */
+  if (total_size <= BLOCK_SIZE / 2) {
+    for (class_c = 0; class_c < frag_p->df_divided_n - 1; class_c++) {
+      if (bit_sizes[class_c] >= total_size) {
+	break;
+      }
+    }
+    return frag_p->df_divided + class_c;
+  }
+  
+  /* runs of blocks are grouped by the log2 of the number of blocks */
+  block_n = total_size / BLOCK_SIZE;
+  for (class_c = 0; block_n > 1 && class_c < DMALLOC_FRAG_CLASS_N - 1;
+       class_c++) {
+    block_n >>= 1;
+  }
+  if (class_c >= frag_p->df_run_n) {
+    frag_p->df_run_n = class_c + 1;
+  }
+  return frag_p->df_runs + class_c;
+}
+
+/*
+ * void _dmalloc_chunk_frag_stats
+ *
+ * Get information about the fragmentation of the heap broken down by
+ * size class.  This walks the used and free lists so it is O(N) in
+ * the number of slots.
+ *
+ * ARGUMENTS:
+ *
+ * frag_p <- Pointer to the fragmentation information to fill in.
+ */
+void	_dmalloc_chunk_frag_stats(dmalloc_frag_t *frag_p)
+{
+  skip_alloc_t		*slot_p;
+  dmalloc_frag_class_t	*class_p;
+  unsigned long		fence_size;
+  int			class_c;
   
-    /*
-     * finally, we update the file/line info -- must be after
-     * _dmalloc_table functions
-     */
-    slot_p->sa_file = file;
-    slot_p->sa_line = line;
+  memset(frag_p, 0, sizeof(*frag_p));
+  
+  /* set up the divided size classes from the bit sizes */
+  for (class_c = 0;
+       class_c < DMALLOC_FRAG_CLASS_N && bit_sizes[class_c] > 0
+	 && bit_sizes[class_c] <= BLOCK_SIZE / 2;
+       class_c++) {
+    frag_p->df_divided[class_c].fc_size = bit_sizes[class_c];
+  }
+  frag_p->df_divided_n = class_c;
+  for (class_c = 0; class_c < DMALLOC_FRAG_CLASS_N; class_c++) {
+    frag_p->df_runs[class_c].fc_size = (unsigned long)BLOCK_SIZE << class_c;
   }
   
-  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_TRANS)) {
-    const char	*trans_log;
-    char	where_buf[MAX_FILE_LENGTH + 64];
-    char	where_buf2[MAX_FILE_LENGTH + 64];
-    
-    if (func_id == DMALLOC_FUNC_RECALLOC) {
-      trans_log = "recalloc";
+  /* the used slots tell us about the rounding and fence overhead */
+  for (slot_p = skip_address_list->sa_next_p[0];
+       slot_p != NULL;
+       slot_p = slot_p->sa_next_p[0]) {
+    if (! BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_USER)) {
+      continue;
+    }
+    class_p = frag_class(frag_p, slot_p->sa_total_size);
+    if (BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_FENCE)) {
+      fence_size = FENCE_OVERHEAD_SIZE;
     }
     else {
-      trans_log = "realloc";
+      fence_size = 0;
+    }
+    class_p->fc_pnt_n++;
+    class_p->fc_user_size += slot_p->sa_user_size;
+    class_p->fc_fence_size += fence_size;
+    if (slot_p->sa_total_size > slot_p->sa_user_size + fence_size) {
+      class_p->fc_round_size += (slot_p->sa_total_size - slot_p->sa_user_size
+				 - fence_size);
     }
-    dmalloc_message("*** %s: at '%s' from '%p' (%u bytes) file '%s' to '%p' (%lu bytes)",
-		    trans_log,
-		    _dmalloc_chunk_desc_pnt(where_buf, sizeof(where_buf),
-					    file, line),
-		    old_user_pnt, old_size,
-		    _dmalloc_chunk_desc_pnt(where_buf2, sizeof(where_buf2),
-					    old_file, old_line),
-		    new_user_pnt, new_size);
   }
   
-  return new_user_pnt;
+  /*
+   * The free list only has slots that can be reused.  We never join
+   * free slots together so the largest free region is the largest
+   * free slot.
+   */
+  for (slot_p = skip_free_list->sa_next_p[0];
+       slot_p != NULL;
+       slot_p = slot_p->sa_next_p[0]) {
+    class_p = frag_class(frag_p, slot_p->sa_total_size);
+    class_p->fc_free_n++;
+    class_p->fc_free_size += slot_p->sa_total_size;
+    frag_p->df_free_size += slot_p->sa_total_size;
+    frag_p->df_largest_free = MAX(frag_p->df_largest_free,
+				  slot_p->sa_total_size);
+  }
+  
+  /* add up the totals from the classes */
+  for (class_c = 0; class_c < DMALLOC_FRAG_CLASS_N; class_c++) {
+    class_p = frag_p->df_divided + class_c;
+    frag_p->df_user_size += class_p->fc_user_size;
+    frag_p->df_round_size += class_p->fc_round_size;
+    frag_p->df_fence_size += class_p->fc_fence_size;
+    class_p = frag_p->df_runs + class_c;
+    frag_p->df_user_size += class_p->fc_user_size;
+    frag_p->df_round_size += class_p->fc_round_size;
+    frag_p->df_fence_size += class_p->fc_fence_size;
+  }
+  
+  /* freed slots that are waiting or never reused are not on the free list */
+  if (free_space_bytes > frag_p->df_free_size) {
+    frag_p->df_unusable_size = free_space_bytes - frag_p->df_free_size;
+  }
+  frag_p->df_admin_size = admin_block_c * BLOCK_SIZE;
+  if (alloc_cur_pnts > 0) {
+    frag_p->df_admin_per_pnt = frag_p->df_admin_size / alloc_cur_pnts;
+  }
 }
 
-/***************************** diagnostic routines ***************************/
+/*
+ * static void log_frag_class
+ *
+ * Log the fragmentation information for a size class if it is being
+ * used.
+ *
+ * ARGUMENTS:
+ *
+ * class_p -> Pointer to the size class.
+ *
+ * desc -> Description of the class.
+ */
+static	void	log_frag_class(const dmalloc_frag_class_t *class_p,
+			       const char *desc)
+{
+  if (class_p->fc_pnt_n == 0 && class_p->fc_free_n == 0) {
+    return;
+  }
+  dmalloc_message(" %12s %7lu %11lu %11lu %9lu %7lu %11lu",
+		  desc, class_p->fc_pnt_n, class_p->fc_user_size,
+		  class_p->fc_round_size, class_p->fc_fence_size,
+		  class_p->fc_free_n, class_p->fc_free_size);
+}
+
+/*
+ * static void log_frag
+ *
+ * Log the fragmentation of the heap broken down by size class.
+ */
+static	void	log_frag(void)
+{
+  dmalloc_frag_t	frag;
+  char			desc[32];
+  int			class_c;
+  
+  _dmalloc_chunk_frag_stats(&frag);
+  
+  dmalloc_message("fragmentation by size class:");
+  dmalloc_message("        class    pnts   user-size round-waste     fence"
+		  "   frees   free-size");
+  for (class_c = 0; class_c < frag.df_divided_n; class_c++) {
+    (void)loc_snprintf(desc, sizeof(desc), "%lu bytes",
+		       frag.df_divided[class_c].fc_size);
+    log_frag_class(frag.df_divided + class_c, desc);
+  }
+  for (class_c = 0; class_c < frag.df_run_n; class_c++) {
+    if (class_c == 0) {
+      (void)loc_snprintf(desc, sizeof(desc), "1 block");
+    }
+    else {
+      (void)loc_snprintf(desc, sizeof(desc), "%lu-%lu blocks",
+			 1UL << class_c, (2UL << class_c) - 1);
+    }
+    log_frag_class(frag.df_runs + class_c, desc);
+  }
+  
+  dmalloc_message("  rounding waste: %lu bytes, fence overhead: %lu bytes",
+		  frag.df_round_size, frag.df_fence_size);
+  dmalloc_message("  free reusable: %lu bytes, free unusable: %lu bytes, largest free: %lu bytes",
+		  frag.df_free_size, frag.df_unusable_size,
+		  frag.df_largest_free);
+  dmalloc_message("  admin space: %lu bytes, %lu bytes per pointer in use",
+		  frag.df_admin_size, frag.df_admin_per_pnt);
+}
+
+/*
+ * static void log_cost
+ *
+ * Log the time spent in each of the costly features of the library
+ * and the system calls that it has made.
+ */
+static	void	log_cost(void)
+{
+  static const char	*names[DMALLOC_COST_N] = {
+    "heap-check", "fence-write", "fence-check", "blank-fill",
+    "blank-check", "log", "mem-table", "skip-list" };
+  dmalloc_cost_t	cost;
+  int			cost_c;
+  
+  /* copy them first because the logging below is itself counted */
+  cost = _dmalloc_cost;
+  
+  dmalloc_message("feature costs:");
+  dmalloc_message("      feature        calls          cycles  cycles/call");
+  for (cost_c = 0; cost_c < DMALLOC_COST_N; cost_c++) {
+    if (cost.dc_calls[cost_c] == 0) {
+      continue;
+    }
+    dmalloc_message(" %12s %12lu %15lu %12lu",
+		    names[cost_c], cost.dc_calls[cost_c],
+		    cost.dc_cycles[cost_c],
+		    cost.dc_cycles[cost_c] / cost.dc_calls[cost_c]);
+  }
+  dmalloc_message("  heap syscalls: %lu maps of %lu bytes, %lu unmaps of %lu bytes",
+		  cost.dc_map_c, cost.dc_map_size, cost.dc_unmap_c,
+		  cost.dc_unmap_size);
+}
 
 /*
  * void _dmalloc_chunk_log_stats
@@ -2780,11 +4192,25 @@ void	_dmalloc_chunk_log_stats(void)
 		   ((alloc_max_given - alloc_maximum) * 100) /
 		   alloc_max_given));
   
+  log_frag();
+  log_cost();
+  
 #if MEMORY_TABLE_TOP_LOG
   dmalloc_message("top %d allocations:", MEMORY_TABLE_TOP_LOG);
   _dmalloc_table_log_info(&mem_table_alloc, MEMORY_TABLE_TOP_LOG,
-			  1 /* have in-use column */);
-#endif
+			  1 /* have in-use column */, 1 /* histograms */);
+#endif  
+  if (budget_n > 0) {
+    budget_t	*budget_p;
+    
+    dmalloc_message("memory budgets:");
+    for (budget_p = budgets; budget_p < budgets + budget_n; budget_p++) {
+      dmalloc_message("  %s:%u limit %lu bytes, in-use %lu, max %lu, over %lu times",
+		      budget_p->bu_file, budget_p->bu_line, budget_p->bu_limit,
+		      budget_p->bu_in_use, budget_p->bu_max_in_use,
+		      budget_p->bu_over_c);
+    }
+  }
 }
 
 /*
@@ -2811,11 +4237,12 @@ void	_dmalloc_chunk_log_changed(const unsigned long mark,
 {
   skip_alloc_t	*slot_p;
   pnt_info_t	pnt_info;
-  int		known_b, freed_b, used_b;
+  mem_entry_t	*changed_entries;
+  int		known_b, freed_b, used_b, changed_entry_n;
   char		out[DUMP_SPACE * 4], *which_str;
   char		where_buf[MAX_FILE_LENGTH + 64], disp_buf[64];
   int		unknown_size_c = 0, unknown_block_c = 0, out_len;
-  int		size_c = 0, block_c = 0, checking_list_c = 0;
+  int		size_c = 0, block_c = 0;
   
   if (log_not_freed_b && log_freed_b) {
     which_str = "Not-Freed and Freed";
@@ -2838,38 +4265,18 @@ void	_dmalloc_chunk_log_changed(const unsigned long mark,
 		    which_str, mark);
   }
   
-  /* clear out our memory table so we can fill it with pointer info */
-  _dmalloc_table_init(&mem_table_changed, mem_table_changed_entries,
-		      sizeof(mem_table_changed_entries) /
-		      sizeof(*mem_table_changed_entries));
-  
-  /* run through the blocks */
-  for (slot_p = skip_address_list->sa_next_p[0];
-       ;
-       slot_p = slot_p->sa_next_p[0]) {
-    
-    /*
-     * switch to the free list in the middle after we've checked the
-     * used pointer slots
-     */
-    if (slot_p == NULL) {
-      checking_list_c++;
-      if (checking_list_c == 1) {
-	slot_p = skip_free_list->sa_next_p[0];
-      }
-#if FREED_POINTER_DELAY
-      else if (checking_list_c == 2) {
-	slot_p = free_wait_list_head;
-      }
-#endif
-      else {
-	/* we are done */
-	break;
-      }
-      if (slot_p == NULL) {
-	break;
-      }
-    }
+  /*
+   * Clear out our memory table so we can fill it with pointer info.
+   * We reuse the entries in case the table was grown before.
+   */
+  changed_entries = mem_table_changed.mt_entries;
+  changed_entry_n = mem_table_changed.mt_entry_n;
+  _dmalloc_table_init(&mem_table_changed, changed_entries, changed_entry_n);
+  
+  /* run through only the slots that were used after the mark */
+  for (slot_p = recent_since(mark);
+       slot_p != NULL;
+       slot_p = slot_p->sa_newer_p) {
     
     freed_b = BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_FREE);
     used_b = BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_USER);
@@ -2885,10 +4292,6 @@ void	_dmalloc_chunk_log_changed(const unsigned long mark,
     if (! ((log_not_freed_b && used_b) || (log_freed_b && freed_b))) {
       continue;
     }    
-    /* is it too long ago? */
-    if (slot_p->sa_use_iter <= mark) {
-      continue;
-    }
     
     /* unknown pointer? */
     if (slot_p->sa_file == DMALLOC_DEFAULT_FILE
@@ -2905,14 +4308,15 @@ void	_dmalloc_chunk_log_changed(const unsigned long mark,
     
     if (known_b || (! BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_KNOWN))) {
       if (details_b) {
-	dmalloc_message(" %s freed: '%s' (%u bytes) from '%s'",
-			(freed_b ? "   " : "not"),
-			display_pnt(pnt_info.pi_user_start, slot_p, disp_buf,
-				    sizeof(disp_buf)),
-			slot_p->sa_user_size,
-			_dmalloc_chunk_desc_pnt(where_buf, sizeof(where_buf),
-						slot_p->sa_file,
-						slot_p->sa_line));
+	_dmalloc_desc_message(&changed_format,
+			      " %s freed: '%s' (%u bytes) from '%s'",
+			      (freed_b ? "   " : "not"),
+			      display_pnt(pnt_info.pi_user_start, slot_p,
+					  disp_buf, sizeof(disp_buf)),
+			      slot_p->sa_user_size,
+			      _dmalloc_chunk_desc_pnt(where_buf, sizeof(where_buf),
+						      slot_p->sa_file,
+						      slot_p->sa_line));
 	
 	if ((! freed_b)
 	    && BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_NONFREE_SPACE)) {
@@ -2922,6 +4326,7 @@ void	_dmalloc_chunk_log_changed(const unsigned long mark,
 			  pnt_info.pi_user_start, out_len, out);
 	}
       }
+      table_grow(&mem_table_changed);
       _dmalloc_table_insert(&mem_table_changed, slot_p->sa_file,
 			    slot_p->sa_line, slot_p->sa_user_size);
     }
@@ -2929,7 +4334,7 @@ void	_dmalloc_chunk_log_changed(const unsigned long mark,
   
   /* dump the summary from the table table */
   _dmalloc_table_log_info(&mem_table_changed, 0 /* log all entries */,
-			  0 /* no in-use column */);
+			  0 /* no in-use column */, 0 /* no histograms */);
   
   /* copy out size of pointers */
   if (block_c > 0) {
@@ -2970,36 +4375,12 @@ unsigned long	_dmalloc_chunk_count_changed(const unsigned long mark,
 {
   skip_alloc_t	*slot_p;
   int		freed_b, used_b;
-  int		checking_list_c = 0;
   unsigned int	mem_count = 0;
   
-  /* run through the blocks */
-  for (slot_p = skip_address_list->sa_next_p[0];
-       ;
-       slot_p = slot_p->sa_next_p[0]) {
-    
-    /*
-     * switch to the free list in the middle after we've checked the
-     * used pointer slots
-     */
-    if (slot_p == NULL) {
-      checking_list_c++;
-      if (checking_list_c == 1) {
-	slot_p = skip_free_list->sa_next_p[0];
-      }
-#if FREED_POINTER_DELAY
-      else if (checking_list_c == 2) {
-	slot_p = free_wait_list_head;
-      }
-#endif
-      else {
-	/* we are done */
-	break;
-      }
-      if (slot_p == NULL) {
-	break;
-      }
-    }
+  /* run through only the slots that were used after the mark */
+  for (slot_p = recent_since(mark);
+       slot_p != NULL;
+       slot_p = slot_p->sa_newer_p) {
     
     freed_b = BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_FREE);
     used_b = BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_USER);
@@ -3010,10 +4391,6 @@ unsigned long	_dmalloc_chunk_count_changed(const unsigned long mark,
     if (! (freed_b || used_b)) {
       continue;
     }
-    /* is it too long ago? */
-    if (slot_p->sa_use_iter <= mark) {
-      continue;
-    }
     
     /* count the memory */
     if (count_not_freed_b && used_b) {
@@ -3085,3 +4462,272 @@ void	_dmalloc_chunk_get_stats(void **heap_low_p, void **heap_high_p,
   SET_POINTER(max_pnt_np, alloc_max_pnts);
   SET_POINTER(max_one_p, alloc_one_max);
 }
+
+/*
+ * void _dmalloc_chunk_stats_ex
+ *
+ * Fill in the heap, pointer, and function counters of a statistics
+ * structure.  The library should be locked.
+ *
+ * ARGUMENTS:
+ *
+ * stats_p <- Pointer to the statistics that we are filling in.
+ */
+void	_dmalloc_chunk_stats_ex(dmalloc_stats_t *stats_p)
+{
+  stats_p->ds_heap_low = _dmalloc_heap_low;
+  stats_p->ds_heap_high = _dmalloc_heap_high;
+  stats_p->ds_total_space = (user_block_c + admin_block_c) * BLOCK_SIZE;
+  stats_p->ds_user_space = alloc_current + free_space_bytes;
+  stats_p->ds_free_space = free_space_bytes;
+  stats_p->ds_user_block_c = user_block_c;
+  stats_p->ds_admin_block_c = admin_block_c;
+  stats_p->ds_heap_check_c = heap_check_c;
+  
+  stats_p->ds_alloc_current = alloc_current;
+  stats_p->ds_alloc_maximum = alloc_maximum;
+  stats_p->ds_alloc_cur_given = alloc_cur_given;
+  stats_p->ds_alloc_max_given = alloc_max_given;
+  stats_p->ds_alloc_one_max = alloc_one_max;
+  
+  stats_p->ds_alloc_cur_pnts = alloc_cur_pnts;
+  stats_p->ds_alloc_max_pnts = alloc_max_pnts;
+  stats_p->ds_alloc_tot_pnts = alloc_tot_pnts;
+  
+  stats_p->ds_malloc_c = func_malloc_c;
+  stats_p->ds_calloc_c = func_calloc_c;
+  stats_p->ds_realloc_c = func_realloc_c;
+  stats_p->ds_recalloc_c = func_recalloc_c;
+  stats_p->ds_memalign_c = func_memalign_c;
+  stats_p->ds_valloc_c = func_valloc_c;
+  stats_p->ds_new_c = func_new_c;
+  stats_p->ds_free_c = func_free_c;
+  stats_p->ds_delete_c = func_delete_c;
+  
+  stats_p->ds_table_entry_n = mem_table_alloc.mt_entry_n;
+  stats_p->ds_table_in_use_c = mem_table_alloc.mt_in_use_c;
+}
+
+/*
+ * int _dmalloc_chunk_top_entries
+ *
+ * Select the call-sites with the largest total-size from the memory
+ * table.  The library should be locked.
+ *
+ * Returns the number of entries in the top array sorted with the
+ * largest first.
+ *
+ * ARGUMENTS:
+ *
+ * top <- Array of entry pointers that we fill in.
+ *
+ * top_n -> Maximum number of entries to select.
+ */
+int	_dmalloc_chunk_top_entries(struct mem_entry_st **top,
+				   const int top_n)
+{
+  return _dmalloc_table_top(&mem_table_alloc, top, top_n);
+}
+
+/*
+ * struct mem_entry_st *_dmalloc_chunk_find_entry
+ *
+ * Find the memory table entry of a call-site.  The library should be
+ * locked.
+ *
+ * Returns the entry or NULL if the call-site is not in the table.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File name or return address of the allocation.
+ *
+ * line -> Line number of the allocation.
+ */
+struct mem_entry_st	*_dmalloc_chunk_find_entry(const char *file,
+						   const unsigned int line)
+{
+  return _dmalloc_table_find(&mem_table_alloc, file, line);
+}
+
+/*
+ * int _dmalloc_chunk_walk
+ *
+ * Call a function for each of the pointers in use that were changed
+ * since a mark, in the order they were changed.  The library should
+ * be locked and the function must not call back into the library.
+ *
+ * Returns the number of pointers that the function was called for.
+ *
+ * ARGUMENTS:
+ *
+ * mark -> Dmalloc counter used to mark a specific time.  Set to 0 to
+ * walk all of the pointers in use.
+ *
+ * func -> Function to call with the user pointer, its size, its size
+ * with the overhead, the file and line or return-address of the
+ * allocation, the iteration it was last changed, the flags of the
+ * slot, and ARG.  It returns 1 to keep walking or 0 to stop.
+ *
+ * arg -> Argument passed through to the function.
+ */
+int	_dmalloc_chunk_walk(const unsigned long mark,
+			    int (*func)(const void *pnt,
+					const unsigned int size,
+					const unsigned int total_size,
+					const char *file,
+					const unsigned int line,
+					const unsigned long iter,
+					const unsigned int flags, void *arg),
+			    void *arg)
+{
+  skip_alloc_t	*slot_p;
+  pnt_info_t	pnt_info;
+  int		walk_c = 0;
+  
+  for (slot_p = recent_since(mark);
+       slot_p != NULL;
+       slot_p = slot_p->sa_newer_p) {
+    if (! BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_USER)) {
+      continue;
+    }
+    get_pnt_info(slot_p, &pnt_info);
+    walk_c++;
+    if (! func(pnt_info.pi_user_start, slot_p->sa_user_size,
+	       slot_p->sa_total_size, slot_p->sa_file, slot_p->sa_line,
+	       slot_p->sa_use_iter, slot_p->sa_flags, arg)) {
+      break;
+    }
+  }
+  
+  return walk_c;
+}
+
+/*
+ * void _dmalloc_chunk_mark_range
+ *
+ * Mark the pointers in use that are reached from a range of memory
+ * that is a root of the leak scan such as the global variables or a
+ * stack.  The library should be locked.
+ *
+ * ARGUMENTS:
+ *
+ * start -> Start of the memory to scan.
+ *
+ * bounds -> Just past the end of the memory to scan.
+ */
+void	_dmalloc_chunk_mark_range(const void *start, const void *bounds)
+{
+  mark_range(start, bounds);
+}
+
+/*
+ * int _dmalloc_chunk_log_unreachable
+ *
+ * Finish marking the pointers reached from the roots given to
+ * _dmalloc_chunk_mark_range and log the pointers in use which were
+ * not reached.  The marks are cleared for the next scan.
+ *
+ * Returns the number of unreachable pointers.
+ *
+ * ARGUMENTS:
+ *
+ * details_b -> If set to 1 then dump the individual pointer entries
+ * instead of just the summary.
+ */
+int	_dmalloc_chunk_log_unreachable(const int details_b)
+{
+  skip_alloc_t	*slot_p;
+  pnt_info_t	pnt_info;
+  mem_entry_t	*changed_entries;
+  char		where_buf[MAX_FILE_LENGTH + 64], disp_buf[64];
+  int		changed_entry_n, known_b;
+  int		block_c = 0, unknown_block_c = 0;
+  unsigned long	size_c = 0, unknown_size_c = 0;
+  
+  mark_finish();
+  
+  dmalloc_message("Dumping Unreachable Pointers:");
+  
+  /* we summarize by call-site in the changed table like log-changed */
+  changed_entries = mem_table_changed.mt_entries;
+  changed_entry_n = mem_table_changed.mt_entry_n;
+  _dmalloc_table_init(&mem_table_changed, changed_entries, changed_entry_n);
+  
+  for (slot_p = skip_address_list->sa_next_p[0];
+       slot_p != NULL;
+       slot_p = slot_p->sa_next_p[0]) {
+    if (! BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_USER)) {
+      continue;
+    }
+    if (BIT_IS_SET(slot_p->sa_flags, ALLOC_FLAG_MARK)) {
+      BIT_CLEAR(slot_p->sa_flags, ALLOC_FLAG_MARK);
+      continue;
+    }
+    
+    block_c++;
+    size_c += slot_p->sa_user_size;
+    if (slot_p->sa_file == DMALLOC_DEFAULT_FILE
+	|| slot_p->sa_line == DMALLOC_DEFAULT_LINE) {
+      unknown_block_c++;
+      unknown_size_c += slot_p->sa_user_size;
+      known_b = 0;
+    }
+    else {
+      known_b = 1;
+    }
+    
+    if ((! known_b) && BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_KNOWN)) {
+      continue;
+    }
+    
+    if (details_b) {
+      get_pnt_info(slot_p, &pnt_info);
+      _dmalloc_desc_message(&unreachable_format,
+			    " unreachable: '%s' (%u bytes) from '%s'",
+			    display_pnt(pnt_info.pi_user_start, slot_p,
+					disp_buf, sizeof(disp_buf)),
+			    slot_p->sa_user_size,
+			    _dmalloc_chunk_desc_pnt(where_buf, sizeof(where_buf),
+						    slot_p->sa_file,
+						    slot_p->sa_line));
+    }
+    table_grow(&mem_table_changed);
+    _dmalloc_table_insert(&mem_table_changed, slot_p->sa_file,
+			  slot_p->sa_line, slot_p->sa_user_size);
+  }
+  
+  /* dump the summary from the table */
+  _dmalloc_table_log_info(&mem_table_changed, 0 /* log all entries */,
+			  0 /* no in-use column */, 0 /* no histograms */);
+  
+  if (block_c - unknown_block_c > 0) {
+    dmalloc_message(" known unreachable: %d pointer%s, %lu bytes",
+		    block_c - unknown_block_c,
+		    (block_c - unknown_block_c == 1 ? "" : "s"),
+		    size_c - unknown_size_c);
+  }
+  if (unknown_block_c > 0) {
+    dmalloc_message(" unknown unreachable: %d pointer%s, %lu bytes",
+		    unknown_block_c, (unknown_block_c == 1 ? "" : "s"),
+		    unknown_size_c);
+  }
+  
+  return block_c;
+}
+
+/*
+ * int _dmalloc_chunk_write_profile
+ *
+ * Write a pprof compatible heap profile of the memory table to a
+ * file.
+ *
+ * Returns 1 on success or 0 on failure.
+ *
+ * ARGUMENTS:
+ *
+ * path -> Path of the file to write.
+ */
+int	_dmalloc_chunk_write_profile(const char *path)
+{
+  return _dmalloc_profile_write(path, &mem_table_alloc);
+}
@@ -22,6 +22,9 @@
 #ifndef __CHUNK_H__
 #define __CHUNK_H__
 
+/* the table entries are defined in dmalloc_tab.h */
+struct mem_entry_st;
+
 /*<<<<<<<<<<  The below prototypes are auto-generated by fillproto */
 
 /* limit in how much memory we are allowed to allocate */
@@ -32,6 +35,10 @@ unsigned long		_dmalloc_memory_limit;
 extern
 unsigned long		_dmalloc_alloc_total;
 
+/* changed each time a pointer is freed or its size is changed */
+extern
+volatile unsigned long	_dmalloc_free_epoch;
+
 /*
  * int _dmalloc_chunk_startup
  * 
@@ -144,11 +151,76 @@ int	_dmalloc_chunk_heap_check(void);
  *
  * min_size -> Make sure that pnt can hold at least that many bytes.
  * If 0 then ignore.
+ *
+ * start_p <- Pointer to the start of the user space of the allocation
+ * holding the pointer or NULL if it is not a user allocation.  Can be
+ * NULL.
+ *
+ * bounds_p <- Pointer to just past the end of the user space of the
+ * allocation holding the pointer or NULL.  Can be NULL.
  */
 extern
 int	_dmalloc_chunk_pnt_check(const char *func, const void *user_pnt,
 				 const int exact_b, const int strlen_b,
-				 const int min_size);
+				 const int min_size, const void **start_p,
+				 const void **bounds_p);
+
+/*
+ * DMALLOC_SIZE _dmalloc_chunk_pnt_check_many
+ *
+ * Check that each of an array of pointers was handed back by an
+ * allocation.  The pointers are sorted in batches so each batch is
+ * found with one walk up the address list.
+ *
+ * Returns the number of pointers that are not okay.
+ *
+ * ARGUMENTS:
+ *
+ * pnts -> Array of the pointers we are checking.  NULL pointers are
+ * skipped.
+ *
+ * pnt_n -> Number of the pointers in the array.
+ *
+ * results <- Array that we set to 1 for each pointer that is okay or
+ * 0 if not.  Can be NULL.
+ */
+extern
+DMALLOC_SIZE	_dmalloc_chunk_pnt_check_many(const DMALLOC_PNT *pnts,
+					      const DMALLOC_SIZE pnt_n,
+					      int *results);
+
+/*
+ * int _dmalloc_chunk_budget_set
+ *
+ * Set, change, or remove the memory budget for a file or a file/line
+ * call-site.
+ *
+ * Returns 1 on success or 0 on failure.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name to match against the allocations.  It can end
+ * with a '*' to match a prefix of the file.
+ *
+ * line -> Line-number to match or 0 for any line in the file.
+ *
+ * limit -> Maximum number of bytes in use by the matching allocations
+ * or 0 to remove the budget.
+ *
+ * action -> What to do when an allocation would go over the budget.
+ * One of the DMALLOC_BUDGET_ values from dmalloc.h.
+ */
+extern
+int	_dmalloc_chunk_budget_set(const char *file, const unsigned int line,
+				  const unsigned long limit, const int action);
+
+/*
+ * void _dmalloc_chunk_budget_clear
+ *
+ * Remove all of the memory budgets.
+ */
+extern
+void	_dmalloc_chunk_budget_clear(void);
 
 /*
  * void *_dmalloc_chunk_malloc
@@ -221,6 +293,20 @@ void	*_dmalloc_chunk_realloc(const char *file, const unsigned int line,
 				const unsigned long new_size,
 				const int func_id);
 
+/*
+ * void _dmalloc_chunk_frag_stats
+ *
+ * Get information about the fragmentation of the heap broken down by
+ * size class.  This walks the used and free lists so it is O(N) in
+ * the number of slots.
+ *
+ * ARGUMENTS:
+ *
+ * frag_p <- Pointer to the fragmentation information to fill in.
+ */
+extern
+void	_dmalloc_chunk_frag_stats(dmalloc_frag_t *frag_p);
+
 /*
  * void _dmalloc_chunk_log_stats
  *
@@ -323,6 +409,136 @@ void	_dmalloc_chunk_get_stats(void **heap_low_p, void **heap_high_p,
 				 unsigned long *max_pnt_np,
 				 unsigned long *max_one_p);
 
+/*
+ * void _dmalloc_chunk_stats_ex
+ *
+ * Fill in the heap, pointer, and function counters of a statistics
+ * structure.  The library should be locked.
+ *
+ * ARGUMENTS:
+ *
+ * stats_p <- Pointer to the statistics that we are filling in.
+ */
+extern
+void	_dmalloc_chunk_stats_ex(dmalloc_stats_t *stats_p);
+
+/*
+ * int _dmalloc_chunk_top_entries
+ *
+ * Select the call-sites with the largest total-size from the memory
+ * table.  The library should be locked.
+ *
+ * Returns the number of entries in the top array sorted with the
+ * largest first.
+ *
+ * ARGUMENTS:
+ *
+ * top <- Array of entry pointers that we fill in.
+ *
+ * top_n -> Maximum number of entries to select.
+ */
+extern
+int	_dmalloc_chunk_top_entries(struct mem_entry_st **top,
+				   const int top_n);
+
+/*
+ * struct mem_entry_st *_dmalloc_chunk_find_entry
+ *
+ * Find the memory table entry of a call-site.  The library should be
+ * locked.
+ *
+ * Returns the entry or NULL if the call-site is not in the table.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File name or return address of the allocation.
+ *
+ * line -> Line number of the allocation.
+ */
+extern
+struct mem_entry_st	*_dmalloc_chunk_find_entry(const char *file,
+						   const unsigned int line);
+
+/*
+ * int _dmalloc_chunk_walk
+ *
+ * Call a function for each of the pointers in use that were changed
+ * since a mark, in the order they were changed.  The library should
+ * be locked and the function must not call back into the library.
+ *
+ * Returns the number of pointers that the function was called for.
+ *
+ * ARGUMENTS:
+ *
+ * mark -> Dmalloc counter used to mark a specific time.  Set to 0 to
+ * walk all of the pointers in use.
+ *
+ * func -> Function to call with the user pointer, its size, its size
+ * with the overhead, the file and line or return-address of the
+ * allocation, the iteration it was last changed, the flags of the
+ * slot, and ARG.  It returns 1 to keep walking or 0 to stop.
+ *
+ * arg -> Argument passed through to the function.
+ */
+extern
+int	_dmalloc_chunk_walk(const unsigned long mark,
+			    int (*func)(const void *pnt,
+					const unsigned int size,
+					const unsigned int total_size,
+					const char *file,
+					const unsigned int line,
+					const unsigned long iter,
+					const unsigned int flags, void *arg),
+			    void *arg);
+
+/*
+ * void _dmalloc_chunk_mark_range
+ *
+ * Mark the pointers in use that are reached from a range of memory
+ * that is a root of the leak scan such as the global variables or a
+ * stack.  The library should be locked.
+ *
+ * ARGUMENTS:
+ *
+ * start -> Start of the memory to scan.
+ *
+ * bounds -> Just past the end of the memory to scan.
+ */
+extern
+void	_dmalloc_chunk_mark_range(const void *start, const void *bounds);
+
+/*
+ * int _dmalloc_chunk_log_unreachable
+ *
+ * Finish marking the pointers reached from the roots given to
+ * _dmalloc_chunk_mark_range and log the pointers in use which were
+ * not reached.  The marks are cleared for the next scan.
+ *
+ * Returns the number of unreachable pointers.
+ *
+ * ARGUMENTS:
+ *
+ * details_b -> If set to 1 then dump the individual pointer entries
+ * instead of just the summary.
+ */
+extern
+int	_dmalloc_chunk_log_unreachable(const int details_b);
+
+/*
+ * int _dmalloc_chunk_write_profile
+ *
+ * Write a pprof compatible heap profile of the memory table to a
+ * file.
+ *
+ * Returns 1 on success or 0 on failure.
+ *
+ * ARGUMENTS:
+ *
+ * path -> Path of the file to write.
+ */
+extern
+int	_dmalloc_chunk_write_profile(const char *path);
+
 /*<<<<<<<<<<   This is end of the auto-generated output from fillproto. */
 
 #endif /* ! __CHUNK_H__ */
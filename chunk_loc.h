@@ -58,6 +58,12 @@
 #define MEM_ALLOC_ENTRIES	(MEMORY_TABLE_SIZE * 2)
 #define MEM_CHANGED_ENTRIES	(MEMORY_TABLE_SIZE * 2)
 
+/* reached slots remembered by the leak scan before it has to rescan */
+#define MARK_STACK_SIZE		4096
+
+/* length of the file name or pattern stored with a budget */
+#define BUDGET_FILE_LENGTH	128
+
 /* NOTE: FENCE_BOTTOM_SIZE and FENCE_TOP_SIZE defined in settings.h */
 #define FENCE_OVERHEAD_SIZE	(FENCE_BOTTOM_SIZE + FENCE_TOP_SIZE)
 #define FENCE_MAGIC_BOTTOM	0xC0C0AB1B
@@ -74,6 +80,7 @@
 #define ALLOC_FLAG_BLANK	BIT_FLAG(4)	/* slot has been blanked */
 #define ALLOC_FLAG_FENCE	BIT_FLAG(5)	/* slot is fence posted */
 #define ALLOC_FLAG_VALLOC	BIT_FLAG(6)	/* slot is block aligned */
+#define ALLOC_FLAG_MARK		BIT_FLAG(7)	/* slot reached by leak scan */
 
 /*
  * Below defines an allocation structure either on the free or used
@@ -113,6 +120,10 @@ typedef struct skip_alloc_st {
   THREAD_TYPE		sa_thread_id;	/* thread id which allocaed pnt */
 #endif
   
+  /* neighbors in the list of slots in the order they were last used */
+  struct skip_alloc_st	*sa_older_p;	/* used before us */
+  struct skip_alloc_st	*sa_newer_p;	/* used after us */
+  
   /*
    * Array of next pointers.  This may extend past the end of the
    * function if we allocate for space larger than the structure.
@@ -121,6 +132,31 @@ typedef struct skip_alloc_st {
   
 } skip_alloc_t;
 
+/*
+ * Memory budget for a file or a file/line call-site.  The file may end
+ * in a '*' to match a prefix and is compared to both the full path
+ * and the basename of the allocation file.
+ */
+typedef struct {
+  char			bu_file[BUDGET_FILE_LENGTH]; /* file or pattern */
+  unsigned int		bu_line;	/* line number or 0 for any line */
+  unsigned long		bu_limit;	/* maximum in-use bytes */
+  int			bu_action;	/* DMALLOC_BUDGET_ action */
+  unsigned long		bu_in_use;	/* current in-use bytes */
+  unsigned long		bu_max_in_use;	/* maximum in-use bytes */
+  unsigned long		bu_over_c;	/* times budget was exceeded */
+  int			bu_over_b;	/* currently over the budget */
+} budget_t;
+
+/*
+ * Pointer being checked by the bulk pointer checks and its place in
+ * the caller's array.
+ */
+typedef struct {
+  const void		*vp_pnt;	/* pointer to check */
+  DMALLOC_SIZE		vp_index;	/* index in the caller's array */
+} verify_pnt_t;
+
 /*
  * This macro helps us determine how much memory we need to store to
  * hold all of the next pointers in the skip-list entry.  So if we are
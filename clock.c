@@ -0,0 +1,324 @@
+/*
+ * Cached clock routines
+ *
+ * Copyright 2020 by Gray Watson
+ *
+ * This file is part of the dmalloc package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ *
+ * The author may be contacted via https://dmalloc.com/
+ */
+
+/*
+ * This file contains the routines which read the time for the log
+ * lines, the binary logs, and the pointer timestamps.  Where there is
+ * a coarse monotonic clock, it is anchored to the time of day once at
+ * startup and then read instead of calling gettimeofday() or time()
+ * for every allocation.  The ctime() string at the front of the log
+ * lines is only rebuilt when the second changes and uses the offset
+ * of the local timezone which is read once when the library starts.
+ */
+
+#if HAVE_STRING_H
+# include <string.h>
+#endif
+
+#define DMALLOC_DISABLE
+
+#include "conf.h"
+
+#if HAVE_TIME
+# ifdef TIME_INCLUDE
+#  include TIME_INCLUDE
+# endif
+#endif
+#if LOG_PNT_TIMEVAL
+# ifdef TIMEVAL_INCLUDE
+#  include TIMEVAL_INCLUDE
+# endif
+#endif
+
+#include "dmalloc.h"
+
+#include "append.h"
+#include "clock.h"
+#include "dmalloc_loc.h"
+
+/* use the coarse clock if the system has one */
+#if USE_CACHED_CLOCK && HAVE_TIME && defined(CLOCK_MONOTONIC_COARSE)
+# define COARSE_CLOCK	1
+#else
+# define COARSE_CLOCK	0
+#endif
+
+#define NSECS_IN_SEC	1000000000L
+#define SECS_IN_MIN	60
+#define MINS_IN_HOUR	60
+#define SECS_IN_HOUR	(MINS_IN_HOUR * SECS_IN_MIN)
+#define SECS_IN_DAY	(24 * SECS_IN_HOUR)
+#define NSECS_IN_USEC	1000L
+
+/* length of the ctime() string without the \n */
+#define CTIME_LENGTH	24
+
+#if COARSE_CLOCK
+/* time of day and the coarse clock when we anchored them together */
+static	int		anchored_b = 0;
+static	struct timespec	wall_base;
+static	struct timespec	mono_base;
+#endif
+
+/* the cost statistics of the library */
+dmalloc_cost_t		_dmalloc_cost;
+
+/* seconds that the local timezone is ahead of UTC */
+static	long		zone_secs = 0;
+
+/* the last ctime() string and the second it is for */
+static	long		ctime_secs = -1;
+static	char		ctime_buf[CTIME_LENGTH + 1];
+
+#if COARSE_CLOCK
+/*
+ * Read the coarse clock into now_p and shift it to the time of day.
+ */
+static	void	clock_now(struct timespec *now_p)
+{
+  struct timespec	mono;
+  
+  if (! anchored_b) {
+    _dmalloc_clock_startup();
+  }
+  (void)clock_gettime(CLOCK_MONOTONIC_COARSE, &mono);
+  
+  now_p->tv_sec = wall_base.tv_sec + (mono.tv_sec - mono_base.tv_sec);
+  now_p->tv_nsec = wall_base.tv_nsec + (mono.tv_nsec - mono_base.tv_nsec);
+  if (now_p->tv_nsec < 0) {
+    now_p->tv_nsec += NSECS_IN_SEC;
+    now_p->tv_sec--;
+  }
+  else if (now_p->tv_nsec >= NSECS_IN_SEC) {
+    now_p->tv_nsec -= NSECS_IN_SEC;
+    now_p->tv_sec++;
+  }
+}
+#endif
+
+/**************************** exported routines ******************************/
+
+/*
+ * void _dmalloc_clock_startup
+ *
+ * Anchor the coarse clock to the time of day.  This is called when
+ * the library starts up and before the first read of the clock.
+ */
+void	_dmalloc_clock_startup(void)
+{
+#if COARSE_CLOCK
+  (void)clock_gettime(CLOCK_REALTIME, &wall_base);
+  (void)clock_gettime(CLOCK_MONOTONIC_COARSE, &mono_base);
+  anchored_b = 1;
+#endif
+}
+
+/*
+ * void _dmalloc_clock_zone_startup
+ *
+ * Read the offset of the local timezone from UTC for the ctime()
+ * string.  This must be called outside of the lock after the library
+ * is enabled because loading the timezone can allocate memory.
+ * Changes to daylight savings time after this are not seen.
+ */
+void	_dmalloc_clock_zone_startup(void)
+{
+#if HAVE_TIME && HAVE_CTIME
+  struct tm	local_tm, utc_tm, *tm_p;
+  time_t	now;
+  long		days;
+  
+  now = time(NULL);
+  /* localtime and gmtime share a buffer so we copy each one */
+  tm_p = localtime(&now);
+  if (tm_p == NULL) {
+    return;
+  }
+  local_tm = *tm_p;
+  tm_p = gmtime(&now);
+  if (tm_p == NULL) {
+    return;
+  }
+  utc_tm = *tm_p;
+  
+  /* the offset is less than a day so the dates are at most a day apart */
+  if (local_tm.tm_year != utc_tm.tm_year) {
+    days = (local_tm.tm_year > utc_tm.tm_year ? 1 : -1);
+  }
+  else {
+    days = local_tm.tm_yday - utc_tm.tm_yday;
+  }
+  zone_secs = (days * SECS_IN_DAY
+	       + (local_tm.tm_hour - utc_tm.tm_hour) * SECS_IN_HOUR
+	       + (local_tm.tm_min - utc_tm.tm_min) * SECS_IN_MIN
+	       + (local_tm.tm_sec - utc_tm.tm_sec));
+#endif
+}
+
+/*
+ * long _dmalloc_clock_seconds
+ *
+ * Returns the current time in seconds since the epoch like time().
+ */
+long	_dmalloc_clock_seconds(void)
+{
+#if COARSE_CLOCK
+  struct timespec	now;
+  
+  clock_now(&now);
+  return now.tv_sec;
+#else
+#if HAVE_TIME
+  return time(NULL);
+#else
+  return 0;
+#endif
+#endif
+}
+
+/*
+ * unsigned long _dmalloc_clock_nanos
+ *
+ * Returns the fine-grained monotonic clock in nano-seconds for timing
+ * intervals or 0 if the system does not have one.
+ */
+unsigned long	_dmalloc_clock_nanos(void)
+{
+#if HAVE_TIME && defined(CLOCK_MONOTONIC)
+  struct timespec	now;
+  
+  (void)clock_gettime(CLOCK_MONOTONIC, &now);
+  return (unsigned long)now.tv_sec * NSECS_IN_SEC + now.tv_nsec;
+#else
+  return 0;
+#endif
+}
+
+/*
+ * unsigned long _dmalloc_clock_cycles
+ *
+ * Returns the CPU's cycle counter for timing the features of the
+ * library.  On systems without a counter that we know how to read,
+ * this returns the monotonic clock in nano-seconds.
+ */
+unsigned long	_dmalloc_clock_cycles(void)
+{
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  return (unsigned long)__builtin_ia32_rdtsc();
+#elif defined(__GNUC__) && defined(__aarch64__)
+  unsigned long	count;
+  
+  __asm__ __volatile__ ("mrs %0, cntvct_el0" : "=r" (count));
+  return count;
+#else
+  return _dmalloc_clock_nanos();
+#endif
+}
+
+#if LOG_PNT_TIMEVAL
+/*
+ * void _dmalloc_clock_timeval
+ *
+ * Read the current time of day into a timeval like GET_TIMEVAL.  It
+ * is only as accurate as the tick of the coarse clock.
+ *
+ * ARGUMENTS:
+ *
+ * timeval_p -> Pointer to the time value that we are setting.
+ */
+void	_dmalloc_clock_timeval(TIMEVAL_TYPE *timeval_p)
+{
+#if COARSE_CLOCK
+  struct timespec	now;
+  
+  clock_now(&now);
+  timeval_p->tv_sec = now.tv_sec;
+  timeval_p->tv_usec = now.tv_nsec / NSECS_IN_USEC;
+#else
+  GET_TIMEVAL(*timeval_p);
+#endif
+}
+#endif
+
+/*
+ * const char *_dmalloc_clock_ctime
+ *
+ * Returns the current local time as a string in the format of
+ * ctime() without the trailing \n.  The string is only rebuilt when
+ * the second changes.  We do not call ctime() because it can allocate
+ * memory when it loads the timezone which would recurse back into the
+ * library.  The timezone is read by _dmalloc_clock_zone_startup.
+ */
+const char	*_dmalloc_clock_ctime(void)
+{
+  static const char	*day_names[] = {
+    "Thu", "Fri", "Sat", "Sun", "Mon", "Tue", "Wed" };
+  static const char	*month_names[] = {
+    "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+    "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+  long	now, days, secs, era, year_of_era, day_of_year, month_idx, year;
+  int	weekday, month, day;
+  char	*buf_p;
+  
+  now = _dmalloc_clock_seconds();
+  if (now == ctime_secs) {
+    return ctime_buf;
+  }
+  
+  days = (now + zone_secs) / SECS_IN_DAY;
+  secs = (now + zone_secs) % SECS_IN_DAY;
+  if (secs < 0) {
+    secs += SECS_IN_DAY;
+    days--;
+  }
+  /* the epoch was on a thursday */
+  weekday = ((days % 7) + 7) % 7;
+  
+  /* convert the days to a date, see Howard Hinnant's civil_from_days */
+  days += 719468;
+  era = (days >= 0 ? days : days - 146096) / 146097;
+  day_of_year = days - era * 146097;
+  year_of_era = (day_of_year - day_of_year / 1460 + day_of_year / 36524
+		 - day_of_year / 146096) / 365;
+  year = year_of_era + era * 400;
+  day_of_year -= 365 * year_of_era + year_of_era / 4 - year_of_era / 100;
+  month_idx = (5 * day_of_year + 2) / 153;
+  day = day_of_year - (153 * month_idx + 2) / 5 + 1;
+  if (month_idx < 10) {
+    month = month_idx + 3;
+  }
+  else {
+    month = month_idx - 9;
+    year++;
+  }
+  
+  /* NOTE: like the ctime() buffer, this is shared between threads */
+  buf_p = append_format(ctime_buf, ctime_buf + sizeof(ctime_buf),
+			"%s %s %2d %02d:%02d:%02d %ld",
+			day_names[weekday],
+			month_names[month - 1], day, (int)(secs / SECS_IN_HOUR),
+			(int)(secs / SECS_IN_MIN % MINS_IN_HOUR),
+			(int)(secs % SECS_IN_MIN), year);
+  (void)append_null(buf_p, ctime_buf + sizeof(ctime_buf));
+  ctime_secs = now;
+  
+  return ctime_buf;
+}
@@ -0,0 +1,122 @@
+/*
+ * Defines for the cached clock routines.
+ *
+ * Copyright 2020 by Gray Watson
+ *
+ * This file is part of the dmalloc package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ *
+ * The author may be contacted via https://dmalloc.com/
+ */
+
+#ifndef __CLOCK_H__
+#define __CLOCK_H__
+
+/*
+ * Time one of the features of the library for the cost statistics.
+ * COST_START reads the cycle counter into start and COST_STOP adds
+ * the cycles since then to the feature's totals.
+ */
+#if LOG_COST_CYCLES
+#define COST_START(start)	((start) = _dmalloc_clock_cycles())
+#define COST_STOP(which, start)	do {					\
+    _dmalloc_cost.dc_calls[which]++;					\
+    _dmalloc_cost.dc_cycles[which] += _dmalloc_clock_cycles() - (start);	\
+  } while (0)
+#else
+#define COST_START(start)	((start) = 0)
+#define COST_STOP(which, start)	((void)(start))
+#endif
+
+/* the cost statistics of the library */
+extern	dmalloc_cost_t		_dmalloc_cost;
+
+/*<<<<<<<<<<  The below prototypes are auto-generated by fillproto */
+
+/*
+ * void _dmalloc_clock_startup
+ *
+ * Anchor the coarse clock to the time of day.  This is called when
+ * the library starts up and before the first read of the clock.
+ */
+extern
+void	_dmalloc_clock_startup(void);
+
+/*
+ * void _dmalloc_clock_zone_startup
+ *
+ * Read the offset of the local timezone from UTC for the ctime()
+ * string.  This must be called outside of the lock after the library
+ * is enabled because loading the timezone can allocate memory.
+ * Changes to daylight savings time after this are not seen.
+ */
+extern
+void	_dmalloc_clock_zone_startup(void);
+
+/*
+ * long _dmalloc_clock_seconds
+ *
+ * Returns the current time in seconds since the epoch like time().
+ */
+extern
+long	_dmalloc_clock_seconds(void);
+
+/*
+ * unsigned long _dmalloc_clock_nanos
+ *
+ * Returns the fine-grained monotonic clock in nano-seconds for timing
+ * intervals or 0 if the system does not have one.
+ */
+extern
+unsigned long	_dmalloc_clock_nanos(void);
+
+/*
+ * unsigned long _dmalloc_clock_cycles
+ *
+ * Returns the CPU's cycle counter for timing the features of the
+ * library.  On systems without a counter that we know how to read,
+ * this returns the monotonic clock in nano-seconds.
+ */
+extern
+unsigned long	_dmalloc_clock_cycles(void);
+
+#if LOG_PNT_TIMEVAL
+/*
+ * void _dmalloc_clock_timeval
+ *
+ * Read the current time of day into a timeval like GET_TIMEVAL.  It
+ * is only as accurate as the tick of the coarse clock.
+ *
+ * ARGUMENTS:
+ *
+ * timeval_p -> Pointer to the time value that we are setting.
+ */
+extern
+void	_dmalloc_clock_timeval(TIMEVAL_TYPE *timeval_p);
+#endif
+
+/*
+ * const char *_dmalloc_clock_ctime
+ *
+ * Returns the current local time as a string in the format of
+ * ctime() without the trailing \n.  The string is only rebuilt when
+ * the second changes.  We do not call ctime() because it can allocate
+ * memory when it loads the timezone which would recurse back into the
+ * library.  The timezone is read by _dmalloc_clock_zone_startup.
+ */
+extern
+const char	*_dmalloc_clock_ctime(void);
+
+/*<<<<<<<<<<   This is end of the auto-generated output from fillproto. */
+
+#endif /* ! __CLOCK_H__ */
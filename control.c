@@ -0,0 +1,218 @@
+/*
+ * Control file routines
+ *
+ * Copyright 2020 by Gray Watson
+ *
+ * This file is part of the dmalloc package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ *
+ * The author may be contacted via https://dmalloc.com/
+ */
+
+/*
+ * This file contains the routines which watch a control file for new
+ * settings while the program is running.  The file holds a string
+ * like the DMALLOC_OPTIONS environment variable.  Its modification
+ * time and size are checked with stat() at most every so many
+ * seconds and when they change the file is read so the library can
+ * apply the new settings.
+ */
+
+#include <fcntl.h>				/* for O_RDONLY */
+#include <sys/stat.h>				/* for stat */
+
+#if HAVE_STRING_H
+# include <string.h>
+#endif
+#if HAVE_UNISTD_H
+# include <unistd.h>				/* for read, close */
+#endif
+
+#define DMALLOC_DISABLE
+
+#include "conf.h"
+#include "dmalloc.h"
+
+#include "clock.h"
+#include "control.h"
+#include "dmalloc_loc.h"
+
+#define COMMENT_CHAR	'#'			/* start of comment lines */
+
+/* local variables */
+static	char		control_path[512] = { '\0' }; /* file we watch */
+static	unsigned long	control_secs = 0;	/* seconds between checks */
+static	long		check_secs = -1;	/* second of the last check */
+static	long		file_mtime = -1;	/* mtime when last checked */
+static	long		file_size = -1;		/* size when last checked */
+
+/****************************** local utilities ******************************/
+
+/*
+ * static int stat_file
+ *
+ * Get the modification time and size of the control file.
+ *
+ * Returns 1 on success or 0 if the file is not there.
+ *
+ * ARGUMENTS:
+ *
+ * mtime_p <- Pointer to the modification time that we set.
+ *
+ * size_p <- Pointer to the size that we set.
+ */
+static	int	stat_file(long *mtime_p, long *size_p)
+{
+  struct stat	sbuf;
+  
+  if (stat(control_path, &sbuf) != 0) {
+    return 0;
+  }
+  *mtime_p = sbuf.st_mtime;
+  *size_p = sbuf.st_size;
+  return 1;
+}
+
+/*
+ * static int read_options
+ *
+ * Read the first line of the control file that is not blank or a
+ * comment into BUF.
+ *
+ * Returns 1 on success or 0 on failure.
+ *
+ * ARGUMENTS:
+ *
+ * buf <- Buffer that we fill in with the options.
+ *
+ * buf_size -> Size of the buffer.
+ */
+static	int	read_options(char *buf, const int buf_size)
+{
+  char	*line_p, *end_p, *next_p, *bounds_p;
+  int	fd, len;
+  
+  /* we read the file with system calls so we do not allocate */
+  fd = open(control_path, O_RDONLY, 0);
+  if (fd < 0) {
+    return 0;
+  }
+  len = read(fd, buf, buf_size - 1);
+  (void)close(fd);
+  if (len < 0) {
+    return 0;
+  }
+  bounds_p = buf + len;
+  
+  for (line_p = buf; line_p < bounds_p; line_p = next_p) {
+    end_p = memchr(line_p, '\n', bounds_p - line_p);
+    if (end_p == NULL) {
+      end_p = bounds_p;
+    }
+    next_p = end_p + 1;
+    
+    /* trim the white space from the ends of the line */
+    while (line_p < end_p && (*line_p == ' ' || *line_p == '\t')) {
+      line_p++;
+    }
+    while (end_p > line_p
+	   && (*(end_p - 1) == ' ' || *(end_p - 1) == '\t'
+	       || *(end_p - 1) == '\r')) {
+      end_p--;
+    }
+    if (line_p < end_p && *line_p != COMMENT_CHAR) {
+      len = end_p - line_p;
+      memmove(buf, line_p, len);
+      buf[len] = '\0';
+      return 1;
+    }
+  }
+  
+  /* an empty file clears the settings */
+  buf[0] = '\0';
+  return 1;
+}
+
+/**************************** exported routines ******************************/
+
+/*
+ * void _dmalloc_control_setup
+ *
+ * Set the control file that we watch for new settings.  The current
+ * state of the file is recorded so only later changes are applied.
+ *
+ * ARGUMENTS:
+ *
+ * path -> Path of the control file or NULL to stop watching.
+ *
+ * secs -> Number of seconds between checks of the file or 0 for
+ * CONTROL_CHECK_SECS.
+ */
+void	_dmalloc_control_setup(const char *path, const unsigned long secs)
+{
+  if (path == NULL) {
+    control_path[0] = '\0';
+    return;
+  }
+  
+  control_secs = (secs == 0 ? CONTROL_CHECK_SECS : secs);
+  if (strcmp(path, control_path) == 0) {
+    return;
+  }
+  
+  (void)strncpy(control_path, path, sizeof(control_path));
+  control_path[sizeof(control_path) - 1] = '\0';
+  check_secs = _dmalloc_clock_seconds();
+  if (! stat_file(&file_mtime, &file_size)) {
+    file_mtime = -1;
+    file_size = -1;
+  }
+}
+
+/*
+ * int _dmalloc_control_changed
+ *
+ * Check the control file if enough time has gone by and read its
+ * settings if it has changed.  The library should be locked.
+ *
+ * Returns 1 if the settings were read into BUF or 0 if not.
+ *
+ * ARGUMENTS:
+ *
+ * buf <- Buffer that we fill in with the new options.
+ *
+ * buf_size -> Size of the buffer.
+ */
+int	_dmalloc_control_changed(char *buf, const int buf_size)
+{
+  long	now, mtime, size;
+  
+  if (control_path[0] == '\0') {
+    return 0;
+  }
+  now = _dmalloc_clock_seconds();
+  if (now - check_secs < (long)control_secs) {
+    return 0;
+  }
+  check_secs = now;
+  
+  /* if the file is removed we keep the current settings */
+  if (! stat_file(&mtime, &size)
+      || (mtime == file_mtime && size == file_size)) {
+    return 0;
+  }
+  file_mtime = mtime;
+  file_size = size;
+  
+  return read_options(buf, buf_size);
+}
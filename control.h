@@ -0,0 +1,62 @@
+/*
+ * Defines for the control file routines.
+ *
+ * Copyright 2020 by Gray Watson
+ *
+ * This file is part of the dmalloc package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ *
+ * The author may be contacted via https://dmalloc.com/
+ */
+
+#ifndef __CONTROL_H__
+#define __CONTROL_H__
+
+/*<<<<<<<<<<  The below prototypes are auto-generated by fillproto */
+
+/*
+ * void _dmalloc_control_setup
+ *
+ * Set the control file that we watch for new settings.  The current
+ * state of the file is recorded so only later changes are applied.
+ *
+ * ARGUMENTS:
+ *
+ * path -> Path of the control file or NULL to stop watching.
+ *
+ * secs -> Number of seconds between checks of the file or 0 for
+ * CONTROL_CHECK_SECS.
+ */
+extern
+void	_dmalloc_control_setup(const char *path, const unsigned long secs);
+
+/*
+ * int _dmalloc_control_changed
+ *
+ * Check the control file if enough time has gone by and read its
+ * settings if it has changed.  The library should be locked.
+ *
+ * Returns 1 if the settings were read into BUF or 0 if not.
+ *
+ * ARGUMENTS:
+ *
+ * buf <- Buffer that we fill in with the new options.
+ *
+ * buf_size -> Size of the buffer.
+ */
+extern
+int	_dmalloc_control_changed(char *buf, const int buf_size);
+
+/*<<<<<<<<<<   This is end of the auto-generated output from fillproto. */
+
+#endif /* ! __CONTROL_H__ */
@@ -35,7 +35,7 @@
 #define DMALLOC_DEBUG_LOG_NONFREE	BIT_FLAG(1)	/* report non-freed pointers */
 #define DMALLOC_DEBUG_LOG_KNOWN		BIT_FLAG(2)	/* report only known nonfreed*/
 #define DMALLOC_DEBUG_LOG_TRANS		BIT_FLAG(3)	/* log memory transactions */
-/* 4 available - 20001107 */
+#define DMALLOC_DEBUG_LOG_UNREACHABLE	BIT_FLAG(4)	/* report only leaked pnts */
 #define DMALLOC_DEBUG_LOG_ADMIN		BIT_FLAG(5)	/* log background admin info */
 /* 6 available 20030508 */
 /* 7 available - 20001107 */
@@ -90,6 +90,8 @@ __attribute__ ((unused))
   { "log-non-free",	DMALLOC_DEBUG_LOG_NONFREE,	"log non-freed pointers" },
   { "log-known",	DMALLOC_DEBUG_LOG_KNOWN,	"log only known non-freed" },
   { "log-trans",	DMALLOC_DEBUG_LOG_TRANS,	"log memory transactions" },
+  { "log-unreachable",	DMALLOC_DEBUG_LOG_UNREACHABLE,
+    "log only unreachable non-freed" },
   { "log-admin",	DMALLOC_DEBUG_LOG_ADMIN,	"log administrative info" },
   { "log-bad-space",	DMALLOC_DEBUG_LOG_BAD_SPACE,	"dump space from bad pnt" },
   { "log-nonfree-space", DMALLOC_DEBUG_LOG_NONFREE_SPACE,
@@ -41,22 +41,62 @@
 #if HAVE_STDLIB_H
 # include <stdlib.h>
 #endif
+#if HAVE_UNISTD_H
+# include <unistd.h>				/* for sleep, isatty */
+#endif
+#if HAVE_DIRENT_H
+# include <dirent.h>				/* for opendir, etc. */
+#endif
+#include <fcntl.h>				/* for O_RDONLY */
+#include <sys/stat.h>				/* for fstat */
+#if HAVE_POLL_H && HAVE_SYS_SOCKET_H && HAVE_SYS_UN_H
+# include <poll.h>				/* for poll */
+# include <sys/socket.h>			/* for socket, connect */
+# include <sys/un.h>				/* for sockaddr_un */
+#endif
 
 #include "conf.h"
 #include "dmalloc_argv.h"			/* for argument processing */
 #include "dmalloc.h"
 
+#if HAVE_MMAP
+# include <sys/mman.h>				/* for mmap stuff */
+#endif
+#if SIGNAL_OKAY && HAVE_SIGNAL_H
+# include <errno.h>				/* for ESRCH */
+# include <signal.h>				/* for kill */
+#endif
+
 #include "append.h"
+#include "binlog_loc.h"
 #include "compat.h"
 #include "debug_tok.h"
 #include "env.h"
 #include "error_val.h"
+#include "livestats_loc.h"
 #include "dmalloc_loc.h"
 #include "version.h"
 
 #define HOME_ENVIRON	"HOME"			/* home directory */
 #define SHELL_ENVIRON	"SHELL"			/* for the type of shell */
 #define DEFAULT_CONFIG	".dmallocrc"		/* default config file */
+
+/* processes and tries to copy a live statistics file that is changing */
+#define LIVE_PROC_MAX	64
+#define LIVE_READ_TRIES	1000
+
+/* how long we wait for the answer from the query server */
+#define QUERY_WAIT_MSECS	5000
+
+/*
+ * Order the reads of the live statistics file around the reads of
+ * its sequence number.
+ */
+#if defined(__GNUC__)
+# define SEQ_FENCE()	__atomic_thread_fence(__ATOMIC_SEQ_CST)
+#else
+# define SEQ_FENCE()
+#endif
 #define TOKENIZE_EQUALS	" \t="			/* for tag lines */
 #define TOKENIZE_CHARS	" \t,"			/* for tag lines */
 
@@ -78,6 +118,27 @@ typedef struct {
   long		de_flags;			/* default settings */
 } default_t;
 
+/*
+ * call-site totals from a binary transaction log
+ */
+typedef struct {
+  unsigned long	bs_file;			/* file id or return-address */
+  unsigned int	bs_line;			/* line-number or 0 */
+  unsigned long	bs_total_size;			/* bytes allocated */
+  unsigned long	bs_total_c;			/* number of allocations */
+  unsigned long	bs_in_use_size;			/* bytes not yet freed */
+  unsigned long	bs_in_use_c;			/* allocations not yet freed */
+} binlog_site_t;
+
+/*
+ * call-site totals from one or two heap snapshots
+ */
+typedef struct {
+  char		*ss_source;			/* description of call-site */
+  unsigned long	ss_size[2];			/* bytes in each snapshot */
+  unsigned long	ss_count[2];			/* pointers in each snapshot */
+} snap_site_t;
+
 #define RUNTIME_FLAGS	(DMALLOC_DEBUG_LOG_STATS | DMALLOC_DEBUG_LOG_NONFREE | \
 			 DMALLOC_DEBUG_LOG_BAD_SPACE | \
 			 DMALLOC_DEBUG_CHECK_FENCE | \
@@ -116,9 +177,20 @@ static	int	gdb_b = 0;			/* set gdb output */
 static	int	rcshell_b = 0;			/* set rc shell output */
 
 static	char	*address = NULL;		/* for ADDRESS */
+static	char	*async_log = NULL;		/* for ASYNCLOG setting */
+static	long	attach_pid = 0;			/* live stats to watch */
+static	char	*binlog = NULL;			/* for BINLOG setting */
+static	char	*binlog_decode = NULL;		/* binary log to decode */
+static	int	binlog_totals_b = 0;		/* decode log as totals */
+static	argv_array_t	budget_args;		/* for BUDGET settings */
 static	int	clear_b = 0;			/* clear variables */
+static	char	*control = NULL;		/* for CONTROL setting */
 static	int	debug = 0;			/* for DEBUG */
+static	argv_array_t	diff_snapshots;		/* snapshots to compare */
+static	char	*dump_signal = NULL;		/* for DUMPSIG setting */
 static	int	errno_to_print = 0;		/* to print the error string */
+static	char	*flight = NULL;			/* for FLIGHT setting */
+static	char	*flight_decode = NULL;		/* flight recorder to decode */
 static	int	help_b = 0;			/* print help message */
 static	char	*inpath = NULL;			/* for config-file path */
 static	unsigned long interval = 0;		/* for setting INTERVAL */
@@ -126,13 +198,18 @@ static	int	thread_lock_on = 0;		/* for setting LOCK_ON */
 static	int	keep_b = 0;			/* keep settings override -r */
 static	int	list_tags_b = 0;		/* list rc tags */
 static	int	debug_tokens_b = 0;		/* list debug tokens */
+static	char	*live = NULL;			/* for LIVESTATS setting */
 static	char	*logpath = NULL;		/* for LOGFILE setting */
 static	int	long_tokens_b = 0;		/* long-tok output */
 static	argv_array_t	minus;			/* tokens to remove */
 static	unsigned long limit_arg = 0;		/* memory limit */
 static	int	make_changes_b = 1;		/* make no changes to env */
 static	argv_array_t	plus;			/* tokens to add */
+static	char	*profile = NULL;		/* for PROFILE setting */
+static	char	*query = NULL;			/* request to attach pid */
+static	int	refresh_count = 0;		/* live stats refreshes */
 static	int	remove_auto_b = 0;		/* auto-remove settings */
+static	char	*server = NULL;			/* for SERVER setting */
 static	char	*start_file = NULL;		/* for START settings */
 static	unsigned long start_iter = 0;		/* for START settings */
 static	unsigned long start_size = 0;		/* for START settings */
@@ -142,6 +219,18 @@ static	int	very_verbose_b = 0;		/* very-verbose flag */
 static	int	version_b = 0;			/* print version string */
 static	char	*tag = NULL;			/* maybe a tag argument */
 
+/* binary log decoding */
+static	char		**binlog_names = NULL;	/* file-names by id */
+static	unsigned long	binlog_name_n = 0;	/* size of the names array */
+static	binlog_site_t	*binlog_sites = NULL;	/* hash of call-sites */
+static	unsigned long	binlog_site_n = 0;	/* size of the sites hash */
+static	unsigned long	binlog_site_c = 0;	/* call-sites in the hash */
+
+/* heap snapshot comparing */
+static	snap_site_t	*snap_sites = NULL;	/* hash of call-sites */
+static	unsigned long	snap_site_n = 0;	/* size of the sites hash */
+static	unsigned long	snap_site_c = 0;	/* call-sites in the hash */
+
 static	argv_t	args[] = {
   { 'b',	"bourne-shell",	ARGV_BOOL_INT,	&bourne_b,
     NULL,			"set output for bourne shells" },
@@ -157,22 +246,46 @@ static	argv_t	args[] = {
   
   { 'a',	"address",	ARGV_CHAR_P,	&address,
     "address:#",		"stop when malloc sees address" },
+  { '\0',	"async-log",	ARGV_CHAR_P,	&async_log,
+    "block|drop|inline",	"write log from a thread (threaded lib)" },
+  { '\0',	"attach",	ARGV_LONG,	&attach_pid,
+    "pid",			"watch live stats of a process" },
+  { '\0',	"binlog",	ARGV_CHAR_P,	&binlog,
+    "path",			"write binary transaction log" },
+  { '\0',	"budget",	ARGV_CHAR_P | ARGV_FLAG_ARRAY,	&budget_args,
+    "file[:line]:size[:act]",	"limit memory in use from file/line" },
   { 'c',	"clear",	ARGV_BOOL_INT,	&clear_b,
     NULL,			"clear all variables not set" },
+  { '\0',	"control",	ARGV_CHAR_P,	&control,
+    "path[:seconds]",		"watch file for new settings" },
   { DEBUG_ARG,	"debug-mask",	ARGV_HEX,	&debug,
     "value",			"hex flag to set debug mask" },
+  { '\0',	"decode-binlog", ARGV_CHAR_P,	&binlog_decode,
+    "path",			"print binary log as log-trans" },
+  { '\0',	"decode-flight", ARGV_CHAR_P,	&flight_decode,
+    "path",			"print flight recorder as log-trans" },
+  { '\0',	"decode-totals", ARGV_BOOL_INT,	&binlog_totals_b,
+    NULL,			"print binary log call-site totals" },
   { 'D',	"debug-tokens",	ARGV_BOOL_INT,	&debug_tokens_b,
     NULL,			"list debug tokens" },
+  { '\0',	"diff-snapshot", ARGV_CHAR_P | ARGV_FLAG_ARRAY,	&diff_snapshots,
+    "path",			"print heap snapshot or diff two of them" },
+  { '\0',	"dump-signal",	ARGV_CHAR_P,	&dump_signal,
+    "signal[:check]",		"log stats and changes on signal" },
   { 'e',	"errno",	ARGV_INT,	&errno_to_print,
     "errno",			"print error string for errno" },
   { 'f',	"file",		ARGV_CHAR_P,	&inpath,
     "path",			"config if not $HOME/.dmallocrc" },
+  { '\0',	"flight",	ARGV_CHAR_P,	&flight,
+    "path[:records]",		"keep recent transactions in file" },
   { 'h',	"help",		ARGV_BOOL_INT,	&help_b,
     NULL,			"print help message" },
   { INTERVAL_ARG, "interval",	ARGV_U_LONG,	&interval,
     "value",			"check heap every number times" },
   { 'k',	"keep",		ARGV_BOOL_INT,	&keep_b,
     NULL,			"keep settings (override -r)" },
+  { '\0',	"livestats",	ARGV_CHAR_P,	&live,
+    "path",			"publish live stats to file with %p" },
   { 'l',	"logfile",	ARGV_CHAR_P,	&logpath,
     "path",			"file to log messages to" },
   { 'L',	"long-tokens",	ARGV_BOOL_INT,	&long_tokens_b,
@@ -187,8 +300,16 @@ static	argv_t	args[] = {
     "number",			"number of times to not lock" },
   { 'p',	"plus",		ARGV_CHAR_P | ARGV_FLAG_ARRAY,	&plus,
     "token(s)",			"add tokens to current debug" },
+  { '\0',	"profile",	ARGV_CHAR_P,	&profile,
+    "path[:iter]",		"write pprof heap profile to path" },
+  { '\0',	"query",	ARGV_CHAR_P,	&query,
+    "request",			"send request to attach pid's server" },
+  { '\0',	"refresh-count", ARGV_INT,	&refresh_count,
+    "number",			"times to show attach stats, 0 forever" },
   { 'r',	"remove",	ARGV_BOOL_INT,	&remove_auto_b,
     NULL,			"remove other settings if tag" },
+  { '\0',	"server",	ARGV_CHAR_P,	&server,
+    "path",			"answer queries on socket with %p" },
   
   { 's',	"start-file",	ARGV_CHAR_P,	&start_file,
     "file:line",		"check heap after this location" },
@@ -696,12 +817,15 @@ static	void	list_tags(void)
  */
 static	void	dump_current(void)
 {
-  char		*log_path, *loc_start_file, token[64];
+  char		*log_path, *loc_start_file, *loc_budget, *loc_profile, token[64];
+  char		*loc_binlog, *loc_flight, *loc_live, *loc_control, *loc_server;
   const char	*env_str;
   DMALLOC_PNT	addr;
   unsigned long	inter, limit_val, loc_start_size, loc_start_iter;
+  unsigned long	loc_profile_iter, loc_flight_recs, loc_control_secs;
   unsigned long	addr_count;
-  int		lock_on, loc_start_line;
+  int		lock_on, loc_start_line, loc_async_log;
+  int		loc_dump_sig, loc_dump_check;
   unsigned int	flags;
   char		env_buf[256];
   
@@ -713,7 +837,11 @@ static	void	dump_current(void)
   _dmalloc_environ_process(env_str, &addr, &addr_count, &flags,
 			   &inter, &lock_on, &log_path,
 			   &loc_start_file, &loc_start_line, &loc_start_iter,
-			   &loc_start_size, &limit_val);
+			   &loc_start_size, &limit_val, &loc_budget,
+			   &loc_profile, &loc_profile_iter, &loc_binlog,
+			   &loc_async_log, &loc_flight, &loc_flight_recs,
+			   &loc_live, &loc_dump_sig, &loc_dump_check,
+			   &loc_control, &loc_control_secs, &loc_server);
   
   if (flags == 0) {
     loc_fprintf(stderr, "Debug-Flags  not-set\n");
@@ -766,6 +894,97 @@ static	void	dump_current(void)
     loc_fprintf(stderr, "Mem-Limit    %lu\n", limit_val);
   }
   
+  if (loc_budget == NULL) {
+    loc_fprintf(stderr, "Budget       not-set\n");
+  }
+  else {
+    const char		*budget_p;
+    char		*budget_file;
+    int			budget_line, budget_action;
+    unsigned long	budget_limit;
+    
+    for (budget_p = loc_budget; budget_p != NULL; ) {
+      budget_p = _dmalloc_budget_break(budget_p, &budget_file, &budget_line,
+				       &budget_limit, &budget_action);
+      loc_fprintf(stderr, "Budget       '%s', line = %d, limit = %lu, action = %s\n",
+		  budget_file, budget_line, budget_limit,
+		  (budget_action == DMALLOC_BUDGET_FAIL ? "fail" :
+		   (budget_action == DMALLOC_BUDGET_ERROR ? "error" : "log")));
+    }
+  }
+  
+  if (loc_profile == NULL) {
+    loc_fprintf(stderr, "Profile      not-set\n");
+  }
+  else if (loc_profile_iter > 0) {
+    loc_fprintf(stderr, "Profile      '%s', every %lu iterations\n",
+		loc_profile, loc_profile_iter);
+  }
+  else {
+    loc_fprintf(stderr, "Profile      '%s'\n", loc_profile);
+  }
+  
+  if (loc_binlog == NULL) {
+    loc_fprintf(stderr, "Binlog       not-set\n");
+  }
+  else {
+    loc_fprintf(stderr, "Binlog       '%s'\n", loc_binlog);
+  }
+  
+  if (loc_async_log == ASYNC_LOG_NONE) {
+    loc_fprintf(stderr, "Async-Log    not-set\n");
+  }
+  else {
+    loc_fprintf(stderr, "Async-Log    %s\n",
+		_dmalloc_async_string(loc_async_log));
+  }
+  
+  if (loc_flight == NULL) {
+    loc_fprintf(stderr, "Flight       not-set\n");
+  }
+  else if (loc_flight_recs > 0) {
+    loc_fprintf(stderr, "Flight       '%s', %lu records\n",
+		loc_flight, loc_flight_recs);
+  }
+  else {
+    loc_fprintf(stderr, "Flight       '%s'\n", loc_flight);
+  }
+  
+  if (loc_live == NULL) {
+    loc_fprintf(stderr, "Live-Stats   not-set\n");
+  }
+  else {
+    loc_fprintf(stderr, "Live-Stats   '%s'\n", loc_live);
+  }
+  
+  if (loc_dump_sig == 0) {
+    loc_fprintf(stderr, "Dump-Signal  not-set\n");
+  }
+  else if (loc_dump_check) {
+    loc_fprintf(stderr, "Dump-Signal  %d, with heap check\n", loc_dump_sig);
+  }
+  else {
+    loc_fprintf(stderr, "Dump-Signal  %d\n", loc_dump_sig);
+  }
+  
+  if (loc_control == NULL) {
+    loc_fprintf(stderr, "Control      not-set\n");
+  }
+  else if (loc_control_secs > 0) {
+    loc_fprintf(stderr, "Control      '%s', every %lu seconds\n",
+		loc_control, loc_control_secs);
+  }
+  else {
+    loc_fprintf(stderr, "Control      '%s'\n", loc_control);
+  }
+  
+  if (loc_server == NULL) {
+    loc_fprintf(stderr, "Server       not-set\n");
+  }
+  else {
+    loc_fprintf(stderr, "Server       '%s'\n", loc_server);
+  }
+  
   if (loc_start_file != NULL) {
     loc_fprintf(stderr, "Start-File   '%s', line = %d\n", loc_start_file, loc_start_line);
   }
@@ -835,173 +1054,1357 @@ static	char	*local_strerror(const int error_num)
 }
 
 /*
- * static void header
- *
- * Print out a little usage header to the user.
+ * Describe the call-site FILE and LINE from a binary log into BUF the
+ * same way that the library does.  Returns BUF.
  */
-static	void	header(void)
-{
-  loc_fprintf(stderr, "Debug Malloc Utility: https://dmalloc.com/\n");
-  loc_fprintf(stderr,
-	      "  This utility helps set the Debug Malloc environment variables.\n");
-}
-
-int	main(int argc, char **argv)
+static	char	*binlog_desc(char *buf, const int buf_size,
+			     const unsigned long file, const unsigned int line)
 {
-  char		buf[1024];
-  int		set_b = 0;
-  char		*log_path, *loc_start_file;
-  const char	*env_str;
-  DMALLOC_PNT	addr;
-  unsigned long	inter, limit_val, loc_start_size, loc_start_iter;
-  unsigned long	addr_count;
-  int		lock_on;
-  int		loc_start_line;
-  unsigned int	flags;
-  char		env_buf[256];
-  
-  argv_help_string = "Sets dmalloc library env variables.  Also try --usage.";
-  argv_version_string = dmalloc_version;
-  argv_usage_type = ARGV_USAGE_LONG;
-  argv_error_type = ARGV_USAGE_SHORT_REM;
-  
-  argv_process(args, argc, argv);
-  
-  if (help_b) {
-    header();
-    loc_fprintf(stderr, "  For a list of the command-line options enter: %s --usage\n",
-		argv_argv[0]);
-    exit(0);
-  }
-  if (usage_b) {
-    header();
-    argv_usage(args, argv_usage_type);
-    exit(0);
+  if (file == 0 && line == 0) {
+    (void)loc_snprintf(buf, buf_size, "unknown");
   }
-  if (version_b) {
-    loc_fprintf(stderr, "Dmalloc utility version string is: %s\n", argv_version_string);
-    loc_fprintf(stderr,
-		"  NOTE: Library linked with your application may be a different version.\n");
-    loc_fprintf(stderr,
-		"        Check top of logfile after application is run for library version.\n");
-    exit(0);
+  else if (line == 0) {
+    (void)loc_snprintf(buf, buf_size, "ra=%p", (DMALLOC_PNT)file);
   }
-  
-  if (very_verbose_b) {
-    verbose_b = 1;
+  else if (file == 0) {
+    (void)loc_snprintf(buf, buf_size, "ra=ERROR(line=%u)", line);
   }
-  
-  /* try to figure out the shell we are using */
-  if ((! bourne_b) && (! cshell_b) && (! gdb_b) && (! rcshell_b)) {
-    choose_shell();
+  else if (file >= binlog_name_n || binlog_names[file] == NULL) {
+    (void)loc_snprintf(buf, buf_size, "file#%lu:%u", file, line);
   }
-  
-  /* get the current debug information from the env variable */
-  env_str = loc_getenv(OPTIONS_ENVIRON, env_buf, sizeof(env_buf), 0);
-  if (env_str == NULL) {
-    env_str = "";
+  else {
+    (void)loc_snprintf(buf, buf_size, "%s:%u", binlog_names[file], line);
   }
-  _dmalloc_environ_process(env_str, &addr, &addr_count, &flags, &inter,
-			   &lock_on, &log_path, &loc_start_file,
-			   &loc_start_line, &loc_start_iter, &loc_start_size,
-			   &limit_val);
   
-  /*
-   * So, if a tag was specified on the command line then we set the
-   * debug from it.  If it was not then we see if the debug flags were
-   * set as a hex value from the -d.  If this was not used then take
-   * the current value.
-   */
-  if (tag == NULL) {
-    if (argv_was_used(args, DEBUG_ARG)) {
-      set_b = 1;
-      /* should we clear the rest? */
-      if (remove_auto_b && (! keep_b)) {
-	clear_b = 1;
-      }
+  return buf;
+}
+
+/*
+ * Find the totals for the call-site FILE and LINE in the hash of
+ * call-sites, adding it if not found.  Returns NULL on error.
+ */
+static	binlog_site_t	*binlog_site(const unsigned long file,
+				     const unsigned int line)
+{
+  binlog_site_t	*site_p, *old_sites, *old_p;
+  unsigned long	old_n;
+  
+  /* grow the hash when it gets half full */
+  if (binlog_site_c >= binlog_site_n / 2) {
+    old_sites = binlog_sites;
+    old_n = binlog_site_n;
+    if (binlog_site_n == 0) {
+      binlog_site_n = 1024;
     }
     else {
-      debug = flags;
+      binlog_site_n *= 2;
     }
-  }
-  else {
-    if (argv_was_used(args, DEBUG_ARG)) {
-      loc_fprintf(stderr, "%s: warning -d ignored, processing tag '%s'\n",
-		  argv_program, tag);
+    binlog_sites = (binlog_site_t *)calloc(binlog_site_n,
+					   sizeof(binlog_site_t));
+    if (binlog_sites == NULL) {
+      return NULL;
     }
-    set_b = 1;
-    debug = find_tag(0L, tag, NULL, 0);
-    /* should we clear the rest? */
-    if (remove_auto_b && (! keep_b)) {
-      clear_b = 1;
+    binlog_site_c = 0;
+    for (old_p = old_sites; old_p < old_sites + old_n; old_p++) {
+      if (old_p->bs_total_c > 0) {
+	site_p = binlog_site(old_p->bs_file, old_p->bs_line);
+	*site_p = *old_p;
+      }
+    }
+    if (old_sites != NULL) {
+      free(old_sites);
     }
   }
   
-  if (plus.aa_entry_n > 0) {
-    int		plus_c;
-    for (plus_c = 0; plus_c < plus.aa_entry_n; plus_c++) {
-      BIT_SET(debug, token_to_value(ARGV_ARRAY_ENTRY(plus, char *, plus_c)));
-      set_b = 1;
+  site_p = binlog_sites + (file * 31 + line) % binlog_site_n;
+  while (site_p->bs_total_c > 0) {
+    if (site_p->bs_file == file && site_p->bs_line == line) {
+      return site_p;
+    }
+    site_p++;
+    if (site_p == binlog_sites + binlog_site_n) {
+      site_p = binlog_sites;
     }
   }
   
-  if (minus.aa_entry_n > 0) {
-    int		minus_c;
-    for (minus_c = 0; minus_c < minus.aa_entry_n; minus_c++) {
-      BIT_CLEAR(debug,
-		token_to_value(ARGV_ARRAY_ENTRY(minus, char *, minus_c)));
-      set_b = 1;
+  /* NOTE: the caller must count an allocation for the site to stay used */
+  site_p->bs_file = file;
+  site_p->bs_line = line;
+  binlog_site_c++;
+  
+  return site_p;
+}
+
+/*
+ * Add the transaction in REC_P to the call-site totals.  Returns 1 on
+ * success or 0 on error.
+ */
+static	int	binlog_count(const binlog_rec_t *rec_p)
+{
+  binlog_site_t	*site_p;
+  unsigned long	size;
+  
+  /* take away the old allocation if it was freed or realloced in place */
+  if (rec_p->br_op == BINLOG_OP_FREE
+      || (rec_p->br_op == BINLOG_OP_REALLOC
+	  && rec_p->br_pnt == rec_p->br_old_pnt)) {
+    site_p = binlog_site(rec_p->br_old_file, rec_p->br_old_line);
+    if (site_p == NULL) {
+      return 0;
+    }
+    if (rec_p->br_op == BINLOG_OP_FREE) {
+      size = rec_p->br_size;
+    }
+    else {
+      size = rec_p->br_old_size;
+    }
+    if (site_p->bs_total_c == 0) {
+      /* the allocation was before the log started so just count it */
+      site_p->bs_total_size = size;
+      site_p->bs_total_c = 1;
+    }
+    else if (site_p->bs_in_use_c > 0 && site_p->bs_in_use_size >= size) {
+      site_p->bs_in_use_size -= size;
+      site_p->bs_in_use_c--;
     }
   }
   
-  if (address != NULL) {
-    _dmalloc_address_break(address, &addr, &addr_count);
-    set_b = 1;
-  }
-  else if (clear_b) {
-    addr = NULL;
+  /* add in the new allocation */
+  if (rec_p->br_op == BINLOG_OP_ALLOC
+      || (rec_p->br_op == BINLOG_OP_REALLOC
+	  && rec_p->br_pnt == rec_p->br_old_pnt)) {
+    site_p = binlog_site(rec_p->br_file, rec_p->br_line);
+    if (site_p == NULL) {
+      return 0;
+    }
+    site_p->bs_total_size += rec_p->br_size;
+    site_p->bs_total_c++;
+    site_p->bs_in_use_size += rec_p->br_size;
+    site_p->bs_in_use_c++;
   }
   
-  if (argv_was_used(args, INTERVAL_ARG)) {
-    inter = interval;
-    set_b = 1;
+  return 1;
+}
+
+/*
+ * Compare two call-site totals for qsort so the largest total-size is
+ * first and the unused hash entries are last.
+ */
+static	int	binlog_site_compare(const void *site1_p, const void *site2_p)
+{
+  const binlog_site_t	*site1 = (const binlog_site_t *)site1_p;
+  const binlog_site_t	*site2 = (const binlog_site_t *)site2_p;
+  
+  if (site1->bs_total_c == 0 || site2->bs_total_c == 0) {
+    return (site1->bs_total_c == 0) - (site2->bs_total_c == 0);
   }
-  else if (clear_b) {
-    inter = 0;
+  if (site1->bs_total_size > site2->bs_total_size) {
+    return -1;
   }
-  
-  /*
-   * NOTE: this should be after the debug setting which this tests.
-   */
-  if (argv_was_used(args, THREAD_LOCK_ON_ARG)) {
-    lock_on = thread_lock_on;
-    set_b = 1;
+  else if (site1->bs_total_size < site2->bs_total_size) {
+    return 1;
   }
-  else if (clear_b) {
-    lock_on = 0;
+  else {
+    return 0;
   }
+}
+
+/*
+ * Print the call-site totals in the same format as the memory table
+ * in the logfile.
+ */
+static	void	binlog_print_totals(void)
+{
+  binlog_site_t	*site_p, total;
+  unsigned long	site_c = 0;
+  char		source[256];
+  
+  if (binlog_site_c > 0) {
+    qsort(binlog_sites, binlog_site_n, sizeof(binlog_site_t),
+	  binlog_site_compare);
+  }
+  
+  memset(&total, 0, sizeof(total));
+  loc_printf(" total-size  count in-use-size  count  source\n");
+  for (site_p = binlog_sites;
+       site_p < binlog_sites + binlog_site_n && site_p->bs_total_c > 0;
+       site_p++) {
+    loc_printf("%11lu %6lu %11lu %6lu  %s\n",
+	       site_p->bs_total_size, site_p->bs_total_c,
+	       site_p->bs_in_use_size, site_p->bs_in_use_c,
+	       binlog_desc(source, sizeof(source), site_p->bs_file,
+			   site_p->bs_line));
+    total.bs_total_size += site_p->bs_total_size;
+    total.bs_total_c += site_p->bs_total_c;
+    total.bs_in_use_size += site_p->bs_in_use_size;
+    total.bs_in_use_c += site_p->bs_in_use_c;
+    site_c++;
+  }
+  loc_printf("%11lu %6lu %11lu %6lu  Total of %lu\n",
+	     total.bs_total_size, total.bs_total_c,
+	     total.bs_in_use_size, total.bs_in_use_c, site_c);
+}
+
+/*
+ * Print the transaction in REC_P as the library prints it to the
+ * logfile with the log-trans token.
+ */
+static	void	binlog_print_trans(const binlog_rec_t *rec_p)
+{
+  const char	*trans_log;
+  char		where_buf[256], where_buf2[256];
   
-  if (logpath != NULL) {
-    log_path = logpath;
-    set_b = 1;
+  loc_printf("%lu: %lu: ", rec_p->br_secs, rec_p->br_iter);
+  (void)binlog_desc(where_buf, sizeof(where_buf), rec_p->br_file,
+		    rec_p->br_line);
+  
+  switch (rec_p->br_op) {
+    
+  case BINLOG_OP_ALLOC:
+    switch (rec_p->br_func_id) {
+    case DMALLOC_FUNC_CALLOC:
+      trans_log = "calloc";
+      break;
+    case DMALLOC_FUNC_MEMALIGN:
+      trans_log = "memalign";
+      break;
+    case DMALLOC_FUNC_VALLOC:
+      trans_log = "valloc";
+      break;
+    default:
+      trans_log = "alloc";
+      break;
+    }
+    loc_printf("*** %s: at '%s' for %lu bytes, got '%p'\n",
+	       trans_log, where_buf, rec_p->br_size, (DMALLOC_PNT)rec_p->br_pnt);
+    break;
+    
+  case BINLOG_OP_FREE:
+    loc_printf("*** free: at '%s' pnt '%p': size %lu, alloced at '%s'\n",
+	       where_buf, (DMALLOC_PNT)rec_p->br_pnt, rec_p->br_size,
+	       binlog_desc(where_buf2, sizeof(where_buf2), rec_p->br_old_file,
+			   rec_p->br_old_line));
+    break;
+    
+  case BINLOG_OP_REALLOC:
+    if (rec_p->br_func_id == DMALLOC_FUNC_RECALLOC) {
+      trans_log = "recalloc";
+    }
+    else {
+      trans_log = "realloc";
+    }
+    loc_printf("*** %s: at '%s' from '%p' (%lu bytes) file '%s' to '%p' (%lu bytes)\n",
+	       trans_log, where_buf, (DMALLOC_PNT)rec_p->br_old_pnt,
+	       rec_p->br_old_size,
+	       binlog_desc(where_buf2, sizeof(where_buf2), rec_p->br_old_file,
+			   rec_p->br_old_line),
+	       (DMALLOC_PNT)rec_p->br_pnt, rec_p->br_size);
+    break;
+    
+  default:
+    loc_printf("unknown record type %u\n", rec_p->br_op);
+    break;
   }
-  else if (clear_b) {
-    log_path = NULL;
+}
+
+/*
+ * Decode the binary transaction log at PATH and print each of the
+ * transactions or, if TOTALS_B, the totals for each call-site.
+ * Returns 1 on success or 0 on failure.
+ */
+static	int	decode_binlog(const char *path, const int totals_b)
+{
+  FILE			*infile;
+  binlog_header_t	header;
+  binlog_rec_t		rec;
+  char			*name;
+  unsigned long		new_n;
+  int			rec_n, ret = 1;
+  
+  infile = fopen(path, "rb");
+  if (infile == NULL) {
+    loc_fprintf(stderr, "%s: could not open binary log '%s'\n",
+		argv_program, path);
+    return 0;
   }
   
-  if (start_file != NULL) {
-    _dmalloc_start_break(start_file, &loc_start_file, &loc_start_line,
-			 &loc_start_iter, &loc_start_size);
-    set_b = 1;
+  if (fread(&header, sizeof(header), 1, infile) != 1
+      || memcmp(header.bh_magic, BINLOG_MAGIC, BINLOG_MAGIC_SIZE) != 0) {
+    loc_fprintf(stderr, "%s: '%s' is not a binary log\n", argv_program, path);
+    (void)fclose(infile);
+    return 0;
   }
-  else if (start_iter > 0) {
-    loc_start_file = NULL;
-    loc_start_line = 0;
-    loc_start_iter = start_iter;
-    loc_start_size = 0;
-    set_b = 1;
+  if (header.bh_version != BINLOG_VERSION
+      || header.bh_byte_order != BINLOG_BYTE_ORDER
+      || header.bh_rec_size != sizeof(binlog_rec_t)) {
+    loc_fprintf(stderr,
+		"%s: binary log '%s' is a different version or from a different system\n",
+		argv_program, path);
+    (void)fclose(infile);
+    return 0;
   }
-  else if (start_size > 0) {
+  
+  while (fread(&rec, sizeof(rec), 1, infile) == 1) {
+    
+    if (rec.br_op != BINLOG_OP_FILE) {
+      if (! totals_b) {
+	binlog_print_trans(&rec);
+      }
+      else if (! binlog_count(&rec)) {
+	loc_fprintf(stderr, "%s: out of memory decoding '%s'\n",
+		    argv_program, path);
+	ret = 0;
+	break;
+      }
+      continue;
+    }
+    
+    /* the file-name follows the record, padded to the record size */
+    rec_n = (rec.br_size + sizeof(rec) - 1) / sizeof(rec);
+    name = (char *)malloc(rec_n * sizeof(rec) + 1);
+    if (name == NULL
+	|| (rec_n > 0 && fread(name, sizeof(rec), rec_n, infile) != rec_n)) {
+      loc_fprintf(stderr, "%s: could not read file-name from '%s'\n",
+		  argv_program, path);
+      ret = 0;
+      break;
+    }
+    name[rec.br_size] = '\0';
+    
+    if (rec.br_file >= binlog_name_n) {
+      new_n = (binlog_name_n == 0 ? 64 : binlog_name_n);
+      while (new_n <= rec.br_file) {
+	new_n *= 2;
+      }
+      binlog_names = (char **)realloc(binlog_names, new_n * sizeof(char *));
+      if (binlog_names == NULL) {
+	loc_fprintf(stderr, "%s: out of memory decoding '%s'\n",
+		    argv_program, path);
+	ret = 0;
+	break;
+      }
+      memset(binlog_names + binlog_name_n, 0,
+	     (new_n - binlog_name_n) * sizeof(char *));
+      binlog_name_n = new_n;
+    }
+    binlog_names[rec.br_file] = name;
+  }
+  (void)fclose(infile);
+  
+  if (ret && totals_b) {
+    binlog_print_totals();
+  }
+  
+  return ret;
+}
+
+/*
+ * Decode the flight recorder file at PATH and print the transactions
+ * that it holds, oldest first, or, if TOTALS_B, the totals for each
+ * call-site.  Returns 1 on success or 0 on failure.
+ */
+static	int	decode_flight(const char *path, const int totals_b)
+{
+  FILE			*infile;
+  flight_header_t	header;
+  binlog_rec_t		*ring = NULL;
+  char			*name_buf = NULL;
+  unsigned long		rec_c, first_c;
+  unsigned int		name_c;
+  int			ret = 1;
+  
+  infile = fopen(path, "rb");
+  if (infile == NULL) {
+    loc_fprintf(stderr, "%s: could not open flight recorder '%s'\n",
+		argv_program, path);
+    return 0;
+  }
+  
+  if (fread(&header, sizeof(header), 1, infile) != 1
+      || memcmp(header.fh_magic, FLIGHT_MAGIC, BINLOG_MAGIC_SIZE) != 0) {
+    loc_fprintf(stderr, "%s: '%s' is not a flight recorder\n",
+		argv_program, path);
+    (void)fclose(infile);
+    return 0;
+  }
+  if (header.fh_version != FLIGHT_VERSION
+      || header.fh_byte_order != BINLOG_BYTE_ORDER
+      || header.fh_rec_size != sizeof(binlog_rec_t)
+      || header.fh_name_size == 0
+      || header.fh_rec_n == 0) {
+    loc_fprintf(stderr,
+		"%s: flight recorder '%s' is a different version or from a different system\n",
+		argv_program, path);
+    (void)fclose(infile);
+    return 0;
+  }
+  
+  /* the file-name table comes first with id N in the N-1th entry */
+  name_buf = (char *)malloc(header.fh_name_n * header.fh_name_size);
+  binlog_names = (char **)calloc(header.fh_name_n + 1, sizeof(char *));
+  ring = (binlog_rec_t *)malloc(header.fh_rec_n * sizeof(binlog_rec_t));
+  if (name_buf == NULL || binlog_names == NULL || ring == NULL) {
+    loc_fprintf(stderr, "%s: out of memory decoding '%s'\n",
+		argv_program, path);
+    ret = 0;
+  }
+  else if (fread(name_buf, header.fh_name_size, header.fh_name_n, infile)
+	   != header.fh_name_n
+	   || fread(ring, sizeof(binlog_rec_t), header.fh_rec_n, infile)
+	   != header.fh_rec_n) {
+    loc_fprintf(stderr, "%s: could not read flight recorder '%s'\n",
+		argv_program, path);
+    ret = 0;
+  }
+  (void)fclose(infile);
+  
+  if (ret) {
+    binlog_name_n = header.fh_name_n + 1;
+    for (name_c = 0; name_c < header.fh_name_n; name_c++) {
+      binlog_names[name_c + 1] = name_buf + name_c * header.fh_name_size;
+      binlog_names[name_c + 1][header.fh_name_size - 1] = '\0';
+    }
+    
+    /* the slot after the newest record may have been half written */
+    if (header.fh_written_c > header.fh_rec_n - 1) {
+      first_c = header.fh_written_c - (header.fh_rec_n - 1);
+    }
+    else {
+      first_c = 0;
+    }
+    if (! totals_b) {
+      loc_printf("Flight recorder of process %lu with %lu of %lu transactions\n",
+		 header.fh_pid, header.fh_written_c - first_c,
+		 header.fh_written_c);
+    }
+    
+    for (rec_c = first_c; rec_c < header.fh_written_c; rec_c++) {
+      if (totals_b) {
+	if (! binlog_count(ring + rec_c % header.fh_rec_n)) {
+	  loc_fprintf(stderr, "%s: out of memory decoding '%s'\n",
+		      argv_program, path);
+	  ret = 0;
+	  break;
+	}
+      }
+      else {
+	binlog_print_trans(ring + rec_c % header.fh_rec_n);
+      }
+    }
+    
+    if (ret && totals_b) {
+      binlog_print_totals();
+    }
+  }
+  
+  if (ring != NULL) {
+    free(ring);
+  }
+  
+  return ret;
+}
+
+/*
+ * Find the totals for the call-site described by SOURCE in the hash
+ * of snapshot call-sites, adding it if not found.  Returns NULL on
+ * error.
+ */
+static	snap_site_t	*snap_site(const char *source)
+{
+  snap_site_t	*site_p, *old_sites, *old_p;
+  unsigned long	old_n, hash = 0;
+  const char	*source_p;
+  
+  /* grow the hash when it gets half full */
+  if (snap_site_c >= snap_site_n / 2) {
+    old_sites = snap_sites;
+    old_n = snap_site_n;
+    if (snap_site_n == 0) {
+      snap_site_n = 1024;
+    }
+    else {
+      snap_site_n *= 2;
+    }
+    snap_sites = (snap_site_t *)calloc(snap_site_n, sizeof(snap_site_t));
+    if (snap_sites == NULL) {
+      return NULL;
+    }
+    snap_site_c = 0;
+    for (old_p = old_sites; old_p < old_sites + old_n; old_p++) {
+      if (old_p->ss_source != NULL) {
+	site_p = snap_site(old_p->ss_source);
+	*site_p = *old_p;
+      }
+    }
+    if (old_sites != NULL) {
+      free(old_sites);
+    }
+  }
+  
+  for (source_p = source; *source_p != '\0'; source_p++) {
+    hash = hash * 31 + (unsigned char)*source_p;
+  }
+  site_p = snap_sites + hash % snap_site_n;
+  while (site_p->ss_source != NULL) {
+    if (strcmp(site_p->ss_source, source) == 0) {
+      return site_p;
+    }
+    site_p++;
+    if (site_p == snap_sites + snap_site_n) {
+      site_p = snap_sites;
+    }
+  }
+  
+  site_p->ss_source = (char *)malloc(strlen(source) + 1);
+  if (site_p->ss_source == NULL) {
+    return NULL;
+  }
+  (void)strcpy(site_p->ss_source, source);
+  snap_site_c++;
+  
+  return site_p;
+}
+
+/*
+ * Read the heap snapshot at PATH into the WHICH totals of the
+ * call-sites and its header into HEADER_P.  The call-sites are
+ * matched between snapshots by their file-name and line since the
+ * ids are different in each.  Returns 1 on success or 0 on failure.
+ */
+static	int	read_snapshot(const char *path, const int which,
+			      snapshot_header_t *header_p)
+{
+  FILE			*infile;
+  snapshot_rec_t	rec;
+  snap_site_t		*site_p;
+  char			*name, source[256];
+  unsigned long		new_n, name_c;
+  int			rec_n, ret = 1;
+  
+  infile = fopen(path, "rb");
+  if (infile == NULL) {
+    loc_fprintf(stderr, "%s: could not open heap snapshot '%s'\n",
+		argv_program, path);
+    return 0;
+  }
+  
+  if (fread(header_p, sizeof(*header_p), 1, infile) != 1
+      || memcmp(header_p->sh_magic, SNAPSHOT_MAGIC, BINLOG_MAGIC_SIZE) != 0) {
+    loc_fprintf(stderr, "%s: '%s' is not a heap snapshot\n",
+		argv_program, path);
+    (void)fclose(infile);
+    return 0;
+  }
+  if (header_p->sh_version != SNAPSHOT_VERSION
+      || header_p->sh_byte_order != BINLOG_BYTE_ORDER
+      || header_p->sh_rec_size != sizeof(snapshot_rec_t)) {
+    loc_fprintf(stderr,
+		"%s: heap snapshot '%s' is a different version or from a different system\n",
+		argv_program, path);
+    (void)fclose(infile);
+    return 0;
+  }
+  
+  while (fread(&rec, sizeof(rec), 1, infile) == 1) {
+    
+    if (rec.sr_pnt != 0) {
+      site_p = snap_site(binlog_desc(source, sizeof(source), rec.sr_file,
+				     rec.sr_line));
+      if (site_p == NULL) {
+	loc_fprintf(stderr, "%s: out of memory reading '%s'\n",
+		    argv_program, path);
+	ret = 0;
+	break;
+      }
+      site_p->ss_size[which] += rec.sr_size;
+      site_p->ss_count[which]++;
+      continue;
+    }
+    
+    /* the file-name follows the record, padded to the record size */
+    rec_n = (rec.sr_size + sizeof(rec) - 1) / sizeof(rec);
+    name = (char *)malloc(rec_n * sizeof(rec) + 1);
+    if (name == NULL
+	|| (rec_n > 0 && fread(name, sizeof(rec), rec_n, infile) != rec_n)) {
+      loc_fprintf(stderr, "%s: could not read file-name from '%s'\n",
+		  argv_program, path);
+      ret = 0;
+      break;
+    }
+    name[rec.sr_size] = '\0';
+    
+    if (rec.sr_file >= binlog_name_n) {
+      new_n = (binlog_name_n == 0 ? 64 : binlog_name_n);
+      while (new_n <= rec.sr_file) {
+	new_n *= 2;
+      }
+      binlog_names = (char **)realloc(binlog_names, new_n * sizeof(char *));
+      if (binlog_names == NULL) {
+	loc_fprintf(stderr, "%s: out of memory reading '%s'\n",
+		    argv_program, path);
+	ret = 0;
+	break;
+      }
+      memset(binlog_names + binlog_name_n, 0,
+	     (new_n - binlog_name_n) * sizeof(char *));
+      binlog_name_n = new_n;
+    }
+    if (binlog_names[rec.sr_file] != NULL) {
+      free(binlog_names[rec.sr_file]);
+    }
+    binlog_names[rec.sr_file] = name;
+  }
+  (void)fclose(infile);
+  
+  /* the file-name ids are only good inside of one snapshot */
+  for (name_c = 0; name_c < binlog_name_n; name_c++) {
+    if (binlog_names[name_c] != NULL) {
+      free(binlog_names[name_c]);
+      binlog_names[name_c] = NULL;
+    }
+  }
+  
+  return ret;
+}
+
+/*
+ * Compare two snapshot call-sites for qsort so the largest growth is
+ * first and the unused hash entries are last.
+ */
+static	int	snap_site_compare(const void *site1_p, const void *site2_p)
+{
+  const snap_site_t	*site1 = (const snap_site_t *)site1_p;
+  const snap_site_t	*site2 = (const snap_site_t *)site2_p;
+  long			growth1, growth2;
+  
+  if (site1->ss_source == NULL || site2->ss_source == NULL) {
+    return (site1->ss_source == NULL) - (site2->ss_source == NULL);
+  }
+  growth1 = site1->ss_size[1] - site1->ss_size[0];
+  growth2 = site2->ss_size[1] - site2->ss_size[0];
+  if (growth1 > growth2) {
+    return -1;
+  }
+  else if (growth1 < growth2) {
+    return 1;
+  }
+  else {
+    return strcmp(site1->ss_source, site2->ss_source);
+  }
+}
+
+/*
+ * Print the call-sites of the heap snapshot at NEW_PATH or, if
+ * OLD_PATH is not NULL, how each call-site changed from the snapshot
+ * at OLD_PATH with the new and vanished call-sites marked.  Returns 1
+ * on success or 0 on failure.
+ */
+static	int	diff_snapshot(const char *old_path, const char *new_path)
+{
+  snapshot_header_t	old_header, new_header;
+  snap_site_t		*site_p, total;
+  unsigned long		site_c = 0, grew_c = 0, new_c = 0, gone_c = 0;
+  const char		*status;
+  
+  if ((old_path != NULL && (! read_snapshot(old_path, 0, &old_header)))
+      || (! read_snapshot(new_path, 1, &new_header))) {
+    return 0;
+  }
+  if (snap_site_c > 0) {
+    qsort(snap_sites, snap_site_n, sizeof(snap_site_t), snap_site_compare);
+  }
+  
+  memset(&total, 0, sizeof(total));
+  if (old_path == NULL) {
+    loc_printf("Heap snapshot of process %lu at mark %lu\n",
+	       new_header.sh_pid, new_header.sh_iter);
+    loc_printf(" in-use-size  count  source\n");
+  }
+  else {
+    loc_printf("Heap growth of process %lu from mark %lu to mark %lu\n",
+	       new_header.sh_pid, old_header.sh_iter, new_header.sh_iter);
+    loc_printf("   old-size  count    new-size  count      growth  source\n");
+  }
+  for (site_p = snap_sites;
+       site_p < snap_sites + snap_site_n && site_p->ss_source != NULL;
+       site_p++) {
+    if (old_path == NULL) {
+      loc_printf("%12lu %6lu  %s\n", site_p->ss_size[1], site_p->ss_count[1],
+		 site_p->ss_source);
+    }
+    else {
+      if (site_p->ss_count[0] == 0) {
+	status = " (new)";
+	new_c++;
+      }
+      else if (site_p->ss_count[1] == 0) {
+	status = " (gone)";
+	gone_c++;
+      }
+      else {
+	status = "";
+	if (site_p->ss_size[1] > site_p->ss_size[0]) {
+	  grew_c++;
+	}
+      }
+      loc_printf("%11lu %6lu %11lu %6lu %11ld  %s%s\n",
+		 site_p->ss_size[0], site_p->ss_count[0],
+		 site_p->ss_size[1], site_p->ss_count[1],
+		 (long)(site_p->ss_size[1] - site_p->ss_size[0]),
+		 site_p->ss_source, status);
+    }
+    total.ss_size[0] += site_p->ss_size[0];
+    total.ss_count[0] += site_p->ss_count[0];
+    total.ss_size[1] += site_p->ss_size[1];
+    total.ss_count[1] += site_p->ss_count[1];
+    site_c++;
+  }
+  
+  if (old_path == NULL) {
+    loc_printf("%12lu %6lu  Total of %lu\n", total.ss_size[1],
+	       total.ss_count[1], site_c);
+  }
+  else {
+    loc_printf("%11lu %6lu %11lu %6lu %11ld  Total of %lu\n",
+	       total.ss_size[0], total.ss_count[0],
+	       total.ss_size[1], total.ss_count[1],
+	       (long)(total.ss_size[1] - total.ss_size[0]), site_c);
+    loc_printf("%lu call-sites grew, %lu are new, %lu are gone\n",
+	       grew_c, new_c, gone_c);
+  }
+  
+  return 1;
+}
+
+/*
+ * Build the path of the live statistics file of process PID from the
+ * PATTERN, which has %p for the process-id, into BUF.
+ */
+static	void	live_path_for(const char *pattern, const long pid, char *buf,
+			      const int buf_size)
+{
+  const char	*pat_p;
+  char		*buf_p, *bounds_p;
+  
+  buf_p = buf;
+  bounds_p = buf + buf_size;
+  for (pat_p = pattern; *pat_p != '\0'; pat_p++) {
+    if (*pat_p == '%' && *(pat_p + 1) == 'p') {
+      buf_p = append_long(buf_p, bounds_p, pid, 10);
+      pat_p++;
+    }
+    else if (buf_p < bounds_p - 1) {
+      *buf_p++ = *pat_p;
+    }
+  }
+  (void)append_null(buf_p, bounds_p);
+}
+
+/*
+ * Copy the live statistics file at PATH into HEADER_P.  The copy is
+ * made again while the library is in the middle of updating the
+ * file.  Returns 1 on success or 0 on failure.
+ */
+static	int	live_read(const char *path, live_header_t *header_p)
+{
+#if HAVE_MMAP
+  volatile live_header_t	*map_p;
+  struct stat		st;
+  unsigned long		seq;
+  int			fd, try_c;
+  
+  fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return 0;
+  }
+  /* a short file would fault when we read past its end */
+  if (fstat(fd, &st) != 0 || st.st_size < (long)sizeof(live_header_t)) {
+    (void)close(fd);
+    return 0;
+  }
+  map_p = mmap(0L, sizeof(live_header_t), PROT_READ, MAP_SHARED, fd, 0);
+  (void)close(fd);
+  if (map_p == MAP_FAILED) {
+    return 0;
+  }
+  
+  for (try_c = 0; try_c < LIVE_READ_TRIES; try_c++) {
+    seq = map_p->lh_seq;
+    SEQ_FENCE();
+    memcpy(header_p, (void *)map_p, sizeof(*header_p));
+    SEQ_FENCE();
+    if (seq % 2 == 0 && seq == map_p->lh_seq) {
+      break;
+    }
+  }
+  (void)munmap((void *)map_p, sizeof(live_header_t));
+  
+  if (try_c >= LIVE_READ_TRIES
+      || memcmp(header_p->lh_magic, LIVE_MAGIC, LIVE_MAGIC_SIZE) != 0
+      || header_p->lh_version != LIVE_VERSION
+      || header_p->lh_size != sizeof(live_header_t)
+      || header_p->lh_site_c > LIVE_SITE_N) {
+    return 0;
+  }
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+/*
+ * Read the live statistics of the processes forked from PID into
+ * PROCS which has room for PROC_MAX entries.  The files are found in
+ * the directory of the PATTERN.  Returns the number of processes.
+ */
+static	int	live_children(const char *pattern, const long pid,
+			      live_header_t *procs, const int proc_max)
+{
+#if HAVE_DIRENT_H
+  char		dir[512], path[1024];
+  const char	*name_p, *pid_p, *suffix_p, *digit_p;
+  struct dirent	*entry_p;
+  DIR		*dir_p;
+  int		dir_len, prefix_len, suffix_len, name_len, proc_c = 0;
+  
+  /* split the pattern into the directory and the name around the %p */
+  name_p = strrchr(pattern, '/');
+  if (name_p == NULL) {
+    strcpy(dir, ".");
+    name_p = pattern;
+  }
+  else if (name_p == pattern) {
+    strcpy(dir, "/");
+    name_p++;
+  }
+  else {
+    dir_len = MIN(name_p - pattern, (int)sizeof(dir) - 1);
+    memcpy(dir, pattern, dir_len);
+    dir[dir_len] = '\0';
+    name_p++;
+  }
+  pid_p = strstr(name_p, "%p");
+  if (pid_p == NULL) {
+    return 0;
+  }
+  prefix_len = pid_p - name_p;
+  suffix_p = pid_p + 2;
+  suffix_len = strlen(suffix_p);
+  
+  dir_p = opendir(dir);
+  if (dir_p == NULL) {
+    return 0;
+  }
+  while (proc_c < proc_max && (entry_p = readdir(dir_p)) != NULL) {
+    name_len = strlen(entry_p->d_name);
+    if (name_len <= prefix_len + suffix_len
+	|| strncmp(entry_p->d_name, name_p, prefix_len) != 0
+	|| strcmp(entry_p->d_name + name_len - suffix_len, suffix_p) != 0) {
+      continue;
+    }
+    for (digit_p = entry_p->d_name + prefix_len;
+	 digit_p < entry_p->d_name + name_len - suffix_len;
+	 digit_p++) {
+      if (*digit_p < '0' || *digit_p > '9') {
+	break;
+      }
+    }
+    if (digit_p < entry_p->d_name + name_len - suffix_len) {
+      continue;
+    }
+    
+    (void)loc_snprintf(path, sizeof(path), "%s/%s", dir, entry_p->d_name);
+    if (! live_read(path, procs + proc_c)
+	|| procs[proc_c].lh_ppid != (unsigned long)pid
+	|| procs[proc_c].lh_pid == (unsigned long)pid) {
+      continue;
+    }
+#if SIGNAL_OKAY && HAVE_SIGNAL_H
+    /* skip the files of children that exited without shutting down */
+    if (kill((pid_t)procs[proc_c].lh_pid, 0) != 0 && errno == ESRCH) {
+      continue;
+    }
+#endif
+    proc_c++;
+  }
+  (void)closedir(dir_p);
+  
+  return proc_c;
+#else
+  /* we cannot look for the forked processes without reading the directory */
+  return 0;
+#endif
+}
+
+/*
+ * Compare two live call-sites for qsort so the largest total-size
+ * comes first.
+ */
+static	int	live_site_cmp(const void *site1_p, const void *site2_p)
+{
+  const live_site_t	*s1_p = site1_p, *s2_p = site2_p;
+  
+  if (s1_p->ls_total_size > s2_p->ls_total_size) {
+    return -1;
+  }
+  else if (s1_p->ls_total_size < s2_p->ls_total_size) {
+    return 1;
+  }
+  else {
+    return 0;
+  }
+}
+
+/*
+ * Print one line of live statistics for process PID or the total if
+ * LABEL is not NULL.
+ */
+static	void	live_show_stats(const dmalloc_stats_t *stats_p,
+				const unsigned long pid, const char *label)
+{
+  if (label == NULL) {
+    loc_printf("%8lu", pid);
+  }
+  else {
+    loc_printf("%8s", label);
+  }
+  loc_printf(" %12lu %9lu %12lu %12lu %10lu %10lu %7lu\n",
+	     stats_p->ds_alloc_current, stats_p->ds_alloc_cur_pnts,
+	     stats_p->ds_alloc_maximum, stats_p->ds_total_space,
+	     stats_p->ds_alloc_tot_pnts,
+	     stats_p->ds_free_c + stats_p->ds_delete_c,
+	     stats_p->ds_heap_check_c);
+}
+
+/*
+ * Print the live statistics of the PROC_N processes in PROCS with a
+ * total line and the top call-sites of all of them added together.
+ */
+static	void	live_show(const live_header_t *procs, const int proc_n)
+{
+  static live_site_t	sites[LIVE_SITE_N * LIVE_PROC_MAX];
+  dmalloc_stats_t	total;
+  const live_site_t	*proc_site_p;
+  int			proc_c, site_c, found_c, site_n = 0;
+  
+  loc_printf("Live statistics of process %lu", procs[0].lh_pid);
+  if (proc_n > 1) {
+    loc_printf(" and %d forked processes", proc_n - 1);
+  }
+  loc_printf("\n\n");
+  loc_printf("     pid       in-use      pnts     max-used  total-space"
+	     "     allocs      frees  checks\n");
+  
+  memset(&total, 0, sizeof(total));
+  for (proc_c = 0; proc_c < proc_n; proc_c++) {
+    live_show_stats(&procs[proc_c].lh_stats, procs[proc_c].lh_pid, NULL);
+    total.ds_alloc_current += procs[proc_c].lh_stats.ds_alloc_current;
+    total.ds_alloc_cur_pnts += procs[proc_c].lh_stats.ds_alloc_cur_pnts;
+    total.ds_alloc_maximum += procs[proc_c].lh_stats.ds_alloc_maximum;
+    total.ds_total_space += procs[proc_c].lh_stats.ds_total_space;
+    total.ds_alloc_tot_pnts += procs[proc_c].lh_stats.ds_alloc_tot_pnts;
+    total.ds_free_c += procs[proc_c].lh_stats.ds_free_c;
+    total.ds_delete_c += procs[proc_c].lh_stats.ds_delete_c;
+    total.ds_heap_check_c += procs[proc_c].lh_stats.ds_heap_check_c;
+    
+    /* add the call-sites of the process in with the others */
+    for (site_c = 0; site_c < procs[proc_c].lh_site_c; site_c++) {
+      proc_site_p = procs[proc_c].lh_sites + site_c;
+      for (found_c = 0; found_c < site_n; found_c++) {
+	if (strncmp(sites[found_c].ls_source, proc_site_p->ls_source,
+		    LIVE_SITE_SIZE) == 0) {
+	  break;
+	}
+      }
+      if (found_c == site_n) {
+	sites[site_n] = *proc_site_p;
+	sites[site_n].ls_source[LIVE_SITE_SIZE - 1] = '\0';
+	site_n++;
+      }
+      else {
+	sites[found_c].ls_total_size += proc_site_p->ls_total_size;
+	sites[found_c].ls_total_c += proc_site_p->ls_total_c;
+	sites[found_c].ls_in_use_size += proc_site_p->ls_in_use_size;
+	sites[found_c].ls_in_use_c += proc_site_p->ls_in_use_c;
+      }
+    }
+  }
+  if (proc_n > 1) {
+    live_show_stats(&total, 0, "total");
+  }
+  
+  qsort(sites, site_n, sizeof(*sites), live_site_cmp);
+  if (site_n > LIVE_SITE_N) {
+    site_n = LIVE_SITE_N;
+  }
+  loc_printf("\n  total-size    count  in-use-size    count  source\n");
+  for (site_c = 0; site_c < site_n; site_c++) {
+    loc_printf("%12lu %8lu %12lu %8lu  %s\n",
+	       sites[site_c].ls_total_size, sites[site_c].ls_total_c,
+	       sites[site_c].ls_in_use_size, sites[site_c].ls_in_use_c,
+	       sites[site_c].ls_source);
+  }
+}
+
+/*
+ * Show the live statistics of process PID and of any processes forked
+ * from it every second.  PATTERN is the path of the files with %p for
+ * the process-id.  Returns 1 on success or 0 on failure.
+ */
+static	int	attach_live(const char *pattern, const long pid)
+{
+  static live_header_t	procs[LIVE_PROC_MAX];
+  char			path[1024];
+  int			show_c, proc_n;
+  
+  live_path_for(pattern, pid, path, sizeof(path));
+  
+  for (show_c = 0; refresh_count <= 0 || show_c < refresh_count; show_c++) {
+    if (show_c > 0) {
+      (void)sleep(1);
+    }
+    
+    if (! live_read(path, procs)) {
+      if (show_c == 0) {
+	loc_fprintf(stderr,
+		    "%s: could not read the live statistics of process %ld in '%s'\n",
+		    argv_program, pid, path);
+	return 0;
+      }
+      loc_fprintf(stderr, "%s: process %ld has finished\n", argv_program, pid);
+      return 1;
+    }
+    proc_n = 1 + live_children(pattern, pid, procs + 1, LIVE_PROC_MAX - 1);
+    
+    /* clear the screen like top if we are writing to a terminal */
+    if (isatty(1)) {
+      loc_printf("\033[H\033[2J");
+    }
+    live_show(procs, proc_n);
+    (void)fflush(stdout);
+  }
+  
+  return 1;
+}
+
+/*
+ * Send the REQUEST to the query server of process PID and print its
+ * answer.  PATTERN is the path of the socket with %p for the
+ * process-id.  Returns 1 on success or 0 on failure.
+ */
+static	int	query_server(const char *pattern, const long pid,
+			     const char *request)
+{
+#if HAVE_POLL_H && HAVE_SYS_SOCKET_H && HAVE_SYS_UN_H
+  struct sockaddr_un	addr;
+  struct pollfd		pfd;
+  char			path[sizeof(addr.sun_path)], buf[4096];
+  int			fd, len, ret = 0;
+  
+  live_path_for(pattern, pid, path, sizeof(path));
+  
+  fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    loc_fprintf(stderr, "%s: could not create a socket\n", argv_program);
+    return 0;
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  (void)strcpy(addr.sun_path, path);
+  if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+    loc_fprintf(stderr,
+		"%s: could not connect to the query server of process %ld in '%s'\n",
+		argv_program, pid, path);
+    (void)close(fd);
+    return 0;
+  }
+  
+  len = loc_snprintf(buf, sizeof(buf), "%s\n", request);
+  if (write(fd, buf, len) != len) {
+    loc_fprintf(stderr, "%s: could not send the request to '%s'\n",
+		argv_program, path);
+    (void)close(fd);
+    return 0;
+  }
+  
+  /*
+   * The server in a library without threads only answers once a
+   * second from inside of an allocation so we may have to wait.
+   */
+  for (;;) {
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, QUERY_WAIT_MSECS) <= 0) {
+      if (! ret) {
+	loc_fprintf(stderr, "%s: no answer from the query server in '%s'\n",
+		    argv_program, path);
+      }
+      break;
+    }
+    len = read(fd, buf, sizeof(buf));
+    if (len <= 0) {
+      break;
+    }
+    (void)fwrite(buf, 1, len, stdout);
+    ret = 1;
+    if (buf[len - 1] == '\n') {
+      break;
+    }
+  }
+  (void)close(fd);
+  
+  return ret;
+#else
+  loc_fprintf(stderr, "%s: the query server is not supported on this system\n",
+	      argv_program);
+  return 0;
+#endif
+}
+
+/*
+ * static void header
+ *
+ * Print out a little usage header to the user.
+ */
+static	void	header(void)
+{
+  loc_fprintf(stderr, "Debug Malloc Utility: https://dmalloc.com/\n");
+  loc_fprintf(stderr,
+	      "  This utility helps set the Debug Malloc environment variables.\n");
+}
+
+int	main(int argc, char **argv)
+{
+  char		buf[1024], budget_buf[512];
+  int		set_b = 0;
+  char		*log_path, *loc_start_file, *loc_budget, *loc_profile;
+  char		*loc_binlog, *loc_flight, *loc_live, *loc_control, *loc_server;
+  const char	*env_str;
+  DMALLOC_PNT	addr;
+  unsigned long	inter, limit_val, loc_start_size, loc_start_iter;
+  unsigned long	loc_profile_iter, loc_flight_recs, loc_control_secs;
+  unsigned long	addr_count;
+  int		lock_on, loc_async_log;
+  int		loc_start_line, loc_dump_sig, loc_dump_check;
+  unsigned int	flags;
+  char		env_buf[256];
+  
+  argv_help_string = "Sets dmalloc library env variables.  Also try --usage.";
+  argv_version_string = dmalloc_version;
+  argv_usage_type = ARGV_USAGE_LONG;
+  argv_error_type = ARGV_USAGE_SHORT_REM;
+  
+  argv_process(args, argc, argv);
+  
+  if (help_b) {
+    header();
+    loc_fprintf(stderr, "  For a list of the command-line options enter: %s --usage\n",
+		argv_argv[0]);
+    exit(0);
+  }
+  if (usage_b) {
+    header();
+    argv_usage(args, argv_usage_type);
+    exit(0);
+  }
+  if (version_b) {
+    loc_fprintf(stderr, "Dmalloc utility version string is: %s\n", argv_version_string);
+    loc_fprintf(stderr,
+		"  NOTE: Library linked with your application may be a different version.\n");
+    loc_fprintf(stderr,
+		"        Check top of logfile after application is run for library version.\n");
+    exit(0);
+  }
+  
+  /* decode a binary transaction log written by the library */
+  if (binlog_decode != NULL) {
+    if (decode_binlog(binlog_decode, binlog_totals_b)) {
+      exit(0);
+    }
+    else {
+      exit(1);
+    }
+  }
+  
+  /* print a heap snapshot or compare two of them */
+  if (diff_snapshots.aa_entry_n > 0) {
+    if (diff_snapshots.aa_entry_n > 2) {
+      loc_fprintf(stderr, "%s: --diff-snapshot can only be given twice\n",
+		  argv_program);
+      exit(1);
+    }
+    if (diff_snapshot((diff_snapshots.aa_entry_n == 1 ? NULL
+		       : ARGV_ARRAY_ENTRY(diff_snapshots, char *, 0)),
+		      ARGV_ARRAY_ENTRY(diff_snapshots, char *,
+				       diff_snapshots.aa_entry_n - 1))) {
+      exit(0);
+    }
+    else {
+      exit(1);
+    }
+  }
+  
+  /* decode a flight recorder file left by the library */
+  if (flight_decode != NULL) {
+    if (decode_flight(flight_decode, binlog_totals_b)) {
+      exit(0);
+    }
+    else {
+      exit(1);
+    }
+  }
+  
+  if (very_verbose_b) {
+    verbose_b = 1;
+  }
+  
+  /* try to figure out the shell we are using */
+  if ((! bourne_b) && (! cshell_b) && (! gdb_b) && (! rcshell_b)) {
+    choose_shell();
+  }
+  
+  /* get the current debug information from the env variable */
+  env_str = loc_getenv(OPTIONS_ENVIRON, env_buf, sizeof(env_buf), 0);
+  if (env_str == NULL) {
+    env_str = "";
+  }
+  _dmalloc_environ_process(env_str, &addr, &addr_count, &flags, &inter,
+			   &lock_on, &log_path, &loc_start_file,
+			   &loc_start_line, &loc_start_iter, &loc_start_size,
+			   &limit_val, &loc_budget, &loc_profile,
+			   &loc_profile_iter, &loc_binlog, &loc_async_log,
+			   &loc_flight, &loc_flight_recs, &loc_live,
+			   &loc_dump_sig, &loc_dump_check, &loc_control,
+			   &loc_control_secs, &loc_server);
+  
+  /* ask the query server of a running program */
+  if (attach_pid > 0 && query != NULL) {
+    if (server != NULL) {
+      loc_server = server;
+    }
+    else if (loc_server == NULL) {
+      loc_server = SERVER_PATH;
+    }
+    if (query_server(loc_server, attach_pid, query)) {
+      exit(0);
+    }
+    else {
+      exit(1);
+    }
+  }
+  
+  /* watch the live statistics of a running program */
+  if (attach_pid > 0) {
+    if (live != NULL) {
+      loc_live = live;
+    }
+    else if (loc_live == NULL) {
+      loc_live = LIVE_STATS_PATH;
+    }
+    if (attach_live(loc_live, attach_pid)) {
+      exit(0);
+    }
+    else {
+      exit(1);
+    }
+  }
+  
+  /*
+   * So, if a tag was specified on the command line then we set the
+   * debug from it.  If it was not then we see if the debug flags were
+   * set as a hex value from the -d.  If this was not used then take
+   * the current value.
+   */
+  if (tag == NULL) {
+    if (argv_was_used(args, DEBUG_ARG)) {
+      set_b = 1;
+      /* should we clear the rest? */
+      if (remove_auto_b && (! keep_b)) {
+	clear_b = 1;
+      }
+    }
+    else {
+      debug = flags;
+    }
+  }
+  else {
+    if (argv_was_used(args, DEBUG_ARG)) {
+      loc_fprintf(stderr, "%s: warning -d ignored, processing tag '%s'\n",
+		  argv_program, tag);
+    }
+    set_b = 1;
+    debug = find_tag(0L, tag, NULL, 0);
+    /* should we clear the rest? */
+    if (remove_auto_b && (! keep_b)) {
+      clear_b = 1;
+    }
+  }
+  
+  if (plus.aa_entry_n > 0) {
+    int		plus_c;
+    for (plus_c = 0; plus_c < plus.aa_entry_n; plus_c++) {
+      BIT_SET(debug, token_to_value(ARGV_ARRAY_ENTRY(plus, char *, plus_c)));
+      set_b = 1;
+    }
+  }
+  
+  if (minus.aa_entry_n > 0) {
+    int		minus_c;
+    for (minus_c = 0; minus_c < minus.aa_entry_n; minus_c++) {
+      BIT_CLEAR(debug,
+		token_to_value(ARGV_ARRAY_ENTRY(minus, char *, minus_c)));
+      set_b = 1;
+    }
+  }
+  
+  if (address != NULL) {
+    _dmalloc_address_break(address, &addr, &addr_count);
+    set_b = 1;
+  }
+  else if (clear_b) {
+    addr = NULL;
+  }
+  
+  if (argv_was_used(args, INTERVAL_ARG)) {
+    inter = interval;
+    set_b = 1;
+  }
+  else if (clear_b) {
+    inter = 0;
+  }
+  
+  /*
+   * NOTE: this should be after the debug setting which this tests.
+   */
+  if (argv_was_used(args, THREAD_LOCK_ON_ARG)) {
+    lock_on = thread_lock_on;
+    set_b = 1;
+  }
+  else if (clear_b) {
+    lock_on = 0;
+  }
+  
+  if (logpath != NULL) {
+    log_path = logpath;
+    set_b = 1;
+  }
+  else if (clear_b) {
+    log_path = NULL;
+  }
+  
+  if (start_file != NULL) {
+    _dmalloc_start_break(start_file, &loc_start_file, &loc_start_line,
+			 &loc_start_iter, &loc_start_size);
+    set_b = 1;
+  }
+  else if (start_iter > 0) {
+    loc_start_file = NULL;
+    loc_start_line = 0;
+    loc_start_iter = start_iter;
+    loc_start_size = 0;
+    set_b = 1;
+  }
+  else if (start_size > 0) {
     loc_start_file = NULL;
     loc_start_line = 0;
     loc_start_iter = 0;
@@ -1020,6 +2423,98 @@ int	main(int argc, char **argv)
     set_b = 1;
   }
   
+  if (budget_args.aa_entry_n > 0) {
+    char	*budget_p = budget_buf, *bounds_p = budget_buf + sizeof(budget_buf);
+    int		budget_c;
+    
+    /* multiple budgets are separated by semi-colons */
+    for (budget_c = 0; budget_c < budget_args.aa_entry_n; budget_c++) {
+      budget_p += loc_snprintf(budget_p, bounds_p - budget_p, "%s%s",
+			       (budget_c == 0 ? "" : ";"),
+			       ARGV_ARRAY_ENTRY(budget_args, char *, budget_c));
+    }
+    loc_budget = budget_buf;
+    set_b = 1;
+  }
+  else if (clear_b) {
+    loc_budget = NULL;
+  }
+  
+  if (profile != NULL) {
+    /* any iterations are passed through in the path */
+    loc_profile = profile;
+    loc_profile_iter = 0;
+    set_b = 1;
+  }
+  else if (clear_b) {
+    loc_profile = NULL;
+    loc_profile_iter = 0;
+  }
+  
+  if (binlog != NULL) {
+    loc_binlog = binlog;
+    set_b = 1;
+  }
+  else if (clear_b) {
+    loc_binlog = NULL;
+  }
+  
+  if (async_log != NULL) {
+    loc_async_log = _dmalloc_async_break(async_log);
+    set_b = 1;
+  }
+  else if (clear_b) {
+    loc_async_log = ASYNC_LOG_NONE;
+  }
+  
+  if (flight != NULL) {
+    /* any number of records is passed through in the path */
+    loc_flight = flight;
+    loc_flight_recs = 0;
+    set_b = 1;
+  }
+  else if (clear_b) {
+    loc_flight = NULL;
+    loc_flight_recs = 0;
+  }
+  
+  if (live != NULL) {
+    loc_live = live;
+    set_b = 1;
+  }
+  else if (clear_b) {
+    loc_live = NULL;
+  }
+  
+  if (dump_signal != NULL) {
+    loc_dump_sig = atoi(dump_signal);
+    loc_dump_check = (strstr(dump_signal, ":check") != NULL);
+    set_b = 1;
+  }
+  else if (clear_b) {
+    loc_dump_sig = 0;
+    loc_dump_check = 0;
+  }
+  
+  if (control != NULL) {
+    /* any number of seconds is passed through in the path */
+    loc_control = control;
+    loc_control_secs = 0;
+    set_b = 1;
+  }
+  else if (clear_b) {
+    loc_control = NULL;
+    loc_control_secs = 0;
+  }
+  
+  if (server != NULL) {
+    loc_server = server;
+    set_b = 1;
+  }
+  else if (clear_b) {
+    loc_server = NULL;
+  }
+  
   if (errno_to_print > 0) {
     loc_fprintf(stderr, "%s: dmalloc_errno value '%d' = \n", argv_program, errno_to_print);
     loc_fprintf(stderr, "   '%s'\n", local_strerror(errno_to_print));
@@ -1061,7 +2556,10 @@ int	main(int argc, char **argv)
     _dmalloc_environ_set(buf, sizeof(buf), long_tokens_b, addr, addr_count,
 			 debug, inter, lock_on, log_path, loc_start_file,
 			 loc_start_line, loc_start_iter, loc_start_size,
-			 limit_val);
+			 limit_val, loc_budget, loc_profile, loc_profile_iter,
+			 loc_binlog, loc_async_log, loc_flight, loc_flight_recs,
+			 loc_live, loc_dump_sig, loc_dump_check, loc_control,
+			 loc_control_secs, loc_server);
     set_variable(OPTIONS_ENVIRON, buf);
   }
   else if (errno_to_print == 0
@@ -0,0 +1,386 @@
+/*
+ * Benchmark of the allocation routines under different debug settings
+ *
+ * Copyright 2020 by Gray Watson
+ *
+ * This file is part of the dmalloc package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ *
+ * The author may be contacted via https://dmalloc.com/
+ */
+
+/*
+ * For each debug setting, size class, and number of live pointers,
+ * the benchmark fills a table with that many pointers, churns random
+ * entries with free, malloc, calloc, and realloc calls, and then
+ * frees them all.  Each call is timed and the results are written to
+ * stdout as JSON.  Runs whose pointers would take more than the
+ * memory limit are skipped.
+ */
+
+#include <stdio.h>				/* for printf */
+
+#if HAVE_STDLIB_H
+# include <stdlib.h>				/* for malloc */
+#endif
+#if HAVE_STRING_H
+# include <string.h>
+#endif
+#if HAVE_UNISTD_H
+# include <unistd.h>				/* for getpid */
+#endif
+
+#include "conf.h"
+#include "append.h"				/* for loc_snprintf */
+
+#if HAVE_TIME
+# ifdef TIME_INCLUDE
+#  include TIME_INCLUDE
+# endif
+#endif
+
+#include "dmalloc.h"
+#include "dmalloc_argv.h"
+#include "dmalloc_rand.h"
+
+#include "dmalloc_loc.h"			/* for BLOCK_SIZE */
+
+/* the calls that we time */
+#define OP_MALLOC		0
+#define OP_FREE			1
+#define OP_REALLOC		2
+#define OP_CALLOC		3
+#define OP_N			4
+
+/* latency histogram with HIST_SUB_N buckets per power of two */
+#define HIST_SUB_BITS		2
+#define HIST_SUB_N		(1 << HIST_SUB_BITS)
+#define HIST_BUCKET_N		(64 * HIST_SUB_N)
+
+/* estimate of the library's administration bytes per pointer */
+#define ADMIN_PER_PNT		64
+
+/* timing of one of the calls in a run */
+typedef struct {
+  unsigned long	ot_count;			/* number of calls */
+  unsigned long	ot_nsecs;			/* total nano-seconds */
+  unsigned long	ot_max;				/* slowest call */
+  unsigned long	ot_hist[HIST_BUCKET_N];		/* log-linear histogram */
+} op_time_t;
+
+/* a debug setting and the options that we pass to the library */
+typedef struct {
+  const char	*ds_name;			/* name in the results */
+  const char	*ds_options;			/* dmalloc_debug_setup str */
+} debug_set_t;
+
+/* a range of allocation sizes */
+typedef struct {
+  const char	*sc_name;			/* name in the results */
+  unsigned long	sc_min;				/* smallest size */
+  unsigned long	sc_max;				/* largest size */
+} size_class_t;
+
+static	debug_set_t	debug_sets[] = {
+  { "none",		"debug=0" },
+  { "check-fence",	"check-fence" },
+  { "check-heap-10000",	"check-heap,inter=10000" },
+  { "check-heap-1000",	"check-heap,inter=1000" },
+  { "alloc-free-blank",	"alloc-blank,free-blank" },
+  { "log-trans",	"log-trans" },
+  { NULL }
+};
+
+static	size_class_t	size_classes[] = {
+  { "tiny",		1,			64 },
+  { "divided",		65,			BLOCK_SIZE / 2 - 1 },
+  { "block",		BLOCK_SIZE / 2,		BLOCK_SIZE },
+  { "multi-block",	BLOCK_SIZE + 1,		BLOCK_SIZE * 8 },
+  { NULL }
+};
+
+static	char	*op_names[] = { "malloc", "free", "realloc", "calloc" };
+
+/* argument variables */
+static	unsigned long	churn_n = 20000;	/* churn calls per run */
+static	char		*log_path = "/dev/null"; /* logfile for log-trans */
+static	unsigned long	live_max = 100000;	/* most live pointers */
+static	unsigned long	live_min = 1000;	/* fewest live pointers */
+static	unsigned long	memory_max = 1024;	/* memory limit in mb */
+static	unsigned int	seed_random = 0;	/* random seed */
+
+static	argv_t		arg_list[] = {
+  { 'c',	"churn",	ARGV_U_LONG,	&churn_n,
+    "number",			"churn calls in each run" },
+  { 'l',	"logfile",	ARGV_CHAR_P,	&log_path,
+    "path",			"logfile for the log-trans runs" },
+  { 'm',	"memory-limit",	ARGV_U_LONG,	&memory_max,
+    "mb",			"skip runs that need more memory" },
+  { 'n',	"min-live",	ARGV_U_LONG,	&live_min,
+    "number",			"fewest live pointers" },
+  { 'p',	"max-live",	ARGV_U_LONG,	&live_max,
+    "number",			"most live pointers (1K to 10M)" },
+  { 'S',	"seed-random",	ARGV_U_INT,	&seed_random,
+    "number",			"seed for random function" },
+  { ARGV_LAST }
+};
+
+/* the timings of the current run */
+static	op_time_t	op_times[OP_N];
+
+/*
+ * Return the current time in nano-seconds.
+ */
+static	unsigned long	nano_now(void)
+{
+#ifdef CLOCK_MONOTONIC
+  struct timespec	now;
+  
+  (void)clock_gettime(CLOCK_MONOTONIC, &now);
+  return (unsigned long)now.tv_sec * 1000000000UL + now.tv_nsec;
+#else
+  return (unsigned long)clock() * (1000000000UL / CLOCKS_PER_SEC);
+#endif
+}
+
+/*
+ * Record that a call of type OP took from START until now.
+ */
+static	void	op_done(const int op, const unsigned long start)
+{
+  op_time_t	*time_p = op_times + op;
+  unsigned long	nsecs = nano_now() - start;
+  int		bits, bucket;
+  
+  if (nsecs < HIST_SUB_N) {
+    bucket = nsecs;
+  }
+  else {
+    bits = 63 - __builtin_clzl(nsecs);
+    bucket = (bits - HIST_SUB_BITS + 1) * HIST_SUB_N
+      + ((nsecs >> (bits - HIST_SUB_BITS)) & (HIST_SUB_N - 1));
+  }
+  time_p->ot_hist[bucket]++;
+  time_p->ot_count++;
+  time_p->ot_nsecs += nsecs;
+  if (nsecs > time_p->ot_max) {
+    time_p->ot_max = nsecs;
+  }
+}
+
+/*
+ * Return the upper limit of the histogram bucket in TIME_P that holds
+ * the PER_MILLE 1/1000th of the calls.
+ */
+static	unsigned long	op_percentile(const op_time_t *time_p,
+				      const unsigned long per_mille)
+{
+  unsigned long	total = 0, want, limit;
+  int		bucket, bits;
+  
+  want = time_p->ot_count * per_mille / 1000;
+  for (bucket = 0; bucket < HIST_BUCKET_N; bucket++) {
+    total += time_p->ot_hist[bucket];
+    if (total > want) {
+      break;
+    }
+  }
+  
+  if (bucket < HIST_SUB_N) {
+    return bucket;
+  }
+  if (bucket >= HIST_BUCKET_N) {
+    return time_p->ot_max;
+  }
+  bits = bucket / HIST_SUB_N + HIST_SUB_BITS - 1;
+  limit = ((unsigned long)(HIST_SUB_N + bucket % HIST_SUB_N + 1)
+	   << (bits - HIST_SUB_BITS)) - 1;
+  if (limit > time_p->ot_max) {
+    return time_p->ot_max;
+  }
+  return limit;
+}
+
+/*
+ * Return a random size from the size class CLASS_P.
+ */
+static	unsigned long	random_size(const size_class_t *class_p)
+{
+  return class_p->sc_min
+    + (unsigned long)_dmalloc_rand() % (class_p->sc_max - class_p->sc_min + 1);
+}
+
+/*
+ * Run one benchmark of LIVE_N pointers from CLASS_P with the library
+ * already set up.  Returns 1 on success or 0 if an allocation failed.
+ */
+static	int	run_one(const size_class_t *class_p, const unsigned long live_n)
+{
+  void		**pnts, *pnt;
+  unsigned long	pnt_c, churn_c, which, size, start;
+  int		ret = 1;
+  
+  memset(op_times, 0, sizeof(op_times));
+  
+  pnts = (void **)malloc(live_n * sizeof(void *));
+  if (pnts == NULL) {
+    return 0;
+  }
+  
+  for (pnt_c = 0; pnt_c < live_n; pnt_c++) {
+    size = random_size(class_p);
+    start = nano_now();
+    pnts[pnt_c] = malloc(size);
+    op_done(OP_MALLOC, start);
+    if (pnts[pnt_c] == NULL) {
+      ret = 0;
+      break;
+    }
+  }
+  
+  for (churn_c = 0; ret && churn_c < churn_n; churn_c++) {
+    which = (unsigned long)_dmalloc_rand() % live_n;
+    size = random_size(class_p);
+  
+    switch (churn_c % 3) {
+    case 0:
+    case 1:
+      start = nano_now();
+      free(pnts[which]);
+      op_done(OP_FREE, start);
+      start = nano_now();
+      if (churn_c % 3 == 0) {
+	pnts[which] = malloc(size);
+	op_done(OP_MALLOC, start);
+      }
+      else {
+	pnts[which] = calloc(1, size);
+	op_done(OP_CALLOC, start);
+      }
+      if (pnts[which] == NULL) {
+	ret = 0;
+      }
+      break;
+    default:
+      start = nano_now();
+      pnt = realloc(pnts[which], size);
+      op_done(OP_REALLOC, start);
+      if (pnt == NULL) {
+	ret = 0;
+      }
+      else {
+	pnts[which] = pnt;
+      }
+      break;
+    }
+  }
+  
+  for (which = 0; which < pnt_c; which++) {
+    if (pnts[which] != NULL) {
+      start = nano_now();
+      free(pnts[which]);
+      op_done(OP_FREE, start);
+    }
+  }
+  free(pnts);
+  
+  return ret;
+}
+
+/*
+ * Print the results of the run as a JSON object.  FIRST_B is set if
+ * this is the first result.
+ */
+static	void	print_run(const int first_b, const debug_set_t *debug_p,
+			  const size_class_t *class_p,
+			  const unsigned long live_n)
+{
+  op_time_t	*time_p;
+  int		op;
+  
+  (void)printf("%s\n    { \"debug\": \"%s\", \"options\": \"%s\",\n",
+	       (first_b ? "" : ","), debug_p->ds_name, debug_p->ds_options);
+  (void)printf("      \"size_class\": \"%s\", \"min_size\": %lu, "
+	       "\"max_size\": %lu, \"live\": %lu,\n",
+	       class_p->sc_name, class_p->sc_min, class_p->sc_max, live_n);
+  (void)printf("      \"ops\": {");
+  for (op = 0; op < OP_N; op++) {
+    time_p = op_times + op;
+    (void)printf("%s\n        \"%s\": { \"count\": %lu, \"ns_per_op\": %.1f, "
+		 "\"ops_per_sec\": %.0f,\n",
+		 (op == 0 ? "" : ","), op_names[op], time_p->ot_count,
+		 (time_p->ot_count == 0 ? 0.0
+		  : (double)time_p->ot_nsecs / time_p->ot_count),
+		 (time_p->ot_nsecs == 0 ? 0.0
+		  : (double)time_p->ot_count * 1000000000.0
+		  / time_p->ot_nsecs));
+    (void)printf("          \"p50_ns\": %lu, \"p90_ns\": %lu, "
+		 "\"p99_ns\": %lu, \"p999_ns\": %lu, \"max_ns\": %lu }",
+		 op_percentile(time_p, 500), op_percentile(time_p, 900),
+		 op_percentile(time_p, 990), op_percentile(time_p, 999),
+		 time_p->ot_max);
+  }
+  (void)printf(" } }");
+  (void)fflush(stdout);
+}
+
+int	main(int argc, char **argv)
+{
+  const debug_set_t	*debug_p;
+  const size_class_t	*class_p;
+  char			options[256];
+  unsigned long		live_n, need;
+  int			first_b = 1, final = 0;
+  
+  argv_process(arg_list, argc, argv);
+  
+  if (seed_random == 0) {
+#if HAVE_TIME && HAVE_GETPID
+    seed_random = time(0) ^ getpid();
+#else
+    seed_random = 0xDEADBEEF;
+#endif
+  }
+  _dmalloc_srand(seed_random);
+  
+  (void)printf("{ \"seed\": %u, \"block_size\": %d, \"churn\": %lu,\n",
+	       seed_random, BLOCK_SIZE, churn_n);
+  (void)printf("  \"results\": [");
+  
+  for (debug_p = debug_sets; debug_p->ds_name != NULL; debug_p++) {
+    (void)loc_snprintf(options, sizeof(options), "%s,log=%s",
+		       debug_p->ds_options, log_path);
+    dmalloc_debug_setup(options);
+  
+    for (class_p = size_classes; class_p->sc_name != NULL; class_p++) {
+      for (live_n = live_min; live_n <= live_max; live_n *= 10) {
+	need = (live_n * (class_p->sc_max + ADMIN_PER_PNT)) / (1024 * 1024);
+	if (need > memory_max) {
+	  continue;
+	}
+	if (! run_one(class_p, live_n)) {
+	  (void)fprintf(stderr, "%s: allocation failed with %s for %lu %s\n",
+			argv_program, debug_p->ds_name, live_n,
+			class_p->sc_name);
+	  final = 1;
+	}
+	print_run(first_b, debug_p, class_p, live_n);
+	first_b = 0;
+      }
+    }
+  }
+  
+  (void)printf("\n  ]\n}\n");
+  
+  exit(final);
+}
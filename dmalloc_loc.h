@@ -60,6 +60,14 @@
 #define DMALLOC_DEFAULT_FILE	0L
 #define DMALLOC_DEFAULT_LINE	0
 
+/*
+ * What the asynchronous log writer does when its ring is full.
+ */
+#define ASYNC_LOG_NONE		0	/* no writer, write messages inline */
+#define ASYNC_LOG_BLOCK		1	/* wait for the writer to make room */
+#define ASYNC_LOG_DROP		2	/* drop the message and count it */
+#define ASYNC_LOG_INLINE	3	/* write the message ourselves */
+
 /*
  * Min/max macros
  *
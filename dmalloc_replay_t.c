@@ -0,0 +1,492 @@
+/*
+ * Replay a binary transaction log through the library as a benchmark
+ *
+ * Copyright 2020 by Gray Watson
+ *
+ * This file is part of the dmalloc package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ *
+ * The author may be contacted via https://dmalloc.com/
+ */
+
+/*
+ * A trace is recorded by running a program with the binlog option.
+ * Each allocation, reallocation, and free in the trace is replayed in
+ * order through the dmalloc API with the debug settings from the -e
+ * option or the environment and timed.  The recorded pointers are
+ * mapped to the replayed ones with a hash table.  The transactions
+ * of all threads are replayed from a single thread.
+ */
+
+#include <stdio.h>				/* for FILE */
+#include <sys/time.h>				/* for getrusage */
+#include <sys/resource.h>			/* for getrusage */
+
+#if HAVE_STDLIB_H
+# include <stdlib.h>				/* for exit */
+#endif
+#if HAVE_STRING_H
+# include <string.h>				/* for memcmp */
+#endif
+
+#include "conf.h"
+#include "append.h"				/* for loc_printf */
+
+#if HAVE_TIME
+# ifdef TIME_INCLUDE
+#  include TIME_INCLUDE
+# endif
+#endif
+
+#include "dmalloc.h"
+#include "dmalloc_argv.h"
+
+#include "binlog_loc.h"				/* for the log format */
+
+/* how many records we read from the trace at a time */
+#define READ_RECS		1024
+
+/* latency histogram with LATENCY_SUB_N buckets per power of two */
+#define LATENCY_SUB_BITS	3
+#define LATENCY_SUB_N		(1 << LATENCY_SUB_BITS)
+#define LATENCY_BUCKET_N	(64 * LATENCY_SUB_N)
+
+/* number of different thread-ids that we count */
+#define THREAD_MAX		256
+
+/* file and line that we pass into the library for the replayed calls */
+#define REPLAY_FILE		"replay"
+
+/* entry in the table which maps recorded pointers to replayed ones */
+typedef struct {
+  unsigned long	pe_recorded;			/* pointer from the trace */
+  DMALLOC_PNT	pe_replayed;			/* pointer that we got */
+} pnt_entry_t;
+
+/* argument variables */
+static	char	*env_string = NULL;		/* env options */
+static	int	iter_n = 1;			/* times to replay the trace */
+static	int	silent_b = ARGV_FALSE;		/* silent flag */
+static	char	*trace_path = NULL;		/* binary log to replay */
+
+static	argv_t	arg_list[] = {
+  { 'e',	"env-string",	ARGV_CHAR_P,	&env_string,
+    "string",			"string of env commands to set" },
+  { 'i',	"iterations",	ARGV_INT,	&iter_n,
+    "number",			"number of times to replay the trace" },
+  { 's',	"silent",	ARGV_BOOL_INT,	&silent_b,
+    NULL,			"only print the results" },
+  { ARGV_MAND,	NULL,		ARGV_CHAR_P,	&trace_path,
+    "trace",			"binary log recorded with binlog" },
+  { ARGV_LAST }
+};
+
+/* the pointer table which is a power of 2 in size */
+static	pnt_entry_t	*pnt_table = NULL;
+static	unsigned long	pnt_table_n = 0;
+static	unsigned long	pnt_c = 0;
+
+/* the latency histogram of all of the replayed calls */
+static	unsigned long	latency_counts[LATENCY_BUCKET_N];
+static	unsigned long	latency_max = 0;
+
+/* the different threads that are in the trace */
+static	unsigned long	thread_ids[THREAD_MAX];
+static	int		thread_c = 0;
+
+/* counts of what we replayed and skipped */
+static	unsigned long	op_c = 0;
+static	unsigned long	skip_c = 0;
+static	unsigned long	fail_c = 0;
+
+/*
+ * Return the current time in nano-seconds.
+ */
+static	unsigned long	nano_now(void)
+{
+#ifdef CLOCK_MONOTONIC
+  struct timespec	now;
+  
+  (void)clock_gettime(CLOCK_MONOTONIC, &now);
+  return (unsigned long)now.tv_sec * 1000000000UL + now.tv_nsec;
+#else
+  return (unsigned long)clock() * (1000000000UL / CLOCKS_PER_SEC);
+#endif
+}
+
+/*
+ * Add a latency of NSECS to the histogram.
+ */
+static	void	latency_add(const unsigned long nsecs)
+{
+  int	bits, bucket;
+  
+  if (nsecs < LATENCY_SUB_N) {
+    bucket = nsecs;
+  }
+  else {
+    bits = 63 - __builtin_clzl(nsecs);
+    bucket = (bits - LATENCY_SUB_BITS + 1) * LATENCY_SUB_N
+      + ((nsecs >> (bits - LATENCY_SUB_BITS)) & (LATENCY_SUB_N - 1));
+  }
+  latency_counts[bucket]++;
+  if (nsecs > latency_max) {
+    latency_max = nsecs;
+  }
+}
+
+/*
+ * Return the upper limit in nano-seconds of the histogram bucket that
+ * holds the PERCENT percentile of the latencies.
+ */
+static	unsigned long	latency_percentile(const double percent)
+{
+  unsigned long	total = 0, want, limit;
+  int		bucket, bits;
+  
+  want = (unsigned long)((double)op_c * percent / 100.0);
+  for (bucket = 0; bucket < LATENCY_BUCKET_N; bucket++) {
+    total += latency_counts[bucket];
+    if (total > want) {
+      break;
+    }
+  }
+  
+  if (bucket < LATENCY_SUB_N) {
+    return bucket;
+  }
+  if (bucket >= LATENCY_BUCKET_N) {
+    return latency_max;
+  }
+  bits = bucket / LATENCY_SUB_N + LATENCY_SUB_BITS - 1;
+  limit = ((unsigned long)(LATENCY_SUB_N + bucket % LATENCY_SUB_N + 1)
+	   << (bits - LATENCY_SUB_BITS)) - 1;
+  if (limit > latency_max) {
+    return latency_max;
+  }
+  return limit;
+}
+
+/*
+ * Return the entry in the pointer table for the RECORDED pointer.  It
+ * is either the entry that holds it or the empty one where it goes.
+ */
+static	pnt_entry_t	*pnt_find(const unsigned long recorded)
+{
+  pnt_entry_t	*entry_p;
+  
+  entry_p = pnt_table + ((recorded >> 4) * 2654435761UL & (pnt_table_n - 1));
+  while (entry_p->pe_recorded != 0 && entry_p->pe_recorded != recorded) {
+    entry_p++;
+    if (entry_p == pnt_table + pnt_table_n) {
+      entry_p = pnt_table;
+    }
+  }
+  return entry_p;
+}
+
+/*
+ * Remove the entry at ENTRY_P from the pointer table and shift back
+ * any of the entries after it that are out of place.
+ */
+static	void	pnt_remove(pnt_entry_t *entry_p)
+{
+  pnt_entry_t	*next_p, *home_p;
+  
+  pnt_c--;
+  next_p = entry_p;
+  for (;;) {
+    next_p++;
+    if (next_p == pnt_table + pnt_table_n) {
+      next_p = pnt_table;
+    }
+    if (next_p->pe_recorded == 0) {
+      break;
+    }
+    home_p = pnt_table + ((next_p->pe_recorded >> 4) * 2654435761UL
+			  & (pnt_table_n - 1));
+    /* can the entry be moved back to the hole at entry_p? */
+    if ((next_p > entry_p && (home_p <= entry_p || home_p > next_p))
+	|| (next_p < entry_p && home_p <= entry_p && home_p > next_p)) {
+      *entry_p = *next_p;
+      entry_p = next_p;
+    }
+  }
+  entry_p->pe_recorded = 0;
+  entry_p->pe_replayed = NULL;
+}
+
+/*
+ * Remember that the RECORDED pointer was replayed as REPLAYED.
+ * Returns 1 on success or 0 if the table is full.
+ */
+static	int	pnt_add(const unsigned long recorded, DMALLOC_PNT replayed)
+{
+  pnt_entry_t	*entry_p;
+  
+  entry_p = pnt_find(recorded);
+  if (entry_p->pe_recorded == 0) {
+    if (pnt_c >= pnt_table_n / 2) {
+      return 0;
+    }
+    pnt_c++;
+  }
+  else {
+    /* the trace missed a free so let the old pointer go */
+    (void)dmalloc_free(REPLAY_FILE, 0, entry_p->pe_replayed,
+		       DMALLOC_FUNC_FREE);
+  }
+  entry_p->pe_recorded = recorded;
+  entry_p->pe_replayed = replayed;
+  return 1;
+}
+
+/*
+ * Count the thread-id of a record if we have not seen it before.
+ */
+static	void	thread_count(const unsigned long thread)
+{
+  int	thread_c2;
+  
+  for (thread_c2 = 0; thread_c2 < thread_c; thread_c2++) {
+    if (thread_ids[thread_c2] == thread) {
+      return;
+    }
+  }
+  if (thread_c < THREAD_MAX) {
+    thread_ids[thread_c++] = thread;
+  }
+}
+
+/*
+ * Replay the transaction in REC_P through the library.
+ */
+static	void	replay_rec(const binlog_rec_t *rec_p)
+{
+  pnt_entry_t	*entry_p;
+  DMALLOC_PNT	pnt;
+  DMALLOC_PNT	old_pnt;
+  unsigned long	start;
+  
+  thread_count(rec_p->br_thread);
+  
+  switch (rec_p->br_op) {
+  
+  case BINLOG_OP_ALLOC:
+    start = nano_now();
+    pnt = dmalloc_malloc(REPLAY_FILE, 0, rec_p->br_size, rec_p->br_func_id,
+			 rec_p->br_align, 0);
+    latency_add(nano_now() - start);
+    op_c++;
+    if (pnt == NULL) {
+      fail_c++;
+    }
+    else if (! pnt_add(rec_p->br_pnt, pnt)) {
+      (void)dmalloc_free(REPLAY_FILE, 0, pnt, DMALLOC_FUNC_FREE);
+      skip_c++;
+    }
+    break;
+  
+  case BINLOG_OP_FREE:
+    entry_p = pnt_find(rec_p->br_pnt);
+    if (entry_p->pe_recorded == 0) {
+      /* allocated before the trace started */
+      skip_c++;
+      break;
+    }
+    start = nano_now();
+    (void)dmalloc_free(REPLAY_FILE, 0, entry_p->pe_replayed,
+		       rec_p->br_func_id);
+    latency_add(nano_now() - start);
+    op_c++;
+    pnt_remove(entry_p);
+    break;
+  
+  case BINLOG_OP_REALLOC:
+    old_pnt = NULL;
+    if (rec_p->br_old_pnt != 0) {
+      entry_p = pnt_find(rec_p->br_old_pnt);
+      if (entry_p->pe_recorded != 0) {
+	old_pnt = entry_p->pe_replayed;
+	pnt_remove(entry_p);
+      }
+    }
+    start = nano_now();
+    pnt = dmalloc_realloc(REPLAY_FILE, 0, old_pnt, rec_p->br_size,
+			  rec_p->br_func_id, 0);
+    latency_add(nano_now() - start);
+    op_c++;
+    if (pnt == NULL) {
+      if (rec_p->br_pnt != 0) {
+	fail_c++;
+      }
+    }
+    else if (! pnt_add(rec_p->br_pnt, pnt)) {
+      (void)dmalloc_free(REPLAY_FILE, 0, pnt, DMALLOC_FUNC_FREE);
+      skip_c++;
+    }
+    break;
+  
+  default:
+    skip_c++;
+    break;
+  }
+}
+
+/*
+ * Replay the trace in INFILE once.  Returns 1 on success or 0 on
+ * failure.
+ */
+static	int	replay_trace(FILE *infile)
+{
+  binlog_header_t	header;
+  binlog_rec_t		recs[READ_RECS], *rec_p, *bounds_p;
+  unsigned long		pad_n = 0;
+  pnt_entry_t		*entry_p;
+  size_t		read_n;
+  
+  if (fread(&header, sizeof(header), 1, infile) != 1
+      || memcmp(header.bh_magic, BINLOG_MAGIC, BINLOG_MAGIC_SIZE) != 0) {
+    loc_fprintf(stderr, "%s: '%s' is not a binary log\n",
+		argv_program, trace_path);
+    return 0;
+  }
+  if (header.bh_version != BINLOG_VERSION
+      || header.bh_byte_order != BINLOG_BYTE_ORDER
+      || header.bh_rec_size != sizeof(binlog_rec_t)) {
+    loc_fprintf(stderr,
+		"%s: binary log '%s' is a different version or from a different system\n",
+		argv_program, trace_path);
+    return 0;
+  }
+  
+  while ((read_n = fread(recs, sizeof(binlog_rec_t), READ_RECS,
+			 infile)) > 0) {
+    bounds_p = recs + read_n;
+    for (rec_p = recs; rec_p < bounds_p; rec_p++) {
+      /* skip the file-names which are padded out to the record size */
+      if (pad_n > 0) {
+	pad_n--;
+      }
+      else if (rec_p->br_op == BINLOG_OP_FILE) {
+	pad_n = (rec_p->br_size + sizeof(binlog_rec_t) - 1)
+	  / sizeof(binlog_rec_t);
+      }
+      else {
+	replay_rec(rec_p);
+      }
+    }
+  }
+  
+  /* free whatever the trace did not */
+  for (entry_p = pnt_table; entry_p < pnt_table + pnt_table_n; entry_p++) {
+    if (entry_p->pe_recorded != 0) {
+      (void)dmalloc_free(REPLAY_FILE, 0, entry_p->pe_replayed,
+			 DMALLOC_FUNC_FREE);
+      entry_p->pe_recorded = 0;
+      entry_p->pe_replayed = NULL;
+    }
+  }
+  pnt_c = 0;
+  
+  return 1;
+}
+
+int	main(int argc, char **argv)
+{
+  FILE			*infile;
+  dmalloc_frag_t	frag;
+  struct rusage		usage;
+  unsigned long		start, elapsed, admin_max = 0, user_max = 0;
+  unsigned long		max_alloc;
+  long			file_size;
+  int			iter_c, final = 0;
+  
+  argv_process(arg_list, argc, argv);
+  
+  if (env_string == NULL) {
+#if GETENV_SAFE == 0
+    dmalloc_debug_setup(getenv("DMALLOC_OPTIONS"));
+#endif
+  }
+  else {
+    dmalloc_debug_setup(env_string);
+  }
+  
+  infile = fopen(trace_path, "rb");
+  if (infile == NULL) {
+    loc_fprintf(stderr, "%s: could not open binary log '%s'\n",
+		argv_program, trace_path);
+    exit(1);
+  }
+  
+  /* there are never more live pointers than records so size the table */
+  (void)fseek(infile, 0L, SEEK_END);
+  file_size = ftell(infile);
+  pnt_table_n = 1024;
+  while (pnt_table_n < (unsigned long)file_size / sizeof(binlog_rec_t) * 2) {
+    pnt_table_n *= 2;
+  }
+  pnt_table = (pnt_entry_t *)calloc(pnt_table_n, sizeof(pnt_entry_t));
+  if (pnt_table == NULL) {
+    loc_fprintf(stderr, "%s: could not allocate pointer table\n",
+		argv_program);
+    exit(1);
+  }
+  
+  start = nano_now();
+  for (iter_c = 0; iter_c < iter_n; iter_c++) {
+    rewind(infile);
+    if (! replay_trace(infile)) {
+      final = 1;
+      break;
+    }
+    dmalloc_get_stats(NULL, NULL, NULL, NULL, NULL, NULL, &max_alloc,
+		      NULL, NULL);
+    if (max_alloc > user_max) {
+      user_max = max_alloc;
+    }
+    dmalloc_get_frag_stats(&frag);
+    if (frag.df_admin_size > admin_max) {
+      admin_max = frag.df_admin_size;
+    }
+  }
+  elapsed = nano_now() - start;
+  (void)fclose(infile);
+  
+  if (final == 0) {
+    if (! silent_b) {
+      loc_printf("Replayed '%s' %d times with: %s\n", trace_path, iter_n,
+		 (env_string == NULL ? "environment" : env_string));
+    }
+    loc_printf("operations %lu, skipped %lu, failed %lu, threads %d\n",
+	       op_c, skip_c, fail_c, thread_c);
+    loc_printf("ops/sec %lu\n",
+	       (elapsed == 0 ? 0UL
+		: (unsigned long)((double)op_c * 1000000000.0 / elapsed)));
+    loc_printf("latency ns p50 %lu p90 %lu p99 %lu p99.9 %lu max %lu\n",
+	       latency_percentile(50.0), latency_percentile(90.0),
+	       latency_percentile(99.0), latency_percentile(99.9),
+	       latency_max);
+    loc_printf("max user bytes %lu, admin bytes %lu (%lu%%)\n",
+	       user_max, admin_max,
+	       (user_max == 0 ? 0UL : admin_max * 100 / user_max));
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+      loc_printf("peak rss %ld kb\n", usage.ru_maxrss);
+    }
+  }
+  
+  free(pnt_table);
+  
+  exit(final);
+}
@@ -45,6 +45,14 @@
 #  include TIME_INCLUDE
 # endif
 #endif
+#if SIGNAL_OKAY && HAVE_SIGNAL_H
+# include <signal.h>				/* for raise */
+#endif
+#if HAVE_POLL_H && HAVE_SYS_SOCKET_H && HAVE_SYS_UN_H
+# include <poll.h>				/* for poll */
+# include <sys/socket.h>			/* for socket, connect */
+# include <sys/un.h>				/* for sockaddr_un */
+#endif
 
 #include "dmalloc.h"
 #include "dmalloc_argv.h"
@@ -54,9 +62,14 @@
 /*
  * NOTE: these are only needed to test certain features of the library.
  */
+#include "binlog_loc.h"				/* for the log format */
+#include "chunk.h"				/* for the top call-sites */
+#include "clock.h"
 #include "debug_tok.h"
+#include "dmalloc_tab.h"			/* for the table entries */
 #include "error_val.h"
 #include "heap.h"				/* for external testing */
+#include "livestats_loc.h"			/* for the live stats format */
 
 #define INTER_CHAR		'i'
 #define DEFAULT_ITERATIONS	10000
@@ -69,6 +82,7 @@
 #define MAX_ALLOC		(1024 * 1024)
 #endif
 #define MIN_AVAIL		10
+#define GLOBAL_PNT_N		8	/* pointers for the leak scan check */
 
 /* pointer tracking structure */
 typedef struct pnt_info_st {
@@ -80,6 +94,9 @@ typedef struct pnt_info_st {
 
 static	pnt_info_t	*pointer_grid;
 
+/* pointers that only a global keeps reachable, not kept in registers */
+static	void		* volatile global_pnts[GLOBAL_PNT_N];
+
 /* argument variables */
 static	long		default_iter_n = DEFAULT_ITERATIONS; /* # of iters */
 static	char		*env_string = NULL;		/* env options */
@@ -208,6 +225,14 @@ static	void	free_slot(const int iter_c, pnt_info_t *slot_p,
   *free_pp = slot_p;
 }
 
+/*
+ * Called with the library locked to see that the call was made
+ */
+static	void	note_locked(void *arg)
+{
+  *(int *)arg = 1;
+}
+
 /*
  * Try ITER_N random program iterations, returns 1 on success else 0
  */
@@ -1576,6 +1601,46 @@ static	int	check_arg_check(void)
   
   /*********/
   
+#if HAVE_STRLEN
+  func = "strlen";
+  if (! silent_b) {
+    loc_printf("    Checking %s\n", func);
+  }
+  
+  /* they should be the same */
+  dmalloc_errno = DMALLOC_ERROR_NONE;
+  memcpy(pnt, "abcd", size);
+  if (_dmalloc_strlen(__FILE__, __LINE__, pnt) != 4) {
+    if (! silent_b) {
+      loc_printf("     ERROR: %s overload failed\n", func);
+    }
+    final = 0;
+  }
+  if (dmalloc_errno != DMALLOC_ERROR_NONE) {
+    if (! silent_b) {
+      loc_printf("     ERROR: %s overload should not get error: %s (%d)\n",
+		 func, dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+    }
+    final = 0;
+  }
+  
+  /* the string runs off the end of the buffer */
+  dmalloc_errno = DMALLOC_ERROR_NONE;
+  hold_ch = *(pnt + size);
+  memcpy(pnt, "abcde", size);
+  /* unknown results */
+  (void)_dmalloc_strlen(__FILE__, __LINE__, pnt);
+  if (dmalloc_errno != DMALLOC_ERROR_WOULD_OVERWRITE) {
+    if (! silent_b) {
+      loc_printf("     ERROR: %s overload should get error\n", func);
+    }
+    final = 0;
+  }
+  *(pnt + size) = hold_ch;
+#endif
+  
+  /*********/
+  
 #if HAVE_STRNCASECMP
   func = "strncasecmp";
   if (! silent_b) {
@@ -1852,6 +1917,78 @@ static	int	check_append_buf(char *buf, char *buf_p, char *expected, int expected
   return final;
 }
 
+/*
+ * Append a format through a cached format descriptor.
+ */
+static	char	*append_desc(char *buf, char *limit, append_format_t *desc_p,
+			     const char *format, ...)
+{
+  va_list	args;
+  char		*buf_p;
+  
+  va_start(args, format);
+  buf_p = append_vformat_desc(buf, limit, desc_p, format, args);
+  va_end(args);
+  return buf_p;
+}
+
+/*
+ * Read a protobuf varint from the buffer at BUF_P into VALUE_P.
+ * Returns the position after it or NULL if it runs past BOUNDS_P.
+ */
+static	const unsigned char	*pb_read_varint(const unsigned char *buf_p,
+						const unsigned char *bounds_p,
+						unsigned long *value_p)
+{
+  int	shift = 0;
+  
+  *value_p = 0;
+  for (; buf_p < bounds_p && shift < 64; shift += 7) {
+    *value_p |= (unsigned long)(*buf_p & 0x7f) << shift;
+    if ((*buf_p++ & 0x80) == 0) {
+      return buf_p;
+    }
+  }
+  return NULL;
+}
+
+/*
+ * Read a protobuf field from the buffer at BUF_P into FIELD_P.  A
+ * varint is put in VALUE_P and a length-delimited field has its
+ * length put in VALUE_P and its data in DATA_PP which is otherwise
+ * NULL.  Returns the position after the field or NULL on an error.
+ */
+static	const unsigned char	*pb_read_field(const unsigned char *buf_p,
+					       const unsigned char *bounds_p,
+					       unsigned long *field_p,
+					       unsigned long *value_p,
+					       const unsigned char **data_pp)
+{
+  unsigned long	key;
+  
+  *data_pp = NULL;
+  buf_p = pb_read_varint(buf_p, bounds_p, &key);
+  if (buf_p == NULL) {
+    return NULL;
+  }
+  *field_p = key >> 3;
+  
+  switch (key & 0x7) {
+  case 0:
+    return pb_read_varint(buf_p, bounds_p, value_p);
+  case 2:
+    buf_p = pb_read_varint(buf_p, bounds_p, value_p);
+    if (buf_p == NULL || *value_p > (unsigned long)(bounds_p - buf_p)) {
+      return NULL;
+    }
+    *data_pp = buf_p;
+    return buf_p + *value_p;
+  default:
+    /* the profile only uses varints and length-delimited fields */
+    return NULL;
+  }
+}
+
 /*
  * Do some special tests, returns 1 on success else 0
  */
@@ -2957,163 +3094,1535 @@ static	int	check_special(void)
   
   /********************/
   
-  /* check all of the arg check routines */
-  if (! check_arg_check()) {
-    final = 0;
-  }
-  
-  /********************/
-  
-  dmalloc_message("NOTE: ignore the errors from the above ----- to here.\n");
-  dmalloc_message("-------------------------------------------------------\n");
-  
-  /*
-   * The following errors whould not generate a dmalloc_errno nor any
-   * error messages
-   */
-  
-  /********************/
-  
   /*
-   * Make sure that realloc of NULL pointers either works or doesn't
-   * depending on the proper ALLOW_REALLOC_NULL setting.
+   * Check the per call-site and per file memory budgets.
    */
-  
   {
+    int		errno_hold = dmalloc_errno;
+    void	*pnt2;
+    
     if (! silent_b) {
-      loc_printf("  Trying to realloc a 0L pointer.\n");
+      loc_printf("  Checking memory budgets\n");
     }
-    pnt = realloc(NULL, 10);
-#if ALLOW_REALLOC_NULL
+    
+    /* use a fake line number so we are the only allocations at the site */
+    if (dmalloc_budget(__FILE__, 9999, 100, DMALLOC_BUDGET_FAIL) != DMALLOC_NOERROR) {
+      if (! silent_b) {
+	loc_printf("   ERROR: could not set the call-site budget.\n");
+      }
+      final = 0;
+    }
+    
+    pnt = dmalloc_malloc(__FILE__, 9999, 60, DMALLOC_FUNC_MALLOC, 0, 0);
     if (pnt == NULL) {
       if (! silent_b) {
-	loc_printf("   ERROR: re-allocation of 0L returned error.\n");
+	loc_printf("   ERROR: allocation under the budget failed.\n");
       }
       final = 0;
     }
-    else {
-      free(pnt);
+    
+    dmalloc_errno = DMALLOC_ERROR_NONE;
+    pnt2 = dmalloc_malloc(__FILE__, 9999, 60, DMALLOC_FUNC_MALLOC, 0, 0);
+    if (pnt2 != NULL || dmalloc_errno != DMALLOC_ERROR_OVER_BUDGET) {
+      if (! silent_b) {
+	loc_printf("   ERROR: allocation over the budget did not fail: %s (err %d)\n",
+		   dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+      }
+      free(pnt2);
+      final = 0;
     }
-#else
-    if (pnt == NULL) {
-      dmalloc_errno = DMALLOC_ERROR_NONE;
+    
+    /* once the first is freed, we should be under the budget again */
+    free(pnt);
+    pnt2 = dmalloc_malloc(__FILE__, 9999, 60, DMALLOC_FUNC_MALLOC, 0, 0);
+    if (pnt2 == NULL) {
+      if (! silent_b) {
+	loc_printf("   ERROR: allocation after free under the budget failed.\n");
+      }
+      final = 0;
     }
-    else {
+    
+    /* growing it in a new block should be credited with the old size */
+    pnt = pnt2;
+    pnt2 = dmalloc_realloc(__FILE__, 9999, pnt, 90, DMALLOC_FUNC_REALLOC, 0);
+    if (pnt2 == NULL) {
       if (! silent_b) {
-	loc_printf("   ERROR: re-allocation of 0L did not return error.\n");
+	loc_printf("   ERROR: realloc under the budget failed: %s (err %d)\n",
+		   dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+      }
+      pnt2 = pnt;
+      final = 0;
+    }
+    else if (pnt2 == pnt) {
+      if (! silent_b) {
+	loc_printf("   ERROR: realloc to 90 bytes did not move the pointer.\n");
+      }
+      final = 0;
+    }
+    
+    /* a file pattern budget should count the existing allocation */
+    (void)dmalloc_budget(__FILE__, 9999, 0, DMALLOC_BUDGET_FAIL);
+    (void)dmalloc_budget("dmalloc_t*", 0, 100, DMALLOC_BUDGET_FAIL);
+    dmalloc_errno = DMALLOC_ERROR_NONE;
+    pnt = malloc(60);
+    if (pnt != NULL || dmalloc_errno != DMALLOC_ERROR_OVER_BUDGET) {
+      if (! silent_b) {
+	loc_printf("   ERROR: allocation over the file budget did not fail: %s (err %d)\n",
+		   dmalloc_strerror(dmalloc_errno), dmalloc_errno);
       }
       free(pnt);
       final = 0;
     }
-#endif
+    
+    (void)dmalloc_budget("dmalloc_t*", 0, 0, DMALLOC_BUDGET_FAIL);
+    free(pnt2);
+    dmalloc_errno = errno_hold;
   }
   
   /********************/
   
   /*
-   * Make sure that valloc returns properly page-aligned memory.
+   * Check writing of the pprof heap profile.  We decode the fields
+   * with the numbers from pprof's profile.proto and not the library's
+   * so that a wrong field number in the library is caught.
    */
-  
   {
-    int			iter_c, amount;
-    unsigned int	old_flags = dmalloc_debug_current();
-    
-    old_env = dmalloc_debug_current_env(env_buf, sizeof(env_buf));
+#define PROFILE_CHECK_SIZE	1234
+#define PROFILE_CHECK_LINE	77
+    const char			*profile_path = "dmalloc_t.prof";
+    const char			*profile_file = "profile_check";
+    const unsigned char		*buf_p, *bounds_p, *data_p, *sub_p, *sub_data_p;
+    const unsigned char		*line_p, *line_data_p;
+    unsigned char		*profile_buf = NULL;
+    unsigned long		field, value, sub_field, sub_value;
+    unsigned long		line_field, line_value, values[4];
+    unsigned long		string_c = 0, file_idx = 0, func_id = 0, loc_id = 0;
+    unsigned long		msg_id, msg_file, line_func_id, line_line, value_c;
+    FILE			*profile_fp;
+    long			profile_size = 0;
+    int				found_b = 0, first_b = 0;
     
     if (! silent_b) {
-      loc_printf("  Testing valloc()\n");
+      loc_printf("  Checking heap profile output\n");
     }
     
-    /*
-     * First check without frence posts
-     */
-    dmalloc_debug(old_flags & ~DMALLOC_DEBUG_CHECK_FENCE);
+    pnt = dmalloc_malloc(profile_file, PROFILE_CHECK_LINE, PROFILE_CHECK_SIZE,
+			 DMALLOC_FUNC_MALLOC, 0, 0);
+    if (dmalloc_profile(profile_path) != DMALLOC_NOERROR) {
+      if (! silent_b) {
+	loc_printf("   ERROR: writing heap profile failed: %s (err %d)\n",
+		   dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+      }
+      final = 0;
+    }
+    free(pnt);
     
-    for (iter_c = 0; iter_c < 20; iter_c++) {
-      do {
-	amount = _dmalloc_rand() % (page_size * 3);
-      } while (amount == 0);
-      pnt = valloc(amount);
-      if (pnt == NULL) {
-	if (! silent_b) {
-	  loc_printf("   ERROR: could not valloc %d bytes.\n", amount);
-	}
-	final = 0;
-	continue;
+    profile_fp = fopen(profile_path, "rb");
+    if (profile_fp != NULL
+	&& fseek(profile_fp, 0, SEEK_END) == 0
+	&& (profile_size = ftell(profile_fp)) > 0
+	&& fseek(profile_fp, 0, SEEK_SET) == 0) {
+      profile_buf = malloc(profile_size);
+      if (profile_buf != NULL
+	  && fread(profile_buf, profile_size, 1, profile_fp) != 1) {
+	free(profile_buf);
+	profile_buf = NULL;
       }
-      if ((PNT_ARITH_TYPE)pnt % page_size != 0) {
-	if (! silent_b) {
-	  loc_printf("   ERROR: valloc got %p which is not page aligned.\n", pnt);
-	}
-	final = 0;
+    }
+    if (profile_fp != NULL) {
+      (void)fclose(profile_fp);
+    }
+    if (profile_buf == NULL) {
+      if (! silent_b) {
+	loc_printf("   ERROR: could not read heap profile '%s'\n", profile_path);
       }
-      free(pnt);
+      profile_size = 0;
+      final = 0;
     }
     
     /*
-     * Now test with fence posts enabled
+     * Each call-site is a function with the file in its filename
+     * string (field 5.4), a location with a line (4.4) which points
+     * to the function (line 1) and has the line number (line 2), and
+     * a sample (field 2) for the location (2.1) with the 4 values
+     * (2.2) of which the last is the in-use bytes.
      */
-    dmalloc_debug(old_flags | DMALLOC_DEBUG_CHECK_FENCE);
-    
-    for (iter_c = 0; iter_c < 20; iter_c++) {
-      do {
-	amount = _dmalloc_rand() % (page_size * 3);
-      } while (amount == 0);
-      pnt = valloc(amount);
-      if (pnt == NULL) {
-	if (! silent_b) {
-	  loc_printf("   ERROR: could not valloc %d bytes.\n", amount);
+    bounds_p = profile_buf + profile_size;
+    for (buf_p = profile_buf; buf_p != NULL && buf_p < bounds_p; ) {
+      buf_p = pb_read_field(buf_p, bounds_p, &field, &value, &data_p);
+      if (buf_p == NULL || data_p == NULL) {
+	continue;
+      }
+      
+      if (field == 6) {
+	/* the string table starts with the empty string */
+	if (string_c == 0 && value == 0) {
+	  first_b = 1;
 	}
-	final = 0;
+	if (value == strlen(profile_file)
+	    && memcmp(data_p, profile_file, value) == 0) {
+	  file_idx = string_c;
+	}
+	string_c++;
 	continue;
       }
-      if ((PNT_ARITH_TYPE)pnt % page_size != 0) {
-	if (! silent_b) {
-	  loc_printf("   ERROR: valloc got %p which is not page aligned.\n", pnt);
+      
+      /* the first field of these messages is the id or the location id */
+      msg_id = 0;
+      msg_file = 0;
+      line_func_id = 0;
+      line_line = 0;
+      value_c = 0;
+      for (sub_p = data_p; sub_p != NULL && sub_p < data_p + value; ) {
+	sub_p = pb_read_field(sub_p, data_p + value, &sub_field, &sub_value,
+			      &sub_data_p);
+	if (sub_p == NULL) {
+	  break;
+	}
+	if (sub_field == 1 && sub_data_p == NULL) {
+	  msg_id = sub_value;
+	}
+	else if (field == 5 && sub_field == 4) {
+	  msg_file = sub_value;
+	}
+	else if (field == 4 && sub_field == 4 && sub_data_p != NULL) {
+	  for (line_p = sub_data_p;
+	       line_p != NULL && line_p < sub_data_p + sub_value; ) {
+	    line_p = pb_read_field(line_p, sub_data_p + sub_value, &line_field,
+				   &line_value, &line_data_p);
+	    if (line_p != NULL && line_field == 1) {
+	      line_func_id = line_value;
+	    }
+	    else if (line_p != NULL && line_field == 2) {
+	      line_line = line_value;
+	    }
+	  }
+	}
+	else if (field == 2 && sub_field == 2 && value_c < 4) {
+	  values[value_c++] = sub_value;
 	}
-	final = 0;
       }
-      free(pnt);
+      
+      if (field == 5 && file_idx > 0 && msg_file == file_idx) {
+	func_id = msg_id;
+      }
+      else if (field == 4 && func_id > 0 && line_func_id == func_id
+	       && line_line == PROFILE_CHECK_LINE) {
+	loc_id = msg_id;
+      }
+      else if (field == 2 && loc_id > 0 && msg_id == loc_id
+	       && value_c == 4 && values[2] == 1
+	       && values[3] == PROFILE_CHECK_SIZE) {
+	found_b = 1;
+      }
     }
     
-    dmalloc_debug_setup(old_env);
+    if (profile_buf != NULL && ! (first_b && found_b)) {
+      if (! silent_b) {
+	loc_printf("   ERROR: heap profile has no sample of %d in-use bytes "
+		   "at %s:%d\n", PROFILE_CHECK_SIZE, profile_file,
+		   PROFILE_CHECK_LINE);
+      }
+      final = 0;
+    }
+    if (profile_buf != NULL) {
+      free(profile_buf);
+    }
+#if HAVE_UNISTD_H
+    (void)unlink(profile_path);
+#endif
   }
   
   /********************/
   
   /*
-   * Make sure that the blanking flags actually blank all of the
-   * allocated pointer space.
+   * Check that a heap snapshot has the pointer that we allocated with
+   * its size and the name of this file.
    */
-  
   {
-    char		*alloc_p;
-    unsigned int	iter_c, amount;
-    unsigned int	old_flags = dmalloc_debug_current();
+    const char		*snap_path = "dmalloc_t.snap";
+    snapshot_header_t	header;
+    snapshot_rec_t	rec;
+    FILE		*snap_fp;
+    int			found_b = 0, name_b = 0;
     
     if (! silent_b) {
-      loc_printf("  Checking alloc blanking\n");
+      loc_printf("  Checking heap snapshot\n");
     }
     
-    old_env = dmalloc_debug_current_env(env_buf, sizeof(env_buf));
-    /* turn on alloc blanking without fence posts */
-    dmalloc_debug((old_flags | DMALLOC_DEBUG_ALLOC_BLANK) & (~DMALLOC_DEBUG_CHECK_FENCE));
+    pnt = malloc(123);
+    if (dmalloc_snapshot(snap_path) != DMALLOC_NOERROR) {
+      if (! silent_b) {
+	loc_printf("   ERROR: writing heap snapshot failed: %s (err %d)\n",
+		   dmalloc_strerror(dmalloc_errno), dmalloc_errno);
+      }
+      final = 0;
+    }
     
-    for (iter_c = 0; iter_c < 20; iter_c++) {
-      do {
-	amount = _dmalloc_rand() % (page_size * 3);
-      } while (amount == 0);
-      pnt = malloc(amount);
-      if (pnt == NULL) {
+    snap_fp = fopen(snap_path, "rb");
+    if (snap_fp == NULL
+	|| fread(&header, sizeof(header), 1, snap_fp) != 1
+	|| memcmp(header.sh_magic, SNAPSHOT_MAGIC, BINLOG_MAGIC_SIZE) != 0
+	|| header.sh_rec_size != sizeof(snapshot_rec_t)) {
+      if (! silent_b) {
+	loc_printf("   ERROR: heap snapshot '%s' has a bad header\n",
+		   snap_path);
+      }
+      final = 0;
+    }
+    else {
+      while (fread(&rec, sizeof(rec), 1, snap_fp) == 1) {
+	if (rec.sr_pnt == (PNT_ARITH_TYPE)pnt && rec.sr_size == 123
+	    && rec.sr_total_size >= 123) {
+	  found_b = 1;
+	}
+	else if (rec.sr_pnt == 0) {
+	  /* the file-name is padded out to the record size */
+	  char	name[MAX_FILE_LENGTH + sizeof(rec)];
+	  int	rec_n = (rec.sr_size + sizeof(rec) - 1) / sizeof(rec);
+	  
+	  if (rec.sr_size >= sizeof(name)
+	      || fread(name, sizeof(rec), rec_n, snap_fp) != rec_n) {
+	    break;
+	  }
+	  name[rec.sr_size] = '\0';
+	  if (strstr(name, "dmalloc_t.c") != NULL) {
+	    name_b = 1;
+	  }
+	}
+      }
+      if (! (found_b && name_b)) {
 	if (! silent_b) {
-	  loc_printf("   ERROR: could not allocate %d bytes.\n", amount);
+	  loc_printf("   ERROR: heap snapshot is missing %s\n",
+		     (found_b ? "the file-name" : "the pointer"));
 	}
 	final = 0;
-	continue;
       }
-      for (alloc_p = pnt; alloc_p < (char *)pnt + amount; alloc_p++) {
-	if (*alloc_p != ALLOC_BLANK_CHAR) {
-	  if (! silent_b) {
+    }
+    if (snap_fp != NULL) {
+      (void)fclose(snap_fp);
+    }
+    free(pnt);
+#if HAVE_UNISTD_H
+    (void)unlink(snap_path);
+#endif
+  }
+  
+  /********************/
+  
+  /*
+   * Check that pointers kept in a global are reachable and that they
+   * are reported as unreachable once the global no longer points to
+   * them.  An old copy of a freed pointer with the same address might
+   * keep one of them reachable so we only need one to be reported.
+   */
+  {
+    volatile PNT_ARITH_TYPE	hidden[GLOBAL_PNT_N];
+    int				pnt_c, base_n, kept_n, lost_n;
+    
+    if (! silent_b) {
+      loc_printf("  Checking unreachable pointers\n");
+    }
+    
+    base_n = dmalloc_log_unreachable();
+    for (pnt_c = 0; pnt_c < GLOBAL_PNT_N; pnt_c++) {
+      global_pnts[pnt_c] = malloc(57);
+    }
+    kept_n = dmalloc_log_unreachable();
+    
+    /* keep the pointers where the scan will not see them to free them */
+    for (pnt_c = 0; pnt_c < GLOBAL_PNT_N; pnt_c++) {
+      hidden[pnt_c] = ~(PNT_ARITH_TYPE)global_pnts[pnt_c];
+      global_pnts[pnt_c] = NULL;
+    }
+    lost_n = dmalloc_log_unreachable();
+    
+    if (base_n < 0) {
+      if (! silent_b) {
+	loc_printf("   NOTE: leak scan is not available here\n");
+      }
+    }
+    else if (kept_n != base_n || lost_n <= base_n
+	     || lost_n > base_n + GLOBAL_PNT_N) {
+      if (! silent_b) {
+	loc_printf("   ERROR: unreachable counts %d, %d, %d are wrong\n",
+		   base_n, kept_n, lost_n);
+      }
+      final = 0;
+    }
+    for (pnt_c = 0; pnt_c < GLOBAL_PNT_N; pnt_c++) {
+      free((void *)~hidden[pnt_c]);
+    }
+  }
+  
+  /********************/
+  
+  /*
+   * Check that the records of the binary log, which hold the pointers
+   * that were allocated, do not keep them reachable.
+   */
+  {
+    const char			*binlog_path = "dmalloc_t.blog", *old_env;
+    char			env_buf[256], new_env[512];
+    volatile PNT_ARITH_TYPE	hidden[GLOBAL_PNT_N];
+    int				pnt_c, base_n, lost_n;
+    
+    if (! silent_b) {
+      loc_printf("  Checking unreachable pointers with the binary log\n");
+    }
+    
+    old_env = dmalloc_debug_current_env(env_buf, sizeof(env_buf));
+    if (old_env == NULL || *old_env == '\0') {
+      (void)loc_snprintf(new_env, sizeof(new_env), "binlog=%s", binlog_path);
+    }
+    else {
+      (void)loc_snprintf(new_env, sizeof(new_env), "%s,binlog=%s", old_env,
+			 binlog_path);
+    }
+    dmalloc_debug_setup(new_env);
+    
+    base_n = dmalloc_log_unreachable();
+    for (pnt_c = 0; pnt_c < GLOBAL_PNT_N; pnt_c++) {
+      hidden[pnt_c] = ~(PNT_ARITH_TYPE)malloc(59);
+    }
+    lost_n = dmalloc_log_unreachable();
+    
+    if (base_n >= 0 && lost_n <= base_n) {
+      if (! silent_b) {
+	loc_printf("   ERROR: %d of %d pointers reported with the binary log\n",
+		   lost_n - base_n, GLOBAL_PNT_N);
+      }
+      final = 0;
+    }
+    for (pnt_c = 0; pnt_c < GLOBAL_PNT_N; pnt_c++) {
+      free((void *)~hidden[pnt_c]);
+    }
+    dmalloc_debug_setup(old_env);
+    (void)unlink(binlog_path);
+  }
+  
+  /********************/
+  
+  /*
+   * Check that the pointers which were just verified, and which the
+   * library caches, do not keep them reachable.
+   */
+  {
+    volatile PNT_ARITH_TYPE	hidden[GLOBAL_PNT_N];
+    int				pnt_c, base_n, lost_n;
+    
+    if (! silent_b) {
+      loc_printf("  Checking unreachable pointers after verifying them\n");
+    }
+    
+    base_n = dmalloc_log_unreachable();
+    for (pnt_c = 0; pnt_c < GLOBAL_PNT_N; pnt_c++) {
+      hidden[pnt_c] = ~(PNT_ARITH_TYPE)malloc(59);
+    }
+    for (pnt_c = 0; pnt_c < GLOBAL_PNT_N; pnt_c++) {
+      (void)dmalloc_verify_pnt(__FILE__, __LINE__, "verify",
+			       (void *)~hidden[pnt_c], 1 /* exact */, 0);
+    }
+    lost_n = dmalloc_log_unreachable();
+    
+    /* one might still be seen on the stack */
+    if (base_n >= 0 && lost_n - base_n < GLOBAL_PNT_N - 1) {
+      if (! silent_b) {
+	loc_printf("   ERROR: %d of %d verified pointers reported\n",
+		   lost_n - base_n, GLOBAL_PNT_N);
+      }
+      final = 0;
+    }
+    for (pnt_c = 0; pnt_c < GLOBAL_PNT_N; pnt_c++) {
+      free((void *)~hidden[pnt_c]);
+    }
+  }
+  
+  /********************/
+  
+  /*
+   * Check that dmalloc_verify_many finds the good pointers in an
+   * unsorted array that is longer than one of its batches and reports
+   * the bad ones in their places.
+   */
+  {
+#define MANY_PNT_N	2500
+    int		errno_hold = dmalloc_errno;
+    void	**pnts, *hold, *hold_null;
+    int		*results, pnt_c, swap_c, bad_c;
+    
+    if (! silent_b) {
+      loc_printf("  Checking verification of many pointers\n");
+    }
+    
+    pnts = malloc(sizeof(*pnts) * MANY_PNT_N);
+    results = malloc(sizeof(*results) * MANY_PNT_N);
+    if (pnts == NULL || results == NULL) {
+      if (! silent_b) {
+	loc_printf("   ERROR: could not allocate the pointer arrays\n");
+      }
+      return 0;
+    }
+    for (pnt_c = 0; pnt_c < MANY_PNT_N; pnt_c++) {
+      pnts[pnt_c] = malloc(1 + _dmalloc_rand() % 100);
+    }
+    for (pnt_c = MANY_PNT_N - 1; pnt_c > 0; pnt_c--) {
+      swap_c = _dmalloc_rand() % (pnt_c + 1);
+      hold = pnts[pnt_c];
+      pnts[pnt_c] = pnts[swap_c];
+      pnts[swap_c] = hold;
+    }
+    
+    if (dmalloc_verify_many((const DMALLOC_PNT *)pnts, MANY_PNT_N, results)
+	!= DMALLOC_VERIFY_NOERROR) {
+      if (! silent_b) {
+	loc_printf("   ERROR: verifying %d good pointers failed\n",
+		   MANY_PNT_N);
+      }
+      final = 0;
+    }
+    
+    /* one pointer inside of a block and a NULL which is okay */
+    hold = pnts[MANY_PNT_N / 2];
+    pnts[MANY_PNT_N / 2] = (char *)hold + 1;
+    hold_null = pnts[MANY_PNT_N / 3];
+    pnts[MANY_PNT_N / 3] = NULL;
+    dmalloc_errno = DMALLOC_ERROR_NONE;
+    if (dmalloc_verify_many((const DMALLOC_PNT *)pnts, MANY_PNT_N, results)
+	!= DMALLOC_VERIFY_ERROR) {
+      if (! silent_b) {
+	loc_printf("   ERROR: verifying a bad pointer should fail\n");
+      }
+      final = 0;
+    }
+    bad_c = 0;
+    for (pnt_c = 0; pnt_c < MANY_PNT_N; pnt_c++) {
+      if (results[pnt_c] != DMALLOC_VERIFY_NOERROR) {
+	bad_c++;
+      }
+    }
+    if (bad_c != 1 || results[MANY_PNT_N / 2] != DMALLOC_VERIFY_ERROR) {
+      if (! silent_b) {
+	loc_printf("   ERROR: %d pointers were bad instead of just index %d\n",
+		   bad_c, MANY_PNT_N / 2);
+      }
+      final = 0;
+    }
+    pnts[MANY_PNT_N / 2] = hold;
+    pnts[MANY_PNT_N / 3] = hold_null;
+    
+    for (pnt_c = 0; pnt_c < MANY_PNT_N; pnt_c++) {
+      free(pnts[pnt_c]);
+    }
+    free(pnts);
+    free(results);
+    dmalloc_errno = errno_hold;
+  }
+  
+  /********************/
+  
+  /*
+   * Check the fragmentation report.
+   */
+  {
+    dmalloc_frag_t	frag;
+    
+    if (! silent_b) {
+      loc_printf("  Checking fragmentation report\n");
+    }
+    
+    pnt = malloc(100);
+    dmalloc_get_frag_stats(&frag);
+    if (frag.df_divided_n <= 0
+	|| frag.df_user_size < 100
+	|| frag.df_admin_size == 0) {
+      if (! silent_b) {
+	loc_printf("   ERROR: bad fragmentation report: %d classes, %lu user bytes, %lu admin bytes\n",
+		   frag.df_divided_n, frag.df_user_size, frag.df_admin_size);
+      }
+      final = 0;
+    }
+    free(pnt);
+  }
+  
+  /********************/
+  
+  /*
+   * Check the lock information which is all 0 without threads.
+   */
+  {
+    dmalloc_lock_t	lock;
+    
+    if (! silent_b) {
+      loc_printf("  Checking lock information\n");
+    }
+    
+    memset(&lock, 1, sizeof(lock));
+    dmalloc_get_lock_stats(&lock);
+    if (lock.dl_lock_c != 0
+	|| lock.dl_wait_c != 0
+	|| lock.dl_hold_nsecs != 0) {
+      if (! silent_b) {
+	loc_printf("   ERROR: lock information should be 0 not %lu locks, %lu waits\n",
+		   lock.dl_lock_c, lock.dl_wait_c);
+      }
+      final = 0;
+    }
+  }
+  
+  /********************/
+  
+  /*
+   * Check the feature cost information.
+   */
+  {
+    dmalloc_cost_t	before, after;
+    unsigned int	old_flags = dmalloc_debug_current();
+    char		*pnt;
+    
+    if (! silent_b) {
+      loc_printf("  Checking feature cost information\n");
+    }
+    
+    dmalloc_debug(old_flags | DMALLOC_DEBUG_CHECK_FENCE);
+    dmalloc_get_cost_stats(&before);
+    
+    pnt = malloc(100);
+    (void)dmalloc_verify(NULL);
+    free(pnt);
+    
+    dmalloc_get_cost_stats(&after);
+    dmalloc_debug(old_flags);
+    
+    if (after.dc_map_c == 0 || after.dc_map_size == 0) {
+      if (! silent_b) {
+	loc_printf("   ERROR: heap should have been mapped %lu times\n",
+		   after.dc_map_c);
+      }
+      final = 0;
+    }
+#if LOG_COST_CYCLES
+    if (after.dc_calls[DMALLOC_COST_FENCE_WRITE]
+	<= before.dc_calls[DMALLOC_COST_FENCE_WRITE]
+	|| after.dc_calls[DMALLOC_COST_FENCE_CHECK]
+	<= before.dc_calls[DMALLOC_COST_FENCE_CHECK]
+	|| after.dc_calls[DMALLOC_COST_HEAP_CHECK]
+	<= before.dc_calls[DMALLOC_COST_HEAP_CHECK]
+	|| after.dc_calls[DMALLOC_COST_SKIP]
+	<= before.dc_calls[DMALLOC_COST_SKIP]) {
+      if (! silent_b) {
+	loc_printf("   ERROR: feature costs should have been counted\n");
+      }
+      final = 0;
+    }
+#endif
+  }
+  
+  /********************/
+  
+  /*
+   * Check the extended statistics.
+   */
+  {
+    dmalloc_stats_t	stats;
+    unsigned long	cur_pnts, old_malloc_c;
+    char		*pnt;
+    
+    if (! silent_b) {
+      loc_printf("  Checking extended statistics\n");
+    }
+    
+    memset(&stats, 0, sizeof(stats));
+    if (dmalloc_get_stats_ex(&stats, sizeof(stats)) != DMALLOC_NOERROR
+	|| stats.ds_version != DMALLOC_STATS_VERSION
+	|| stats.ds_size != sizeof(stats)) {
+      if (! silent_b) {
+	loc_printf("   ERROR: extended statistics failed or wrong version %u\n",
+		   stats.ds_version);
+      }
+      final = 0;
+    }
+    old_malloc_c = stats.ds_malloc_c;
+    
+    pnt = malloc(100);
+    dmalloc_get_stats(NULL, NULL, NULL, NULL, NULL, &cur_pnts, NULL, NULL,
+		      NULL);
+    (void)dmalloc_get_stats_ex(&stats, sizeof(stats));
+    if (stats.ds_alloc_cur_pnts != cur_pnts
+	|| stats.ds_malloc_c != old_malloc_c + 1
+	|| stats.ds_alloc_current < 100
+	|| stats.ds_user_block_c == 0) {
+      if (! silent_b) {
+	loc_printf("   ERROR: extended statistics has %lu pointers not %lu\n",
+		   stats.ds_alloc_cur_pnts, cur_pnts);
+      }
+      final = 0;
+    }
+    free(pnt);
+    
+    /* an older and smaller structure should only be partially filled */
+    memset(&stats, 0, sizeof(stats));
+    if (dmalloc_get_stats_ex(&stats, sizeof(unsigned int) * 2)
+	!= DMALLOC_NOERROR
+	|| stats.ds_size != sizeof(unsigned int) * 2
+	|| stats.ds_iter_c != 0) {
+      if (! silent_b) {
+	loc_printf("   ERROR: extended statistics filled too much\n");
+      }
+      final = 0;
+    }
+    if (dmalloc_get_stats_ex(&stats, 1) != DMALLOC_ERROR) {
+      if (! silent_b) {
+	loc_printf("   ERROR: extended statistics should reject a small size\n");
+      }
+      final = 0;
+    }
+  }
+  
+  /********************/
+  
+#if MEMORY_TABLE_TOP_LOG && MEMORY_TABLE_MAX_SIZE > MEMORY_TABLE_SIZE
+  /*
+   * Check that the memory table grows when more call-sites than fit
+   * in its first size are used instead of lumping them into the
+   * other-pointers entry and that the top call-sites come out in order.
+   */
+  {
+#define TABLE_SITE_N	(MEMORY_TABLE_SIZE + 1000)
+#define TABLE_TOP_N	(TABLE_SITE_N * 2)
+    static void		*site_pnts[TABLE_SITE_N];
+    static mem_entry_t	*all_top[TABLE_TOP_N];
+    const char		*site_file = "table_grow_check";
+    mem_entry_t		*some_top[10], *entry_p;
+    dmalloc_stats_t	stats;
+    int			site_c, top_c, some_c, found_c = 0, order_b = 1;
+    
+    if (! silent_b) {
+      loc_printf("  Checking memory table growth and top call-sites\n");
+    }
+    
+    /* each fake line gets its own size so we can check their entries */
+    for (site_c = 0; site_c < TABLE_SITE_N; site_c++) {
+      site_pnts[site_c] = dmalloc_malloc(site_file, site_c + 1,
+					 site_c % 100 + 1,
+					 DMALLOC_FUNC_MALLOC, 0, 0);
+    }
+    
+    (void)dmalloc_get_stats_ex(&stats, sizeof(stats));
+    if (stats.ds_table_entry_n <= MEMORY_TABLE_SIZE * 2
+	|| stats.ds_table_in_use_c < TABLE_SITE_N) {
+      if (! silent_b) {
+	loc_printf("   ERROR: table has %lu of %lu entries in use after %d sites\n",
+		   stats.ds_table_in_use_c, stats.ds_table_entry_n,
+		   TABLE_SITE_N);
+      }
+      final = 0;
+    }
+    
+    top_c = _dmalloc_chunk_top_entries(all_top, TABLE_TOP_N);
+    for (site_c = 0; site_c < top_c; site_c++) {
+      entry_p = all_top[site_c];
+      if (site_c > 0
+	  && all_top[site_c - 1]->me_total_size < entry_p->me_total_size) {
+	order_b = 0;
+      }
+      if (entry_p->me_file == site_file
+	  && entry_p->me_line >= 1 && entry_p->me_line <= TABLE_SITE_N
+	  && entry_p->me_total_size == (entry_p->me_line - 1) % 100 + 1
+	  && entry_p->me_total_c == 1) {
+	found_c++;
+      }
+    }
+    if (found_c != TABLE_SITE_N) {
+      if (! silent_b) {
+	loc_printf("   ERROR: found %d of the %d call-sites in the table\n",
+		   found_c, TABLE_SITE_N);
+      }
+      final = 0;
+    }
+    
+    /* the heap selection of a few should match the start of all of them */
+    some_c = _dmalloc_chunk_top_entries(some_top, 10);
+    if (some_c != 10) {
+      order_b = 0;
+    }
+    for (site_c = 0; site_c < some_c; site_c++) {
+      if (some_top[site_c]->me_total_size != all_top[site_c]->me_total_size) {
+	order_b = 0;
+      }
+    }
+    if (! order_b) {
+      if (! silent_b) {
+	loc_printf("   ERROR: top call-sites are not in total-size order\n");
+      }
+      final = 0;
+    }
+    
+    for (site_c = 0; site_c < TABLE_SITE_N; site_c++) {
+      free(site_pnts[site_c]);
+    }
+  }
+#endif
+  
+#if MEMORY_TABLE_TOP_LOG && MEMORY_TABLE_HISTOGRAMS
+  /*
+   * Check that the size and lifetimes of a pointer land in the right
+   * buckets of its memory table entry's histograms.
+   */
+  {
+#define HIST_SIZE	(1024 * 1024)
+#define HIST_ITER_N	100
+    mem_entry_t		*entry_p;
+    const char		*hist_file = "histogram_check";
+    unsigned int	old_flags = dmalloc_debug_current();
+    unsigned long	bucket_c, hist_c;
+    int			iter_c;
+    void		*pnt, *pnt2;
+#if LOG_PNT_TIMEVAL
+    unsigned long	before, after, inside, outside, min_c, max_c;
+#endif
+    
+    if (! silent_b) {
+      loc_printf("  Checking memory table histograms\n");
+    }
+    
+#if LOG_PNT_TIMEVAL
+    /* the time of the pointer is only stored with one of these */
+    dmalloc_debug(old_flags | DMALLOC_DEBUG_LOG_ELAPSED_TIME);
+    before = _dmalloc_clock_nanos();
+#endif
+    pnt = dmalloc_malloc(hist_file, 1, HIST_SIZE, DMALLOC_FUNC_MALLOC, 0, 0);
+#if LOG_PNT_TIMEVAL
+    after = _dmalloc_clock_nanos();
+#if HAVE_UNISTD_H
+    /* a second puts it well past the sizes' last bucket */
+    (void)sleep(1);
+#endif
+#endif
+    
+    /* each of these is 2 iterations and the free is 1 more */
+    for (iter_c = 0; iter_c < HIST_ITER_N; iter_c++) {
+      pnt2 = malloc(10);
+      free(pnt2);
+    }
+    
+#if LOG_PNT_TIMEVAL
+    inside = _dmalloc_clock_nanos() - after;
+#endif
+    dmalloc_free(hist_file, 1, pnt, DMALLOC_FUNC_FREE);
+#if LOG_PNT_TIMEVAL
+    outside = _dmalloc_clock_nanos() - before;
+    dmalloc_debug(old_flags);
+#endif
+    
+    entry_p = _dmalloc_chunk_find_entry(hist_file, 1);
+    if (entry_p == NULL) {
+      if (! silent_b) {
+	loc_printf("   ERROR: could not find the histogram call-site\n");
+      }
+      final = 0;
+    }
+    else {
+      /* the size is too large so it goes in the last bucket */
+      hist_c = 0;
+      for (bucket_c = 0; bucket_c < MEM_HISTOGRAM_N; bucket_c++) {
+	hist_c += entry_p->me_size_hist[bucket_c];
+      }
+      if (hist_c != 1 || entry_p->me_size_hist[MEM_HISTOGRAM_N - 1] != 1) {
+	if (! silent_b) {
+	  loc_printf("   ERROR: size %d was not in the last bucket\n",
+		     HIST_SIZE);
+	}
+	final = 0;
+      }
+      
+      /* 2 * HIST_ITER_N + 1 is in the 128 to 255 bucket */
+      hist_c = 0;
+      for (bucket_c = 0; bucket_c < MEM_HISTOGRAM_N; bucket_c++) {
+	hist_c += entry_p->me_iter_hist[bucket_c];
+      }
+      if (hist_c != 1 || entry_p->me_iter_hist[7] != 1) {
+	if (! silent_b) {
+	  loc_printf("   ERROR: life of %d iterations was not in bucket 7\n",
+		     HIST_ITER_N * 2 + 1);
+	}
+	final = 0;
+      }
+      
+#if LOG_PNT_TIMEVAL
+      /* the life in usecs is between the times inside and outside */
+      for (min_c = 0, inside /= 1000; inside > 1; min_c++) {
+	inside >>= 1;
+      }
+      for (max_c = 0, outside /= 1000; outside > 1; max_c++) {
+	outside >>= 1;
+      }
+      hist_c = 0;
+      for (bucket_c = 0; bucket_c < MEM_HISTOGRAM_USEC_N; bucket_c++) {
+	hist_c += entry_p->me_usec_hist[bucket_c];
+	if (entry_p->me_usec_hist[bucket_c] > 0
+	    && (bucket_c < min_c || bucket_c > max_c)) {
+	  hist_c = 0;
+	  break;
+	}
+      }
+      if (hist_c != 1) {
+	if (! silent_b) {
+	  loc_printf("   ERROR: life in usecs was not in buckets %lu to %lu\n",
+		     min_c, max_c);
+	}
+	final = 0;
+      }
+#endif
+    }
+  }
+#endif
+  
+  /********************/
+  
+  /*
+   * Check writing of the binary transaction log.
+   */
+  {
+    const char		*binlog_path = "dmalloc_t.blog", *old_env;
+    char		env_buf[256], new_env[512];
+    FILE		*binlog_fp;
+    binlog_header_t	header;
+    binlog_rec_t	rec;
+    int			alloc_c = 0, free_c = 0;
+    
+    if (! silent_b) {
+      loc_printf("  Checking binary transaction log\n");
+    }
+    
+    old_env = dmalloc_debug_current_env(env_buf, sizeof(env_buf));
+    if (old_env == NULL || *old_env == '\0') {
+      (void)loc_snprintf(new_env, sizeof(new_env), "binlog=%s", binlog_path);
+    }
+    else {
+      (void)loc_snprintf(new_env, sizeof(new_env), "%s,binlog=%s", old_env,
+			 binlog_path);
+    }
+    dmalloc_debug_setup(new_env);
+    pnt = malloc(123);
+    free(pnt);
+    /* this turns off the log which writes out the records */
+    dmalloc_debug_setup(old_env);
+    
+    binlog_fp = fopen(binlog_path, "rb");
+    if (binlog_fp == NULL) {
+      if (! silent_b) {
+	loc_printf("   ERROR: could not open binary log '%s'\n", binlog_path);
+      }
+      final = 0;
+    }
+    else {
+      if (fread(&header, sizeof(header), 1, binlog_fp) != 1
+	  || memcmp(header.bh_magic, BINLOG_MAGIC, BINLOG_MAGIC_SIZE) != 0
+	  || header.bh_rec_size != sizeof(binlog_rec_t)) {
+	if (! silent_b) {
+	  loc_printf("   ERROR: binary log has a bad header\n");
+	}
+	final = 0;
+      }
+      else {
+	while (fread(&rec, sizeof(rec), 1, binlog_fp) == 1) {
+	  if (rec.br_op == BINLOG_OP_FILE) {
+	    /* skip over the file-name */
+	    (void)fseek(binlog_fp, (rec.br_size + sizeof(rec) - 1)
+			/ sizeof(rec) * sizeof(rec), SEEK_CUR);
+	  }
+	  else if (rec.br_op == BINLOG_OP_ALLOC && rec.br_size == 123) {
+	    alloc_c++;
+	  }
+	  else if (rec.br_op == BINLOG_OP_FREE && rec.br_size == 123) {
+	    free_c++;
+	  }
+	}
+	if (alloc_c != 1 || free_c != 1) {
+	  if (! silent_b) {
+	    loc_printf("   ERROR: binary log has %d allocs and %d frees not 1\n",
+		       alloc_c, free_c);
+	  }
+	  final = 0;
+	}
+      }
+      (void)fclose(binlog_fp);
+    }
+#if HAVE_UNISTD_H
+    (void)unlink(binlog_path);
+#endif
+  }
+  
+  /********************/
+  
+#if HAVE_MMAP
+  /*
+   * Check that the flight recorder keeps the most recent transactions.
+   */
+  {
+    const char		*flight_path = "dmalloc_t.flt", *old_env;
+    char		env_buf[256], new_env[512];
+    FILE		*flight_fp;
+    flight_header_t	header;
+    binlog_rec_t	rec;
+    int			iter_c;
+    
+    if (! silent_b) {
+      loc_printf("  Checking flight recorder\n");
+    }
+    
+    old_env = dmalloc_debug_current_env(env_buf, sizeof(env_buf));
+    if (old_env == NULL || *old_env == '\0') {
+      (void)loc_snprintf(new_env, sizeof(new_env), "flight=%s:8",
+			 flight_path);
+    }
+    else {
+      (void)loc_snprintf(new_env, sizeof(new_env), "%s,flight=%s:8", old_env,
+			 flight_path);
+    }
+    dmalloc_debug_setup(new_env);
+    /* more transactions than the ring holds so it wraps */
+    for (iter_c = 0; iter_c < 10; iter_c++) {
+      pnt = malloc(77);
+      free(pnt);
+    }
+    
+    /* read the file while it is still mapped like after a crash */
+    flight_fp = fopen(flight_path, "rb");
+    if (flight_fp == NULL) {
+      if (! silent_b) {
+	loc_printf("   ERROR: could not open flight recorder '%s'\n",
+		   flight_path);
+      }
+      final = 0;
+    }
+    else {
+      if (fread(&header, sizeof(header), 1, flight_fp) != 1
+	  || memcmp(header.fh_magic, FLIGHT_MAGIC, BINLOG_MAGIC_SIZE) != 0
+	  || header.fh_rec_size != sizeof(binlog_rec_t)
+	  || header.fh_rec_n != 9
+	  || header.fh_written_c < 20) {
+	if (! silent_b) {
+	  loc_printf("   ERROR: flight recorder has a bad header\n");
+	}
+	final = 0;
+      }
+      else {
+	/* the 20th record is our last free, fopen may have allocated since */
+	(void)fseek(flight_fp, header.fh_name_n * header.fh_name_size
+		    + (20 - 1) % header.fh_rec_n * sizeof(rec), SEEK_CUR);
+	if (fread(&rec, sizeof(rec), 1, flight_fp) != 1
+	    || rec.br_op != BINLOG_OP_FREE
+	    || rec.br_pnt != (PNT_ARITH_TYPE)pnt
+	    || rec.br_size != 77) {
+	  if (! silent_b) {
+	    loc_printf("   ERROR: flight recorder does not have the last free\n");
+	  }
+	  final = 0;
+	}
+      }
+      (void)fclose(flight_fp);
+    }
+    
+    /* this unmaps the flight recorder */
+    dmalloc_debug_setup(old_env);
+#if HAVE_UNISTD_H
+    (void)unlink(flight_path);
+#endif
+  }
+#endif
+  
+#if HAVE_MMAP
+  /*
+   * Check that the live statistics file is written by the library and
+   * removed when the option is turned off.
+   */
+  {
+    const char		*live_path = "dmalloc_t.live", *old_env;
+    char		env_buf[256], new_env[512];
+    FILE		*live_fp;
+    live_header_t	header;
+    
+    if (! silent_b) {
+      loc_printf("  Checking live statistics\n");
+    }
+    
+    old_env = dmalloc_debug_current_env(env_buf, sizeof(env_buf));
+    if (old_env == NULL || *old_env == '\0') {
+      (void)loc_snprintf(new_env, sizeof(new_env), "livestats=%s", live_path);
+    }
+    else {
+      (void)loc_snprintf(new_env, sizeof(new_env), "%s,livestats=%s", old_env,
+			 live_path);
+    }
+    dmalloc_debug_setup(new_env);
+    /* the first call after the setup writes the file */
+    pnt = malloc(55);
+    free(pnt);
+    
+    live_fp = fopen(live_path, "rb");
+    if (live_fp == NULL) {
+      if (! silent_b) {
+	loc_printf("   ERROR: could not open live statistics '%s'\n",
+		   live_path);
+      }
+      final = 0;
+    }
+    else {
+      if (fread(&header, sizeof(header), 1, live_fp) != 1
+	  || memcmp(header.lh_magic, LIVE_MAGIC, LIVE_MAGIC_SIZE) != 0
+	  || header.lh_version != LIVE_VERSION
+	  || header.lh_size != sizeof(header)
+	  || header.lh_seq % 2 != 0
+#if HAVE_GETPID
+	  || header.lh_pid != (unsigned long)getpid()
+#endif
+	  || header.lh_stats.ds_malloc_c == 0
+	  || header.lh_site_c > LIVE_SITE_N) {
+	if (! silent_b) {
+	  loc_printf("   ERROR: live statistics has a bad header\n");
+	}
+	final = 0;
+      }
+      (void)fclose(live_fp);
+    }
+    
+    /* this removes the live statistics file */
+    dmalloc_debug_setup(old_env);
+#if HAVE_UNISTD_H
+    if (access(live_path, F_OK) == 0) {
+      if (! silent_b) {
+	loc_printf("   ERROR: live statistics '%s' was not removed\n",
+		   live_path);
+      }
+      final = 0;
+      (void)unlink(live_path);
+    }
+#endif
+  }
+#endif
+  
+#if SIGNAL_OKAY && HAVE_SIGNAL_H && defined(SIGUSR2)
+  /*
+   * Check that the dump signal logs the stats at the next call into
+   * the library and that the program keeps running.
+   */
+  {
+    const char	*dump_path = "dmalloc_t.dump", *old_env;
+    char	env_buf[256], new_env[512], line[256];
+    FILE	*dump_fp;
+    int		dump_c = 0;
+    
+    if (! silent_b) {
+      loc_printf("  Checking dump signal\n");
+    }
+    
+    old_env = dmalloc_debug_current_env(env_buf, sizeof(env_buf));
+    if (old_env == NULL || *old_env == '\0') {
+      (void)loc_snprintf(new_env, sizeof(new_env), "log=%s,dumpsig=%d:check",
+			 dump_path, SIGUSR2);
+    }
+    else {
+      (void)loc_snprintf(new_env, sizeof(new_env),
+			 "%s,log=%s,dumpsig=%d:check", old_env, dump_path,
+			 SIGUSR2);
+    }
+    dmalloc_debug_setup(new_env);
+    
+    /* two dumps with an allocation in between */
+    (void)raise(SIGUSR2);
+    pnt = malloc(33);
+    (void)raise(SIGUSR2);
+    free(pnt);
+    
+    /* this puts back the log and stops catching the signal */
+    dmalloc_debug_setup(old_env);
+    
+    dump_fp = fopen(dump_path, "r");
+    if (dump_fp != NULL) {
+      while (fgets(line, sizeof(line), dump_fp) != NULL) {
+	if (strstr(line, "dumping because of signal") != NULL) {
+	  dump_c++;
+	}
+      }
+      (void)fclose(dump_fp);
+    }
+    if (dump_c != 2) {
+      if (! silent_b) {
+	loc_printf("   ERROR: dump signal wrote %d dumps not 2\n", dump_c);
+      }
+      final = 0;
+    }
+#if HAVE_UNISTD_H
+    (void)unlink(dump_path);
+#endif
+  }
+#endif
+  
+#if HAVE_UNISTD_H
+  /*
+   * Check that new settings written to the control file are applied
+   * by a later call into the library.
+   */
+  {
+    const char	*control_path = "dmalloc_t.ctl", *old_env;
+    char	env_buf[256], new_env[512];
+    FILE	*control_fp;
+    int		try_c;
+    
+    if (! silent_b) {
+      loc_printf("  Checking control file\n");
+    }
+    
+    (void)unlink(control_path);
+    old_env = dmalloc_debug_current_env(env_buf, sizeof(env_buf));
+    if (old_env == NULL || *old_env == '\0') {
+      (void)loc_snprintf(new_env, sizeof(new_env), "control=%s:1",
+			 control_path);
+    }
+    else {
+      (void)loc_snprintf(new_env, sizeof(new_env), "%s,control=%s:1",
+			 old_env, control_path);
+    }
+    dmalloc_debug_setup(new_env);
+    
+    control_fp = fopen(control_path, "w");
+    if (control_fp == NULL) {
+      if (! silent_b) {
+	loc_printf("   ERROR: could not create control file '%s'\n",
+		   control_path);
+      }
+      final = 0;
+    }
+    else {
+      (void)fprintf(control_fp, "# new settings\n%s%slog-bad-space\n",
+		    (old_env == NULL ? "" : old_env),
+		    (old_env == NULL || *old_env == '\0' ? "" : ","));
+      (void)fclose(control_fp);
+      
+      /* the file is checked at most once a second */
+      for (try_c = 0; try_c < 3; try_c++) {
+	pnt = malloc(11);
+	free(pnt);
+	if (dmalloc_debug_current() & DMALLOC_DEBUG_LOG_BAD_SPACE) {
+	  break;
+	}
+	(void)sleep(1);
+      }
+      if (! (dmalloc_debug_current() & DMALLOC_DEBUG_LOG_BAD_SPACE)) {
+	if (! silent_b) {
+	  loc_printf("   ERROR: control file settings were not applied\n");
+	}
+	final = 0;
+      }
+    }
+    
+    /* this stops watching the control file */
+    dmalloc_debug_setup(old_env);
+    (void)unlink(control_path);
+  }
+#endif
+  
+#if HAVE_UNISTD_H && HAVE_POLL_H && HAVE_SYS_SOCKET_H && HAVE_SYS_UN_H
+  /*
+   * Check that the query server answers a request from inside of a
+   * later call into the library.
+   */
+  {
+    const char		*sock_path = "dmalloc_t.sock", *old_env;
+    char		env_buf[256], new_env[512], reply[1024];
+    struct sockaddr_un	addr;
+    struct pollfd	pfd;
+    unsigned long	start, call_nanos, max_nanos = 0;
+    int			fd, stall_fd, try_c, len = 0;
+    
+    if (! silent_b) {
+      loc_printf("  Checking query server\n");
+    }
+    
+    old_env = dmalloc_debug_current_env(env_buf, sizeof(env_buf));
+    if (old_env == NULL || *old_env == '\0') {
+      (void)loc_snprintf(new_env, sizeof(new_env), "server=%s", sock_path);
+    }
+    else {
+      (void)loc_snprintf(new_env, sizeof(new_env), "%s,server=%s",
+			 old_env, sock_path);
+    }
+    dmalloc_debug_setup(new_env);
+    
+    /* the socket is opened the next time the server runs */
+    for (try_c = 0; try_c < 3; try_c++) {
+      pnt = malloc(12);
+      free(pnt);
+      if (access(sock_path, F_OK) == 0) {
+	break;
+      }
+      (void)sleep(1);
+    }
+    
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    (void)strcpy(addr.sun_path, sock_path);
+    
+    /* a client that never sends its request must not hold up the calls */
+    stall_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (stall_fd >= 0
+	&& connect(stall_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+      (void)close(stall_fd);
+      stall_fd = -1;
+    }
+    
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0
+	|| connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0
+	|| write(fd, "stats\n", 6) != 6) {
+      if (! silent_b) {
+	loc_printf("   ERROR: could not send a request to '%s'\n", sock_path);
+      }
+      final = 0;
+    }
+    else {
+      /* the server only looks for queries once a second */
+      for (try_c = 0; try_c < 4; try_c++) {
+	(void)sleep(1);
+	start = _dmalloc_clock_nanos();
+	pnt = malloc(13);
+	free(pnt);
+	call_nanos = _dmalloc_clock_nanos() - start;
+	if (call_nanos > max_nanos) {
+	  max_nanos = call_nanos;
+	}
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	if (poll(&pfd, 1, 0) > 0) {
+	  len = read(fd, reply, sizeof(reply) - 1);
+	  break;
+	}
+      }
+      if (len <= 0) {
+	len = 0;
+      }
+      reply[len] = '\0';
+      if (strstr(reply, "\"mark\":") == NULL
+	  || strstr(reply, "\"in_use_pnts\":") == NULL) {
+	if (! silent_b) {
+	  loc_printf("   ERROR: bad query server reply '%s'\n", reply);
+	}
+	final = 0;
+      }
+      if (max_nanos >= 50000000) {
+	if (! silent_b) {
+	  loc_printf("   ERROR: serving a stalled client took %lu msecs\n",
+		     max_nanos / 1000000);
+	}
+	final = 0;
+      }
+    }
+    if (fd >= 0) {
+      (void)close(fd);
+    }
+    if (stall_fd >= 0) {
+      (void)close(stall_fd);
+    }
+    
+    /* this closes the socket and removes it */
+    dmalloc_debug_setup(old_env);
+    pnt = malloc(14);
+    free(pnt);
+    (void)unlink(sock_path);
+  }
+#endif
+  
+  /********************/
+  
+  /*
+   * Check that the server's locked calls do not count as iterations
+   * of the program.
+   */
+  {
+    unsigned long	mark;
+    int			called_b = 0;
+    
+    if (! silent_b) {
+      loc_printf("  Checking that a locked call does not move the mark\n");
+    }
+    
+    mark = dmalloc_mark();
+    if (! _dmalloc_call_locked(note_locked, &called_b) || ! called_b) {
+      if (! silent_b) {
+	loc_printf("   ERROR: the locked call was not made\n");
+      }
+      final = 0;
+    }
+    if (dmalloc_mark() != mark) {
+      if (! silent_b) {
+	loc_printf("   ERROR: the locked call moved the mark from %lu to %lu\n",
+		   mark, dmalloc_mark());
+      }
+      final = 0;
+    }
+  }
+  
+  /********************/
+  
+  /* check all of the arg check routines */
+  if (! check_arg_check()) {
+    final = 0;
+  }
+  
+  /********************/
+  
+  dmalloc_message("NOTE: ignore the errors from the above ----- to here.\n");
+  dmalloc_message("-------------------------------------------------------\n");
+  
+  /*
+   * The following errors whould not generate a dmalloc_errno nor any
+   * error messages
+   */
+  
+  /********************/
+  
+  /*
+   * Make sure that realloc of NULL pointers either works or doesn't
+   * depending on the proper ALLOW_REALLOC_NULL setting.
+   */
+  
+  {
+    if (! silent_b) {
+      loc_printf("  Trying to realloc a 0L pointer.\n");
+    }
+    pnt = realloc(NULL, 10);
+#if ALLOW_REALLOC_NULL
+    if (pnt == NULL) {
+      if (! silent_b) {
+	loc_printf("   ERROR: re-allocation of 0L returned error.\n");
+      }
+      final = 0;
+    }
+    else {
+      free(pnt);
+    }
+#else
+    if (pnt == NULL) {
+      dmalloc_errno = DMALLOC_ERROR_NONE;
+    }
+    else {
+      if (! silent_b) {
+	loc_printf("   ERROR: re-allocation of 0L did not return error.\n");
+      }
+      free(pnt);
+      final = 0;
+    }
+#endif
+  }
+  
+  /********************/
+  
+  /*
+   * Make sure that valloc returns properly page-aligned memory.
+   */
+  
+  {
+    int			iter_c, amount;
+    unsigned int	old_flags = dmalloc_debug_current();
+    
+    old_env = dmalloc_debug_current_env(env_buf, sizeof(env_buf));
+    
+    if (! silent_b) {
+      loc_printf("  Testing valloc()\n");
+    }
+    
+    /*
+     * First check without frence posts
+     */
+    dmalloc_debug(old_flags & ~DMALLOC_DEBUG_CHECK_FENCE);
+    
+    for (iter_c = 0; iter_c < 20; iter_c++) {
+      do {
+	amount = _dmalloc_rand() % (page_size * 3);
+      } while (amount == 0);
+      pnt = valloc(amount);
+      if (pnt == NULL) {
+	if (! silent_b) {
+	  loc_printf("   ERROR: could not valloc %d bytes.\n", amount);
+	}
+	final = 0;
+	continue;
+      }
+      if ((PNT_ARITH_TYPE)pnt % page_size != 0) {
+	if (! silent_b) {
+	  loc_printf("   ERROR: valloc got %p which is not page aligned.\n", pnt);
+	}
+	final = 0;
+      }
+      free(pnt);
+    }
+    
+    /*
+     * Now test with fence posts enabled
+     */
+    dmalloc_debug(old_flags | DMALLOC_DEBUG_CHECK_FENCE);
+    
+    for (iter_c = 0; iter_c < 20; iter_c++) {
+      do {
+	amount = _dmalloc_rand() % (page_size * 3);
+      } while (amount == 0);
+      pnt = valloc(amount);
+      if (pnt == NULL) {
+	if (! silent_b) {
+	  loc_printf("   ERROR: could not valloc %d bytes.\n", amount);
+	}
+	final = 0;
+	continue;
+      }
+      if ((PNT_ARITH_TYPE)pnt % page_size != 0) {
+	if (! silent_b) {
+	  loc_printf("   ERROR: valloc got %p which is not page aligned.\n", pnt);
+	}
+	final = 0;
+      }
+      free(pnt);
+    }
+    
+    dmalloc_debug_setup(old_env);
+  }
+  
+  /********************/
+  
+  /*
+   * Make sure that the blanking flags actually blank all of the
+   * allocated pointer space.
+   */
+  
+  {
+    char		*alloc_p;
+    unsigned int	iter_c, amount;
+    unsigned int	old_flags = dmalloc_debug_current();
+    
+    if (! silent_b) {
+      loc_printf("  Checking alloc blanking\n");
+    }
+    
+    old_env = dmalloc_debug_current_env(env_buf, sizeof(env_buf));
+    /* turn on alloc blanking without fence posts */
+    dmalloc_debug((old_flags | DMALLOC_DEBUG_ALLOC_BLANK) & (~DMALLOC_DEBUG_CHECK_FENCE));
+    
+    for (iter_c = 0; iter_c < 20; iter_c++) {
+      do {
+	amount = _dmalloc_rand() % (page_size * 3);
+      } while (amount == 0);
+      pnt = malloc(amount);
+      if (pnt == NULL) {
+	if (! silent_b) {
+	  loc_printf("   ERROR: could not allocate %d bytes.\n", amount);
+	}
+	final = 0;
+	continue;
+      }
+      for (alloc_p = pnt; alloc_p < (char *)pnt + amount; alloc_p++) {
+	if (*alloc_p != ALLOC_BLANK_CHAR) {
+	  if (! silent_b) {
 	    loc_printf("   ERROR: allocation not fully blanked.\n");
 	  }
 	  final = 0;
@@ -3457,6 +4966,60 @@ static	int	check_special(void)
   
   /********************/
   
+  /*
+   * Verify that the check-funcs see a pointer shrink after the same
+   * buffer has been checked a number of times.
+   */
+  {
+    int	errno_hold = dmalloc_errno, check_c;
+    
+    old_env = dmalloc_debug_current_env(env_buf, sizeof(env_buf));
+    dmalloc_debug(DMALLOC_DEBUG_CHECK_FUNCS);
+    
+    if (! silent_b) {
+      loc_printf("  Checking check-funcs after a resize\n");
+    }
+    
+    pnt = malloc(BUF_SIZE);
+    if (pnt == NULL) {
+      if (! silent_b) {
+	loc_printf("   ERROR: could not malloc %d bytes.\n", BUF_SIZE);
+      }
+      return 0;
+    }
+    
+    dmalloc_errno = DMALLOC_ERROR_NONE;
+    for (check_c = 0; check_c < 10; check_c++) {
+      _dmalloc_memset(__FILE__, __LINE__, (char *)pnt + check_c, 0,
+		      BUF_SIZE - check_c);
+    }
+    if (dmalloc_errno != DMALLOC_ERROR_NONE) {
+      if (! silent_b) {
+	loc_printf("   ERROR: repeated memset on buf of %d bytes failed.\n",
+		   BUF_SIZE);
+      }
+      final = 0;
+    }
+    
+    /* the same memset must fail once the buffer is smaller */
+    pnt = realloc(pnt, BUF_SIZE / 2);
+    dmalloc_errno = DMALLOC_ERROR_NONE;
+    _dmalloc_memset(__FILE__, __LINE__, pnt, 0, BUF_SIZE);
+    if (dmalloc_errno != DMALLOC_ERROR_WOULD_OVERWRITE) {
+      if (! silent_b) {
+	loc_printf("   ERROR: memset of %d bytes after realloc to %d should fail.\n",
+		   BUF_SIZE, BUF_SIZE / 2);
+      }
+      final = 0;
+    }
+    
+    free(pnt);
+    dmalloc_debug_setup(old_env);
+    dmalloc_errno = errno_hold;
+  }
+  
+  /********************/
+  
   /*
    * Verify the dmalloc_count_changed function.
    */
@@ -3547,6 +5110,52 @@ static	int	check_special(void)
       return 0;
     }
   }
+  
+  /********************/
+  
+  /*
+   * Verify that a pointer changed after a mark is counted even if it
+   * was allocated before the mark and that older pointers are not.
+   */
+  {
+    unsigned long	mem_count, loc_mark;
+    void		*old_pnt, *new_pnt;
+    
+    if (! silent_b) {
+      loc_printf("  Checking changed pointers since a later mark\n");
+    }
+    
+    old_pnt = malloc(100);
+    pnt = malloc(200);
+    loc_mark = dmalloc_mark();
+    new_pnt = malloc(300);
+    /* this moves the oldest pointer after the newest */
+    old_pnt = realloc(old_pnt, 50);
+    
+    mem_count = dmalloc_count_changed(loc_mark, 1 /* not-freed */,
+				      0 /* no freed */);
+    if (old_pnt == NULL || pnt == NULL || new_pnt == NULL
+	|| mem_count != 300 + 50) {
+      if (! silent_b) {
+	loc_printf("   ERROR: count-changed reported %lu bytes changed not %d.\n",
+		   mem_count, 300 + 50);
+      }
+      return 0;
+    }
+    
+    free(old_pnt);
+    free(pnt);
+    free(new_pnt);
+    mem_count = dmalloc_count_changed(loc_mark, 1 /* not-freed */,
+				      0 /* no freed */);
+    if (mem_count != 0) {
+      if (! silent_b) {
+	loc_printf("   ERROR: count-changed reported %lu bytes changed.\n",
+		   mem_count);
+      }
+      return 0;
+    }
+  }
  
   /********************/
   
@@ -3897,9 +5506,122 @@ static	int	check_special(void)
     final = check_append_buf(buf, buf + len, "number 0x400, string X, number 10", 33, final,
 			     "number string number");
   }
+  
+  /********************/
+  
+  {
+    char		buf[80], *max = buf + sizeof(buf), *buf_p;
+    append_format_t	desc;
+    int			iter_c;
+    
+    buf_p = append_ulong(buf, max, 4294967295UL, 10);
+    final = check_append_buf(buf, buf_p, "4294967295", 10, final, "ulong big");
+    
+    buf_p = append_long(buf, max, -1000000007L, 10);
+    final = check_append_buf(buf, buf_p, "-1000000007", 11, final, "long neg big");
+    
+    buf_p = append_ulong(buf, max, 0, 16);
+    final = check_append_buf(buf, buf_p, "0", 1, final, "ulong hex zero");
+    
+    buf_p = append_ulong(buf, max, 0xdeadbeefUL, 16);
+    final = check_append_buf(buf, buf_p, "deadbeef", 8, final, "ulong hex");
+    
+    buf_p = append_ulong(buf, max, 01234567UL, 8);
+    final = check_append_buf(buf, buf_p, "1234567", 7, final, "ulong octal");
+    
+    buf_p = append_ulong(buf, max, 1295, 36);
+    final = check_append_buf(buf, buf_p, "zz", 2, final, "ulong base 36");
+    
+    /* number truncated at the limit */
+    buf_p = append_ulong(buf, buf + 3, 123456, 10);
+    final = check_append_buf(buf, buf_p, "123", 3, final, "ulong truncated");
+    
+    buf_p = append_ulong(buf, buf + 3, 0x123456, 16);
+    final = check_append_buf(buf, buf_p, "123", 3, final, "hex truncated");
+    
+    buf_p = append_pointer(buf, max, 0x1234abcdUL, 16);
+    final = check_append_buf(buf, buf_p, "1234abcd", 8, final, "pointer");
+    
+    /* the second pass uses the already parsed descriptor */
+    memset(&desc, 0, sizeof(desc));
+    for (iter_c = 0; iter_c < 2; iter_c++) {
+      buf_p = append_desc(buf, max, &desc, "'%s' got %ld bytes at %#lx|%-4d|",
+			  "x.c:10", 123L, 0xbeefUL, 7);
+      final = check_append_buf(buf, buf_p, "'x.c:10' got 123 bytes at 0xbeef|7   |",
+			       38, final, "cached format");
+    }
+    
+    /* a new format replaces the cached one */
+    buf_p = append_desc(buf, max, &desc, "%5.2f%% %c", 3.14159, 'z');
+    final = check_append_buf(buf, buf_p, " 3.14% z", 8, final,
+			     "cached new format");
+    
+    /* too many conversions falls back to the uncached path */
+    memset(&desc, 0, sizeof(desc));
+    buf_p = append_desc(buf, max, &desc,
+			"%d%d%d%d%d%d%d%d%d%d%d%d%d%d%d%d%d%d",
+			1, 2, 3, 4, 5, 6, 7, 8, 9, 0, 1, 2, 3, 4, 5, 6, 7, 8);
+    final = check_append_buf(buf, buf_p, "123456789012345678", 18, final,
+			     "cached too many");
+    
+    /* truncated at the limit */
+    memset(&desc, 0, sizeof(desc));
+    buf_p = append_desc(buf, buf + 6, &desc, "abc %d def", 12345);
+    final = check_append_buf(buf, buf_p, "abc 12", 6, final, "cached truncated");
+  }
 
   /********************/
   
+#if HAVE_TIME
+  if (! silent_b) {
+    loc_printf("  Checking the cached clock\n");
+  }
+  
+  {
+    long	before, secs, check_secs, after;
+    const char	*str;
+    char	local_buf[64];
+    time_t	local_secs;
+    
+    before = time(NULL);
+    secs = _dmalloc_clock_seconds();
+    str = _dmalloc_clock_ctime();
+    check_secs = _dmalloc_clock_seconds();
+    after = time(NULL);
+    
+    /* the clocks tick at different times so they can be a second apart */
+    if (secs < before - 1 || secs > after + 1) {
+      if (! silent_b) {
+	loc_printf("   ERROR: clock seconds %ld not between %ld and %ld\n",
+		   secs, before, after);
+      }
+      final = 0;
+    }
+    if (strlen(str) != 24 || str[3] != ' ' || str[7] != ' '
+	|| str[13] != ':' || str[16] != ':' || str[19] != ' ') {
+      if (! silent_b) {
+	loc_printf("   ERROR: clock ctime string is bad: '%s'\n", str);
+      }
+      final = 0;
+    }
+    
+    /* the string should be in local time if the second did not change */
+    local_secs = secs;
+    if (secs == check_secs
+	&& strftime(local_buf, sizeof(local_buf), "%a %b %e %H:%M:%S %Y",
+		    localtime(&local_secs)) > 0
+	&& strcmp(str, local_buf) != 0) {
+      if (! silent_b) {
+	loc_printf("   ERROR: clock ctime string '%s' is not local time '%s'\n",
+		   str, local_buf);
+      }
+      final = 0;
+    }
+  }
+  
+  /********************/
+#endif
+  
   /*
    * NOTE: add tests which should result in errors before the -------
    * message above
@@ -34,15 +34,22 @@
 #endif
 
 #include "conf.h"
+#include "dmalloc.h"
+
 #include "append.h"
 #include "chunk.h"
+#include "clock.h"
 #include "compat.h"
-#include "dmalloc.h"
 #include "dmalloc_loc.h"
+#include "error.h"
 
 #include "dmalloc_tab.h"
 #include "dmalloc_tab_loc.h"
 
+/* formats of the table entry lines so they are only parsed once */
+static	append_format_t	in_use_format;
+static	append_format_t	total_format;
+
 /*
  * static unsigned int hash
  *
@@ -177,6 +184,86 @@ static	unsigned int	which_bucket(const int entry_n, const char *file,
   return bucket;
 }
 
+#if MEMORY_TABLE_HISTOGRAMS
+/*
+ * static int histogram_bucket
+ *
+ * Find the log2 histogram bucket for a value.
+ *
+ * Returns the bucket number with values of 0 and 1 in bucket 0 and
+ * everything too large in the last bucket.
+ *
+ * ARGUMENTS:
+ *
+ * value -> Value we are bucketing.
+ *
+ * bucket_n -> Number of buckets in the histogram.
+ */
+static	int	histogram_bucket(unsigned long value, const int bucket_n)
+{
+  int	bucket_c;
+  
+  for (bucket_c = 0; value > 1 && bucket_c < bucket_n - 1; bucket_c++) {
+    value >>= 1;
+  }
+  
+  return bucket_c;
+}
+
+/*
+ * static void log_histogram
+ *
+ * Log the non-empty buckets of a histogram on one line.  Each bucket
+ * is shown as its lower bound and count.
+ *
+ * ARGUMENTS:
+ *
+ * label -> Label of the histogram.
+ *
+ * hist -> Array of bucket counts.
+ *
+ * bucket_n -> Number of buckets in the hist array.
+ */
+static	void	log_histogram(const char *label, const unsigned int *hist,
+			      const int bucket_n)
+{
+  char	buf[1024], *buf_p = buf, *bounds_p = buf + sizeof(buf);
+  int	bucket_c;
+  
+  for (bucket_c = 0; bucket_c < bucket_n; bucket_c++) {
+    if (hist[bucket_c] > 0) {
+      buf_p += loc_snprintf(buf_p, bounds_p - buf_p, " %lu%s:%u",
+			    1UL << bucket_c,
+			    (bucket_c == bucket_n - 1 ? "+" : ""),
+			    hist[bucket_c]);
+    }
+  }
+  
+  if (buf_p > buf) {
+    dmalloc_message("             %s:%s", label, buf);
+  }
+}
+
+/*
+ * static void log_histograms
+ *
+ * Log the histograms of a memory table entry.
+ *
+ * ARGUMENTS:
+ *
+ * entry_p -> Pointer to the memory table entry we are dumping.
+ */
+static	void	log_histograms(const mem_entry_t *entry_p)
+{
+  log_histogram("size", entry_p->me_size_hist, MEM_HISTOGRAM_N);
+  log_histogram("life-iters", entry_p->me_iter_hist, MEM_HISTOGRAM_N);
+#if LOG_PNT_TIMEVAL
+  log_histogram("life-usecs", entry_p->me_usec_hist,
+		MEM_HISTOGRAM_USEC_N);
+#endif
+}
+#endif /* MEMORY_TABLE_HISTOGRAMS */
+
 /*
  * static int entry_cmp
  *
@@ -452,6 +539,103 @@ static	void	split(unsigned char *first_p, unsigned char *last_p,
   }
 }
 
+/*
+ * static void top_sift_down
+ *
+ * Put an entry at the top of a heap of entries ordered by smallest
+ * total-size first and sift it down into its place.
+ *
+ * ARGUMENTS:
+ *
+ * top <-> Array of entry pointers that makes up the heap.
+ *
+ * top_n -> Number of entries in the heap.
+ *
+ * entry_p -> Entry we are placing in the heap.
+ */
+static	void	top_sift_down(mem_entry_t **top, const int top_n,
+			      mem_entry_t *entry_p)
+{
+  int	parent_c, child_c;
+  
+  for (parent_c = 0; ; parent_c = child_c) {
+    child_c = parent_c * 2 + 1;
+    if (child_c >= top_n) {
+      break;
+    }
+    /* find the smaller of the two children */
+    if (child_c + 1 < top_n
+	&& top[child_c + 1]->me_total_size < top[child_c]->me_total_size) {
+      child_c++;
+    }
+    if (entry_p->me_total_size <= top[child_c]->me_total_size) {
+      break;
+    }
+    top[parent_c] = top[child_c];
+  }
+  
+  top[parent_c] = entry_p;
+}
+
+/*
+ * static int select_top
+ *
+ * Select the entries with the largest total-size from the table
+ * without sorting the whole table.  We keep a heap of the top_n
+ * largest entries seen so far, with the smallest of them on top, so
+ * this takes O(N log top_n).
+ *
+ * Returns the number of entries in the top array sorted with the
+ * largest first.
+ *
+ * ARGUMENTS:
+ *
+ * mem_table -> Memory table we are working on.
+ *
+ * top <- Array of entry pointers that we fill in.
+ *
+ * top_n -> Maximum number of entries to select.
+ */
+static	int	select_top(const mem_table_t *mem_table, mem_entry_t **top,
+			   const int top_n)
+{
+  mem_entry_t	*entry_p;
+  int		top_c = 0, child_c, parent_c;
+  
+  for (entry_p = mem_table->mt_entries;
+       entry_p < mem_table->mt_bounds_p;
+       entry_p++) {
+    if (entry_p->me_file == NULL) {
+      continue;
+    }
+    
+    if (top_c < top_n) {
+      /* add the entry to the bottom of the heap and sift it up */
+      for (child_c = top_c++; child_c > 0; child_c = parent_c) {
+	parent_c = (child_c - 1) / 2;
+	if (top[parent_c]->me_total_size <= entry_p->me_total_size) {
+	  break;
+	}
+	top[child_c] = top[parent_c];
+      }
+      top[child_c] = entry_p;
+    }
+    else if (entry_p->me_total_size > top[0]->me_total_size) {
+      /* replace the smallest of the top entries */
+      top_sift_down(top, top_c, entry_p);
+    }
+  }
+  
+  /* move the smallest to the end until the heap is sorted largest first */
+  for (child_c = top_c - 1; child_c > 0; child_c--) {
+    entry_p = top[child_c];
+    top[child_c] = top[0];
+    top_sift_down(top, child_c, entry_p);
+  }
+  
+  return top_c;
+}
+
 /*
  * static void log_slot
  *
@@ -469,13 +653,14 @@ static	void	log_entry(const mem_entry_t *entry_p,
 			  const int in_use_column_b, const char *source)
 {
   if (in_use_column_b) {
-    dmalloc_message("%11lu %6lu %11lu %6lu  %s\n",
-		    entry_p->me_total_size, entry_p->me_total_c,
-		    entry_p->me_in_use_size, entry_p->me_in_use_c, source);
+    _dmalloc_desc_message(&in_use_format, "%11lu %6lu %11lu %6lu  %s\n",
+			  entry_p->me_total_size, entry_p->me_total_c,
+			  entry_p->me_in_use_size, entry_p->me_in_use_c,
+			  source);
   }
   else {
-    dmalloc_message("%11lu %6lu  %s\n",
-		     entry_p->me_total_size, entry_p->me_total_c, source);
+    _dmalloc_desc_message(&total_format, "%11lu %6lu  %s\n",
+			  entry_p->me_total_size, entry_p->me_total_c, source);
   }
 }
 
@@ -525,6 +710,54 @@ void	_dmalloc_table_init(mem_table_t *mem_table, mem_entry_t *mem_entries,
   mem_table->mt_bounds_p = mem_entries + mem_table->mt_entry_n;
 }
 
+/*
+ * void _dmalloc_table_resize
+ *
+ * Rehash the entries in our table into a new array of entries.  This
+ * is used to grow the table when it is getting full.
+ *
+ * ARGUMENTS:
+ *
+ * mem_table -> Memory table we are working on.
+ *
+ * mem_entries -> New entries to associate with the table.  The old
+ * entries are not referenced after this call.
+ *
+ * entry_n -> Number of entries in the mem_entries array.  This must
+ * be larger than the number of entries in use in the table.
+ */
+void	_dmalloc_table_resize(mem_table_t *mem_table, mem_entry_t *mem_entries,
+			      const int entry_n)
+{
+  mem_entry_t	*old_p, *entry_p, *bounds_p;
+  
+  memset(mem_entries, 0, sizeof(*mem_entries) * entry_n);
+  bounds_p = mem_entries + entry_n;
+  
+  for (old_p = mem_table->mt_entries; old_p < mem_table->mt_bounds_p; old_p++) {
+    if (old_p->me_file == NULL) {
+      continue;
+    }
+    
+    /* find the next open slot from the entry's new bucket */
+    entry_p = mem_entries + which_bucket(entry_n, old_p->me_file,
+					 old_p->me_line);
+    while (entry_p->me_file != NULL) {
+      entry_p++;
+      if (entry_p == bounds_p) {
+	entry_p = mem_entries;
+      }
+    }
+    
+    *entry_p = *old_p;
+    entry_p->me_entry_pos_p = entry_p;
+  }
+  
+  mem_table->mt_entries = mem_entries;
+  mem_table->mt_entry_n = entry_n;
+  mem_table->mt_bounds_p = bounds_p;
+}
+
 /*
  * static mem_entry_t *table_find
  *
@@ -570,10 +803,43 @@ static mem_entry_t	*table_find(mem_table_t *mem_table,
 }
 
 /*
- * void _dmalloc_table_insert
+ * mem_entry_t *_dmalloc_table_find
+ *
+ * Find the entry for a file/line in the table without changing it.
+ *
+ * Returns the entry for the file/line, or NULL if the file/line is
+ * not in the table.
+ *
+ * ARGUMENTS:
+ *
+ * mem_table -> Memory table we are working on.
+ *
+ * file -> File name or return address of the allocation.
+ *
+ * line -> Line number of the allocation.
+ */
+mem_entry_t	*_dmalloc_table_find(mem_table_t *mem_table, const char *file,
+				     const unsigned int line)
+{
+  mem_entry_t	*entry_p;
+  
+  entry_p = table_find(mem_table, file, line);
+  if (entry_p->me_file == NULL || entry_p == &mem_table->mt_other_pointers) {
+    return NULL;
+  }
+  else {
+    return entry_p;
+  }
+}
+
+/*
+ * mem_entry_t *_dmalloc_table_insert
  *
  * Insert a pointer to the table.
  *
+ * Returns the entry that was updated which may be the other-pointers
+ * entry if the table is too full or there is no file.
+ *
  * ARGUMENTS:
  *
  * mem_table -> Memory table we are working on.
@@ -584,18 +850,26 @@ static mem_entry_t	*table_find(mem_table_t *mem_table,
  *
  * size -> Size in bytes of the allocation.
  */
-void	_dmalloc_table_insert(mem_table_t *mem_table,
-			      const char *file, const unsigned int line,
-			      const unsigned long size)
+mem_entry_t	*_dmalloc_table_insert(mem_table_t *mem_table,
+				       const char *file,
+				       const unsigned int line,
+				       const unsigned long size)
 {
   mem_entry_t	*entry_p;
+  unsigned long	cost;
   
+  COST_START(cost);
   entry_p = table_find(mem_table, file, line);
   if (entry_p->me_file == NULL
-      && mem_table->mt_in_use_c > mem_table->mt_entry_n / 2) {
-    /* do we have too many entries in the table?  then put in other bucket. */
+      && (file == NULL
+	  || mem_table->mt_in_use_c > mem_table->mt_entry_n / 2)) {
+    /*
+     * Do we have too many entries in the table or no file to mark the
+     * slot as used?  Then put in other bucket.
+     */
     entry_p = &mem_table->mt_other_pointers;
-  } else if (entry_p != &mem_table->mt_other_pointers) {
+  } else if (entry_p->me_file == NULL
+	     && entry_p != &mem_table->mt_other_pointers) {
     /* we found an open slot so update the file/line */
     entry_p->me_file = file;
     entry_p->me_line = line;
@@ -608,13 +882,22 @@ void	_dmalloc_table_insert(mem_table_t *mem_table,
   entry_p->me_in_use_size += size;
   entry_p->me_in_use_c++;
   entry_p->me_entry_pos_p = entry_p;
+#if MEMORY_TABLE_HISTOGRAMS
+  entry_p->me_size_hist[histogram_bucket(size, MEM_HISTOGRAM_N)]++;
+#endif
+  COST_STOP(DMALLOC_COST_TABLE, cost);
+  
+  return entry_p;
 }
 
 /*
- * void _dmalloc_table_delete
+ * mem_entry_t *_dmalloc_table_delete
  *
  * Remove a pointer from the table.
  *
+ * Returns the entry that was updated which may be the other-pointers
+ * entry if the file/line was not found.
+ *
  * ARGUMENTS:
  *
  * mem_table -> Memory table we are working on.
@@ -626,12 +909,15 @@ void	_dmalloc_table_insert(mem_table_t *mem_table,
  *
  * size -> Size in bytes of the allocation.
  */
-void	_dmalloc_table_delete(mem_table_t *mem_table, const char *old_file,
-			      const unsigned int old_line,
-			      const DMALLOC_SIZE size)
+mem_entry_t	*_dmalloc_table_delete(mem_table_t *mem_table,
+				       const char *old_file,
+				       const unsigned int old_line,
+				       const DMALLOC_SIZE size)
 {
   mem_entry_t	*entry_p;
+  unsigned long	cost;
   
+  COST_START(cost);
   entry_p = table_find(mem_table, old_file, old_line);
   if (entry_p->me_file == NULL) {
     /* if we didn't find it, account for it in the other_pointers?? */
@@ -642,6 +928,64 @@ void	_dmalloc_table_delete(mem_table_t *mem_table, const char *old_file,
     entry_p->me_in_use_size -= size;
     entry_p->me_in_use_c--;
   }
+  COST_STOP(DMALLOC_COST_TABLE, cost);
+  
+  return entry_p;
+}
+
+/*
+ * void _dmalloc_table_lifetime
+ *
+ * Record the lifetime of a pointer that was removed from the table in
+ * the entry's histograms.  This does nothing if the histograms are
+ * not enabled.
+ *
+ * ARGUMENTS:
+ *
+ * entry_p -> Entry returned by _dmalloc_table_delete.
+ *
+ * life_iter -> Number of iterations that the pointer was in use.
+ *
+ * life_usecs -> Number of microseconds that the pointer was in use
+ * or MEM_LIFE_UNKNOWN if not known.  This is only recorded if
+ * LOG_PNT_TIMEVAL is enabled.
+ */
+void	_dmalloc_table_lifetime(mem_entry_t *entry_p,
+				const unsigned long life_iter,
+				const unsigned long life_usecs)
+{
+#if MEMORY_TABLE_HISTOGRAMS
+  entry_p->me_iter_hist[histogram_bucket(life_iter, MEM_HISTOGRAM_N)]++;
+#if LOG_PNT_TIMEVAL
+  if (life_usecs != MEM_LIFE_UNKNOWN) {
+    entry_p->me_usec_hist[histogram_bucket(life_usecs,
+					   MEM_HISTOGRAM_USEC_N)]++;
+  }
+#endif
+#endif
+}
+
+/*
+ * int _dmalloc_table_top
+ *
+ * Select the entries with the largest total-size from the table
+ * without sorting it.
+ *
+ * Returns the number of entries in the top array sorted with the
+ * largest first.
+ *
+ * ARGUMENTS:
+ *
+ * mem_table -> Memory table we are working on.
+ *
+ * top <- Array of entry pointers that we fill in.
+ *
+ * top_n -> Maximum number of entries to select.
+ */
+int	_dmalloc_table_top(const mem_table_t *mem_table, mem_entry_t **top,
+			   const int top_n)
+{
+  return select_top(mem_table, top, top_n);
 }
 
 /*
@@ -657,12 +1001,15 @@ void	_dmalloc_table_delete(mem_table_t *mem_table, const char *old_file,
  * display all entries in the table.
  *
  * in_use_column_b -> Display the in-use numbers in a column.
+ *
+ * histogram_b -> Display the histograms of the logged entries if
+ * they are enabled.
  */
 void	_dmalloc_table_log_info(mem_table_t *mem_table, const int log_n,
-				const int in_use_column_b)
+				const int in_use_column_b, const int histogram_b)
 {
-  mem_entry_t	*entry_p, total;
-  int		entry_c;
+  mem_entry_t	*entry_p, *top[MAX_TOP_ENTRIES], **top_p, total;
+  int		entry_c, top_c, sort_b;
   char		source[64];
   
   /* is the table empty */
@@ -671,10 +1018,20 @@ void	_dmalloc_table_log_info(mem_table_t *mem_table, const int log_n,
     return;
   }
   
-  /* sort the entries by their total-size */
-  split((unsigned char *)mem_table->mt_entries,
-	(unsigned char *)(mem_table->mt_bounds_p - 1),
-	sizeof(*mem_table->mt_entries));
+  /*
+   * If we only need a couple of the top entries then we select them
+   * with a heap.  Otherwise we sort the whole table by total-size.
+   */
+  sort_b = (log_n == 0 || log_n > MAX_TOP_ENTRIES);
+  if (sort_b) {
+    split((unsigned char *)mem_table->mt_entries,
+	  (unsigned char *)(mem_table->mt_bounds_p - 1),
+	  sizeof(*mem_table->mt_entries));
+    top_c = 0;
+  }
+  else {
+    top_c = select_top(mem_table, top, log_n);
+  }
   
   /* display the column headers */  
   if (in_use_column_b) {
@@ -693,15 +1050,33 @@ void	_dmalloc_table_log_info(mem_table_t *mem_table, const int log_n,
     if (entry_p->me_file != NULL) {
       entry_c++;
       /* can we still print the pointer information? */
-      if (log_n == 0 || entry_c < log_n) {
+      if (sort_b && (log_n == 0 || entry_c <= log_n)) {
 	(void)_dmalloc_chunk_desc_pnt(source, sizeof(source),
 				      entry_p->me_file, entry_p->me_line);
 	log_entry(entry_p, in_use_column_b, source);
+#if MEMORY_TABLE_HISTOGRAMS
+	if (histogram_b) {
+	  log_histograms(entry_p);
+	}
+#endif
       }
       add_entry(&total, entry_p);
     }
   }
-  if (mem_table->mt_in_use_c >= MEMORY_TABLE_SIZE) {
+  
+  /* log the selected top entries which are already in order */
+  for (top_p = top; top_p < top + top_c; top_p++) {
+    (void)_dmalloc_chunk_desc_pnt(source, sizeof(source),
+				  (*top_p)->me_file, (*top_p)->me_line);
+    log_entry(*top_p, in_use_column_b, source);
+#if MEMORY_TABLE_HISTOGRAMS
+    if (histogram_b) {
+      log_histograms(*top_p);
+    }
+#endif
+  }
+  
+  if (mem_table->mt_other_pointers.me_total_c > 0) {
     strncpy(source, "Other pointers", sizeof(source));
     source[sizeof(source) - 1] = '\0';
     log_entry(&mem_table->mt_other_pointers, in_use_column_b, source);
@@ -712,6 +1087,10 @@ void	_dmalloc_table_log_info(mem_table_t *mem_table, const int log_n,
   (void)loc_snprintf(source, sizeof(source), "Total of %d", entry_c);
   log_entry(&total, in_use_column_b, source);
   
+  if (! sort_b) {
+    return;
+  }
+  
   /*
    * If we sorted the array, we have to put it back the way it was if
    * we want to continue and handle memory transactions.  We should be
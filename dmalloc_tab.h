@@ -22,6 +22,19 @@
 #ifndef __DMALLOC_TAB_H__
 #define __DMALLOC_TAB_H__
 
+/* number of log2 buckets in the memory entry histograms */
+#define MEM_HISTOGRAM_N		16
+
+/*
+ * Number of log2 buckets in the lifetime in microseconds histogram.
+ * Times run much larger than sizes so this keeps lifetimes of up to
+ * about half an hour out of the last bucket.
+ */
+#define MEM_HISTOGRAM_USEC_N	32
+
+/* passed as the lifetime when it was not recorded */
+#define MEM_LIFE_UNKNOWN	((unsigned long)-1)
+
 /* entry in a memory table */
 typedef struct mem_entry_st {
   const char		*me_file;		/* filename of alloc or ra */
@@ -30,6 +43,17 @@ typedef struct mem_entry_st {
   unsigned long		me_total_c;		/* total pointers allocated */
   unsigned long		me_in_use_size;		/* size currently alloced */
   unsigned long		me_in_use_c;		/* pointers currently in use */
+#if MEMORY_TABLE_HISTOGRAMS
+  /* log2 histograms, the last bucket holds everything larger */
+  unsigned int		me_size_hist[MEM_HISTOGRAM_N];	/* alloc sizes */
+  unsigned int		me_iter_hist[MEM_HISTOGRAM_N];	/* life in iters */
+#if LOG_PNT_TIMEVAL
+  unsigned int		me_usec_hist[MEM_HISTOGRAM_USEC_N]; /* life in usecs */
+#endif
+#endif
+  /* cached budget that applies to this file/line, see chunk.c */
+  void			*me_budget_p;		/* budget or NULL if none */
+  int			me_budget_b;		/* me_budget_p is resolved */
   /* we use this so we can easily un-sort the list */
   struct mem_entry_st	*me_entry_pos_p;	/* pos of entry in table */
 } mem_entry_t;
@@ -64,10 +88,53 @@ void	_dmalloc_table_init(mem_table_t *mem_table, mem_entry_t *mem_entries,
 			    const int entry_n);
 
 /*
- * void _dmalloc_table_insert
+ * void _dmalloc_table_resize
+ *
+ * Rehash the entries in our table into a new array of entries.  This
+ * is used to grow the table when it is getting full.
+ *
+ * ARGUMENTS:
+ *
+ * mem_table -> Memory table we are working on.
+ *
+ * mem_entries -> New entries to associate with the table.  The old
+ * entries are not referenced after this call.
+ *
+ * entry_n -> Number of entries in the mem_entries array.  This must
+ * be larger than the number of entries in use in the table.
+ */
+extern
+void	_dmalloc_table_resize(mem_table_t *mem_table, mem_entry_t *mem_entries,
+			      const int entry_n);
+
+/*
+ * mem_entry_t *_dmalloc_table_find
+ *
+ * Find the entry for a file/line in the table without changing it.
+ *
+ * Returns the entry for the file/line, or NULL if the file/line is
+ * not in the table.
+ *
+ * ARGUMENTS:
+ *
+ * mem_table -> Memory table we are working on.
+ *
+ * file -> File name or return address of the allocation.
+ *
+ * line -> Line number of the allocation.
+ */
+extern
+mem_entry_t	*_dmalloc_table_find(mem_table_t *mem_table, const char *file,
+				     const unsigned int line);
+
+/*
+ * mem_entry_t *_dmalloc_table_insert
  *
  * Insert a pointer to the table.
  *
+ * Returns the entry that was updated which may be the other-pointers
+ * entry if the table is too full or there is no file.
+ *
  * ARGUMENTS:
  *
  * mem_table -> Memory table we are working on.
@@ -79,15 +146,19 @@ void	_dmalloc_table_init(mem_table_t *mem_table, mem_entry_t *mem_entries,
  * size -> Size in bytes of the allocation.
  */
 extern
-void	_dmalloc_table_insert(mem_table_t *mem_table,
-			      const char *file, const unsigned int line,
-			      const unsigned long size);
+mem_entry_t	*_dmalloc_table_insert(mem_table_t *mem_table,
+				       const char *file,
+				       const unsigned int line,
+				       const unsigned long size);
 
 /*
- * void _dmalloc_table_delete
+ * mem_entry_t *_dmalloc_table_delete
  *
  * Remove a pointer from the table.
  *
+ * Returns the entry that was updated which may be the other-pointers
+ * entry if the file/line was not found.
+ *
  * ARGUMENTS:
  *
  * mem_table -> Memory table we are working on.
@@ -100,9 +171,53 @@ void	_dmalloc_table_insert(mem_table_t *mem_table,
  * size -> Size in bytes of the allocation.
  */
 extern
-void	_dmalloc_table_delete(mem_table_t *mem_table, const char *old_file,
-			      const unsigned int old_line,
-			      const DMALLOC_SIZE size);
+mem_entry_t	*_dmalloc_table_delete(mem_table_t *mem_table,
+				       const char *old_file,
+				       const unsigned int old_line,
+				       const DMALLOC_SIZE size);
+
+/*
+ * void _dmalloc_table_lifetime
+ *
+ * Record the lifetime of a pointer that was removed from the table in
+ * the entry's histograms.  This does nothing if the histograms are
+ * not enabled.
+ *
+ * ARGUMENTS:
+ *
+ * entry_p -> Entry returned by _dmalloc_table_delete.
+ *
+ * life_iter -> Number of iterations that the pointer was in use.
+ *
+ * life_usecs -> Number of microseconds that the pointer was in use
+ * or MEM_LIFE_UNKNOWN if not known.  This is only recorded if
+ * LOG_PNT_TIMEVAL is enabled.
+ */
+extern
+void	_dmalloc_table_lifetime(mem_entry_t *entry_p,
+				const unsigned long life_iter,
+				const unsigned long life_usecs);
+
+/*
+ * int _dmalloc_table_top
+ *
+ * Select the entries with the largest total-size from the table
+ * without sorting it.
+ *
+ * Returns the number of entries in the top array sorted with the
+ * largest first.
+ *
+ * ARGUMENTS:
+ *
+ * mem_table -> Memory table we are working on.
+ *
+ * top <- Array of entry pointers that we fill in.
+ *
+ * top_n -> Maximum number of entries to select.
+ */
+extern
+int	_dmalloc_table_top(const mem_table_t *mem_table, mem_entry_t **top,
+			   const int top_n);
 
 /*
  * void _dmalloc_table_log_info
@@ -117,10 +232,13 @@ void	_dmalloc_table_delete(mem_table_t *mem_table, const char *old_file,
  * display all entries in the table.
  *
  * in_use_column_b -> Display the in-use numbers in a column.
+ *
+ * histogram_b -> Display the histograms of the logged entries if
+ * they are enabled.
  */
 extern
 void	_dmalloc_table_log_info(mem_table_t *mem_table, const int log_n,
-				const int in_use_column_b);
+				const int in_use_column_b, const int histogram_b);
 
 /*<<<<<<<<<<   This is end of the auto-generated output from fillproto. */
 
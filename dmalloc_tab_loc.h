@@ -38,6 +38,13 @@
  */
 #define MAX_QSORT_PARTITION	8
 
+/*
+ * Maximum number of top entries that we select with a bounded heap
+ * when logging the table.  If more entries are asked for then we sort
+ * the whole table.
+ */
+#define MAX_TOP_ENTRIES		128
+
 /* comparison function */
 typedef int	(*compare_t)(const void *element1_p, const void *element2_p);
 
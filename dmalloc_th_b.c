@@ -0,0 +1,453 @@
+/*
+ * Benchmark of the threaded library with different numbers of threads
+ *
+ * Copyright 2020 by Gray Watson
+ *
+ * This file is part of the dmalloc package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ *
+ * The author may be contacted via https://dmalloc.com/
+ */
+
+/*
+ * This is linked with the threaded library.  Each workload is run
+ * with 1, 2, 4, ... up to the maximum number of threads.  Every run
+ * happens in a child process so the heap starts out empty and so a
+ * fatal error such as DMALLOC_ERROR_IN_TWICE, when two threads get
+ * into the library at the same time, is reported instead of ending
+ * the benchmark.  The workloads are:
+ *
+ * churn -> Each thread allocates and frees its own pointers.
+ *
+ * prodcons -> Each thread hands its allocations to the next thread
+ * which frees them.
+ *
+ * cache -> The threads look up entries of a shared table of
+ * long-lived allocations and sometimes replace one.
+ */
+
+#include <errno.h>				/* for EINTR */
+#include <pthread.h>
+#include <stdio.h>				/* for printf */
+#include <sys/types.h>
+#include <sys/wait.h>				/* for waitpid */
+
+#if HAVE_STDLIB_H
+# include <stdlib.h>				/* for malloc */
+#endif
+#if HAVE_STRING_H
+# include <string.h>				/* for strcmp */
+#endif
+#if HAVE_UNISTD_H
+# include <unistd.h>				/* for fork */
+#endif
+
+#include "conf.h"
+
+#if HAVE_TIME
+# ifdef TIME_INCLUDE
+#  include TIME_INCLUDE
+# endif
+#endif
+
+#include "dmalloc.h"
+#include "dmalloc_argv.h"
+
+#include "error_val.h"				/* for DMALLOC_ERROR_IN_TWICE */
+
+/* the workloads */
+#define WORK_CHURN		0
+#define WORK_PRODCONS		1
+#define WORK_CACHE		2
+#define WORK_N			3
+
+/* most threads that we run with */
+#define THREAD_MAX		64
+
+/* pointers each thread keeps in the churn workload */
+#define CHURN_SLOTS		1024
+
+/* size of the ring that each thread is handed pointers on */
+#define RING_SIZE		256
+
+/* entries in the shared cache and the number of locks over them */
+#define CACHE_SIZE		16384
+#define CACHE_LOCKS		64
+
+/* one in this many cache lookups replaces the entry */
+#define CACHE_REPLACE		16
+
+/* largest allocation in the workloads */
+#define MAX_SIZE		1024
+
+/* ring of pointers handed to a thread in the prodcons workload */
+typedef struct {
+  pthread_mutex_t	ri_lock;		/* lock of the ring */
+  void			*ri_pnts[RING_SIZE];	/* pointers to free */
+  unsigned int		ri_head;		/* next to take */
+  unsigned int		ri_tail;		/* next to put */
+} ring_t;
+
+/* what a child process sends back to us */
+typedef struct {
+  unsigned long		rs_ops;			/* workload operations */
+  unsigned long		rs_calls;		/* allocation calls */
+  unsigned long		rs_nsecs;		/* elapsed nano-seconds */
+  dmalloc_lock_t	rs_lock;		/* lock information */
+} result_t;
+
+static	char	*work_names[] = { "churn", "prodcons", "cache" };
+
+/* argument variables */
+static	char		*env_string = NULL;	/* env options */
+static	unsigned long	ops_n = 100000;		/* operations per thread */
+static	int		thread_max = 8;		/* most threads */
+static	char		*work_name = NULL;	/* only run this workload */
+
+static	argv_t		arg_list[] = {
+  { 'e',	"env-string",	ARGV_CHAR_P,	&env_string,
+    "string",			"string of env commands to set" },
+  { 'o',	"operations",	ARGV_U_LONG,	&ops_n,
+    "number",			"operations per thread" },
+  { 't',	"threads",	ARGV_INT,	&thread_max,
+    "number",			"most threads to run with" },
+  { 'w',	"workload",	ARGV_CHAR_P,	&work_name,
+    "name",			"churn, prodcons, or cache" },
+  { ARGV_LAST }
+};
+
+/* state shared by the threads of a run */
+static	int		thread_n = 0;
+static	int		work = WORK_CHURN;
+static	ring_t		rings[THREAD_MAX];
+static	void		*cache[CACHE_SIZE];
+static	pthread_mutex_t	cache_locks[CACHE_LOCKS];
+static	unsigned long	call_counts[THREAD_MAX];
+
+/* where the cache lookups go so they are not optimized away */
+static	unsigned long	cache_sums[THREAD_MAX];
+
+/*
+ * Return the current time in nano-seconds.
+ */
+static	unsigned long	nano_now(void)
+{
+#ifdef CLOCK_MONOTONIC
+  struct timespec	now;
+  
+  (void)clock_gettime(CLOCK_MONOTONIC, &now);
+  return (unsigned long)now.tv_sec * 1000000000UL + now.tv_nsec;
+#else
+  return (unsigned long)clock() * (1000000000UL / CLOCKS_PER_SEC);
+#endif
+}
+
+/*
+ * Return the next number from the random state at SEED_P.  Each
+ * thread has its own state so they do not share a lock.
+ */
+static	unsigned long	next_random(unsigned long *seed_p)
+{
+  *seed_p = *seed_p * 6364136223846793005UL + 1442695040888963407UL;
+  return *seed_p >> 33;
+}
+
+/*
+ * Allocate and free private pointers.
+ */
+static	void	work_churn(const int thread_c, unsigned long *seed_p)
+{
+  void		*pnts[CHURN_SLOTS];
+  unsigned long	op_c, calls = 0;
+  int		which;
+  
+  memset(pnts, 0, sizeof(pnts));
+  for (op_c = 0; op_c < ops_n; op_c++) {
+    which = next_random(seed_p) % CHURN_SLOTS;
+    if (pnts[which] != NULL) {
+      free(pnts[which]);
+      calls++;
+    }
+    pnts[which] = malloc(next_random(seed_p) % MAX_SIZE + 1);
+    calls++;
+  }
+  for (which = 0; which < CHURN_SLOTS; which++) {
+    if (pnts[which] != NULL) {
+      free(pnts[which]);
+      calls++;
+    }
+  }
+  call_counts[thread_c] = calls;
+}
+
+/*
+ * Hand our allocations to the next thread and free the ones that the
+ * thread before us handed to us.
+ */
+static	void	work_prodcons(const int thread_c, unsigned long *seed_p)
+{
+  ring_t	*next_p = rings + (thread_c + 1) % thread_n;
+  ring_t	*ours_p = rings + thread_c;
+  void		*pnt;
+  unsigned long	op_c, calls = 0;
+  
+  for (op_c = 0; op_c < ops_n; op_c++) {
+    pnt = malloc(next_random(seed_p) % MAX_SIZE + 1);
+    calls++;
+  
+    pthread_mutex_lock(&next_p->ri_lock);
+    if (next_p->ri_tail - next_p->ri_head < RING_SIZE) {
+      next_p->ri_pnts[next_p->ri_tail++ % RING_SIZE] = pnt;
+      pnt = NULL;
+    }
+    pthread_mutex_unlock(&next_p->ri_lock);
+    /* the ring is full so free it ourselves */
+    if (pnt != NULL) {
+      free(pnt);
+      calls++;
+    }
+  
+    pthread_mutex_lock(&ours_p->ri_lock);
+    if (ours_p->ri_head != ours_p->ri_tail) {
+      pnt = ours_p->ri_pnts[ours_p->ri_head++ % RING_SIZE];
+    }
+    pthread_mutex_unlock(&ours_p->ri_lock);
+    if (pnt != NULL) {
+      free(pnt);
+      calls++;
+    }
+  }
+  call_counts[thread_c] = calls;
+}
+
+/*
+ * Look up entries in the shared cache and sometimes replace them.
+ */
+static	void	work_cache(const int thread_c, unsigned long *seed_p)
+{
+  unsigned long	op_c, calls = 0, sum = 0;
+  int		which;
+  
+  for (op_c = 0; op_c < ops_n; op_c++) {
+    which = next_random(seed_p) % CACHE_SIZE;
+    pthread_mutex_lock(cache_locks + which % CACHE_LOCKS);
+    if (next_random(seed_p) % CACHE_REPLACE == 0) {
+      free(cache[which]);
+      cache[which] = malloc(next_random(seed_p) % MAX_SIZE + 1);
+      calls += 2;
+    }
+    sum += *(unsigned char *)cache[which];
+    pthread_mutex_unlock(cache_locks + which % CACHE_LOCKS);
+  }
+  call_counts[thread_c] = calls;
+  cache_sums[thread_c] = sum;
+}
+
+/*
+ * Start routine of each of the threads.
+ */
+static	void	*thread_start(void *arg)
+{
+  int		thread_c = (int)(long)arg;
+  unsigned long	seed = thread_c * 7919 + 1;
+  
+  switch (work) {
+  case WORK_CHURN:
+    work_churn(thread_c, &seed);
+    break;
+  case WORK_PRODCONS:
+    work_prodcons(thread_c, &seed);
+    break;
+  default:
+    work_cache(thread_c, &seed);
+    break;
+  }
+  return NULL;
+}
+
+/*
+ * Run the workload with thread_n threads and fill in RESULT_P.  This
+ * is called in the child process.
+ */
+static	void	run_threads(result_t *result_p)
+{
+  pthread_t	threads[THREAD_MAX];
+  unsigned long	start, seed = 1;
+  int		thread_c, which;
+  
+  if (env_string != NULL) {
+    dmalloc_debug_setup(env_string);
+  }
+  
+  for (thread_c = 0; thread_c < thread_n; thread_c++) {
+    pthread_mutex_init(&rings[thread_c].ri_lock, NULL);
+  }
+  for (which = 0; which < CACHE_LOCKS; which++) {
+    pthread_mutex_init(cache_locks + which, NULL);
+  }
+  if (work == WORK_CACHE) {
+    for (which = 0; which < CACHE_SIZE; which++) {
+      cache[which] = calloc(1, next_random(&seed) % MAX_SIZE + 1);
+    }
+  }
+  
+  start = nano_now();
+  for (thread_c = 0; thread_c < thread_n; thread_c++) {
+    pthread_create(threads + thread_c, NULL, thread_start,
+		   (void *)(long)thread_c);
+  }
+  for (thread_c = 0; thread_c < thread_n; thread_c++) {
+    pthread_join(threads[thread_c], NULL);
+  }
+  result_p->rs_nsecs = nano_now() - start;
+  
+  result_p->rs_ops = ops_n * thread_n;
+  result_p->rs_calls = 0;
+  for (thread_c = 0; thread_c < thread_n; thread_c++) {
+    result_p->rs_calls += call_counts[thread_c];
+  }
+  dmalloc_get_lock_stats(&result_p->rs_lock);
+}
+
+/*
+ * Run the workload with thread_n threads in a child process.  Returns
+ * 1 on success with RESULT_P filled in, 0 if the child failed with
+ * the error in ERRNO_P or -1 if it failed in some other way.
+ */
+static	int	run_child(result_t *result_p, int *errno_p)
+{
+  int		result_fds[2], error_fds[2], status;
+  char		error_buf[1024], match[32];
+  ssize_t	len;
+  size_t	error_len = 0;
+  pid_t		pid;
+  
+  *errno_p = DMALLOC_ERROR_NONE;
+  if (pipe(result_fds) != 0 || pipe(error_fds) != 0) {
+    return -1;
+  }
+  (void)fflush(stdout);
+  
+  pid = fork();
+  if (pid < 0) {
+    return -1;
+  }
+  if (pid == 0) {
+    /* the library writes its fatal errors to stderr */
+    (void)dup2(error_fds[1], 2);
+    (void)close(result_fds[0]);
+    (void)close(error_fds[0]);
+    run_threads(result_p);
+    (void)write(result_fds[1], result_p, sizeof(*result_p));
+    _exit(0);
+  }
+  
+  (void)close(result_fds[1]);
+  (void)close(error_fds[1]);
+  len = read(result_fds[0], result_p, sizeof(*result_p));
+  while (error_len < sizeof(error_buf) - 1) {
+    ssize_t	got = read(error_fds[0], error_buf + error_len,
+			   sizeof(error_buf) - 1 - error_len);
+    if (got < 0 && errno == EINTR) {
+      continue;
+    }
+    if (got <= 0) {
+      break;
+    }
+    error_len += got;
+  }
+  error_buf[error_len] = '\0';
+  (void)close(result_fds[0]);
+  (void)close(error_fds[0]);
+  (void)waitpid(pid, &status, 0);
+  
+  if (len == sizeof(*result_p) && WIFEXITED(status)
+      && WEXITSTATUS(status) == 0) {
+    return 1;
+  }
+  
+  /* look for the error number that _dmalloc_die prints */
+  (void)snprintf(match, sizeof(match), "(err %d)", DMALLOC_ERROR_IN_TWICE);
+  if (strstr(error_buf, match) != NULL) {
+    *errno_p = DMALLOC_ERROR_IN_TWICE;
+    return 0;
+  }
+  if (error_len > 0) {
+    (void)fprintf(stderr, "%s", error_buf);
+  }
+  return -1;
+}
+
+int	main(int argc, char **argv)
+{
+  result_t	result;
+  double	secs, rate, base_rate = 0.0;
+  unsigned long	in_twice_c = 0;
+  int		ret, child_errno, final = 0;
+  
+  argv_process(arg_list, argc, argv);
+  
+  if (thread_max < 1) {
+    thread_max = 1;
+  }
+  else if (thread_max > THREAD_MAX) {
+    thread_max = THREAD_MAX;
+  }
+  
+  (void)printf("%-8s %7s %12s %7s %9s %9s %8s %9s %8s %8s\n",
+	       "workload", "threads", "ops/sec", "scaling", "locks",
+	       "waits", "wait-ns", "wait-max", "hold-ns", "hold-max");
+  
+  for (work = 0; work < WORK_N; work++) {
+    if (work_name != NULL && strcmp(work_name, work_names[work]) != 0) {
+      continue;
+    }
+  
+    for (thread_n = 1; thread_n <= thread_max; thread_n *= 2) {
+      memset(&result, 0, sizeof(result));
+      ret = run_child(&result, &child_errno);
+      if (ret < 0) {
+	(void)printf("%-8s %7d failed\n", work_names[work], thread_n);
+	final = 1;
+	continue;
+      }
+      if (ret == 0) {
+	(void)printf("%-8s %7d %s\n", work_names[work], thread_n,
+		     dmalloc_strerror(child_errno));
+	in_twice_c++;
+	continue;
+      }
+  
+      secs = (double)result.rs_nsecs / 1000000000.0;
+      rate = (secs > 0.0 ? (double)result.rs_ops / secs : 0.0);
+      if (thread_n == 1) {
+	base_rate = rate;
+      }
+      (void)printf("%-8s %7d %12.0f %6.2fx %9lu %9lu %8lu %9lu %8lu %8lu\n",
+		   work_names[work], thread_n, rate,
+		   (base_rate > 0.0 ? rate / base_rate : 0.0),
+		   result.rs_lock.dl_lock_c, result.rs_lock.dl_wait_c,
+		   (result.rs_lock.dl_wait_c == 0 ? 0UL
+		    : result.rs_lock.dl_wait_nsecs / result.rs_lock.dl_wait_c),
+		   result.rs_lock.dl_wait_max,
+		   (result.rs_lock.dl_lock_c == 0 ? 0UL
+		    : result.rs_lock.dl_hold_nsecs / result.rs_lock.dl_lock_c),
+		   result.rs_lock.dl_hold_max);
+    }
+  }
+  
+  (void)printf("%lu runs failed with %s\n", in_twice_c,
+	       dmalloc_strerror(DMALLOC_ERROR_IN_TWICE));
+  
+  exit(final);
+}
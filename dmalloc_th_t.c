@@ -0,0 +1,334 @@
+/*
+ * Test program for the features of the threaded library
+ *
+ * Copyright 2020 by Gray Watson
+ *
+ * This file is part of the dmalloc package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ *
+ * The author may be contacted via https://dmalloc.com/
+ */
+
+/*
+ * This is linked with the threaded library.  It checks the
+ * asynchronous log writer by logging to a fifo in a child process.
+ * The child fills the pipe before it logs so the writer thread is
+ * stuck until we start reading and the messages pile up in its ring.
+ * The child then shuts down the library and exits so the messages
+ * still in the ring are only read if the shutdown flushed them.
+ */
+
+#include <errno.h>				/* for EINTR */
+#include <fcntl.h>				/* for O_RDONLY */
+#include <poll.h>				/* for poll */
+#include <stdio.h>				/* for printf */
+#include <sys/types.h>
+#include <sys/stat.h>				/* for mkfifo */
+#include <sys/wait.h>				/* for waitpid */
+
+#if HAVE_STDLIB_H
+# include <stdlib.h>				/* for malloc */
+#endif
+#if HAVE_STRING_H
+# include <string.h>				/* for strstr */
+#endif
+#if HAVE_UNISTD_H
+# include <unistd.h>				/* for fork */
+#endif
+
+#include "conf.h"
+
+#include "dmalloc.h"
+#include "dmalloc_argv.h"
+
+/* fifo that the child logs to */
+#define FIFO_PATH		"dmalloc_th_t.fifo"
+
+/* what the messages that we count start with */
+#define MESSAGE_MARK		"async-test "
+
+/* messages the child logs which is more than LOG_ASYNC_RING_SIZE */
+#define FULL_MESSAGES		3000
+
+/* messages the child logs which fit in the ring */
+#define FLUSH_MESSAGES		500
+
+/* size of the lines that the child fills the pipe with */
+#define FILL_SIZE		1024
+
+/* milli-seconds we let the child fill the ring before we read */
+#define FILL_MSECS		200
+
+/* milli-seconds we wait for more of the log before giving up */
+#define READ_MSECS		10000
+
+/* what we read from the log of the child */
+typedef struct {
+  long		lr_message_c;			/* messages we got */
+  long		lr_dropped_c;			/* messages that were dropped */
+  int		lr_order_b;			/* messages were in order */
+  int		lr_status;			/* child's exit status */
+} log_result_t;
+
+/* argument variables */
+static	int	silent_b = 0;			/* print nothing */
+
+static	argv_t		arg_list[] = {
+  { 's',	"silent",	ARGV_BOOL_INT,	&silent_b,
+    NULL,			"do not display messages" },
+  { ARGV_LAST }
+};
+
+/*
+ * Count the messages and the dropped messages in the LEN bytes of log
+ * in BUF which ends with a newline and add them to RESULT_P.  LAST_P
+ * has the number of the last message that we saw.
+ */
+static	void	count_lines(char *buf, const int len, log_result_t *result_p,
+			    long *last_p)
+{
+  char		*line_p, *end_p, *mark_p;
+  unsigned long	dropped_c;
+  long		num;
+  
+  for (line_p = buf; line_p < buf + len; line_p = end_p + 1) {
+    end_p = memchr(line_p, '\n', buf + len - line_p);
+    *end_p = '\0';
+  
+    mark_p = strstr(line_p, MESSAGE_MARK);
+    if (mark_p != NULL) {
+      num = atol(mark_p + strlen(MESSAGE_MARK));
+      if (num <= *last_p) {
+	result_p->lr_order_b = 0;
+      }
+      *last_p = num;
+      result_p->lr_message_c++;
+      continue;
+    }
+  
+    mark_p = strstr(line_p, "async log writer dropped ");
+    if (mark_p != NULL
+	&& sscanf(mark_p, "async log writer dropped %lu", &dropped_c) == 1) {
+      result_p->lr_dropped_c += dropped_c;
+    }
+  }
+}
+
+/*
+ * In a child process, log MESSAGE_N messages through the asynchronous
+ * writer with the POLICY and then shutdown the library.  We read the
+ * log from the fifo after waiting for the child to fill it and fill
+ * in RESULT_P.  Returns 1 on success or 0 on failure.
+ */
+static	int	run_child(const char *policy, const long message_n,
+			  log_result_t *result_p)
+{
+  struct pollfd	pfd;
+  char		buf[8192], env[256];
+  long		last = -1;
+  int		fd, len = 0, ret, message_c;
+  pid_t		pid;
+  void		*pnt;
+  
+  memset(result_p, 0, sizeof(*result_p));
+  result_p->lr_order_b = 1;
+  
+  (void)unlink(FIFO_PATH);
+  if (mkfifo(FIFO_PATH, 0600) != 0) {
+    return 0;
+  }
+  /* the child's open for writing would block without a reader */
+  fd = open(FIFO_PATH, O_RDONLY | O_NONBLOCK);
+  if (fd < 0) {
+    (void)unlink(FIFO_PATH);
+    return 0;
+  }
+  (void)fflush(stdout);
+  
+  pid = fork();
+  if (pid < 0) {
+    (void)close(fd);
+    (void)unlink(FIFO_PATH);
+    return 0;
+  }
+  if (pid == 0) {
+    (void)close(fd);
+    (void)snprintf(env, sizeof(env), "log=%s,asynclog=%s", FIFO_PATH,
+		   policy);
+    dmalloc_debug_setup(env);
+    /* the log is opened and the writer thread started when we leave */
+    pnt = malloc(10);
+    free(pnt);
+    
+    /* fill up the pipe so the writer cannot write anything */
+    fd = open(FIFO_PATH, O_WRONLY | O_NONBLOCK);
+    memset(buf, '-', FILL_SIZE);
+    buf[FILL_SIZE - 1] = '\n';
+    while (fd >= 0 && write(fd, buf, FILL_SIZE) > 0) {
+    }
+    if (fd >= 0) {
+      (void)close(fd);
+    }
+    
+    for (message_c = 0; message_c < message_n; message_c++) {
+      dmalloc_message(MESSAGE_MARK "%d", message_c);
+    }
+    dmalloc_shutdown();
+    _exit(0);
+  }
+  
+  /* let the child fill the ring before we read */
+  (void)poll(NULL, 0, FILL_MSECS);
+  
+  for (;;) {
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, READ_MSECS) <= 0) {
+      break;
+    }
+    ret = read(fd, buf + len, sizeof(buf) - len);
+    if (ret < 0 && (errno == EINTR || errno == EAGAIN)) {
+      continue;
+    }
+    if (ret <= 0) {
+      break;
+    }
+    len += ret;
+  
+    /* count the full lines and keep the rest for the next read */
+    for (ret = len; ret > 0 && buf[ret - 1] != '\n'; ret--) {
+    }
+    count_lines(buf, ret, result_p, &last);
+    len -= ret;
+    memmove(buf, buf + ret, len);
+  }
+  (void)close(fd);
+  (void)unlink(FIFO_PATH);
+  
+  (void)waitpid(pid, &result_p->lr_status, 0);
+  return 1;
+}
+
+/*
+ * Check the asynchronous log writer with the POLICY when its ring
+ * fills up.  Returns 1 on success or 0 on failure.
+ */
+static	int	check_policy(const char *policy)
+{
+  log_result_t	result;
+  int		ok_b = 1;
+  
+  if (! silent_b) {
+    (void)printf("  Checking async log writer %s policy\n", policy);
+  }
+  
+  if (! run_child(policy, FULL_MESSAGES, &result)) {
+    if (! silent_b) {
+      (void)printf("   ERROR: could not run the child process\n");
+    }
+    return 0;
+  }
+  if (! WIFEXITED(result.lr_status) || WEXITSTATUS(result.lr_status) != 0) {
+    if (! silent_b) {
+      (void)printf("   ERROR: child process failed with status %d\n",
+		   result.lr_status);
+    }
+    ok_b = 0;
+  }
+  
+  if (strcmp(policy, "drop") == 0) {
+    /* we must have dropped some and said how many which can include ours */
+    if (result.lr_dropped_c == 0
+	|| result.lr_message_c + result.lr_dropped_c < FULL_MESSAGES) {
+      if (! silent_b) {
+	(void)printf("   ERROR: got %ld messages and %ld dropped, not %d\n",
+		     result.lr_message_c, result.lr_dropped_c, FULL_MESSAGES);
+      }
+      ok_b = 0;
+    }
+  }
+  else if (result.lr_message_c != FULL_MESSAGES || result.lr_dropped_c != 0) {
+    if (! silent_b) {
+      (void)printf("   ERROR: got %ld messages and %ld dropped, not %d\n",
+		   result.lr_message_c, result.lr_dropped_c, FULL_MESSAGES);
+    }
+    ok_b = 0;
+  }
+  
+  /* only the inline policy can write messages out of order */
+  if (strcmp(policy, "inline") != 0 && ! result.lr_order_b) {
+    if (! silent_b) {
+      (void)printf("   ERROR: messages were written out of order\n");
+    }
+    ok_b = 0;
+  }
+  
+  return ok_b;
+}
+
+/*
+ * Check that the messages in the ring are written out when the
+ * library is shutdown.  Returns 1 on success or 0 on failure.
+ */
+static	int	check_flush(void)
+{
+  log_result_t	result;
+  
+  if (! silent_b) {
+    (void)printf("  Checking async log writer flush on shutdown\n");
+  }
+  
+  /* these fit in the ring so they are only written if it is flushed */
+  if (! run_child("drop", FLUSH_MESSAGES, &result)) {
+    if (! silent_b) {
+      (void)printf("   ERROR: could not run the child process\n");
+    }
+    return 0;
+  }
+  if (result.lr_message_c != FLUSH_MESSAGES || ! result.lr_order_b) {
+    if (! silent_b) {
+      (void)printf("   ERROR: got %ld of the %d messages after shutdown\n",
+		   result.lr_message_c, FLUSH_MESSAGES);
+    }
+    return 0;
+  }
+  
+  return 1;
+}
+
+int	main(int argc, char **argv)
+{
+  int	final = 1;
+  
+  argv_process(arg_list, argc, argv);
+  
+  if (! check_policy("block")) {
+    final = 0;
+  }
+  if (! check_policy("drop")) {
+    final = 0;
+  }
+  if (! check_policy("inline")) {
+    final = 0;
+  }
+  if (! check_flush()) {
+    final = 0;
+  }
+  
+  if (final) {
+    exit(0);
+  }
+  else {
+    exit(1);
+  }
+}
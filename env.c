@@ -59,12 +59,48 @@
 #define LOGFILE_LABEL		"log"
 #define START_LABEL		"start"
 #define LIMIT_LABEL		"limit"
+#define BUDGET_LABEL		"budget"
+#define PROFILE_LABEL		"profile"
+#define BINLOG_LABEL		"binlog"
+#define ASYNC_LOG_LABEL		"asynclog"
+#define FLIGHT_LABEL		"flight"
+#define LIVE_STATS_LABEL	"livestats"
+#define DUMP_SIGNAL_LABEL	"dumpsig"
+#define CONTROL_LABEL		"control"
+#define SERVER_LABEL		"server"
+
+/* asynchronous log writer policies */
+#define ASYNC_BLOCK_POLICY	"block"
+#define ASYNC_DROP_POLICY	"drop"
+#define ASYNC_INLINE_POLICY	"inline"
+
+/* budget actions */
+#define BUDGET_LOG_ACTION	"log"
+#define BUDGET_ERROR_ACTION	"error"
+#define BUDGET_FAIL_ACTION	"fail"
 
 #define ASSIGNMENT_CHAR		'='
+#define BUDGET_SEP_CHAR		';'		/* between multiple budgets */
+#define BUDGET_FIELD_CHAR	':'		/* between budget fields */
+#define PROFILE_ITER_CHAR	':'		/* before profile iterations */
+#define FLIGHT_RECS_CHAR	':'		/* before flight records */
+#define DUMP_CHECK_CHAR		':'		/* before dump heap check */
+#define CONTROL_SECS_CHAR	':'		/* before control seconds */
+
+/* signal dump option to also check the heap */
+#define DUMP_CHECK_OPTION	"check"
 
 /* local variables */
 static	char		log_path[512]	= { '\0' }; /* storage for env path */
 static	char		start_file[512] = { '\0' }; /* file to start at */
+static	char		budget_list[512] = { '\0' }; /* all budgets */
+static	char		budget_file[512] = { '\0' }; /* file of a budget */
+static	char		profile_path[512] = { '\0' }; /* heap profile path */
+static	char		binlog_path[512] = { '\0' }; /* binary trans log path */
+static	char		flight_path[512] = { '\0' }; /* flight recorder path */
+static	char		live_path[512] = { '\0' }; /* live statistics path */
+static	char		control_path[512] = { '\0' }; /* control file path */
+static	char		server_path[512] = { '\0' }; /* query socket path */
 
 /****************************** local utilities ******************************/
 
@@ -136,6 +172,39 @@ static	DMALLOC_PNT	hex_to_address(const char *str)
   return (DMALLOC_PNT)ret;
 }
 
+/*
+ * Size STR to long translation with an optional k, m, or g suffix
+ */
+static	unsigned long	size_to_ulong(const char *str)
+{
+  unsigned long	ret;
+  const char	*str_p;
+  
+  ret = loc_atoul(str);
+  
+  /* find the suffix after the digits */
+  for (str_p = str; *str_p == ' ' || *str_p == '\t'; str_p++) {
+  }
+  for (; *str_p >= '0' && *str_p <= '9'; str_p++) {
+  }
+  
+  switch (*str_p) {
+  case 'k': case 'K':
+    ret *= 1024;
+    break;
+  case 'm': case 'M':
+    ret *= 1024 * 1024;
+    break;
+  case 'g': case 'G':
+    ret *= 1024 * 1024 * 1024;
+    break;
+  default:
+    break;
+  }
+  
+  return ret;
+}
+
 /***************************** exported routines *****************************/
 
 /*
@@ -194,6 +263,113 @@ void	_dmalloc_start_break(const char *start_all, char **start_file_p,
   }
 }
 
+/*
+ * Break up the first budget in BUDGET_ALL of the form
+ * file[:line]:size[:action] into FILE_P, LINE_P, LIMIT_P, and
+ * ACTION_P.  Returns a pointer to the next budget in BUDGET_ALL or
+ * NULL if none.
+ */
+const char	*_dmalloc_budget_break(const char *budget_all, char **file_p,
+				       int *line_p, unsigned long *limit_p,
+				       int *action_p)
+{
+  char		*fields[4], *field_p, *action_str;
+  const char	*next_p;
+  int		field_n, len;
+  
+  next_p = strchr(budget_all, BUDGET_SEP_CHAR);
+  if (next_p == NULL) {
+    len = strlen(budget_all);
+  }
+  else {
+    len = next_p - budget_all;
+    next_p++;
+  }
+  len = MIN(len, sizeof(budget_file) - 1);
+  (void)strncpy(budget_file, budget_all, len);
+  budget_file[len] = '\0';
+  
+  /* split up the fields on the colons */
+  field_n = 0;
+  fields[field_n++] = budget_file;
+  for (field_p = budget_file; *field_p != '\0' && field_n < 4; field_p++) {
+    if (*field_p == BUDGET_FIELD_CHAR) {
+      *field_p = '\0';
+      fields[field_n++] = field_p + 1;
+    }
+  }
+  
+  /* the last field may be an action */
+  action_str = fields[field_n - 1];
+  if (field_n > 2 && strcmp(action_str, BUDGET_LOG_ACTION) == 0) {
+    SET_POINTER(action_p, DMALLOC_BUDGET_LOG);
+    field_n--;
+  }
+  else if (field_n > 2 && strcmp(action_str, BUDGET_ERROR_ACTION) == 0) {
+    SET_POINTER(action_p, DMALLOC_BUDGET_ERROR);
+    field_n--;
+  }
+  else if (field_n > 2 && strcmp(action_str, BUDGET_FAIL_ACTION) == 0) {
+    SET_POINTER(action_p, DMALLOC_BUDGET_FAIL);
+    field_n--;
+  }
+  else {
+    SET_POINTER(action_p, DMALLOC_BUDGET_LOG);
+  }
+  
+  SET_POINTER(file_p, budget_file);
+  if (field_n >= 3) {
+    SET_POINTER(line_p, atoi(fields[1]));
+    SET_POINTER(limit_p, size_to_ulong(fields[2]));
+  }
+  else if (field_n == 2) {
+    SET_POINTER(line_p, 0);
+    SET_POINTER(limit_p, size_to_ulong(fields[1]));
+  }
+  else {
+    SET_POINTER(line_p, 0);
+    SET_POINTER(limit_p, 0);
+  }
+  
+  return next_p;
+}
+
+/*
+ * Convert the asynchronous log writer POLICY string into its
+ * ASYNC_LOG_ value.  Returns ASYNC_LOG_BLOCK if the policy is not
+ * known.
+ */
+int	_dmalloc_async_break(const char *policy)
+{
+  if (strcmp(policy, ASYNC_DROP_POLICY) == 0) {
+    return ASYNC_LOG_DROP;
+  }
+  else if (strcmp(policy, ASYNC_INLINE_POLICY) == 0) {
+    return ASYNC_LOG_INLINE;
+  }
+  else {
+    return ASYNC_LOG_BLOCK;
+  }
+}
+
+/*
+ * Returns the policy string for the asynchronous log writer
+ * ASYNC_LOG value or NULL if none.
+ */
+const char	*_dmalloc_async_string(const int async_log)
+{
+  switch (async_log) {
+  case ASYNC_LOG_BLOCK:
+    return ASYNC_BLOCK_POLICY;
+  case ASYNC_LOG_DROP:
+    return ASYNC_DROP_POLICY;
+  case ASYNC_LOG_INLINE:
+    return ASYNC_INLINE_POLICY;
+  default:
+    return NULL;
+  }
+}
+
 /*
  * Process the values of dmalloc environ variable(s) from ENVIRON
  * string.
@@ -206,7 +382,16 @@ void	_dmalloc_environ_process(const char *env_str, DMALLOC_PNT *addr_p,
 				 int *start_line_p,
 				 unsigned long *start_iter_p,
 				 unsigned long *start_size_p,
-				 unsigned long *limit_p)
+				 unsigned long *limit_p, char **budget_p,
+				 char **profile_p,
+				 unsigned long *profile_iter_p,
+				 char **binlog_p, int *async_log_p,
+				 char **flight_p,
+				 unsigned long *flight_recs_p,
+				 char **live_p, int *dump_sig_p,
+				 int *dump_check_p, char **control_p,
+				 unsigned long *control_secs_p,
+				 char **server_p)
 {
   const char	*next_p, *this_p;
   int		len, done_b = 0;
@@ -224,6 +409,20 @@ void	_dmalloc_environ_process(const char *env_str, DMALLOC_PNT *addr_p,
   SET_POINTER(start_iter_p, 0);
   SET_POINTER(start_size_p, 0);
   SET_POINTER(limit_p, 0);
+  SET_POINTER(budget_p, NULL);
+  budget_list[0] = '\0';
+  SET_POINTER(profile_p, NULL);
+  SET_POINTER(profile_iter_p, 0);
+  SET_POINTER(binlog_p, NULL);
+  SET_POINTER(async_log_p, ASYNC_LOG_NONE);
+  SET_POINTER(flight_p, NULL);
+  SET_POINTER(flight_recs_p, 0);
+  SET_POINTER(live_p, NULL);
+  SET_POINTER(dump_sig_p, 0);
+  SET_POINTER(dump_check_p, 0);
+  SET_POINTER(control_p, NULL);
+  SET_POINTER(control_secs_p, 0);
+  SET_POINTER(server_p, NULL);
   
   /* handle each of tokens, in turn */
   for (next_p = env_str, this_p = env_str; ! done_b; next_p++, this_p = next_p) {
@@ -311,6 +510,154 @@ void	_dmalloc_environ_process(const char *env_str, DMALLOC_PNT *addr_p,
       continue;
     }
     
+    /* add a memory budget to the list of budgets */
+    len = strlen(BUDGET_LABEL);
+    if (strncmp(this_p, BUDGET_LABEL, len) == 0
+	&& *(this_p + len) == ASSIGNMENT_CHAR) {
+      int	list_len;
+      
+      this_p += len + 1;
+      list_len = strlen(budget_list);
+      if (list_len > 0 && list_len < sizeof(budget_list) - 1) {
+	budget_list[list_len++] = BUDGET_SEP_CHAR;
+      }
+      len = MIN(next_p - this_p, sizeof(budget_list) - 1 - list_len);
+      (void)strncpy(budget_list + list_len, this_p, len);
+      budget_list[list_len + len] = '\0';
+      SET_POINTER(budget_p, budget_list);
+      continue;
+    }
+    
+    /* get the heap profile path and the optional iterations */
+    len = strlen(PROFILE_LABEL);
+    if (strncmp(this_p, PROFILE_LABEL, len) == 0
+	&& *(this_p + len) == ASSIGNMENT_CHAR) {
+      char	*iter_p;
+      
+      this_p += len + 1;
+      len = MIN(next_p - this_p, sizeof(profile_path) - 1);
+      (void)strncpy(profile_path, this_p, len);
+      profile_path[len] = '\0';
+      
+      /* path:iterations writes a profile every so many iterations */
+      iter_p = strrchr(profile_path, PROFILE_ITER_CHAR);
+      if (iter_p != NULL && *(iter_p + 1) >= '0' && *(iter_p + 1) <= '9') {
+	*iter_p = '\0';
+	SET_POINTER(profile_iter_p, loc_atoul(iter_p + 1));
+      }
+      SET_POINTER(profile_p, profile_path);
+      continue;
+    }
+    
+    /* get the binary transaction log path */
+    len = strlen(BINLOG_LABEL);
+    if (strncmp(this_p, BINLOG_LABEL, len) == 0
+	&& *(this_p + len) == ASSIGNMENT_CHAR) {
+      this_p += len + 1;
+      len = MIN(next_p - this_p, sizeof(binlog_path) - 1);
+      (void)strncpy(binlog_path, this_p, len);
+      binlog_path[len] = '\0';
+      SET_POINTER(binlog_p, binlog_path);
+      continue;
+    }
+    
+    /* get the asynchronous log writer policy */
+    len = strlen(ASYNC_LOG_LABEL);
+    if (strncmp(this_p, ASYNC_LOG_LABEL, len) == 0
+	&& *(this_p + len) == ASSIGNMENT_CHAR) {
+      char	policy[32];
+      
+      this_p += len + 1;
+      len = MIN(next_p - this_p, sizeof(policy) - 1);
+      (void)strncpy(policy, this_p, len);
+      policy[len] = '\0';
+      SET_POINTER(async_log_p, _dmalloc_async_break(policy));
+      continue;
+    }
+    
+    /* get the flight recorder path and the optional number of records */
+    len = strlen(FLIGHT_LABEL);
+    if (strncmp(this_p, FLIGHT_LABEL, len) == 0
+	&& *(this_p + len) == ASSIGNMENT_CHAR) {
+      char	*recs_p;
+      
+      this_p += len + 1;
+      len = MIN(next_p - this_p, sizeof(flight_path) - 1);
+      (void)strncpy(flight_path, this_p, len);
+      flight_path[len] = '\0';
+      
+      recs_p = strrchr(flight_path, FLIGHT_RECS_CHAR);
+      if (recs_p != NULL && *(recs_p + 1) >= '0' && *(recs_p + 1) <= '9') {
+	*recs_p = '\0';
+	SET_POINTER(flight_recs_p, loc_atoul(recs_p + 1));
+      }
+      SET_POINTER(flight_p, flight_path);
+      continue;
+    }
+    
+    /* get the live statistics path */
+    len = strlen(LIVE_STATS_LABEL);
+    if (strncmp(this_p, LIVE_STATS_LABEL, len) == 0
+	&& *(this_p + len) == ASSIGNMENT_CHAR) {
+      this_p += len + 1;
+      len = MIN(next_p - this_p, sizeof(live_path) - 1);
+      (void)strncpy(live_path, this_p, len);
+      live_path[len] = '\0';
+      SET_POINTER(live_p, live_path);
+      continue;
+    }
+    
+    /* get the dump signal and whether to also check the heap */
+    len = strlen(DUMP_SIGNAL_LABEL);
+    if (strncmp(this_p, DUMP_SIGNAL_LABEL, len) == 0
+	&& *(this_p + len) == ASSIGNMENT_CHAR) {
+      const char	*check_p;
+      
+      this_p += len + 1;
+      SET_POINTER(dump_sig_p, atoi(this_p));
+      
+      /* signal:check also checks the heap with each dump */
+      len = strlen(DUMP_CHECK_OPTION);
+      check_p = next_p - len - 1;
+      if (check_p > this_p && *check_p == DUMP_CHECK_CHAR
+	  && strncmp(check_p + 1, DUMP_CHECK_OPTION, len) == 0) {
+	SET_POINTER(dump_check_p, 1);
+      }
+      continue;
+    }
+    
+    /* get the control file path and the optional seconds between checks */
+    len = strlen(CONTROL_LABEL);
+    if (strncmp(this_p, CONTROL_LABEL, len) == 0
+	&& *(this_p + len) == ASSIGNMENT_CHAR) {
+      char	*secs_p;
+      
+      this_p += len + 1;
+      len = MIN(next_p - this_p, sizeof(control_path) - 1);
+      (void)strncpy(control_path, this_p, len);
+      control_path[len] = '\0';
+      
+      secs_p = strrchr(control_path, CONTROL_SECS_CHAR);
+      if (secs_p != NULL && *(secs_p + 1) >= '0' && *(secs_p + 1) <= '9') {
+	*secs_p = '\0';
+	SET_POINTER(control_secs_p, loc_atoul(secs_p + 1));
+      }
+      SET_POINTER(control_p, control_path);
+      continue;
+    }
+    
+    /* get the query server socket path */
+    len = strlen(SERVER_LABEL);
+    if (strncmp(this_p, SERVER_LABEL, len) == 0
+	&& *(this_p + len) == ASSIGNMENT_CHAR) {
+      this_p += len + 1;
+      len = MIN(next_p - this_p, sizeof(server_path) - 1);
+      (void)strncpy(server_path, this_p, len);
+      server_path[len] = '\0';
+      SET_POINTER(server_p, server_path);
+      continue;
+    }
+    
     /* need to check the short/long debug options */
     len = next_p - this_p;
     for (attr_p = attributes; attr_p->at_string != NULL; attr_p++) {
@@ -350,7 +697,16 @@ void	_dmalloc_environ_set(char *buf, const int buf_size,
 			     const int start_line,
 			     const unsigned long start_iter,
 			     const unsigned long start_size,
-			     const unsigned long limit_val)
+			     const unsigned long limit_val,
+			     const char *budget, const char *profile,
+			     const unsigned long profile_iter,
+			     const char *binlog, const int async_log,
+			     const char *flight,
+			     const unsigned long flight_recs,
+			     const char *live, const int dump_sig,
+			     const int dump_check_b, const char *control,
+			     const unsigned long control_secs,
+			     const char *server)
 {
   char	*buf_p = buf, *bounds_p = buf + buf_size;
   
@@ -417,6 +773,83 @@ void	_dmalloc_environ_set(char *buf, const int buf_size,
     buf_p += loc_snprintf(buf_p, bounds_p - buf_p, "%s%c%lu,",
 			  LIMIT_LABEL, ASSIGNMENT_CHAR, limit_val);
   }
+  if (budget != NULL) {
+    const char	*budget_p, *sep_p;
+    
+    /* write each of the budgets as its own token */
+    for (budget_p = budget; *budget_p != '\0'; budget_p = sep_p + 1) {
+      sep_p = strchr(budget_p, BUDGET_SEP_CHAR);
+      if (sep_p == NULL) {
+	buf_p += loc_snprintf(buf_p, bounds_p - buf_p, "%s%c%s,",
+			      BUDGET_LABEL, ASSIGNMENT_CHAR, budget_p);
+	break;
+      }
+      buf_p += loc_snprintf(buf_p, bounds_p - buf_p, "%s%c%.*s,",
+			    BUDGET_LABEL, ASSIGNMENT_CHAR,
+			    (int)(sep_p - budget_p), budget_p);
+    }
+  }
+  if (profile != NULL) {
+    if (profile_iter > 0) {
+      buf_p += loc_snprintf(buf_p, bounds_p - buf_p, "%s%c%s%c%lu,",
+			    PROFILE_LABEL, ASSIGNMENT_CHAR, profile,
+			    PROFILE_ITER_CHAR, profile_iter);
+    }
+    else {
+      buf_p += loc_snprintf(buf_p, bounds_p - buf_p, "%s%c%s,",
+			    PROFILE_LABEL, ASSIGNMENT_CHAR, profile);
+    }
+  }
+  if (binlog != NULL) {
+    buf_p += loc_snprintf(buf_p, bounds_p - buf_p, "%s%c%s,",
+			  BINLOG_LABEL, ASSIGNMENT_CHAR, binlog);
+  }
+  if (async_log != ASYNC_LOG_NONE) {
+    buf_p += loc_snprintf(buf_p, bounds_p - buf_p, "%s%c%s,",
+			  ASYNC_LOG_LABEL, ASSIGNMENT_CHAR,
+			  _dmalloc_async_string(async_log));
+  }
+  if (flight != NULL) {
+    if (flight_recs > 0) {
+      buf_p += loc_snprintf(buf_p, bounds_p - buf_p, "%s%c%s%c%lu,",
+			    FLIGHT_LABEL, ASSIGNMENT_CHAR, flight,
+			    FLIGHT_RECS_CHAR, flight_recs);
+    }
+    else {
+      buf_p += loc_snprintf(buf_p, bounds_p - buf_p, "%s%c%s,",
+			    FLIGHT_LABEL, ASSIGNMENT_CHAR, flight);
+    }
+  }
+  if (live != NULL) {
+    buf_p += loc_snprintf(buf_p, bounds_p - buf_p, "%s%c%s,",
+			  LIVE_STATS_LABEL, ASSIGNMENT_CHAR, live);
+  }
+  if (dump_sig > 0) {
+    if (dump_check_b) {
+      buf_p += loc_snprintf(buf_p, bounds_p - buf_p, "%s%c%d%c%s,",
+			    DUMP_SIGNAL_LABEL, ASSIGNMENT_CHAR, dump_sig,
+			    DUMP_CHECK_CHAR, DUMP_CHECK_OPTION);
+    }
+    else {
+      buf_p += loc_snprintf(buf_p, bounds_p - buf_p, "%s%c%d,",
+			    DUMP_SIGNAL_LABEL, ASSIGNMENT_CHAR, dump_sig);
+    }
+  }
+  if (control != NULL) {
+    if (control_secs > 0) {
+      buf_p += loc_snprintf(buf_p, bounds_p - buf_p, "%s%c%s%c%lu,",
+			    CONTROL_LABEL, ASSIGNMENT_CHAR, control,
+			    CONTROL_SECS_CHAR, control_secs);
+    }
+    else {
+      buf_p += loc_snprintf(buf_p, bounds_p - buf_p, "%s%c%s,",
+			    CONTROL_LABEL, ASSIGNMENT_CHAR, control);
+    }
+  }
+  if (server != NULL) {
+    buf_p += loc_snprintf(buf_p, bounds_p - buf_p, "%s%c%s,",
+			  SERVER_LABEL, ASSIGNMENT_CHAR, server);
+  }
   
   /* cut off the last comma */
   if (buf_p > buf) {
@@ -39,6 +39,32 @@ void	_dmalloc_start_break(const char *start_all, char **start_file_p,
 			     int *start_line_p, unsigned long *start_iter_p,
 			     unsigned long *start_size_p);
 
+/*
+ * Break up the first budget in BUDGET_ALL of the form
+ * file[:line]:size[:action] into FILE_P, LINE_P, LIMIT_P, and
+ * ACTION_P.  Returns a pointer to the next budget in BUDGET_ALL or
+ * NULL if none.
+ */
+extern
+const char	*_dmalloc_budget_break(const char *budget_all, char **file_p,
+				       int *line_p, unsigned long *limit_p,
+				       int *action_p);
+
+/*
+ * Convert the asynchronous log writer POLICY string into its
+ * ASYNC_LOG_ value.  Returns ASYNC_LOG_BLOCK if the policy is not
+ * known.
+ */
+extern
+int	_dmalloc_async_break(const char *policy);
+
+/*
+ * Returns the policy string for the asynchronous log writer
+ * ASYNC_LOG value or NULL if none.
+ */
+extern
+const char	*_dmalloc_async_string(const int async_log);
+
 /*
  * Process the values of dmalloc environ variable(s) from ENVIRON
  * string.
@@ -52,7 +78,16 @@ void	_dmalloc_environ_process(const char *env_str, DMALLOC_PNT *addr_p,
 				 int *start_line_p,
 				 unsigned long *start_iter_p,
 				 unsigned long *start_size_p,
-				 unsigned long *limit_p);
+				 unsigned long *limit_p, char **budget_p,
+				 char **profile_p,
+				 unsigned long *profile_iter_p,
+				 char **binlog_p, int *async_log_p,
+				 char **flight_p,
+				 unsigned long *flight_recs_p,
+				 char **live_p, int *dump_sig_p,
+				 int *dump_check_p, char **control_p,
+				 unsigned long *control_secs_p,
+				 char **server_p);
 
 /*
  * Set dmalloc environ variable(s) with the values (maybe SHORT debug
@@ -69,7 +104,16 @@ void	_dmalloc_environ_set(char *buf, const int buf_size,
 			     const int start_line,
 			     const unsigned long start_iter,
 			     const unsigned long start_size,
-			     const unsigned long limit_val);
+			     const unsigned long limit_val,
+			     const char *budget, const char *profile,
+			     const unsigned long profile_iter,
+			     const char *binlog, const int async_log,
+			     const char *flight,
+			     const unsigned long flight_recs,
+			     const char *live, const int dump_sig,
+			     const int dump_check_b, const char *control,
+			     const unsigned long control_secs,
+			     const char *server);
 
 /*<<<<<<<<<<   This is end of the auto-generated output from fillproto. */
 
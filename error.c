@@ -35,6 +35,9 @@
 #if HAVE_STDLIB_H
 # include <stdlib.h>				/* for abort */
 #endif
+#if HAVE_STRING_H
+# include <string.h>				/* for memcpy */
+#endif
 #if HAVE_UNISTD_H
 # include <unistd.h>				/* for _exit */
 #endif
@@ -60,12 +63,28 @@
 # endif
 #endif
 
+#if LOCK_THREADS && LOG_ASYNC_WRITER && defined(__ATOMIC_ACQUIRE)
+# define ASYNC_WRITER	1
+#else
+# define ASYNC_WRITER	0
+#endif
+
+#if ASYNC_WRITER
+# include <errno.h>				/* for EINTR */
+# include <pthread.h>				/* for pthread_create */
+# include <sched.h>				/* for sched_yield */
+# include <sys/uio.h>				/* for writev */
+# include <time.h>				/* for nanosleep */
+#endif
+
 #define DMALLOC_DISABLE
 
 #include "dmalloc.h"
 
 #include "append.h"
+#include "binlog.h"
 #include "chunk.h"				/* for _dmalloc_memory_limit */
+#include "clock.h"
 #include "compat.h"
 #include "debug_tok.h"
 #include "env.h"				/* for LOGPATH_INIT */
@@ -86,6 +105,8 @@ static char *information = "@(#) $Information: lock-threads is enabled $";
 #define SECS_IN_MIN	60
 #define SECS_IN_HOUR	(MINS_IN_HOUR * SECS_IN_MIN)
 
+#define MESSAGE_SIZE	1024			/* largest log message */
+
 /* external routines */
 extern	const char	*dmalloc_strerror(const int errnum);
 
@@ -125,10 +146,338 @@ int		_dmalloc_lock_on = 0;
 /* global flag which indicates when we are aborting */
 int		_dmalloc_aborting_b = 0;
 
+/* what the asynchronous log writer does when full or ASYNC_LOG_NONE */
+int		_dmalloc_async_log = ASYNC_LOG_NONE;
+
 /* local variables */
 static	int	outfile_fd = -1;		/* output file descriptor */
 /* the following are here to reduce stack overhead */
-static	char	message_str[1024];		/* message string buffer */
+static	char	message_str[MESSAGE_SIZE];	/* message string buffer */
+
+/************************** asynchronous log writer **************************/
+
+#if ASYNC_WRITER
+
+/* states of the writer thread */
+#define ASYNC_STOPPED	0
+#define ASYNC_STARTING	1
+#define ASYNC_RUNNING	2
+#define ASYNC_FAILED	3
+
+/* where a message in the ring should be written */
+#define ASYNC_TO_LOG	BIT_FLAG(0)
+#define ASYNC_TO_STDERR	BIT_FLAG(1)
+
+/* most messages that the writer gathers into one writev call */
+#define ASYNC_BATCH_MAX	64
+
+/*
+ * A message in the ring.  The sequence number says whether the slot
+ * is free for the producer at that position or whether it holds a
+ * message for the writer.
+ */
+typedef struct {
+  unsigned long	as_seq;				/* sequence of the slot */
+  int		as_len;				/* length of the message */
+  int		as_flags;			/* ASYNC_TO_ where to write */
+  char		as_msg[MESSAGE_SIZE];		/* the message itself */
+} async_slot_t;
+
+static	async_slot_t	async_ring[LOG_ASYNC_RING_SIZE]; /* message ring */
+static	unsigned long	async_head = 0;		/* next slot to write out */
+static	unsigned long	async_tail = 0;		/* next slot to fill in */
+static	unsigned long	async_dropped_c = 0;	/* messages dropped */
+static	int		async_state = ASYNC_STOPPED; /* state of the writer */
+#if HAVE_GETPID
+static	long		async_pid = -1;		/* process of the writer */
+#endif
+
+/*
+ * static int async_running
+ *
+ * Returns 1 if the writer thread is running in this process else 0.
+ */
+static	int	async_running(void)
+{
+  if (__atomic_load_n(&async_state, __ATOMIC_ACQUIRE) != ASYNC_RUNNING) {
+    return 0;
+  }
+#if HAVE_GETPID
+  /* the writer thread does not survive a fork */
+  if (getpid() != async_pid) {
+    return 0;
+  }
+#endif
+  return 1;
+}
+
+/*
+ * static void async_nap
+ *
+ * Sleep for a bit while waiting for the ring.
+ *
+ * ARGUMENTS:
+ *
+ * usecs -> Number of micro-seconds to sleep.
+ */
+static	void	async_nap(const long usecs)
+{
+  struct timespec	nap;
+  
+  nap.tv_sec = usecs / 1000000;
+  nap.tv_nsec = (usecs % 1000000) * 1000L;
+  (void)nanosleep(&nap, NULL);
+}
+
+/*
+ * static void async_writev
+ *
+ * Write all of the messages in a batch handling any short writes.
+ *
+ * ARGUMENTS:
+ *
+ * fd -> File descriptor to write to.
+ *
+ * iov -> Array of the messages which we change as we write them.
+ *
+ * iov_c -> Number of messages in the array.
+ */
+static	void	async_writev(const int fd, struct iovec *iov, int iov_c)
+{
+  ssize_t	ret;
+  
+  while (iov_c > 0) {
+    ret = writev(fd, iov, iov_c);
+    if (ret < 0 && errno == EINTR) {
+      continue;
+    }
+    if (ret <= 0) {
+      return;
+    }
+    
+    /* skip over the messages that were written and then part of the next */
+    while (iov_c > 0 && (size_t)ret >= iov->iov_len) {
+      ret -= iov->iov_len;
+      iov++;
+      iov_c--;
+    }
+    if (iov_c > 0) {
+      iov->iov_base = (char *)iov->iov_base + ret;
+      iov->iov_len -= ret;
+    }
+  }
+}
+
+/*
+ * static int async_queue
+ *
+ * Copy a message into the ring for the writer thread.  Multiple
+ * threads can add messages at the same time without locking.
+ *
+ * Returns 1 if the message was handled or 0 if the caller needs to
+ * write it.
+ *
+ * ARGUMENTS:
+ *
+ * msg -> Message to write.
+ *
+ * len -> Length of the message.
+ *
+ * flags -> ASYNC_TO_ flags of where to write the message.
+ */
+static	int	async_queue(const char *msg, const int len, const int flags)
+{
+  async_slot_t	*slot_p;
+  unsigned long	pos, seq;
+  
+  if (! async_running()) {
+    return 0;
+  }
+  
+  pos = __atomic_load_n(&async_tail, __ATOMIC_RELAXED);
+  for (;;) {
+    slot_p = async_ring + (pos % LOG_ASYNC_RING_SIZE);
+    seq = __atomic_load_n(&slot_p->as_seq, __ATOMIC_ACQUIRE);
+    if (seq == pos) {
+      /* the slot is free so try to claim it, this updates pos if not */
+      if (__atomic_compare_exchange_n(&async_tail, &pos, pos + 1,
+				      1 /* weak */, __ATOMIC_RELAXED,
+				      __ATOMIC_RELAXED)) {
+	break;
+      }
+    }
+    else if ((long)(seq - pos) < 0) {
+      /* the ring is full */
+      if (_dmalloc_async_log == ASYNC_LOG_DROP) {
+	(void)__atomic_add_fetch(&async_dropped_c, 1, __ATOMIC_RELAXED);
+	return 1;
+      }
+      if (_dmalloc_async_log == ASYNC_LOG_INLINE) {
+	return 0;
+      }
+      (void)sched_yield();
+      pos = __atomic_load_n(&async_tail, __ATOMIC_RELAXED);
+    }
+    else {
+      /* another thread claimed the slot */
+      pos = __atomic_load_n(&async_tail, __ATOMIC_RELAXED);
+    }
+  }
+  
+  memcpy(slot_p->as_msg, msg, len);
+  slot_p->as_len = len;
+  slot_p->as_flags = flags;
+  /* hand the slot to the writer */
+  __atomic_store_n(&slot_p->as_seq, pos + 1, __ATOMIC_RELEASE);
+  
+  return 1;
+}
+
+/*
+ * static void *async_writer
+ *
+ * Writer thread which writes the messages from the ring in batches.
+ *
+ * Returns NULL but never returns.
+ *
+ * ARGUMENTS:
+ *
+ * arg -> Unused thread argument.
+ */
+static	void	*async_writer(void *arg)
+{
+  struct iovec	log_iov[ASYNC_BATCH_MAX], err_iov[ASYNC_BATCH_MAX];
+  async_slot_t	*slot_p;
+  unsigned long	head, pos, dropped_c;
+  long		nap_usecs = LOG_ASYNC_IDLE_USECS;
+  int		slot_c, log_c, err_c, len;
+  char		drop_msg[128];
+  
+  for (;;) {
+    head = __atomic_load_n(&async_head, __ATOMIC_RELAXED);
+    
+    /* gather the messages that are ready */
+    log_c = 0;
+    err_c = 0;
+    for (slot_c = 0, pos = head; slot_c < ASYNC_BATCH_MAX; slot_c++, pos++) {
+      slot_p = async_ring + (pos % LOG_ASYNC_RING_SIZE);
+      if (__atomic_load_n(&slot_p->as_seq, __ATOMIC_ACQUIRE) != pos + 1) {
+	break;
+      }
+      if (BIT_IS_SET(slot_p->as_flags, ASYNC_TO_LOG)) {
+	log_iov[log_c].iov_base = slot_p->as_msg;
+	log_iov[log_c].iov_len = slot_p->as_len;
+	log_c++;
+      }
+      if (BIT_IS_SET(slot_p->as_flags, ASYNC_TO_STDERR)) {
+	err_iov[err_c].iov_base = slot_p->as_msg;
+	err_iov[err_c].iov_len = slot_p->as_len;
+	err_c++;
+      }
+    }
+    
+    if (log_c > 0 && outfile_fd >= 0) {
+      async_writev(outfile_fd, log_iov, log_c);
+    }
+    if (err_c > 0) {
+      async_writev(STDERR, err_iov, err_c);
+    }
+    
+    /* let the log know if messages were dropped because we were full */
+    dropped_c = __atomic_exchange_n(&async_dropped_c, 0, __ATOMIC_RELAXED);
+    if (dropped_c > 0 && outfile_fd >= 0) {
+      len = loc_snprintf(drop_msg, sizeof(drop_msg),
+			 "async log writer dropped %lu messages\n",
+			 dropped_c);
+      log_iov[0].iov_base = drop_msg;
+      log_iov[0].iov_len = len;
+      async_writev(outfile_fd, log_iov, 1);
+    }
+    
+    if (slot_c == 0) {
+      /* back off while the ring stays empty so an idle writer rarely wakes */
+      async_nap(nap_usecs);
+      nap_usecs = MIN(nap_usecs * 2, LOG_ASYNC_IDLE_MAX_USECS);
+      continue;
+    }
+    nap_usecs = LOG_ASYNC_IDLE_USECS;
+    
+    /* give the slots back to the producers for their next lap */
+    for (pos = head; pos < head + slot_c; pos++) {
+      __atomic_store_n(&async_ring[pos % LOG_ASYNC_RING_SIZE].as_seq,
+		       pos + LOG_ASYNC_RING_SIZE, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&async_head, head + slot_c, __ATOMIC_RELEASE);
+  }
+  
+  /*NOTREACHED*/
+  return NULL;
+}
+
+#endif /* ASYNC_WRITER */
+
+/*
+ * void _dmalloc_async_start
+ *
+ * Start the asynchronous log writer thread if it has not been
+ * started already.  This must be called outside of the library lock
+ * since creating the thread may allocate memory.
+ */
+void	_dmalloc_async_start(void)
+{
+#if ASYNC_WRITER
+  pthread_t	thread;
+  int		state = ASYNC_STOPPED, slot_c;
+  
+  /* quick check so we can be called on every library call */
+  if (async_state != ASYNC_STOPPED) {
+    return;
+  }
+  /* only one thread gets to start the writer */
+  if (! __atomic_compare_exchange_n(&async_state, &state, ASYNC_STARTING,
+				    0 /* strong */, __ATOMIC_ACQ_REL,
+				    __ATOMIC_ACQUIRE)) {
+    return;
+  }
+  
+  for (slot_c = 0; slot_c < LOG_ASYNC_RING_SIZE; slot_c++) {
+    async_ring[slot_c].as_seq = slot_c;
+  }
+  async_head = 0;
+  async_tail = 0;
+#if HAVE_GETPID
+  async_pid = getpid();
+#endif
+  
+  if (pthread_create(&thread, NULL, async_writer, NULL) != 0) {
+    __atomic_store_n(&async_state, ASYNC_FAILED, __ATOMIC_RELEASE);
+    dmalloc_message("could not start the asynchronous log writer");
+    return;
+  }
+  (void)pthread_detach(thread);
+  
+  __atomic_store_n(&async_state, ASYNC_RUNNING, __ATOMIC_RELEASE);
+#endif
+}
+
+/*
+ * void _dmalloc_async_flush
+ *
+ * Wait for the asynchronous log writer to write out all of the
+ * messages in its ring.
+ */
+void	_dmalloc_async_flush(void)
+{
+#if ASYNC_WRITER
+  if (! async_running()) {
+    return;
+  }
+  while (__atomic_load_n(&async_head, __ATOMIC_ACQUIRE)
+	 != __atomic_load_n(&async_tail, __ATOMIC_ACQUIRE)) {
+    async_nap(LOG_ASYNC_IDLE_USECS);
+  }
+#endif
+}
 
 /*
  * void _dmalloc_open_log
@@ -198,7 +547,7 @@ static	void	build_logfile_path(char *buf, const int buf_len)
 #if HAVE_TIME
       /* we make time a long here so it will promote */
       long	now;
-      now = time(NULL);
+      now = _dmalloc_clock_seconds();
       buf_p = append_long(buf_p, bounds_p, now, 10);
 #else
       buf_p = append_string(buf_p, bounds_p, "no-time");
@@ -321,6 +670,9 @@ void	_dmalloc_reopen_log(void)
 		     dmalloc_logpath);
   }
   
+  /* the writer needs to finish with the old file */
+  _dmalloc_async_flush();
+  
   (void)close(outfile_fd);
   outfile_fd = -1;
   /* we don't call open here, we'll let the next message do it */
@@ -421,21 +773,21 @@ char	*_dmalloc_ptime(const TIME_TYPE *time_p, char *buf, const int buf_size,
 #endif
 
 /*
- * void _dmalloc_vmessage
+ * static void vmessage
  *
  * Message writer with vprintf like arguments which adds a line to the
  * dmalloc logfile.
  *
- * NOTE: An internal snprintf has been implemented which doesn't support all
- * formats.  This was done to stop dmalloc from going recursive.  YMMV.
- *
  * ARGUMENTS:
  *
+ * desc_p -> Pre-parsed format or NULL to parse the format.
+ *
  * format -> Printf-style format statement.
  *
  * args -> Already converted pointer to a stdarg list.
  */
-void	_dmalloc_vmessage(const char *format, va_list args)
+static	void	vmessage(append_format_t *desc_p, const char *format,
+			 va_list args)
 {
   char	*str_p, *bounds_p;
   int	len;
@@ -490,19 +842,14 @@ void	_dmalloc_vmessage(const char *format, va_list args)
 #if LOG_TIME_NUMBER
   {
     long	now;
-    now = time(NULL);
+    now = _dmalloc_clock_seconds();
     str_p = append_format(str_p, bounds_p, "%ld: ", now);
   }
 #endif /* LOG_TIME_NUMBER */
-#if HAVE_CTIME
 #if LOG_CTIME_STRING
-  {
-    TIME_TYPE	now;
-    now = time(NULL);
-    str_p = append_format(str_p, bounds_p, "%.24s: ", ctime(&now));
-  }
+  str_p = append_string(str_p, bounds_p, _dmalloc_clock_ctime());
+  str_p = append_string(str_p, bounds_p, ": ");
 #endif /* LOG_CTIME_STRING */
-#endif /* HAVE_CTIME */
 #endif /* HAVE_TIME */
   
 #if LOG_ITERATION
@@ -527,7 +874,12 @@ void	_dmalloc_vmessage(const char *format, va_list args)
   
   /* write the format + info into str */
   char *start_p = str_p;
-  str_p = append_vformat(str_p, bounds_p, format, args);
+  if (desc_p == NULL) {
+    str_p = append_vformat(str_p, bounds_p, format, args);
+  }
+  else {
+    str_p = append_vformat_desc(str_p, bounds_p, desc_p, format, args);
+  }
   
   /* was it an empty format? */
   if (str_p == start_p) {
@@ -541,6 +893,23 @@ void	_dmalloc_vmessage(const char *format, va_list args)
   }
   len = str_p - message_str;
   
+#if ASYNC_WRITER
+  /* hand the message off to the asynchronous writer */
+  if (_dmalloc_async_log != ASYNC_LOG_NONE) {
+    int	flags = 0;
+    
+    if (dmalloc_logpath != NULL) {
+      BIT_SET(flags, ASYNC_TO_LOG);
+    }
+    if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_PRINT_MESSAGES)) {
+      BIT_SET(flags, ASYNC_TO_STDERR);
+    }
+    if (async_queue(message_str, len, flags)) {
+      return;
+    }
+  }
+#endif
+  
   /* do we need to write the message to the logfile */
   if (dmalloc_logpath != NULL) {
     (void)write(outfile_fd, message_str, len);
@@ -552,6 +921,58 @@ void	_dmalloc_vmessage(const char *format, va_list args)
   }
 }
 
+/*
+ * void _dmalloc_vmessage
+ *
+ * Message writer with vprintf like arguments which adds a line to the
+ * dmalloc logfile.
+ *
+ * NOTE: An internal snprintf has been implemented which doesn't support all
+ * formats.  This was done to stop dmalloc from going recursive.  YMMV.
+ *
+ * ARGUMENTS:
+ *
+ * format -> Printf-style format statement.
+ *
+ * args -> Already converted pointer to a stdarg list.
+ */
+void	_dmalloc_vmessage(const char *format, va_list args)
+{
+  unsigned long	cost;
+  
+  COST_START(cost);
+  vmessage(NULL, format, args);
+  COST_STOP(DMALLOC_COST_LOG, cost);
+}
+
+/*
+ * void _dmalloc_desc_message
+ *
+ * Message writer with printf like arguments which adds a line to the
+ * dmalloc logfile.  The format is only parsed the first time into
+ * desc_p which saves time for the messages which are written for each
+ * transaction.  This should only be called with the library locked.
+ *
+ * ARGUMENTS:
+ *
+ * desc_p -> Pre-parsed format that the caller keeps in a static.
+ *
+ * format -> Printf-style format statement which must be a constant.
+ *
+ * ... -> Variable argument list.
+ */
+void	_dmalloc_desc_message(append_format_t *desc_p, const char *format, ...)
+{
+  va_list	args;
+  unsigned long	cost;
+  
+  COST_START(cost);
+  va_start(args, format);
+  vmessage(desc_p, format, args);
+  va_end(args);
+  COST_STOP(DMALLOC_COST_LOG, cost);
+}
+
 /*
  * void _dmalloc_die
  *
@@ -587,6 +1008,16 @@ void	_dmalloc_die(const int silent_b)
   /* set this in case the following generates a recursive call for some reason */
   _dmalloc_aborting_b = 1;
   
+  /* make sure that the log messages make it out before we go */
+  _dmalloc_async_flush();
+  /*
+   * the dump child shares the binary log descriptor with the parent
+   * which flushes its own records so only the dying process writes
+   */
+  if (! silent_b) {
+    _dmalloc_binlog_flush();
+  }
+  
   /* do I need to drop core? */
   if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_ERROR_ABORT)
       || BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_ERROR_DUMP)) {
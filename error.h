@@ -25,6 +25,7 @@
 #include <stdarg.h>				/* for ... */
 
 #include "conf.h"				/* up here for _INCLUDE */
+#include "append.h"				/* for append_format_t */
 
 /* for time type -- see settings.h */
 #if STORE_TIME
@@ -84,6 +85,29 @@ int		_dmalloc_lock_on;
 extern
 int		_dmalloc_aborting_b;
 
+/* what the asynchronous log writer does when full or ASYNC_LOG_NONE */
+extern
+int		_dmalloc_async_log;
+
+/*
+ * void _dmalloc_async_start
+ *
+ * Start the asynchronous log writer thread if it has not been
+ * started already.  This must be called outside of the library lock
+ * since creating the thread may allocate memory.
+ */
+extern
+void	_dmalloc_async_start(void);
+
+/*
+ * void _dmalloc_async_flush
+ *
+ * Wait for the asynchronous log writer to write out all of the
+ * messages in its ring.
+ */
+extern
+void	_dmalloc_async_flush(void);
+
 /*
  * void _dmalloc_open_log
  *
@@ -166,6 +190,25 @@ char	*_dmalloc_ptime(const TIME_TYPE *time_p, char *buf, const int buf_size,
 extern
 void	_dmalloc_vmessage(const char *format, va_list args);
 
+/*
+ * void _dmalloc_desc_message
+ *
+ * Message writer with printf like arguments which adds a line to the
+ * dmalloc logfile.  The format is only parsed the first time into
+ * desc_p which saves time for the messages which are written for each
+ * transaction.  This should only be called with the library locked.
+ *
+ * ARGUMENTS:
+ *
+ * desc_p -> Pre-parsed format that the caller keeps in a static.
+ *
+ * format -> Printf-style format statement which must be a constant.
+ *
+ * ... -> Variable argument list.
+ */
+extern
+void	_dmalloc_desc_message(append_format_t *desc_p, const char *format, ...);
+
 /*
  * void _dmalloc_die
  *
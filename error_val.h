@@ -57,6 +57,7 @@
 #define DMALLOC_ERROR_ALLOC_FAILED	43	/* could not get more space */
 /* 44 unused */
 #define DMALLOC_ERROR_OVER_LIMIT	45	/* over allocation limit */
+#define DMALLOC_ERROR_OVER_BUDGET	46	/* over call-site budget */
 
 /* free errors */
 #define DMALLOC_ERROR_NOT_ON_BLOCK	60	/* not on block boundary */
@@ -107,6 +108,7 @@ __attribute__ ((unused))
   { DMALLOC_ERROR_TOO_BIG,		"largest maximum allocation size exceeded" },
   { DMALLOC_ERROR_ALLOC_FAILED,		"could not grow heap by allocating memory" },
   { DMALLOC_ERROR_OVER_LIMIT,		"over user specified allocation limit" },
+  { DMALLOC_ERROR_OVER_BUDGET,		"over user specified call-site budget" },
   
   /* free errors */
   { DMALLOC_ERROR_NOT_ON_BLOCK,		"pointer is not on block boundary" },
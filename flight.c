@@ -0,0 +1,472 @@
+/*
+ * Flight recorder routines
+ *
+ * Copyright 2020 by Gray Watson
+ *
+ * This file is part of the dmalloc package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ *
+ * The author may be contacted via https://dmalloc.com/
+ */
+
+/*
+ * This file contains routines which keep the most recent allocation
+ * transactions in a ring of binary records inside of a memory-mapped
+ * file.  Recording a transaction is just a few stores into the
+ * mapping so it can be left on all of the time.  Because the file is
+ * mapped shared, the records are in the file even if the program
+ * crashes or is killed.  The dmalloc utility can decode the file
+ * afterwards.
+ */
+
+#include <fcntl.h>				/* for O_RDWR, etc. */
+
+#if HAVE_STRING_H
+# include <string.h>
+#endif
+#if HAVE_UNISTD_H
+# include <unistd.h>				/* for ftruncate, getpid */
+#endif
+
+#define DMALLOC_DISABLE
+
+#include "conf.h"
+
+#if HAVE_MMAP
+# include <sys/mman.h>				/* for mmap stuff */
+#endif
+
+#if LOG_PNT_TIMEVAL
+# ifdef TIMEVAL_INCLUDE
+#  include TIMEVAL_INCLUDE
+# endif
+#else
+# if HAVE_TIME
+#  ifdef TIME_INCLUDE
+#   include TIME_INCLUDE
+#  endif
+# endif
+#endif
+
+#include "dmalloc.h"
+
+#include "binlog_loc.h"
+#include "clock.h"
+#include "dmalloc_loc.h"
+#include "error.h"
+#include "flight.h"
+
+/*
+ * Keep the compiler from moving the stores to a record after the
+ * store which counts it as written.
+ */
+#if defined(__GNUC__)
+# define STORE_BARRIER()	__asm__ __volatile__("" : : : "memory")
+#else
+# define STORE_BARRIER()
+#endif
+
+/* set to 1 when the transactions should be written to the flight recorder */
+int	_dmalloc_flight_b = 0;
+
+/* local variables */
+static	char		flight_path[512] = { '\0' }; /* path of the file */
+static	unsigned long	flight_recs = 0;	/* records asked for */
+static	void		*map_base = NULL;	/* start of the mapping */
+static	unsigned long	map_size = 0;		/* size of the mapping */
+static	volatile flight_header_t *header_p = NULL; /* header in the mapping */
+static	char		*names = NULL;		/* file-names in the mapping */
+static	binlog_rec_t	*ring = NULL;		/* records in the mapping */
+static	const char	*file_keys[FLIGHT_NAME_N * 2]; /* file-names given ids */
+static	unsigned int	file_ids[FLIGHT_NAME_N * 2]; /* ids of the file-names */
+static	unsigned int	file_id_c = 0;		/* file-names in the mapping */
+
+/****************************** local utilities ******************************/
+
+/*
+ * static void unmap_file
+ *
+ * Unmap the flight recorder file if it is mapped and forget the
+ * file-name ids since they were defined in that file.
+ */
+static	void	unmap_file(void)
+{
+#if HAVE_MMAP
+  if (map_base != NULL) {
+    (void)munmap(map_base, map_size);
+  }
+#endif
+  map_base = NULL;
+  map_size = 0;
+  header_p = NULL;
+  names = NULL;
+  ring = NULL;
+  memset(file_keys, 0, sizeof(file_keys));
+  file_id_c = 0;
+}
+
+/*
+ * static int map_file
+ *
+ * Create the flight recorder file, map it into memory, and write the
+ * header.
+ *
+ * Returns 1 on success or 0 on failure.
+ */
+static	int	map_file(void)
+{
+#if HAVE_MMAP
+  int		fd;
+  unsigned long	rec_n;
+  
+  /* one more record than asked for since the oldest may be half written */
+  rec_n = flight_recs + 1;
+  map_size = sizeof(flight_header_t) + FLIGHT_NAME_N * FLIGHT_NAME_SIZE
+    + rec_n * sizeof(binlog_rec_t);
+  
+  fd = open(flight_path, O_RDWR | O_CREAT | O_TRUNC, 0666);
+  if (fd < 0) {
+    dmalloc_message("could not open flight recorder '%s'", flight_path);
+    return 0;
+  }
+  if (ftruncate(fd, map_size) != 0) {
+    dmalloc_message("could not size flight recorder '%s' to %lu bytes",
+		    flight_path, map_size);
+    (void)close(fd);
+    return 0;
+  }
+  map_base = mmap(0L, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  (void)close(fd);
+  if (map_base == MAP_FAILED) {
+    dmalloc_message("could not map flight recorder '%s'", flight_path);
+    map_base = NULL;
+    return 0;
+  }
+  
+  header_p = (flight_header_t *)map_base;
+  names = (char *)map_base + sizeof(flight_header_t);
+  ring = (binlog_rec_t *)(names + FLIGHT_NAME_N * FLIGHT_NAME_SIZE);
+  
+  /* the new file is all zeros so we just fill in the header fields */
+  memcpy((char *)header_p->fh_magic, FLIGHT_MAGIC, BINLOG_MAGIC_SIZE);
+  header_p->fh_version = FLIGHT_VERSION;
+  header_p->fh_byte_order = BINLOG_BYTE_ORDER;
+  header_p->fh_rec_size = sizeof(binlog_rec_t);
+  header_p->fh_name_n = FLIGHT_NAME_N;
+  header_p->fh_name_size = FLIGHT_NAME_SIZE;
+#if HAVE_GETPID
+  header_p->fh_pid = getpid();
+#endif
+  header_p->fh_rec_n = rec_n;
+  header_p->fh_written_c = 0;
+  
+  return 1;
+#else
+  dmalloc_message("flight recorder needs mmap which is not available");
+  return 0;
+#endif
+}
+
+/*
+ * static unsigned long file_id
+ *
+ * Get the id of a file-name, copying it into the file-name table in
+ * the mapping the first time that we see it.
+ *
+ * Returns the id of the file-name, the return-address if there is no
+ * line-number, or 0 if the table is full.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address of the call-site.
+ *
+ * line -> Line-number of the call-site.
+ */
+static	unsigned long	file_id(const char *file, const unsigned int line)
+{
+  unsigned int	hash_c;
+  int		len;
+  
+  if (line == DMALLOC_DEFAULT_LINE) {
+    return (PNT_ARITH_TYPE)file;
+  }
+  if (file == DMALLOC_DEFAULT_FILE) {
+    return 0;
+  }
+  
+  /* the file-names are constant strings so we look them up by pointer */
+  hash_c = ((PNT_ARITH_TYPE)file >> 2) % (FLIGHT_NAME_N * 2);
+  while (file_keys[hash_c] != NULL) {
+    if (file_keys[hash_c] == file) {
+      return file_ids[hash_c];
+    }
+    hash_c = (hash_c + 1) % (FLIGHT_NAME_N * 2);
+  }
+  
+  /* the names in the file cannot be reused so new ones are lost when full */
+  if (file_id_c >= FLIGHT_NAME_N) {
+    return 0;
+  }
+  
+  len = strlen(file);
+  if (len > FLIGHT_NAME_SIZE - 1) {
+    len = FLIGHT_NAME_SIZE - 1;
+  }
+  memcpy(names + file_id_c * FLIGHT_NAME_SIZE, file, len);
+  file_id_c++;
+  
+  file_keys[hash_c] = file;
+  file_ids[hash_c] = file_id_c;
+  
+  return file_id_c;
+}
+
+/*
+ * static binlog_rec_t *get_rec
+ *
+ * Get the next record in the ring and fill in its call-sites,
+ * iteration, and time.
+ *
+ * Returns a pointer to the record or NULL on error.
+ *
+ * ARGUMENTS:
+ *
+ * op -> BINLOG_OP_ type of the transaction.
+ *
+ * func_id -> Function ID of the call.
+ *
+ * file -> File-name or return-address of the call-site.
+ *
+ * line -> Line-number of the call-site.
+ *
+ * old_file -> File-name or return-address of the original allocation.
+ *
+ * old_line -> Line-number of the original allocation.
+ */
+static	binlog_rec_t	*get_rec(const int op, const int func_id,
+				 const char *file, const unsigned int line,
+				 const char *old_file,
+				 const unsigned int old_line)
+{
+  binlog_rec_t	*rec_p;
+#if LOG_PNT_TIMEVAL
+  TIMEVAL_TYPE	now;
+#endif
+  
+  if (ring == NULL) {
+    if (! map_file()) {
+      unmap_file();
+      _dmalloc_flight_b = 0;
+      return NULL;
+    }
+  }
+  
+  rec_p = ring + header_p->fh_written_c % header_p->fh_rec_n;
+  rec_p->br_op = op;
+  rec_p->br_func_id = func_id;
+  rec_p->br_line = line;
+  rec_p->br_file = file_id(file, line);
+  rec_p->br_old_line = old_line;
+  if (op == BINLOG_OP_ALLOC) {
+    rec_p->br_old_file = 0;
+  }
+  else {
+    rec_p->br_old_file = file_id(old_file, old_line);
+  }
+  rec_p->br_iter = _dmalloc_iter_c;
+#if LOG_PNT_TIMEVAL
+  _dmalloc_clock_timeval(&now);
+  rec_p->br_secs = now.tv_sec;
+  rec_p->br_usecs = now.tv_usec;
+#else
+#if HAVE_TIME
+  rec_p->br_secs = _dmalloc_clock_seconds();
+#endif
+#endif
+  
+  return rec_p;
+}
+
+/*
+ * static void put_rec
+ *
+ * Count the record that we just filled in as written.
+ */
+static	void	put_rec(void)
+{
+  STORE_BARRIER();
+  header_p->fh_written_c++;
+}
+
+/**************************** exported routines ******************************/
+
+/*
+ * void _dmalloc_flight_setup
+ *
+ * Set the path and size of the flight recorder.  If either has
+ * changed then the current file is unmapped and the new one will be
+ * created with the next transaction.
+ *
+ * ARGUMENTS:
+ *
+ * path -> Path of the file or NULL to not record.
+ *
+ * rec_n -> Number of transactions to keep or 0 for the default.
+ */
+void	_dmalloc_flight_setup(const char *path, const unsigned long rec_n)
+{
+  unsigned long	recs;
+  
+  if (path == NULL) {
+    unmap_file();
+    _dmalloc_flight_b = 0;
+    flight_path[0] = '\0';
+    return;
+  }
+  
+  if (rec_n == 0) {
+    recs = FLIGHT_DEFAULT_RECORDS;
+  }
+  else {
+    recs = rec_n;
+  }
+  
+  if (strcmp(path, flight_path) != 0 || recs != flight_recs) {
+    unmap_file();
+    (void)strncpy(flight_path, path, sizeof(flight_path));
+    flight_path[sizeof(flight_path) - 1] = '\0';
+    flight_recs = recs;
+  }
+  _dmalloc_flight_b = 1;
+}
+
+/*
+ * void _dmalloc_flight_alloc
+ *
+ * Record an allocation transaction in the flight recorder.
+ *
+ * ARGUMENTS:
+ *
+ * func_id -> Function ID of the call.
+ *
+ * file -> File-name or return-address of the call-site.
+ *
+ * line -> Line-number of the call-site.
+ *
+ * pnt -> User pointer that was allocated.
+ *
+ * size -> Number of bytes that the user asked for.
+ */
+void	_dmalloc_flight_alloc(const int func_id, const char *file,
+			      const unsigned int line, const void *pnt,
+			      const unsigned long size)
+{
+  binlog_rec_t	*rec_p;
+  
+  rec_p = get_rec(BINLOG_OP_ALLOC, func_id, file, line, NULL, 0);
+  if (rec_p == NULL) {
+    return;
+  }
+  rec_p->br_pnt = (PNT_ARITH_TYPE)pnt;
+  rec_p->br_size = size;
+  rec_p->br_old_pnt = 0;
+  rec_p->br_old_size = 0;
+  put_rec();
+}
+
+/*
+ * void _dmalloc_flight_free
+ *
+ * Record a free transaction in the flight recorder.
+ *
+ * ARGUMENTS:
+ *
+ * func_id -> Function ID of the call.
+ *
+ * file -> File-name or return-address of the call-site.
+ *
+ * line -> Line-number of the call-site.
+ *
+ * pnt -> User pointer that was freed.
+ *
+ * size -> Number of bytes that the user had asked for.
+ *
+ * alloc_file -> File-name or return-address of the allocation.
+ *
+ * alloc_line -> Line-number of the allocation.
+ */
+void	_dmalloc_flight_free(const int func_id, const char *file,
+			     const unsigned int line, const void *pnt,
+			     const unsigned long size, const char *alloc_file,
+			     const unsigned int alloc_line)
+{
+  binlog_rec_t	*rec_p;
+  
+  rec_p = get_rec(BINLOG_OP_FREE, func_id, file, line, alloc_file,
+		  alloc_line);
+  if (rec_p == NULL) {
+    return;
+  }
+  rec_p->br_pnt = (PNT_ARITH_TYPE)pnt;
+  rec_p->br_size = size;
+  rec_p->br_old_pnt = 0;
+  rec_p->br_old_size = 0;
+  put_rec();
+}
+
+/*
+ * void _dmalloc_flight_realloc
+ *
+ * Record a reallocation transaction in the flight recorder.
+ *
+ * ARGUMENTS:
+ *
+ * func_id -> Function ID of the call.
+ *
+ * file -> File-name or return-address of the call-site.
+ *
+ * line -> Line-number of the call-site.
+ *
+ * old_pnt -> User pointer that was passed in.
+ *
+ * old_size -> Number of bytes of the old pointer.
+ *
+ * old_file -> File-name or return-address of the old allocation.
+ *
+ * old_line -> Line-number of the old allocation.
+ *
+ * new_pnt -> User pointer that was returned.
+ *
+ * new_size -> Number of bytes that the user asked for.
+ */
+void	_dmalloc_flight_realloc(const int func_id, const char *file,
+				const unsigned int line, const void *old_pnt,
+				const unsigned long old_size,
+				const char *old_file,
+				const unsigned int old_line,
+				const void *new_pnt,
+				const unsigned long new_size)
+{
+  binlog_rec_t	*rec_p;
+  
+  rec_p = get_rec(BINLOG_OP_REALLOC, func_id, file, line, old_file,
+		  old_line);
+  if (rec_p == NULL) {
+    return;
+  }
+  rec_p->br_pnt = (PNT_ARITH_TYPE)new_pnt;
+  rec_p->br_size = new_size;
+  rec_p->br_old_pnt = (PNT_ARITH_TYPE)old_pnt;
+  rec_p->br_old_size = old_size;
+  put_rec();
+}
@@ -0,0 +1,132 @@
+/*
+ * Defines for the flight recorder routines.
+ *
+ * Copyright 2020 by Gray Watson
+ *
+ * This file is part of the dmalloc package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ *
+ * The author may be contacted via https://dmalloc.com/
+ */
+
+#ifndef __FLIGHT_H__
+#define __FLIGHT_H__
+
+/*<<<<<<<<<<  The below prototypes are auto-generated by fillproto */
+
+/* set to 1 when the transactions should be written to the flight recorder */
+extern
+int	_dmalloc_flight_b;
+
+/*
+ * void _dmalloc_flight_setup
+ *
+ * Set the path and size of the flight recorder.  If either has
+ * changed then the current file is unmapped and the new one will be
+ * created with the next transaction.
+ *
+ * ARGUMENTS:
+ *
+ * path -> Path of the file or NULL to not record.
+ *
+ * rec_n -> Number of transactions to keep or 0 for the default.
+ */
+extern
+void	_dmalloc_flight_setup(const char *path, const unsigned long rec_n);
+
+/*
+ * void _dmalloc_flight_alloc
+ *
+ * Record an allocation transaction in the flight recorder.
+ *
+ * ARGUMENTS:
+ *
+ * func_id -> Function ID of the call.
+ *
+ * file -> File-name or return-address of the call-site.
+ *
+ * line -> Line-number of the call-site.
+ *
+ * pnt -> User pointer that was allocated.
+ *
+ * size -> Number of bytes that the user asked for.
+ */
+extern
+void	_dmalloc_flight_alloc(const int func_id, const char *file,
+			      const unsigned int line, const void *pnt,
+			      const unsigned long size);
+
+/*
+ * void _dmalloc_flight_free
+ *
+ * Record a free transaction in the flight recorder.
+ *
+ * ARGUMENTS:
+ *
+ * func_id -> Function ID of the call.
+ *
+ * file -> File-name or return-address of the call-site.
+ *
+ * line -> Line-number of the call-site.
+ *
+ * pnt -> User pointer that was freed.
+ *
+ * size -> Number of bytes that the user had asked for.
+ *
+ * alloc_file -> File-name or return-address of the allocation.
+ *
+ * alloc_line -> Line-number of the allocation.
+ */
+extern
+void	_dmalloc_flight_free(const int func_id, const char *file,
+			     const unsigned int line, const void *pnt,
+			     const unsigned long size, const char *alloc_file,
+			     const unsigned int alloc_line);
+
+/*
+ * void _dmalloc_flight_realloc
+ *
+ * Record a reallocation transaction in the flight recorder.
+ *
+ * ARGUMENTS:
+ *
+ * func_id -> Function ID of the call.
+ *
+ * file -> File-name or return-address of the call-site.
+ *
+ * line -> Line-number of the call-site.
+ *
+ * old_pnt -> User pointer that was passed in.
+ *
+ * old_size -> Number of bytes of the old pointer.
+ *
+ * old_file -> File-name or return-address of the old allocation.
+ *
+ * old_line -> Line-number of the old allocation.
+ *
+ * new_pnt -> User pointer that was returned.
+ *
+ * new_size -> Number of bytes that the user asked for.
+ */
+extern
+void	_dmalloc_flight_realloc(const int func_id, const char *file,
+				const unsigned int line, const void *old_pnt,
+				const unsigned long old_size,
+				const char *old_file,
+				const unsigned int old_line,
+				const void *new_pnt,
+				const unsigned long new_size);
+
+/*<<<<<<<<<<   This is end of the auto-generated output from fillproto. */
+
+#endif /* ! __FLIGHT_H__ */
@@ -38,6 +38,7 @@
 
 #include "append.h"
 #include "chunk.h"
+#include "clock.h"
 #include "compat.h"
 #include "debug_tok.h"
 #include "error.h"
@@ -89,12 +90,20 @@ static	void	*heap_extend(const int incr)
 	     MAP_PRIVATE | MAP_ANON, -1 /* no fd */, 0 /* no offset */);
 #else
 #endif
+  _dmalloc_cost.dc_map_c++;
   if (ret == MAP_FAILED) {
     ret = SBRK_ERROR;
   }
+  else {
+    _dmalloc_cost.dc_map_size += incr;
+  }
 #else
 #if HAVE_SBRK
   ret = sbrk(incr);
+  _dmalloc_cost.dc_map_c++;
+  if (ret != SBRK_ERROR) {
+    _dmalloc_cost.dc_map_size += incr;
+  }
 #endif /* if HAVE_SBRK */
 #endif /* if not HAVE_MMAP && USE_MMAP */
 #endif /* if not INTERNAL_MEMORY_SPACE */
@@ -141,7 +150,9 @@ static	void	heap_release(void *addr, const int size)
   /* no-op */
 #else
 #if HAVE_MUNMAP && USE_MMAP
+  _dmalloc_cost.dc_unmap_c++;
   if (munmap(addr, size) == 0) {
+    _dmalloc_cost.dc_unmap_size += size;
     if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_ADMIN)) {
       dmalloc_message("releasing heap memory %p, size %d", addr, size);
     }
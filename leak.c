@@ -0,0 +1,394 @@
+/*
+ * Leak scan routines
+ *
+ * Copyright 2020 by Gray Watson
+ *
+ * This file is part of the dmalloc package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ *
+ * The author may be contacted via https://dmalloc.com/
+ */
+
+/*
+ * This file contains the routines which find the roots of the leak
+ * scan.  The writable private mappings in /proc/self/maps hold the
+ * global variables, the thread stacks, and any memory the program
+ * mapped itself.  The registers are saved on our stack with setjmp()
+ * and the stack of the current thread is only scanned from there up.
+ * The memory of the library's own heap is skipped so that only what
+ * the program still points to keeps a pointer reachable.  Anything
+ * that looks like a pointer into a block counts, so the scan might
+ * miss a leak but should not report memory which is in use.
+ */
+
+#include <fcntl.h>				/* for O_RDONLY */
+#include <setjmp.h>				/* for setjmp */
+
+#if HAVE_STRING_H
+# include <string.h>
+#endif
+#if HAVE_UNISTD_H
+# include <unistd.h>				/* for read, close */
+#endif
+
+#define DMALLOC_DISABLE
+
+#include "conf.h"
+#include "dmalloc.h"
+
+#include "chunk.h"
+#include "dmalloc_loc.h"
+#include "heap.h"
+#include "leak.h"
+
+/* where we read the memory mappings of the process */
+#define MAPS_PATH	"/proc/self/maps"
+
+/* number of fields in the maps lines before the path */
+#define MAPS_FIELD_N	5
+
+/* maximum number of the library's buffers that we leave out */
+#define SKIP_BUFFER_N	8
+
+/* buffer of the library that is not a root */
+typedef struct {
+  PNT_ARITH_TYPE	sb_start;		/* start of the buffer */
+  PNT_ARITH_TYPE	sb_bounds;		/* just past the end */
+} skip_buffer_t;
+
+/* local variables */
+static	char	maps_buf[4096];			/* lines read from the maps */
+static	skip_buffer_t	skip_buffers[SKIP_BUFFER_N]; /* buffers left out */
+static	int		skip_buffer_c = 0;	/* buffers in skip_buffers */
+
+/****************************** local utilities ******************************/
+
+/*
+ * static const char *parse_hex
+ *
+ * Parse a hexadecimal address from a maps line.
+ *
+ * Returns a pointer to the character after the address.
+ *
+ * ARGUMENTS:
+ *
+ * str_p -> Start of the address.
+ *
+ * bounds_p -> End of the line.
+ *
+ * val_p <- Pointer to the address that we set.
+ */
+static	const char	*parse_hex(const char *str_p, const char *bounds_p,
+				   PNT_ARITH_TYPE *val_p)
+{
+  PNT_ARITH_TYPE	val = 0;
+  
+  for (; str_p < bounds_p; str_p++) {
+    if (*str_p >= '0' && *str_p <= '9') {
+      val = val * 16 + (*str_p - '0');
+    }
+    else if (*str_p >= 'a' && *str_p <= 'f') {
+      val = val * 16 + (*str_p - 'a' + 10);
+    }
+    else {
+      break;
+    }
+  }
+  
+  *val_p = val;
+  return str_p;
+}
+
+/*
+ * static void mark_skipping
+ *
+ * Mark the pointers reached from a region of memory, leaving out the
+ * buffers of the library that hold user pointers.
+ *
+ * ARGUMENTS:
+ *
+ * start -> Start of the region.
+ *
+ * bounds -> Just past the end of the region.
+ *
+ * skip_c -> First of the skip_buffers that we still have to look at.
+ */
+static	void	mark_skipping(PNT_ARITH_TYPE start, PNT_ARITH_TYPE bounds,
+			      int skip_c)
+{
+  const skip_buffer_t	*skip_p;
+  
+  for (; skip_c < skip_buffer_c; skip_c++) {
+    skip_p = skip_buffers + skip_c;
+    if (start < skip_p->sb_bounds && bounds > skip_p->sb_start) {
+      /* mark the parts on either side of the buffer */
+      if (start < skip_p->sb_start) {
+	mark_skipping(start, skip_p->sb_start, skip_c + 1);
+      }
+      if (bounds > skip_p->sb_bounds) {
+	mark_skipping(skip_p->sb_bounds, bounds, skip_c + 1);
+      }
+      return;
+    }
+  }
+  
+  if (start < bounds) {
+    _dmalloc_chunk_mark_range((void *)start, (void *)bounds);
+  }
+}
+
+/*
+ * static void mark_region
+ *
+ * Mark the pointers reached from a region of memory, leaving out our
+ * heap if the region holds it.
+ *
+ * ARGUMENTS:
+ *
+ * start -> Start of the region.
+ *
+ * bounds -> Just past the end of the region.
+ *
+ * heap_b -> Set to 1 if our heap might be in the region.
+ */
+static	void	mark_region(PNT_ARITH_TYPE start, PNT_ARITH_TYPE bounds,
+			    const int heap_b)
+{
+  PNT_ARITH_TYPE	low, high;
+  
+  low = (PNT_ARITH_TYPE)_dmalloc_heap_low;
+  high = (PNT_ARITH_TYPE)_dmalloc_heap_high;
+  
+  if (heap_b && start < high && bounds > low) {
+    if (start < low) {
+      mark_skipping(start, low, 0);
+    }
+    if (bounds > high) {
+      mark_skipping(high, bounds, 0);
+    }
+  }
+  else {
+    mark_skipping(start, bounds, 0);
+  }
+}
+
+/*
+ * static void mark_line
+ *
+ * Mark the pointers reached from the mapping in a line of the maps
+ * file if it is one of the roots.
+ *
+ * ARGUMENTS:
+ *
+ * line_p -> Start of the line.
+ *
+ * bounds_p -> End of the line.
+ *
+ * stack_p -> Lowest address of the stack that is in use.
+ */
+static	void	mark_line(const char *line_p, const char *bounds_p,
+			  const char *stack_p)
+{
+  PNT_ARITH_TYPE	start, bounds;
+  const char		*perms_p, *path_p;
+  int			field_c, heap_b;
+  
+  /* 00400000-0040b000 rw-p 00000000 08:01 1234   /usr/bin/prog */
+  path_p = parse_hex(line_p, bounds_p, &start);
+  if (path_p >= bounds_p || *path_p != '-') {
+    return;
+  }
+  path_p = parse_hex(path_p + 1, bounds_p, &bounds);
+  perms_p = path_p + 1;
+  
+  /* we only look at the private memory that can be written */
+  if (bounds_p - perms_p < 4
+      || perms_p[0] != 'r' || perms_p[1] != 'w' || perms_p[3] != 'p') {
+    return;
+  }
+  
+  for (field_c = 1; field_c < MAPS_FIELD_N; field_c++) {
+    while (path_p < bounds_p && *path_p == ' ') {
+      path_p++;
+    }
+    while (path_p < bounds_p && *path_p != ' ') {
+      path_p++;
+    }
+  }
+  while (path_p < bounds_p && *path_p == ' ') {
+    path_p++;
+  }
+  
+  /* reading a device might do something */
+  if (bounds_p - path_p >= 5 && strncmp(path_p, "/dev/", 5) == 0) {
+    return;
+  }
+  
+#if INTERNAL_MEMORY_SPACE
+  /* the heap is a static block in the data of the program */
+  heap_b = 1;
+#else
+#if HAVE_MMAP && USE_MMAP
+  /* our heap is mapped executable which keeps it apart from the rest */
+  heap_b = (perms_p[2] == 'x' && path_p == bounds_p);
+#else
+  heap_b = (bounds_p - path_p == 6 && strncmp(path_p, "[heap]", 6) == 0);
+#endif
+#endif
+  
+  /* the stack below the one that is in use is garbage */
+  if ((PNT_ARITH_TYPE)stack_p >= start && (PNT_ARITH_TYPE)stack_p < bounds) {
+    start = (PNT_ARITH_TYPE)stack_p;
+  }
+  
+  mark_region(start, bounds, heap_b);
+}
+
+/*
+ * static int mark_maps
+ *
+ * Read the maps file and mark the pointers reached from each of the
+ * roots that it lists.
+ *
+ * Returns 1 on success or 0 if we could not read the maps.
+ *
+ * ARGUMENTS:
+ *
+ * regs_p -> Where the registers were saved on the stack.
+ */
+static	int	mark_maps(const char *regs_p)
+{
+  char		here, *line_p, *end_p, *bounds_p;
+  const char	*stack_p;
+  int		fd, len, fill_c = 0, skip_b = 0;
+  
+  /* the stack grows down so we start with the lower of the two */
+  if ((PNT_ARITH_TYPE)&here < (PNT_ARITH_TYPE)regs_p) {
+    stack_p = &here;
+  }
+  else {
+    stack_p = regs_p;
+  }
+  
+  /* we read the file with system calls so we do not allocate */
+  fd = open(MAPS_PATH, O_RDONLY, 0);
+  if (fd < 0) {
+    return 0;
+  }
+  
+  while (1) {
+    len = read(fd, maps_buf + fill_c, sizeof(maps_buf) - fill_c);
+    if (len <= 0) {
+      break;
+    }
+    bounds_p = maps_buf + fill_c + len;
+    
+    for (line_p = maps_buf; ; line_p = end_p + 1) {
+      end_p = memchr(line_p, '\n', bounds_p - line_p);
+      if (end_p == NULL) {
+	break;
+      }
+      if (skip_b) {
+	skip_b = 0;
+      }
+      else {
+	mark_line(line_p, end_p, stack_p);
+      }
+    }
+    
+    /* keep the start of the next line for the next read */
+    fill_c = bounds_p - line_p;
+    if (fill_c == sizeof(maps_buf)) {
+      /* a line that is too long for us is skipped */
+      fill_c = 0;
+      skip_b = 1;
+    }
+    else {
+      memmove(maps_buf, line_p, fill_c);
+    }
+  }
+  
+  (void)close(fd);
+  return 1;
+}
+
+/**************************** exported routines ******************************/
+
+/*
+ * void _dmalloc_leak_skip
+ *
+ * Leave a buffer of the library which holds user pointers out of the
+ * roots of the scan so the pointers in it do not keep their
+ * allocations reachable.  A buffer can be given more than once.
+ *
+ * ARGUMENTS:
+ *
+ * buf -> Start of the buffer.
+ *
+ * size -> Size of the buffer in bytes.
+ */
+void	_dmalloc_leak_skip(const void *buf, const unsigned long size)
+{
+  skip_buffer_t	*skip_p;
+  
+  for (skip_p = skip_buffers; skip_p < skip_buffers + skip_buffer_c;
+       skip_p++) {
+    if (skip_p->sb_start == (PNT_ARITH_TYPE)buf) {
+      return;
+    }
+  }
+  if (skip_buffer_c == SKIP_BUFFER_N) {
+    dmalloc_message("too many buffers to leave out of the leak scan");
+    return;
+  }
+  
+  skip_p->sb_start = (PNT_ARITH_TYPE)buf;
+  skip_p->sb_bounds = (PNT_ARITH_TYPE)buf + size;
+  skip_buffer_c++;
+}
+
+/*
+ * int _dmalloc_leak_log
+ *
+ * Scan the memory of the program for the pointers in use that it can
+ * still reach and log the ones that it cannot.  The library should be
+ * locked.
+ *
+ * Returns the number of unreachable pointers or -1 if we could not
+ * find the roots of the scan.
+ *
+ * ARGUMENTS:
+ *
+ * details_b -> If set to 1 then dump the individual pointer entries
+ * instead of just the summary.
+ */
+int	_dmalloc_leak_log(const int details_b)
+{
+  jmp_buf	regs;
+  
+  /*
+   * Save the registers on the stack so the pointers in them are seen.
+   * The buffer is cleared first so that the parts setjmp does not use
+   * do not hold old pointers from the calls that ran here before.
+   */
+  memset(regs, 0, sizeof(regs));
+  (void)setjmp(regs);
+  
+  if (! mark_maps((char *)regs)) {
+    dmalloc_message("could not read '%s' to find unreachable pointers",
+		    MAPS_PATH);
+    return -1;
+  }
+  
+  return _dmalloc_chunk_log_unreachable(details_b);
+}
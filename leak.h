@@ -0,0 +1,63 @@
+/*
+ * Defines for the leak scan routines.
+ *
+ * Copyright 2020 by Gray Watson
+ *
+ * This file is part of the dmalloc package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ *
+ * The author may be contacted via https://dmalloc.com/
+ */
+
+#ifndef __LEAK_H__
+#define __LEAK_H__
+
+/*<<<<<<<<<<  The below prototypes are auto-generated by fillproto */
+
+/*
+ * void _dmalloc_leak_skip
+ *
+ * Leave a buffer of the library which holds user pointers out of the
+ * roots of the scan so the pointers in it do not keep their
+ * allocations reachable.  A buffer can be given more than once.
+ *
+ * ARGUMENTS:
+ *
+ * buf -> Start of the buffer.
+ *
+ * size -> Size of the buffer in bytes.
+ */
+extern
+void	_dmalloc_leak_skip(const void *buf, const unsigned long size);
+
+/*
+ * int _dmalloc_leak_log
+ *
+ * Scan the memory of the program for the pointers in use that it can
+ * still reach and log the ones that it cannot.  The library should be
+ * locked.
+ *
+ * Returns the number of unreachable pointers or -1 if we could not
+ * find the roots of the scan.
+ *
+ * ARGUMENTS:
+ *
+ * details_b -> If set to 1 then dump the individual pointer entries
+ * instead of just the summary.
+ */
+extern
+int	_dmalloc_leak_log(const int details_b);
+
+/*<<<<<<<<<<   This is end of the auto-generated output from fillproto. */
+
+#endif /* ! __LEAK_H__ */
@@ -0,0 +1,304 @@
+/*
+ * Live statistics routines
+ *
+ * Copyright 2020 by Gray Watson
+ *
+ * This file is part of the dmalloc package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ *
+ * The author may be contacted via https://dmalloc.com/
+ */
+
+/*
+ * This file contains routines which publish the counters of the
+ * library and the top call-sites of the memory table in a small
+ * memory-mapped file, usually in /dev/shm, so the dmalloc utility can
+ * watch a running program without it having to write to its logfile.
+ * The file is rewritten at most once a second and the writes are
+ * bracketed by a sequence number so that readers can tell when they
+ * have copied a half written file.
+ */
+
+#include <fcntl.h>				/* for O_RDWR, etc. */
+
+#if HAVE_STRING_H
+# include <string.h>
+#endif
+#if HAVE_UNISTD_H
+# include <unistd.h>				/* for ftruncate, getpid */
+#endif
+
+#define DMALLOC_DISABLE
+
+#include "conf.h"
+
+#if HAVE_MMAP
+# include <sys/mman.h>				/* for mmap stuff */
+#endif
+
+#include "dmalloc.h"
+
+#include "append.h"
+#include "chunk.h"
+#include "clock.h"
+#include "dmalloc_loc.h"
+#include "dmalloc_tab.h"
+#include "error.h"
+#include "livestats.h"
+#include "livestats_loc.h"
+
+/*
+ * Order the stores to the file around the changes of the sequence
+ * number so that a reader never sees an even number with half written
+ * fields.
+ */
+#if defined(__GNUC__)
+# define SEQ_FENCE()	__atomic_thread_fence(__ATOMIC_SEQ_CST)
+#else
+# define SEQ_FENCE()
+#endif
+
+/* local variables */
+static	char		live_path[512] = { '\0' }; /* path from the options */
+static	char		map_path[512] = { '\0' }; /* path of our file */
+static	long		map_pid = -1;		/* process that mapped it */
+static	volatile live_header_t	*header_p = NULL; /* the mapping */
+static	long		update_secs = -1;	/* second of the last update */
+
+/****************************** local utilities ******************************/
+
+/*
+ * static long get_pid
+ *
+ * Returns the process-id or 0 if it is not available.
+ */
+static	long	get_pid(void)
+{
+#if HAVE_GETPID
+  return getpid();
+#else
+  return 0;
+#endif
+}
+
+/*
+ * static void unmap_file
+ *
+ * Unmap the live statistics file if it is mapped.
+ *
+ * ARGUMENTS:
+ *
+ * remove_b -> Set to 1 to also remove the file.
+ */
+static	void	unmap_file(const int remove_b)
+{
+#if HAVE_MMAP
+  if (header_p != NULL) {
+    (void)munmap((void *)header_p, sizeof(live_header_t));
+  }
+#endif
+  if (remove_b && map_path[0] != '\0') {
+    (void)unlink(map_path);
+  }
+  header_p = NULL;
+  map_path[0] = '\0';
+  map_pid = -1;
+  update_secs = -1;
+}
+
+/*
+ * static int map_file
+ *
+ * Create the live statistics file for this process, replacing %p in
+ * the path with the process-id, and map it into memory.
+ *
+ * Returns 1 on success or 0 on failure.
+ */
+static	int	map_file(void)
+{
+#if HAVE_MMAP
+  char		*path_p, *buf_p, *bounds_p;
+  void		*mem;
+  int		fd;
+  
+  map_pid = get_pid();
+  
+  buf_p = map_path;
+  bounds_p = map_path + sizeof(map_path);
+  for (path_p = live_path; *path_p != '\0'; path_p++) {
+    if (*path_p == '%' && *(path_p + 1) == 'p') {
+      buf_p = append_long(buf_p, bounds_p, map_pid, 10);
+      path_p++;
+    }
+    else if (buf_p < bounds_p - 1) {
+      *buf_p++ = *path_p;
+    }
+  }
+  (void)append_null(buf_p, bounds_p);
+  
+  fd = open(map_path, O_RDWR | O_CREAT | O_TRUNC, 0666);
+  if (fd < 0) {
+    dmalloc_message("could not open live statistics '%s'", map_path);
+    return 0;
+  }
+  if (ftruncate(fd, sizeof(live_header_t)) != 0) {
+    dmalloc_message("could not size live statistics '%s'", map_path);
+    (void)close(fd);
+    return 0;
+  }
+  mem = mmap(0L, sizeof(live_header_t), PROT_READ | PROT_WRITE, MAP_SHARED,
+	     fd, 0);
+  (void)close(fd);
+  if (mem == MAP_FAILED) {
+    dmalloc_message("could not map live statistics '%s'", map_path);
+    return 0;
+  }
+  header_p = (live_header_t *)mem;
+  
+  /* the new file is all zeros so we just fill in the header fields */
+  memcpy((char *)header_p->lh_magic, LIVE_MAGIC, LIVE_MAGIC_SIZE);
+  header_p->lh_version = LIVE_VERSION;
+  header_p->lh_size = sizeof(live_header_t);
+  header_p->lh_pid = map_pid;
+#if HAVE_GETPID
+  header_p->lh_ppid = getppid();
+#endif
+  
+  return 1;
+#else
+  dmalloc_message("live statistics needs mmap which is not available");
+  return 0;
+#endif
+}
+
+/*
+ * static void write_sites
+ *
+ * Copy the call-sites with the largest total-size into the file.
+ */
+static	void	write_sites(void)
+{
+  mem_entry_t		*top[LIVE_SITE_N];
+  volatile live_site_t	*site_p;
+  char			source[LIVE_SITE_SIZE];
+  int			top_c, site_c;
+  
+  top_c = _dmalloc_chunk_top_entries(top, LIVE_SITE_N);
+  for (site_c = 0; site_c < top_c; site_c++) {
+    site_p = header_p->lh_sites + site_c;
+    (void)_dmalloc_chunk_desc_pnt(source, sizeof(source), top[site_c]->me_file,
+				  top[site_c]->me_line);
+    memcpy((char *)site_p->ls_source, source, sizeof(source));
+    site_p->ls_total_size = top[site_c]->me_total_size;
+    site_p->ls_total_c = top[site_c]->me_total_c;
+    site_p->ls_in_use_size = top[site_c]->me_in_use_size;
+    site_p->ls_in_use_c = top[site_c]->me_in_use_c;
+  }
+  header_p->lh_site_c = top_c;
+}
+
+/**************************** exported routines ******************************/
+
+/*
+ * void _dmalloc_live_setup
+ *
+ * Set the path of the live statistics file.  If it has changed then
+ * the current file is removed and the new one will be created with
+ * the next update.
+ *
+ * ARGUMENTS:
+ *
+ * path -> Path of the file with %p for the process-id or NULL to not
+ * publish the statistics.
+ */
+void	_dmalloc_live_setup(const char *path)
+{
+  if (path == NULL) {
+    unmap_file(1 /* remove */);
+    live_path[0] = '\0';
+    return;
+  }
+  
+  if (strcmp(path, live_path) != 0) {
+    unmap_file(1 /* remove */);
+    (void)strncpy(live_path, path, sizeof(live_path));
+    live_path[sizeof(live_path) - 1] = '\0';
+  }
+}
+
+/*
+ * int _dmalloc_live_due
+ *
+ * Returns 1 if the live statistics should be updated because the
+ * second has changed since the last update, otherwise 0.
+ */
+int	_dmalloc_live_due(void)
+{
+  if (live_path[0] == '\0') {
+    return 0;
+  }
+  return (_dmalloc_clock_seconds() != update_secs);
+}
+
+/*
+ * void _dmalloc_live_update
+ *
+ * Write the statistics and the top call-sites into the live
+ * statistics file, creating it if needed.  The library should be
+ * locked.
+ *
+ * ARGUMENTS:
+ *
+ * stats_p -> Counters of the library to publish.
+ */
+void	_dmalloc_live_update(const dmalloc_stats_t *stats_p)
+{
+  if (live_path[0] == '\0') {
+    return;
+  }
+  
+  /* a forked child gets its own file instead of writing to its parent's */
+  if (header_p != NULL && map_pid != get_pid()) {
+    unmap_file(0 /* not the parent's file */);
+  }
+  if (header_p == NULL) {
+    if (! map_file()) {
+      unmap_file(0 /* not created */);
+      live_path[0] = '\0';
+      return;
+    }
+  }
+  
+  update_secs = _dmalloc_clock_seconds();
+  
+  header_p->lh_seq++;
+  SEQ_FENCE();
+  header_p->lh_secs = update_secs;
+  memcpy((void *)&header_p->lh_stats, stats_p, sizeof(*stats_p));
+  write_sites();
+  SEQ_FENCE();
+  header_p->lh_seq++;
+}
+
+/*
+ * void _dmalloc_live_shutdown
+ *
+ * Remove the live statistics file when the program is finished.
+ */
+void	_dmalloc_live_shutdown(void)
+{
+  /* only the process that created the file removes it */
+  if (header_p != NULL && map_pid == get_pid()) {
+    unmap_file(1 /* remove */);
+  }
+}
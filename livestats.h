@@ -0,0 +1,75 @@
+/*
+ * Defines for the live statistics routines.
+ *
+ * Copyright 2020 by Gray Watson
+ *
+ * This file is part of the dmalloc package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ *
+ * The author may be contacted via https://dmalloc.com/
+ */
+
+#ifndef __LIVESTATS_H__
+#define __LIVESTATS_H__
+
+/*<<<<<<<<<<  The below prototypes are auto-generated by fillproto */
+
+/*
+ * void _dmalloc_live_setup
+ *
+ * Set the path of the live statistics file.  If it has changed then
+ * the current file is removed and the new one will be created with
+ * the next update.
+ *
+ * ARGUMENTS:
+ *
+ * path -> Path of the file with %p for the process-id or NULL to not
+ * publish the statistics.
+ */
+extern
+void	_dmalloc_live_setup(const char *path);
+
+/*
+ * int _dmalloc_live_due
+ *
+ * Returns 1 if the live statistics should be updated because the
+ * second has changed since the last update, otherwise 0.
+ */
+extern
+int	_dmalloc_live_due(void);
+
+/*
+ * void _dmalloc_live_update
+ *
+ * Write the statistics and the top call-sites into the live
+ * statistics file, creating it if needed.  The library should be
+ * locked.
+ *
+ * ARGUMENTS:
+ *
+ * stats_p -> Counters of the library to publish.
+ */
+extern
+void	_dmalloc_live_update(const dmalloc_stats_t *stats_p);
+
+/*
+ * void _dmalloc_live_shutdown
+ *
+ * Remove the live statistics file when the program is finished.
+ */
+extern
+void	_dmalloc_live_shutdown(void);
+
+/*<<<<<<<<<<   This is end of the auto-generated output from fillproto. */
+
+#endif /* ! __LIVESTATS_H__ */
@@ -0,0 +1,73 @@
+/*
+ * Local defines for the live statistics routines.
+ *
+ * Copyright 2020 by Gray Watson
+ *
+ * This file is part of the dmalloc package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ *
+ * The author may be contacted via https://dmalloc.com/
+ */
+
+#ifndef __LIVESTATS_LOC_H__
+#define __LIVESTATS_LOC_H__
+
+/*
+ * NOTE: this file is also used by the dmalloc utility to read the
+ * statistics of a running program so it should only have the file
+ * format definitions.  The file is written in the native byte order
+ * and word size so it needs to be read on the same system.
+ */
+
+/* magic string at the start of the file and the version of the format */
+#define LIVE_MAGIC		"DMLS"
+#define LIVE_MAGIC_SIZE		4
+#define LIVE_VERSION		1
+
+/* number of the top call-sites in the file and the size of their names */
+#define LIVE_SITE_N		16
+#define LIVE_SITE_SIZE		64
+
+/*
+ * One of the call-sites with the largest total-size from the memory
+ * table.
+ */
+typedef struct {
+  char			ls_source[LIVE_SITE_SIZE]; /* file:line or ra=addr */
+  unsigned long		ls_total_size;		/* bytes ever allocated */
+  unsigned long		ls_total_c;		/* pointers ever allocated */
+  unsigned long		ls_in_use_size;		/* bytes in use */
+  unsigned long		ls_in_use_c;		/* pointers in use */
+} live_site_t;
+
+/*
+ * The whole of the live statistics file.  The library increments
+ * lh_seq to an odd number before it changes the rest of the fields
+ * and to the next even number afterwards.  A reader copies the file
+ * and then checks that lh_seq was even and did not change while it
+ * was copying, otherwise it tries again.
+ */
+typedef struct {
+  char			lh_magic[LIVE_MAGIC_SIZE]; /* LIVE_MAGIC no null */
+  unsigned int		lh_version;		/* LIVE_VERSION */
+  unsigned int		lh_size;		/* sizeof(live_header_t) */
+  unsigned int		lh_site_c;		/* call-sites in lh_sites */
+  unsigned long		lh_seq;			/* odd while being written */
+  unsigned long		lh_pid;			/* process that writes it */
+  unsigned long		lh_ppid;		/* parent of that process */
+  unsigned long		lh_secs;		/* time of the last update */
+  dmalloc_stats_t	lh_stats;		/* counters of the library */
+  live_site_t		lh_sites[LIVE_SITE_N];	/* top call-sites */
+} live_header_t;
+
+#endif /* ! __LIVESTATS_LOC_H__ */
@@ -0,0 +1,399 @@
+/*
+ * Heap profile output routines
+ *
+ * Copyright 2020 by Gray Watson
+ *
+ * This file is part of the dmalloc package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ *
+ * The author may be contacted via https://dmalloc.com/
+ */
+
+/*
+ * This file contains routines which write the memory table out as a
+ * heap profile in the protocol-buffer format used by the pprof tools
+ * (profile.proto).  It is not compressed so "pprof" may need to be
+ * told the file type but it needs no external libraries.  The
+ * protobuf encoding is done by hand since we cannot allocate memory.
+ */
+
+#include <fcntl.h>				/* for O_WRONLY, etc. */
+
+#if HAVE_STRING_H
+# include <string.h>
+#endif
+#if HAVE_UNISTD_H
+# include <unistd.h>				/* for write */
+#endif
+
+#define DMALLOC_DISABLE
+
+#include "conf.h"
+
+#if HAVE_TIME
+# ifdef TIME_INCLUDE
+#  include TIME_INCLUDE
+# endif
+#endif
+
+#include "dmalloc.h"
+
+#include "chunk.h"
+#include "compat.h"
+#include "dmalloc_loc.h"
+#include "dmalloc_tab.h"
+#include "error.h"
+#include "profile.h"
+#include "profile_loc.h"
+
+/*
+ * Output state while we are writing a profile.  We buffer the output
+ * in static storage since we cannot allocate.
+ */
+typedef struct {
+  int		po_fd;				/* file we are writing */
+  int		po_error_b;			/* had a write error */
+  unsigned long	po_string_c;			/* strings written */
+  char		*po_buf_p;			/* position in the buffer */
+  char		po_buf[PROFILE_BUFFER_SIZE];	/* output buffer */
+} profile_out_t;
+
+static	profile_out_t	profile_out;
+
+/*
+ * static char *pb_varint
+ *
+ * Encode a protobuf variable-length integer into a buffer.
+ *
+ * Returns a pointer to the position after the integer.
+ *
+ * ARGUMENTS:
+ *
+ * buf_p -> Position in the buffer to write the integer.
+ *
+ * bounds_p -> End of the buffer.
+ *
+ * value -> Value we are encoding.
+ */
+static	char	*pb_varint(char *buf_p, char *bounds_p, unsigned long value)
+{
+  /* 7 bits at a time, low bits first, high bit set if more follow */
+  while (value >= 0x80 && buf_p < bounds_p) {
+    *buf_p++ = (char)((value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  if (buf_p < bounds_p) {
+    *buf_p++ = (char)value;
+  }
+  return buf_p;
+}
+
+/*
+ * static char *pb_int_field
+ *
+ * Encode a protobuf integer field with its key into a buffer.
+ *
+ * Returns a pointer to the position after the field.
+ *
+ * ARGUMENTS:
+ *
+ * buf_p -> Position in the buffer to write the field.
+ *
+ * bounds_p -> End of the buffer.
+ *
+ * field -> Field number from the .proto file.
+ *
+ * value -> Value we are encoding.
+ */
+static	char	*pb_int_field(char *buf_p, char *bounds_p, const int field,
+			      const unsigned long value)
+{
+  buf_p = pb_varint(buf_p, bounds_p, PB_KEY(field, PB_WIRE_VARINT));
+  return pb_varint(buf_p, bounds_p, value);
+}
+
+/*
+ * static char *pb_bytes_field
+ *
+ * Encode a protobuf length-delimited field with its key into a
+ * buffer.  This is used for strings and embedded messages.
+ *
+ * Returns a pointer to the position after the field.
+ *
+ * ARGUMENTS:
+ *
+ * buf_p -> Position in the buffer to write the field.
+ *
+ * bounds_p -> End of the buffer.
+ *
+ * field -> Field number from the .proto file.
+ *
+ * data -> Bytes that we are writing.
+ *
+ * len -> Number of bytes of data.
+ */
+static	char	*pb_bytes_field(char *buf_p, char *bounds_p, const int field,
+				const char *data, const int len)
+{
+  buf_p = pb_varint(buf_p, bounds_p, PB_KEY(field, PB_WIRE_LENGTH));
+  buf_p = pb_varint(buf_p, bounds_p, len);
+  if (buf_p + len > bounds_p) {
+    return bounds_p;
+  }
+  memcpy(buf_p, data, len);
+  return buf_p + len;
+}
+
+/*
+ * static void out_flush
+ *
+ * Write out the buffered profile data.
+ */
+static	void	out_flush(void)
+{
+  int	len = profile_out.po_buf_p - profile_out.po_buf;
+  
+  if (len > 0 && (! profile_out.po_error_b)) {
+    if (write(profile_out.po_fd, profile_out.po_buf, len) != len) {
+      profile_out.po_error_b = 1;
+    }
+  }
+  profile_out.po_buf_p = profile_out.po_buf;
+}
+
+/*
+ * static void out_field
+ *
+ * Write a top level length-delimited field of the profile.
+ *
+ * ARGUMENTS:
+ *
+ * field -> Field number of the Profile message.
+ *
+ * data -> Bytes of the string or encoded message.
+ *
+ * len -> Number of bytes of data.
+ */
+static	void	out_field(const int field, const char *data, const int len)
+{
+  char	*bounds_p = profile_out.po_buf + sizeof(profile_out.po_buf);
+  
+  /* the key and length are at most 20 bytes */
+  if (profile_out.po_buf_p + len + 20 > bounds_p) {
+    out_flush();
+  }
+  profile_out.po_buf_p = pb_bytes_field(profile_out.po_buf_p, bounds_p, field,
+					data, len);
+}
+
+/*
+ * static void out_int
+ *
+ * Write a top level integer field of the profile.
+ *
+ * ARGUMENTS:
+ *
+ * field -> Field number of the Profile message.
+ *
+ * value -> Value we are writing.
+ */
+static	void	out_int(const int field, const unsigned long value)
+{
+  char	*bounds_p = profile_out.po_buf + sizeof(profile_out.po_buf);
+  
+  if (profile_out.po_buf_p + 20 > bounds_p) {
+    out_flush();
+  }
+  profile_out.po_buf_p = pb_int_field(profile_out.po_buf_p, bounds_p, field,
+				      value);
+}
+
+/*
+ * static unsigned long out_string
+ *
+ * Add a string to the profile's string table.
+ *
+ * Returns the index of the string in the table.
+ *
+ * ARGUMENTS:
+ *
+ * str -> String we are adding.
+ */
+static	unsigned long	out_string(const char *str)
+{
+  out_field(PROFILE_STRING_TABLE, str, strlen(str));
+  return profile_out.po_string_c++;
+}
+
+/*
+ * static void out_value_type
+ *
+ * Write a top level ValueType message field of the profile.
+ *
+ * ARGUMENTS:
+ *
+ * field -> Field number of the Profile message.
+ *
+ * type -> String index of the type.
+ *
+ * unit -> String index of the unit.
+ */
+static	void	out_value_type(const int field, const unsigned long type,
+			       const unsigned long unit)
+{
+  char	msg[32], *msg_p, *bounds_p = msg + sizeof(msg);
+  
+  msg_p = pb_int_field(msg, bounds_p, VALUE_TYPE_TYPE, type);
+  msg_p = pb_int_field(msg_p, bounds_p, VALUE_TYPE_UNIT, unit);
+  out_field(field, msg, msg_p - msg);
+}
+
+/*
+ * static void out_entry
+ *
+ * Write the function, location, and sample for an entry in the
+ * memory table.
+ *
+ * ARGUMENTS:
+ *
+ * entry_p -> Memory table entry we are writing.
+ *
+ * id -> Unique id of the entry used for the function and location.
+ *
+ * desc -> Description of the location of the entry.
+ */
+static	void	out_entry(const mem_entry_t *entry_p, const unsigned long id,
+			  const char *desc)
+{
+  char		msg[128], line_msg[32], *msg_p, *line_p;
+  char		*bounds_p = msg + sizeof(msg);
+  unsigned long	name_idx, file_idx;
+  
+  name_idx = out_string(desc);
+  if (entry_p->me_line == 0 || entry_p->me_file == NULL) {
+    /* return-address or the other pointers */
+    file_idx = 0;
+  }
+  else {
+    file_idx = out_string(entry_p->me_file);
+  }
+  
+  /* the function */
+  msg_p = pb_int_field(msg, bounds_p, FUNCTION_ID, id);
+  msg_p = pb_int_field(msg_p, bounds_p, FUNCTION_NAME, name_idx);
+  msg_p = pb_int_field(msg_p, bounds_p, FUNCTION_SYSTEM_NAME, name_idx);
+  msg_p = pb_int_field(msg_p, bounds_p, FUNCTION_FILENAME, file_idx);
+  out_field(PROFILE_FUNCTION, msg, msg_p - msg);
+  
+  /* the location with one line pointing to the function */
+  line_p = pb_int_field(line_msg, line_msg + sizeof(line_msg), LINE_FUNCTION_ID,
+			id);
+  line_p = pb_int_field(line_p, line_msg + sizeof(line_msg), LINE_LINE,
+			entry_p->me_line);
+  msg_p = pb_int_field(msg, bounds_p, LOCATION_ID, id);
+  if (entry_p->me_line == 0 && entry_p->me_file != NULL) {
+    msg_p = pb_int_field(msg_p, bounds_p, LOCATION_ADDRESS,
+			 (PNT_ARITH_TYPE)entry_p->me_file);
+  }
+  msg_p = pb_bytes_field(msg_p, bounds_p, LOCATION_LINE, line_msg,
+			 line_p - line_msg);
+  out_field(PROFILE_LOCATION, msg, msg_p - msg);
+  
+  /* the sample in the order of the sample types */
+  msg_p = pb_int_field(msg, bounds_p, SAMPLE_LOCATION_ID, id);
+  msg_p = pb_int_field(msg_p, bounds_p, SAMPLE_VALUE, entry_p->me_total_c);
+  msg_p = pb_int_field(msg_p, bounds_p, SAMPLE_VALUE, entry_p->me_total_size);
+  msg_p = pb_int_field(msg_p, bounds_p, SAMPLE_VALUE, entry_p->me_in_use_c);
+  msg_p = pb_int_field(msg_p, bounds_p, SAMPLE_VALUE,
+		       entry_p->me_in_use_size);
+  out_field(PROFILE_SAMPLE, msg, msg_p - msg);
+}
+
+/*
+ * int _dmalloc_profile_write
+ *
+ * Write the information from a memory table to a file as a pprof
+ * compatible heap profile.  The samples have the allocated objects
+ * and space as well as the in-use objects and space for each
+ * location in the table.
+ *
+ * Returns 1 on success or 0 on failure.
+ *
+ * ARGUMENTS:
+ *
+ * path -> Path of the file to write.
+ *
+ * mem_table -> Memory table we are writing.
+ */
+int	_dmalloc_profile_write(const char *path, const mem_table_t *mem_table)
+{
+  const mem_entry_t	*entry_p;
+  unsigned long		id = 0, count_idx, bytes_idx, inuse_space_idx;
+  char			desc[MAX_FILE_LENGTH + 64];
+  
+  profile_out.po_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (profile_out.po_fd < 0) {
+    dmalloc_message("could not open heap profile '%s'", path);
+    return 0;
+  }
+  profile_out.po_error_b = 0;
+  profile_out.po_string_c = 0;
+  profile_out.po_buf_p = profile_out.po_buf;
+  
+  /* the first string in the table must be empty */
+  (void)out_string("");
+  
+  /* these are the sample types that pprof uses for heap profiles */
+  count_idx = out_string("count");
+  bytes_idx = out_string("bytes");
+  out_value_type(PROFILE_SAMPLE_TYPE, out_string("alloc_objects"), count_idx);
+  out_value_type(PROFILE_SAMPLE_TYPE, out_string("alloc_space"), bytes_idx);
+  out_value_type(PROFILE_SAMPLE_TYPE, out_string("inuse_objects"), count_idx);
+  inuse_space_idx = out_string("inuse_space");
+  out_value_type(PROFILE_SAMPLE_TYPE, inuse_space_idx, bytes_idx);
+  out_value_type(PROFILE_PERIOD_TYPE, out_string("space"), bytes_idx);
+  out_int(PROFILE_DEFAULT_SAMPLE_TYPE, inuse_space_idx);
+#if HAVE_TIME
+  /* nano-seconds will not fit in a 32-bit long */
+  if (sizeof(unsigned long) >= 8) {
+    out_int(PROFILE_TIME_NANOS,
+	    (unsigned long)time(NULL) * (unsigned long)1000000000);
+  }
+#endif
+  
+  for (entry_p = mem_table->mt_entries;
+       entry_p < mem_table->mt_bounds_p;
+       entry_p++) {
+    if (entry_p->me_file == NULL) {
+      continue;
+    }
+    (void)_dmalloc_chunk_desc_pnt(desc, sizeof(desc), entry_p->me_file,
+				  entry_p->me_line);
+    out_entry(entry_p, ++id, desc);
+  }
+  
+  /* the locations that did not fit in the table */
+  if (mem_table->mt_other_pointers.me_total_c > 0) {
+    out_entry(&mem_table->mt_other_pointers, ++id, "other pointers");
+  }
+  
+  out_flush();
+  (void)close(profile_out.po_fd);
+  
+  if (profile_out.po_error_b) {
+    dmalloc_message("could not write heap profile '%s'", path);
+    return 0;
+  }
+  
+  return 1;
+}
@@ -0,0 +1,50 @@
+/*
+ * Defines for the heap profile routines.
+ *
+ * Copyright 2020 by Gray Watson
+ *
+ * This file is part of the dmalloc package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ *
+ * The author may be contacted via https://dmalloc.com/
+ */
+
+#ifndef __PROFILE_H__
+#define __PROFILE_H__
+
+#include "dmalloc_tab.h"			/* for mem_table_t */
+
+/*<<<<<<<<<<  The below prototypes are auto-generated by fillproto */
+
+/*
+ * int _dmalloc_profile_write
+ *
+ * Write the information from a memory table to a file as a pprof
+ * compatible heap profile.  The samples have the allocated objects
+ * and space as well as the in-use objects and space for each
+ * location in the table.
+ *
+ * Returns 1 on success or 0 on failure.
+ *
+ * ARGUMENTS:
+ *
+ * path -> Path of the file to write.
+ *
+ * mem_table -> Memory table we are writing.
+ */
+extern
+int	_dmalloc_profile_write(const char *path, const mem_table_t *mem_table);
+
+/*<<<<<<<<<<   This is end of the auto-generated output from fillproto. */
+
+#endif /* ! __PROFILE_H__ */
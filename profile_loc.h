@@ -0,0 +1,70 @@
+/*
+ * Local defines for the heap profile routines.
+ *
+ * Copyright 2020 by Gray Watson
+ *
+ * This file is part of the dmalloc package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ *
+ * The author may be contacted via https://dmalloc.com/
+ */
+
+#ifndef __PROFILE_LOC_H__
+#define __PROFILE_LOC_H__
+
+/* size of the buffer used to write the profile */
+#define PROFILE_BUFFER_SIZE	4096
+
+/* protobuf wire types and the key which holds a field number and type */
+#define PB_WIRE_VARINT		0
+#define PB_WIRE_LENGTH		2
+#define PB_KEY(field, wire)	((unsigned long)(((field) << 3) | (wire)))
+
+/*
+ * Field numbers from the profile.proto file distributed with pprof.
+ */
+
+/* Profile message */
+#define PROFILE_SAMPLE_TYPE		1
+#define PROFILE_SAMPLE			2
+#define PROFILE_LOCATION		4
+#define PROFILE_FUNCTION		5
+#define PROFILE_STRING_TABLE		6
+#define PROFILE_TIME_NANOS		9
+#define PROFILE_PERIOD_TYPE		11
+#define PROFILE_DEFAULT_SAMPLE_TYPE	14
+
+/* ValueType message */
+#define VALUE_TYPE_TYPE			1
+#define VALUE_TYPE_UNIT			2
+
+/* Sample message */
+#define SAMPLE_LOCATION_ID		1
+#define SAMPLE_VALUE			2
+
+/* Location message */
+#define LOCATION_ID			1
+#define LOCATION_ADDRESS		3
+#define LOCATION_LINE			4
+
+/* Line message */
+#define LINE_FUNCTION_ID		1
+#define LINE_LINE			2
+
+/* Function message */
+#define FUNCTION_ID			1
+#define FUNCTION_NAME			2
+#define FUNCTION_SYSTEM_NAME		3
+#define FUNCTION_FILENAME		4
+
+#endif /* ! __PROFILE_LOC_H__ */
@@ -0,0 +1,743 @@
+/*
+ * Query server routines
+ *
+ * Copyright 2020 by Gray Watson
+ *
+ * This file is part of the dmalloc package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ *
+ * The author may be contacted via https://dmalloc.com/
+ */
+
+/*
+ * This file contains the routines which answer queries about the
+ * heap on a unix domain socket.  Each connection sends one request
+ * line and gets back one line of JSON.  In the threaded library the
+ * socket is served by a thread of its own.  Otherwise it is checked
+ * at most once a second when a call leaves the library.  Either way
+ * the library is only locked while the snapshot for the reply is
+ * copied and not while talking to the client.
+ */
+
+#include <fcntl.h>				/* for O_NONBLOCK */
+#if HAVE_POLL_H && HAVE_SYS_SOCKET_H && HAVE_SYS_UN_H
+# include <poll.h>				/* for poll */
+# include <sys/socket.h>			/* for socket, etc. */
+# include <sys/un.h>				/* for sockaddr_un */
+# define SERVER_SOCKETS	1
+#else
+# define SERVER_SOCKETS	0
+#endif
+
+#if HAVE_STDLIB_H
+# include <stdlib.h>				/* for strtoul */
+#endif
+#if HAVE_STRING_H
+# include <string.h>
+#endif
+#if HAVE_UNISTD_H
+# include <unistd.h>				/* for read, write, close */
+#endif
+
+#define DMALLOC_DISABLE
+
+#include "conf.h"
+
+#if SERVER_SOCKETS && LOCK_THREADS && defined(__ATOMIC_ACQUIRE)
+# define SERVER_THREAD	1
+#else
+# define SERVER_THREAD	0
+#endif
+
+#if SERVER_THREAD
+# include <pthread.h>				/* for pthread_create */
+#endif
+
+#include "dmalloc.h"
+
+#include "append.h"
+#include "chunk.h"
+#include "clock.h"
+#include "dmalloc_loc.h"
+#include "dmalloc_tab.h"
+#include "error.h"
+#include "leak.h"
+#include "server.h"
+#include "user_malloc.h"
+
+/* states of the server thread */
+#define SERVER_STOPPED	0
+#define SERVER_STARTING	1
+#define SERVER_RUNNING	2
+
+#define ITEM_MAX	256			/* most sites or pointers */
+#define ITEM_DEFAULT	10			/* sites or pointers if no n */
+#define SOURCE_SIZE	64			/* size of a file:line */
+#define REQUEST_SIZE	256			/* longest request line */
+#define REPLY_SIZE	(ITEM_MAX * 160 + 1024)	/* largest reply */
+#define POLL_MSECS	1000			/* thread checks path changes */
+#if SERVER_THREAD
+# define READ_MSECS	1000			/* wait for the request */
+# define WRITE_MSECS	1000			/* wait for the reply to go */
+#else
+# define READ_MSECS	0			/* no waiting inside a call */
+# define WRITE_MSECS	10			/* most we add to a call */
+#endif
+
+/* the requests that we answer */
+#define REQ_STATS	"stats"
+#define REQ_TOP		"top"
+#define REQ_CHANGED	"changed"
+#define REQ_EXAMINE	"examine"
+#define REQ_CHECK	"check"
+
+/* a call-site or pointer copied out of the library */
+typedef struct {
+  const void		*si_pnt;		/* pointer or NULL for sites */
+  unsigned long		si_size;		/* size or total-size */
+  unsigned long		si_count;		/* total count of a site */
+  unsigned long		si_in_use_size;		/* in-use size of a site */
+  unsigned long		si_in_use_c;		/* in-use count of a site */
+  unsigned long		si_iter;		/* when a pointer changed */
+  char			si_source[SOURCE_SIZE];	/* file:line or ra=addr */
+} server_item_t;
+
+/* local variables */
+static	char		server_path[512] = { '\0' }; /* path from the options */
+static	char		sock_path[512] = { '\0' }; /* path of our socket */
+static	int		server_gen = 0;		/* changes with the path */
+static	long		sock_pid = -1;		/* process that made it */
+#if SERVER_SOCKETS
+static	char		path_copy[512];		/* server path for the thread */
+static	int		sock_gen = -1;		/* generation of our socket */
+static	int		listen_fd = -1;		/* socket we accept on */
+#endif
+#if SERVER_THREAD
+static	int		server_state = SERVER_STOPPED; /* state of the thread */
+static	long		server_pid = -1;	/* process of the thread */
+#elif SERVER_SOCKETS
+static	long		poll_secs = -1;		/* second of the last poll */
+static	int		serving_b = 0;		/* answering a request */
+#endif
+
+#if SERVER_SOCKETS
+/* the snapshot of the request being answered */
+static	server_item_t	items[ITEM_MAX];	/* sites or pointers */
+static	int		item_c = 0;		/* entries in items */
+static	unsigned long	item_mark = 0;		/* mark of changed request */
+static	unsigned long	item_total_c = 0;	/* pointers that matched */
+static	char		reply[REPLY_SIZE];	/* reply being written */
+#endif
+
+/****************************** local utilities ******************************/
+
+/*
+ * static long get_pid
+ *
+ * Returns the process-id or 0 if it is not available.
+ */
+static	long	get_pid(void)
+{
+#if HAVE_GETPID
+  return getpid();
+#else
+  return 0;
+#endif
+}
+
+#if SERVER_SOCKETS
+/*
+ * static void close_socket
+ *
+ * Close our listening socket and remove it if we created it.
+ */
+static	void	close_socket(void)
+{
+  if (listen_fd >= 0) {
+    (void)close(listen_fd);
+    listen_fd = -1;
+  }
+  if (sock_path[0] != '\0' && sock_pid == get_pid()) {
+    (void)unlink(sock_path);
+  }
+  sock_path[0] = '\0';
+  sock_pid = -1;
+}
+
+/*
+ * static int open_socket
+ *
+ * Create the listening socket at PATH, replacing %p with the
+ * process-id.
+ *
+ * Returns 1 on success or 0 on failure.
+ */
+static	int	open_socket(const char *path)
+{
+  struct sockaddr_un	addr;
+  const char		*path_p;
+  char			*buf_p, *bounds_p;
+  
+  sock_pid = get_pid();
+  buf_p = sock_path;
+  bounds_p = sock_path + MIN(sizeof(sock_path), sizeof(addr.sun_path));
+  for (path_p = path; *path_p != '\0'; path_p++) {
+    if (*path_p == '%' && *(path_p + 1) == 'p') {
+      buf_p = append_long(buf_p, bounds_p, sock_pid, 10);
+      path_p++;
+    }
+    else if (buf_p < bounds_p - 1) {
+      *buf_p++ = *path_p;
+    }
+  }
+  (void)append_null(buf_p, bounds_p);
+  
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  (void)strcpy(addr.sun_path, sock_path);
+  
+  listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listen_fd < 0) {
+    dmalloc_message("could not create query socket");
+    sock_path[0] = '\0';
+    return 0;
+  }
+  /* a socket left by a process that crashed is in our way */
+  (void)unlink(sock_path);
+  if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0
+      || listen(listen_fd, 4) != 0) {
+    dmalloc_message("could not listen on query socket '%s'", sock_path);
+    (void)close(listen_fd);
+    listen_fd = -1;
+    sock_path[0] = '\0';
+    return 0;
+  }
+#if SERVER_THREAD == 0
+  /* we only take the connections that are already waiting */
+  (void)fcntl(listen_fd, F_SETFL, fcntl(listen_fd, F_GETFL, 0) | O_NONBLOCK);
+#endif
+  
+  return 1;
+}
+
+/*
+ * static void copy_path
+ *
+ * Copy the server path and its generation while the library is
+ * locked.
+ */
+static	void	copy_path(void *arg)
+{
+  (void)strcpy(path_copy, server_path);
+  *(int *)arg = server_gen;
+}
+
+/*
+ * static void copy_top
+ *
+ * Copy the call-sites with the largest total-size into the items
+ * while the library is locked.
+ */
+static	void	copy_top(void *arg)
+{
+  mem_entry_t	*top[ITEM_MAX];
+  int		top_c;
+  
+  top_c = _dmalloc_chunk_top_entries(top, *(int *)arg);
+  for (item_c = 0; item_c < top_c; item_c++) {
+    items[item_c].si_pnt = NULL;
+    items[item_c].si_size = top[item_c]->me_total_size;
+    items[item_c].si_count = top[item_c]->me_total_c;
+    items[item_c].si_in_use_size = top[item_c]->me_in_use_size;
+    items[item_c].si_in_use_c = top[item_c]->me_in_use_c;
+    (void)_dmalloc_chunk_desc_pnt(items[item_c].si_source, SOURCE_SIZE,
+				  top[item_c]->me_file, top[item_c]->me_line);
+  }
+}
+
+/*
+ * static int copy_pnt
+ *
+ * Walk function that copies one of the changed pointers into the
+ * items.
+ */
+static	int	copy_pnt(const void *pnt, const unsigned int size,
+			 const unsigned int total_size, const char *file,
+			 const unsigned int line, const unsigned long iter,
+			 const unsigned int flags, void *arg)
+{
+  server_item_t	*item_p;
+  
+  item_total_c++;
+  if (item_c >= *(int *)arg) {
+    /* keep counting the pointers that did not fit */
+    return 1;
+  }
+  item_p = items + item_c++;
+  item_p->si_pnt = pnt;
+  item_p->si_size = size;
+  item_p->si_iter = iter;
+  (void)_dmalloc_chunk_desc_pnt(item_p->si_source, SOURCE_SIZE, file, line);
+  return 1;
+}
+
+/*
+ * static void copy_changed
+ *
+ * Copy the pointers in use that changed since the mark into the
+ * items while the library is locked.
+ */
+static	void	copy_changed(void *arg)
+{
+  item_c = 0;
+  item_total_c = 0;
+  (void)_dmalloc_chunk_walk(item_mark, copy_pnt, arg);
+}
+
+/*
+ * static char *append_json_string
+ *
+ * Append STR as a quoted JSON string.
+ */
+static	char	*append_json_string(char *buf_p, char *bounds_p,
+				    const char *str)
+{
+  const char	*str_p;
+  
+  buf_p = append_string(buf_p, bounds_p, "\"");
+  for (str_p = str; *str_p != '\0' && buf_p < bounds_p - 2; str_p++) {
+    if (*str_p == '"' || *str_p == '\\') {
+      *buf_p++ = '\\';
+      *buf_p++ = *str_p;
+    }
+    else if ((unsigned char)*str_p < ' ') {
+      *buf_p++ = '?';
+    }
+    else {
+      *buf_p++ = *str_p;
+    }
+  }
+  return append_string(buf_p, bounds_p, "\"");
+}
+
+/*
+ * static char *answer
+ *
+ * Take the snapshot for the REQUEST and format the reply.
+ *
+ * Returns the end of the reply in the reply buffer.
+ */
+static	char	*answer(const char *request)
+{
+  dmalloc_stats_t	stats;
+  DMALLOC_SIZE		user_size;
+  const char		*word_p, *arg_p;
+  char			*file, *buf_p, *bounds_p = reply + sizeof(reply);
+  char			*end_p, source[SOURCE_SIZE];
+  unsigned int		line;
+  unsigned long		used_mark, seen_c, arg1 = 0, arg2 = 0;
+  int			word_len, arg_c = 0, item_n, which_c;
+  
+  /* split the request into a word and up to two numbers */
+  word_p = request + strspn(request, " ");
+  word_len = strcspn(word_p, " ");
+  for (arg_p = word_p + word_len; *arg_p != '\0' && arg_c < 2; arg_p = end_p) {
+    arg2 = strtoul(arg_p, &end_p, 0);
+    if (end_p == arg_p) {
+      break;
+    }
+    if (arg_c++ == 0) {
+      arg1 = arg2;
+      arg2 = 0;
+    }
+  }
+  
+  buf_p = reply;
+  if (word_len == strlen(REQ_STATS)
+      && strncmp(word_p, REQ_STATS, word_len) == 0) {
+    if (dmalloc_get_stats_ex(&stats, sizeof(stats)) != DMALLOC_NOERROR) {
+      return append_string(buf_p, bounds_p, "{\"error\":\"no stats\"}");
+    }
+    buf_p = append_format(buf_p, bounds_p,
+			  "{\"mark\":%lu,\"heap_low\":\"%p\","
+			  "\"heap_high\":\"%p\",\"total_space\":%lu,"
+			  "\"user_space\":%lu,\"free_space\":%lu,",
+			  stats.ds_iter_c, stats.ds_heap_low,
+			  stats.ds_heap_high,
+			  stats.ds_total_space, stats.ds_user_space,
+			  stats.ds_free_space);
+    buf_p = append_format(buf_p, bounds_p,
+			  "\"in_use\":%lu,\"in_use_pnts\":%lu,"
+			  "\"max_in_use\":%lu,\"max_in_use_pnts\":%lu,"
+			  "\"total\":%lu,\"total_pnts\":%lu,"
+			  "\"max_one\":%lu,\"heap_checks\":%lu,",
+			  stats.ds_alloc_current, stats.ds_alloc_cur_pnts,
+			  stats.ds_alloc_maximum, stats.ds_alloc_max_pnts,
+			  stats.ds_alloc_cur_given, stats.ds_alloc_tot_pnts,
+			  stats.ds_alloc_one_max, stats.ds_heap_check_c);
+    return append_format(buf_p, bounds_p,
+			 "\"malloc\":%lu,\"calloc\":%lu,\"realloc\":%lu,"
+			 "\"memalign\":%lu,\"valloc\":%lu,\"new\":%lu,"
+			 "\"free\":%lu,\"delete\":%lu}",
+			 stats.ds_malloc_c, stats.ds_calloc_c,
+			 stats.ds_realloc_c, stats.ds_memalign_c,
+			 stats.ds_valloc_c, stats.ds_new_c, stats.ds_free_c,
+			 stats.ds_delete_c);
+  }
+  
+  if ((word_len == strlen(REQ_TOP)
+       && strncmp(word_p, REQ_TOP, word_len) == 0)
+      || (word_len == strlen(REQ_CHANGED)
+	  && strncmp(word_p, REQ_CHANGED, word_len) == 0)) {
+    if (*word_p == 't') {
+      arg2 = (arg_c > 0 ? arg1 : ITEM_DEFAULT);
+    }
+    else {
+      item_mark = arg1;
+      arg2 = (arg_c > 1 ? arg2 : ITEM_DEFAULT);
+    }
+    item_n = (arg2 == 0 || arg2 > ITEM_MAX ? ITEM_MAX : (int)arg2);
+    item_c = 0;
+    if (! _dmalloc_call_locked((*word_p == 't' ? copy_top : copy_changed),
+			       &item_n)) {
+      return append_string(buf_p, bounds_p, "{\"error\":\"library busy\"}");
+    }
+  
+    if (*word_p == 't') {
+      buf_p = append_string(buf_p, bounds_p, "{\"sites\":[");
+    }
+    else {
+      buf_p = append_format(buf_p, bounds_p,
+			    "{\"mark\":%lu,\"count\":%lu,\"pointers\":[",
+			    item_mark, item_total_c);
+    }
+    for (which_c = 0; which_c < item_c; which_c++) {
+      if (which_c > 0) {
+	buf_p = append_string(buf_p, bounds_p, ",");
+      }
+      if (*word_p == 't') {
+	buf_p = append_format(buf_p, bounds_p,
+			      "{\"total_size\":%lu,\"total_count\":%lu,"
+			      "\"in_use_size\":%lu,\"in_use_count\":%lu,"
+			      "\"source\":",
+			      items[which_c].si_size, items[which_c].si_count,
+			      items[which_c].si_in_use_size,
+			      items[which_c].si_in_use_c);
+      }
+      else {
+	buf_p = append_format(buf_p, bounds_p,
+			      "{\"pnt\":\"%p\",\"size\":%lu,\"mark\":%lu,"
+			      "\"source\":",
+			      items[which_c].si_pnt,
+			      items[which_c].si_size, items[which_c].si_iter);
+      }
+      buf_p = append_json_string(buf_p, bounds_p, items[which_c].si_source);
+      buf_p = append_string(buf_p, bounds_p, "}");
+    }
+    return append_string(buf_p, bounds_p, "]}");
+  }
+  
+  if (word_len == strlen(REQ_EXAMINE)
+      && strncmp(word_p, REQ_EXAMINE, word_len) == 0) {
+    if (arg_c == 0
+	|| dmalloc_examine((DMALLOC_PNT)arg1, &user_size, NULL, &file, &line,
+			   NULL, &used_mark, &seen_c) != DMALLOC_NOERROR) {
+      return append_string(buf_p, bounds_p, "{\"error\":\"not found\"}");
+    }
+    (void)_dmalloc_chunk_desc_pnt(source, sizeof(source), file, line);
+    buf_p = append_format(buf_p, bounds_p,
+			  "{\"pnt\":\"%p\",\"size\":%lu,\"mark\":%lu,"
+			  "\"seen\":%lu,\"source\":",
+			  (DMALLOC_PNT)arg1, (unsigned long)user_size, used_mark,
+			  seen_c);
+    buf_p = append_json_string(buf_p, bounds_p, source);
+    return append_string(buf_p, bounds_p, "}");
+  }
+  
+  if (word_len == strlen(REQ_CHECK)
+      && strncmp(word_p, REQ_CHECK, word_len) == 0) {
+    if (dmalloc_verify(NULL) == DMALLOC_VERIFY_NOERROR) {
+      return append_string(buf_p, bounds_p, "{\"heap_ok\":true}");
+    }
+    buf_p = append_format(buf_p, bounds_p,
+			  "{\"heap_ok\":false,\"errno\":%d,\"error\":",
+			  dmalloc_errno);
+    buf_p = append_json_string(buf_p, bounds_p,
+			       dmalloc_strerror(dmalloc_errno));
+    return append_string(buf_p, bounds_p, "}");
+  }
+  
+  return append_string(buf_p, bounds_p, "{\"error\":\"unknown request\"}");
+}
+
+/*
+ * static void serve
+ *
+ * Read one request from the connection in FD and write the reply.
+ * The connection is non-blocking so a client that stalls can only
+ * hold us up for READ_MSECS while sending the request and WRITE_MSECS
+ * while reading the reply.  A request that is not finished in time is
+ * dropped without an answer.
+ */
+static	void	serve(const int fd)
+{
+  struct pollfd	pfd;
+  char		request[REQUEST_SIZE], *end_p, *buf_p;
+  unsigned long	start, now;
+  int		len = 0, ret, done_b = 0, wait_msecs;
+  
+  (void)fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+  
+  /* read until the end of the line or the client stops writing */
+  while (len < (int)sizeof(request) - 1) {
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, READ_MSECS) <= 0) {
+      break;
+    }
+    ret = read(fd, request + len, sizeof(request) - 1 - len);
+    if (ret == 0) {
+      /* the client closed its end so this is all of the request */
+      done_b = 1;
+      break;
+    }
+    if (ret < 0) {
+      break;
+    }
+    len += ret;
+    if (memchr(request, '\n', len) != NULL) {
+      done_b = 1;
+      break;
+    }
+  }
+  if (! done_b) {
+    return;
+  }
+  request[len] = '\0';
+  end_p = strpbrk(request, "\r\n");
+  if (end_p != NULL) {
+    *end_p = '\0';
+  }
+  
+  end_p = answer(request);
+  end_p = append_string(end_p, reply + sizeof(reply) - 1, "\n");
+  
+  /* WRITE_MSECS is for the whole reply and not for each write */
+  start = _dmalloc_clock_nanos();
+  wait_msecs = WRITE_MSECS;
+  for (buf_p = reply; buf_p < end_p; buf_p += ret) {
+    pfd.fd = fd;
+    pfd.events = POLLOUT;
+    if (poll(&pfd, 1, wait_msecs) <= 0) {
+      break;
+    }
+    ret = write(fd, buf_p, end_p - buf_p);
+    if (ret <= 0) {
+      break;
+    }
+    now = _dmalloc_clock_nanos();
+    if (start == 0 || now - start >= (unsigned long)WRITE_MSECS * 1000000) {
+      /* out of time or no clock so we only write what fits */
+      wait_msecs = 0;
+    }
+    else {
+      wait_msecs = WRITE_MSECS - (int)((now - start) / 1000000);
+    }
+  }
+}
+
+/*
+ * static int check_socket
+ *
+ * Make sure our listening socket matches the current path if it has
+ * changed.
+ *
+ * Returns 1 if we have a socket to accept on or 0 if not.
+ */
+static	int	check_socket(void)
+{
+  int	gen;
+  
+  /* a forked child gets its own socket and leaves the parent's alone */
+  if (listen_fd >= 0 && sock_pid != get_pid()) {
+    close_socket();
+    sock_gen = -1;
+  }
+  
+  if (! _dmalloc_call_locked(copy_path, &gen)) {
+    return (listen_fd >= 0);
+  }
+  if (gen != sock_gen) {
+    close_socket();
+    sock_gen = gen;
+    if (path_copy[0] != '\0') {
+      (void)open_socket(path_copy);
+    }
+  }
+  
+  return (listen_fd >= 0);
+}
+
+#if SERVER_THREAD
+/*
+ * static void *server_thread
+ *
+ * Thread which accepts the connections on the socket and answers
+ * them until the server path is cleared.
+ *
+ * Returns NULL.
+ *
+ * ARGUMENTS:
+ *
+ * arg -> Unused thread argument.
+ */
+static	void	*server_thread(void *arg)
+{
+  struct pollfd	pfd;
+  int		fd;
+  
+  for (;;) {
+    if (! check_socket()) {
+      break;
+    }
+  
+    /* wake up now and then to see if the path was changed */
+    pfd.fd = listen_fd;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, POLL_MSECS) <= 0) {
+      continue;
+    }
+    fd = accept(listen_fd, NULL, NULL);
+    if (fd >= 0) {
+      serve(fd);
+      (void)close(fd);
+    }
+  }
+  
+  __atomic_store_n(&server_state, SERVER_STOPPED, __ATOMIC_RELEASE);
+  return NULL;
+}
+#endif /* SERVER_THREAD */
+#endif /* SERVER_SOCKETS */
+
+/**************************** exported routines ******************************/
+
+/*
+ * void _dmalloc_server_setup
+ *
+ * Set the path of the query socket.  If it has changed then the
+ * current socket is removed and the new one is opened when the
+ * server next runs.  The library should be locked.
+ *
+ * ARGUMENTS:
+ *
+ * path -> Path of the socket with %p for the process-id or NULL to
+ * not answer queries.
+ */
+void	_dmalloc_server_setup(const char *path)
+{
+  if (path == NULL) {
+    path = "";
+  }
+  if (strcmp(path, server_path) != 0) {
+    (void)strncpy(server_path, path, sizeof(server_path));
+    server_path[sizeof(server_path) - 1] = '\0';
+    server_gen++;
+  }
+#if SERVER_SOCKETS
+  /* the items are not roots of the leak scan */
+  _dmalloc_leak_skip(items, sizeof(items));
+#endif
+}
+
+/*
+ * void _dmalloc_server_run
+ *
+ * Start the query server thread in the threaded library or answer
+ * any waiting queries in the other library.  This is called when
+ * leaving the library and must be outside of the library lock.
+ */
+void	_dmalloc_server_run(void)
+{
+#if SERVER_THREAD
+  pthread_t	thread;
+  int		state = SERVER_STOPPED;
+  
+  if (server_path[0] == '\0') {
+    return;
+  }
+  /* the thread does not survive a fork */
+  if (__atomic_load_n(&server_state, __ATOMIC_ACQUIRE) == SERVER_RUNNING
+      && server_pid != get_pid()) {
+    __atomic_store_n(&server_state, SERVER_STOPPED, __ATOMIC_RELEASE);
+  }
+  /* quick check so we can be called on every library call */
+  if (__atomic_load_n(&server_state, __ATOMIC_ACQUIRE) != SERVER_STOPPED) {
+    return;
+  }
+  /* only one thread gets to start the server */
+  if (! __atomic_compare_exchange_n(&server_state, &state, SERVER_STARTING,
+				    0 /* strong */, __ATOMIC_ACQ_REL,
+				    __ATOMIC_ACQUIRE)) {
+    return;
+  }
+  
+  server_pid = get_pid();
+  if (pthread_create(&thread, NULL, server_thread, NULL) != 0) {
+    dmalloc_message("could not start the query server thread");
+    /* do not try again until the path is changed */
+    server_path[0] = '\0';
+    __atomic_store_n(&server_state, SERVER_STOPPED, __ATOMIC_RELEASE);
+    return;
+  }
+  (void)pthread_detach(thread);
+  __atomic_store_n(&server_state, SERVER_RUNNING, __ATOMIC_RELEASE);
+#elif SERVER_SOCKETS
+  long	now;
+  int	fd;
+  
+  if (serving_b || (server_path[0] == '\0' && listen_fd < 0)) {
+    return;
+  }
+  /* we only look for queries once a second */
+  now = _dmalloc_clock_seconds();
+  if (now == poll_secs) {
+    return;
+  }
+  poll_secs = now;
+  
+  /* our own calls to the library come back through here */
+  serving_b = 1;
+  if (check_socket()) {
+    fd = accept(listen_fd, NULL, NULL);
+    if (fd >= 0) {
+      serve(fd);
+      (void)close(fd);
+    }
+  }
+  serving_b = 0;
+#endif
+}
+
+/*
+ * void _dmalloc_server_shutdown
+ *
+ * Remove the query socket when the program is finished.
+ */
+void	_dmalloc_server_shutdown(void)
+{
+  /* only the process that created the socket removes it */
+  if (sock_path[0] != '\0' && sock_pid == get_pid()) {
+    (void)unlink(sock_path);
+  }
+}
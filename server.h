@@ -0,0 +1,62 @@
+/*
+ * Defines for the query server routines.
+ *
+ * Copyright 2020 by Gray Watson
+ *
+ * This file is part of the dmalloc package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ *
+ * The author may be contacted via https://dmalloc.com/
+ */
+
+#ifndef __SERVER_H__
+#define __SERVER_H__
+
+/*<<<<<<<<<<  The below prototypes are auto-generated by fillproto */
+
+/*
+ * void _dmalloc_server_setup
+ *
+ * Set the path of the query socket.  If it has changed then the
+ * current socket is removed and the new one is opened when the
+ * server next runs.  The library should be locked.
+ *
+ * ARGUMENTS:
+ *
+ * path -> Path of the socket with %p for the process-id or NULL to
+ * not answer queries.
+ */
+extern
+void	_dmalloc_server_setup(const char *path);
+
+/*
+ * void _dmalloc_server_run
+ *
+ * Start the query server thread in the threaded library or answer
+ * any waiting queries in the other library.  This is called when
+ * leaving the library and must be outside of the library lock.
+ */
+extern
+void	_dmalloc_server_run(void);
+
+/*
+ * void _dmalloc_server_shutdown
+ *
+ * Remove the query socket when the program is finished.
+ */
+extern
+void	_dmalloc_server_shutdown(void);
+
+/*<<<<<<<<<<   This is end of the auto-generated output from fillproto. */
+
+#endif /* ! __SERVER_H__ */
@@ -0,0 +1,280 @@
+/*
+ * Heap snapshot routines
+ *
+ * Copyright 2020 by Gray Watson
+ *
+ * This file is part of the dmalloc package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ *
+ * The author may be contacted via https://dmalloc.com/
+ */
+
+/*
+ * This file contains routines which write the pointers in use to a
+ * file as fixed-size binary records instead of logging a line of
+ * text for each of them.  File-names are written once into the file
+ * and the records refer to them by id.  The dmalloc utility can
+ * compare two snapshots to show the growth of each call-site.
+ */
+
+#include <fcntl.h>				/* for O_WRONLY, etc. */
+
+#if HAVE_STRING_H
+# include <string.h>
+#endif
+#if HAVE_UNISTD_H
+# include <unistd.h>				/* for write, getpid */
+#endif
+
+#define DMALLOC_DISABLE
+
+#include "conf.h"
+#include "dmalloc.h"
+
+#include "binlog_loc.h"
+#include "chunk.h"
+#include "clock.h"
+#include "dmalloc_loc.h"
+#include "error.h"
+#include "leak.h"
+#include "snapshot.h"
+
+/* number of file-names whose ids we remember while writing */
+#define FILE_KEY_N	1024
+
+/* local variables */
+static	int		snap_fd = -1;		/* fd of the snapshot or -1 */
+static	snapshot_rec_t	rec_buf[SNAPSHOT_BUFFER_RECS]; /* records to write */
+static	int		rec_c = 0;		/* number of records in buf */
+static	const char	*file_keys[FILE_KEY_N];	/* file-names given ids */
+static	unsigned long	file_ids[FILE_KEY_N];	/* ids of the file-names */
+static	int		file_key_c = 0;		/* file-names in the table */
+static	unsigned long	file_id_c = 0;		/* last file-name id */
+
+/****************************** local utilities ******************************/
+
+/*
+ * static int flush_recs
+ *
+ * Write the buffered records to the snapshot.
+ *
+ * Returns 1 on success or 0 on failure.
+ */
+static	int	flush_recs(void)
+{
+  int	size;
+  
+  if (rec_c == 0) {
+    return 1;
+  }
+  size = rec_c * sizeof(snapshot_rec_t);
+  rec_c = 0;
+  return (write(snap_fd, rec_buf, size) == size);
+}
+
+/*
+ * static snapshot_rec_t *get_recs
+ *
+ * Get a number of clear records from the buffer, flushing it if the
+ * records do not fit.
+ *
+ * Returns a pointer to the first record or NULL on error.
+ *
+ * ARGUMENTS:
+ *
+ * rec_n -> Number of records we need.
+ */
+static	snapshot_rec_t	*get_recs(const int rec_n)
+{
+  snapshot_rec_t	*rec_p;
+  
+  if (rec_c + rec_n > SNAPSHOT_BUFFER_RECS && (! flush_recs())) {
+    return NULL;
+  }
+  rec_p = rec_buf + rec_c;
+  memset(rec_p, 0, rec_n * sizeof(snapshot_rec_t));
+  rec_c += rec_n;
+  
+  return rec_p;
+}
+
+/*
+ * static int file_id
+ *
+ * Get the id of a file-name, writing a name entry into the snapshot
+ * the first time that we see the file-name.
+ *
+ * Returns 1 on success or 0 on failure.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address of the call-site.
+ *
+ * line -> Line-number of the call-site.
+ *
+ * id_p <- Pointer to the id of the file-name or the return-address
+ * if there is no line-number.
+ */
+static	int	file_id(const char *file, const unsigned int line,
+			unsigned long *id_p)
+{
+  snapshot_rec_t	*rec_p;
+  unsigned int		hash_c;
+  int			len;
+  
+  if (line == DMALLOC_DEFAULT_LINE) {
+    *id_p = (PNT_ARITH_TYPE)file;
+    return 1;
+  }
+  if (file == DMALLOC_DEFAULT_FILE) {
+    *id_p = 0;
+    return 1;
+  }
+  
+  /* the file-names are constant strings so we look them up by pointer */
+  hash_c = ((PNT_ARITH_TYPE)file >> 2) % FILE_KEY_N;
+  while (file_keys[hash_c] != NULL) {
+    if (file_keys[hash_c] == file) {
+      *id_p = file_ids[hash_c];
+      return 1;
+    }
+    hash_c = (hash_c + 1) % FILE_KEY_N;
+  }
+  
+  /* forget the ids if the table gets full since we can write them again */
+  if (file_key_c >= FILE_KEY_N / 2) {
+    memset(file_keys, 0, sizeof(file_keys));
+    file_key_c = 0;
+    hash_c = ((PNT_ARITH_TYPE)file >> 2) % FILE_KEY_N;
+  }
+  
+  /* write the name after a name record padded to the record size */
+  len = strlen(file);
+  if (len > MAX_FILE_LENGTH) {
+    len = MAX_FILE_LENGTH;
+  }
+  rec_p = get_recs(1 + (len + sizeof(snapshot_rec_t) - 1)
+		   / sizeof(snapshot_rec_t));
+  if (rec_p == NULL) {
+    return 0;
+  }
+  file_id_c++;
+  rec_p->sr_file = file_id_c;
+  rec_p->sr_size = len;
+  memcpy(rec_p + 1, file, len);
+  
+  file_keys[hash_c] = file;
+  file_ids[hash_c] = file_id_c;
+  file_key_c++;
+  
+  *id_p = file_id_c;
+  return 1;
+}
+
+/*
+ * static int write_pnt
+ *
+ * Walk function that writes the record of one of the pointers in use.
+ *
+ * Returns 1 to keep walking or 0 on an error.
+ */
+static	int	write_pnt(const void *pnt, const unsigned int size,
+			  const unsigned int total_size, const char *file,
+			  const unsigned int line, const unsigned long iter,
+			  const unsigned int flags, void *arg)
+{
+  snapshot_rec_t	*rec_p;
+  unsigned long		file_val;
+  
+  if (! file_id(file, line, &file_val)) {
+    *(int *)arg = 0;
+    return 0;
+  }
+  rec_p = get_recs(1);
+  if (rec_p == NULL) {
+    *(int *)arg = 0;
+    return 0;
+  }
+  rec_p->sr_pnt = (PNT_ARITH_TYPE)pnt;
+  rec_p->sr_file = file_val;
+  rec_p->sr_iter = iter;
+  rec_p->sr_size = size;
+  rec_p->sr_total_size = total_size;
+  rec_p->sr_line = line;
+  rec_p->sr_flags = flags;
+  return 1;
+}
+
+/**************************** exported routines ******************************/
+
+/*
+ * int _dmalloc_snapshot_write
+ *
+ * Write the pointers in use and the file-names of their call-sites
+ * to a snapshot file.  The library should be locked.
+ *
+ * Returns 1 on success or 0 on failure.
+ *
+ * ARGUMENTS:
+ *
+ * path -> Path of the file to write.
+ */
+int	_dmalloc_snapshot_write(const char *path)
+{
+  snapshot_header_t	header;
+  int			ok_b = 1;
+  
+  /* the records are not roots of the leak scan */
+  _dmalloc_leak_skip(rec_buf, sizeof(rec_buf));
+  
+  snap_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (snap_fd < 0) {
+    dmalloc_message("could not open heap snapshot '%s'", path);
+    return 0;
+  }
+  
+  memset(&header, 0, sizeof(header));
+  memcpy(header.sh_magic, SNAPSHOT_MAGIC, BINLOG_MAGIC_SIZE);
+  header.sh_version = SNAPSHOT_VERSION;
+  header.sh_byte_order = BINLOG_BYTE_ORDER;
+  header.sh_rec_size = sizeof(snapshot_rec_t);
+#if HAVE_GETPID
+  header.sh_pid = getpid();
+#endif
+  header.sh_secs = _dmalloc_clock_seconds();
+  header.sh_iter = _dmalloc_iter_c;
+  
+  /* the file-name ids start over with each snapshot */
+  rec_c = 0;
+  memset(file_keys, 0, sizeof(file_keys));
+  file_key_c = 0;
+  file_id_c = 0;
+  
+  if (write(snap_fd, &header, sizeof(header)) != sizeof(header)) {
+    ok_b = 0;
+  }
+  else {
+    (void)_dmalloc_chunk_walk(0 /* all pointers */, write_pnt, &ok_b);
+    if (ok_b) {
+      ok_b = flush_recs();
+    }
+  }
+  
+  (void)close(snap_fd);
+  snap_fd = -1;
+  if (! ok_b) {
+    dmalloc_message("could not write heap snapshot '%s'", path);
+  }
+  
+  return ok_b;
+}
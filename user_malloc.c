@@ -86,12 +86,20 @@
 #include "dmalloc.h"
 
 #include "append.h"
+#include "binlog.h"
 #include "chunk.h"
+#include "clock.h"
 #include "compat.h"
+#include "control.h"
 #include "debug_tok.h"
 #include "env.h"
 #include "error.h"
 #include "error_val.h"
+#include "flight.h"
+#include "leak.h"
+#include "livestats.h"
+#include "server.h"
+#include "snapshot.h"
 #include "heap.h"
 #include "dmalloc_loc.h"
 #include "user_malloc.h"
@@ -107,6 +115,35 @@ static char *information = "@(#) $Information: lock-threads is enabled $";
 
 #define INT_TYPE	int
 
+/*
+ * Each thread keeps its own cache of checked allocations so it needs
+ * thread-local storage if we are locking threads.  The initial-exec
+ * model keeps the storage from being allocated with malloc the first
+ * time that a thread uses it.
+ */
+#if VERIFY_CACHE_SIZE > 0
+# if LOCK_THREADS == 0
+#  define USE_VERIFY_CACHE	1
+#  define THREAD_LOCAL
+# elif defined(__GNUC__)
+#  define USE_VERIFY_CACHE	1
+#  define THREAD_LOCAL		__thread \
+				__attribute__((tls_model("initial-exec")))
+# endif
+#endif
+#ifndef USE_VERIFY_CACHE
+# define USE_VERIFY_CACHE	0
+#endif
+
+#if USE_VERIFY_CACHE
+/* allocation that passed the pointer checks */
+typedef struct {
+  const char		*vc_start;		/* start of the user space */
+  const char		*vc_bounds;		/* end of the user space */
+  unsigned long		vc_epoch;		/* free epoch when checked */
+} verify_cache_t;
+#endif
+
 /* exported variables */
 
 /* internal dmalloc error number for reference purposes only */
@@ -119,6 +156,7 @@ char		*dmalloc_logpath = NULL;
 static	int		enabled_b = 0;		/* have we started yet? */
 static	int		in_alloc_b = 0;		/* can't be here twice */
 static	int		do_shutdown_b = 0;	/* execute shutdown soon */
+static	int		do_dump_b = 0;		/* execute signal dump soon */
 static	int		memalign_warn_b = 0;	/* memalign warning printed?*/
 static	dmalloc_track_t	tracking_func = NULL;	/* memory trxn tracking func */
 
@@ -128,6 +166,29 @@ static	int		start_line = 0;		/* line to start */
 static	unsigned long	start_iter = 0;		/* start after X iterations */
 static	unsigned long	start_size = 0;		/* start after X bytes */
 static	int		thread_lock_c = 0;	/* lock counter */
+static	char		*profile_path = NULL;	/* heap profile path */
+static	unsigned long	profile_iter = 0;	/* profile every X iterations */
+static	char		*binlog_path = NULL;	/* binary trans log path */
+static	char		*flight_path = NULL;	/* flight recorder path */
+static	unsigned long	flight_recs = 0;	/* flight recorder records */
+static	char		*live_path = NULL;	/* live statistics path */
+static	int		dump_sig = 0;		/* signal that dumps stats */
+static	int		dump_check_b = 0;	/* check heap with the dump */
+static	int		dump_caught_sig = 0;	/* dump signal we catch */
+static	unsigned long	dump_mark = 0;		/* mark of the last dump */
+static	char		*control_path = NULL;	/* control file path */
+static	unsigned long	control_secs = 0;	/* seconds between checks */
+static	int		in_control_b = 0;	/* applying control file */
+static	char		*server_path = NULL;	/* query socket path */
+#if LOCK_THREADS && LOCK_TIMES
+static	dmalloc_lock_t	lock_stats;		/* lock counts and times */
+static	unsigned long	lock_start = 0;		/* when lock was taken */
+#endif
+#if USE_VERIFY_CACHE
+/* allocations checked by this thread and the next one to replace */
+static	THREAD_LOCAL verify_cache_t	verify_cache[VERIFY_CACHE_SIZE];
+static	THREAD_LOCAL int		verify_cache_c = 0;
+#endif
 
 /****************************** thread locking *******************************/
 
@@ -191,10 +252,32 @@ static THREAD_MUTEX_T dmalloc_mutex;
  */
 static	void	lock_thread(void)
 {
+#if LOCK_TIMES
+  unsigned long	wait;
+#endif
+  
   /* we only lock if the lock-on counter has reached 0 */
   if (thread_lock_c == 0) {
 #if HAVE_PTHREAD_MUTEX_LOCK
+#if LOCK_TIMES
+    if (pthread_mutex_trylock(&dmalloc_mutex) == 0) {
+      lock_start = _dmalloc_clock_nanos();
+    }
+    else {
+      wait = _dmalloc_clock_nanos();
+      pthread_mutex_lock(&dmalloc_mutex);
+      lock_start = _dmalloc_clock_nanos();
+      wait = lock_start - wait;
+      lock_stats.dl_wait_c++;
+      lock_stats.dl_wait_nsecs += wait;
+      if (wait > lock_stats.dl_wait_max) {
+	lock_stats.dl_wait_max = wait;
+      }
+    }
+    lock_stats.dl_lock_c++;
+#else
     pthread_mutex_lock(&dmalloc_mutex);
+#endif
 #endif
   }
 }
@@ -231,6 +314,14 @@ static	void	unlock_thread(void)
   }
   else if (thread_lock_c == 0) {
 #if HAVE_PTHREAD_MUTEX_UNLOCK
+#if LOCK_TIMES
+    unsigned long	hold = _dmalloc_clock_nanos() - lock_start;
+    
+    lock_stats.dl_hold_nsecs += hold;
+    if (hold > lock_stats.dl_hold_max) {
+      lock_stats.dl_hold_max = hold;
+    }
+#endif
     pthread_mutex_unlock(&dmalloc_mutex);
 #endif
   }
@@ -266,6 +357,17 @@ static	void	check_pnt(const char *file, const int line, const void *pnt,
   }
 }
 
+#if SIGNAL_OKAY
+/*
+ * Dump signal catcher which does the dump the next time we leave the
+ * library.
+ */
+static	RETSIGTYPE	dump_handler(const int sig)
+{
+  do_dump_b = 1;
+}
+#endif
+
 static	void	process_environ(const char *option_str)
 {
   /*
@@ -273,6 +375,10 @@ static	void	process_environ(const char *option_str)
    * into problems
    */
   static char	options[1024];
+  char		*budget_str, *budget_file;
+  const char	*budget_p;
+  int		budget_line, budget_action;
+  unsigned long	budget_limit;
   
   /* process the options flag */
   if (option_str == NULL) {
@@ -288,7 +394,11 @@ static	void	process_environ(const char *option_str)
 			   (unsigned long *)&_dmalloc_address_seen_n, &_dmalloc_flags,
 			   &_dmalloc_check_interval, &_dmalloc_lock_on,
 			   &dmalloc_logpath, &start_file, &start_line,
-			   &start_iter, &start_size, &_dmalloc_memory_limit);
+			   &start_iter, &start_size, &_dmalloc_memory_limit,
+			   &budget_str, &profile_path, &profile_iter,
+			   &binlog_path, &_dmalloc_async_log, &flight_path,
+			   &flight_recs, &live_path, &dump_sig, &dump_check_b,
+			   &control_path, &control_secs, &server_path);
   thread_lock_c = _dmalloc_lock_on;
   
   /* if we set the start stuff, then check-heap comes on later */
@@ -302,6 +412,47 @@ static	void	process_environ(const char *option_str)
     _dmalloc_reopen_log();
   }
   
+  /* this will close the binary log if the path changed */
+  _dmalloc_binlog_setup(binlog_path);
+  
+  /* this will map a new flight recorder if the path or size changed */
+  _dmalloc_flight_setup(flight_path, flight_recs);
+  
+  /* this will remove the old live statistics file if the path changed */
+  _dmalloc_live_setup(live_path);
+  
+#if SIGNAL_OKAY
+  /* catch the dump signal if it changed */
+  if (dump_sig != dump_caught_sig) {
+    if (dump_caught_sig > 0) {
+      (void)signal(dump_caught_sig, SIG_DFL);
+    }
+    if (dump_sig > 0) {
+      (void)signal(dump_sig, dump_handler);
+    }
+    dump_caught_sig = dump_sig;
+  }
+#endif
+  
+  /* the settings from the control file do not stop us watching it */
+  if (control_path != NULL || ! in_control_b) {
+    _dmalloc_control_setup(control_path, control_secs);
+  }
+  
+  /* this will move the query socket if the path changed */
+  _dmalloc_server_setup(server_path);
+  
+  /* replace any budgets with the ones from the options */
+  _dmalloc_chunk_budget_clear();
+  for (budget_p = budget_str; budget_p != NULL; ) {
+    budget_p = _dmalloc_budget_break(budget_p, &budget_file, &budget_line,
+				     &budget_limit, &budget_action);
+    if (budget_limit > 0) {
+      (void)_dmalloc_chunk_budget_set(budget_file, budget_line, budget_limit,
+				      budget_action);
+    }
+  }
+  
 #if LOCK_THREADS == 0
   /* was thread-lock-on specified but not configured? */
   if (_dmalloc_lock_on > 0) {
@@ -311,6 +462,157 @@ static	void	process_environ(const char *option_str)
 #endif
 }
 
+/*
+ * static int write_profile
+ *
+ * Write a heap profile to a path.  If the path is NULL then the
+ * profile path from the options is used with the current iteration
+ * count appended so it can be matched up with dmalloc_mark.
+ *
+ * Returns 1 on success or 0 on failure.
+ *
+ * ARGUMENTS:
+ *
+ * path -> Path of the file to write or NULL for the configured one.
+ */
+static	int	write_profile(const char *path)
+{
+  char	path_buf[1024];
+  
+  if (path == NULL) {
+    if (profile_path == NULL) {
+      return 0;
+    }
+    (void)loc_snprintf(path_buf, sizeof(path_buf), "%s.%lu", profile_path,
+		       _dmalloc_iter_c);
+    path = path_buf;
+  }
+  
+  return _dmalloc_chunk_write_profile(path);
+}
+
+#if USE_VERIFY_CACHE
+/*
+ * static const verify_cache_t *verify_find
+ *
+ * Find the allocation holding a pointer that this thread has checked
+ * since the last free.
+ *
+ * Returns the cache entry or NULL if it is not there.
+ *
+ * ARGUMENTS:
+ *
+ * pnt -> Pointer we are looking for.
+ */
+static	const verify_cache_t	*verify_find(const void *pnt)
+{
+  const verify_cache_t	*cache_p, *bounds_p;
+  const char		*mem_p = (const char *)pnt;
+  unsigned long		epoch;
+  
+  epoch = _dmalloc_free_epoch;
+  bounds_p = verify_cache + VERIFY_CACHE_SIZE;
+  for (cache_p = verify_cache; cache_p < bounds_p; cache_p++) {
+    if (cache_p->vc_epoch == epoch
+	&& mem_p >= cache_p->vc_start && mem_p < cache_p->vc_bounds) {
+      return cache_p;
+    }
+  }
+  
+  return NULL;
+}
+
+/*
+ * static int verify_cached
+ *
+ * See if a pointer can be passed with the allocations that this
+ * thread has checked since the last free without locking the library.
+ *
+ * Returns 1 if the pointer is okay or 0 if it needs to be checked.
+ *
+ * ARGUMENTS:
+ *
+ * pnt -> Pointer we are checking.
+ *
+ * exact_b -> Set to 1 if the pointer must be the start of an
+ * allocation.
+ *
+ * strlen_b -> Set to 1 to make sure that the pointer can hold
+ * strlen(pnt) + 1 bytes up to min_size.
+ *
+ * min_size -> Make sure that the pointer can hold at least that many
+ * bytes.  If 0 then ignore.
+ */
+static	int	verify_cached(const void *pnt, const int exact_b,
+			      const int strlen_b, const int min_size)
+{
+  const verify_cache_t	*cache_p;
+  const char		*mem_p = (const char *)pnt;
+  
+  /* pointers outside of the heap are okay if they need not be ours */
+  if ((! exact_b) && (! IS_IN_HEAP(pnt))) {
+    return 1;
+  }
+  
+  cache_p = verify_find(pnt);
+  if (cache_p == NULL) {
+    return 0;
+  }
+  
+  if (exact_b && mem_p != cache_p->vc_start) {
+    return 0;
+  }
+  if (strlen_b) {
+    /* min_size can be past the end if we find the \0 first */
+    if (min_size > 0 && mem_p + min_size <= cache_p->vc_bounds) {
+      return 1;
+    }
+    return (memchr(mem_p, '\0', cache_p->vc_bounds - mem_p) != NULL);
+  }
+  return (min_size <= 0 || mem_p + min_size <= cache_p->vc_bounds);
+}
+
+/*
+ * static void verify_remember
+ *
+ * Remember an allocation whose pointer has been checked so later
+ * checks inside of it can be done without the lock.  The library
+ * should be locked.
+ *
+ * ARGUMENTS:
+ *
+ * start -> Start of the user space of the allocation.
+ *
+ * bounds -> Just past the end of the user space.
+ */
+static	void	verify_remember(const void *start, const void *bounds)
+{
+  verify_cache_t	*cache_p;
+  
+  cache_p = verify_cache + verify_cache_c;
+  cache_p->vc_start = (const char *)start;
+  cache_p->vc_bounds = (const char *)bounds;
+  cache_p->vc_epoch = _dmalloc_free_epoch;
+  verify_cache_c = (verify_cache_c + 1) % VERIFY_CACHE_SIZE;
+}
+
+/*
+ * static void verify_forget
+ *
+ * Forget the allocations that have been checked.  This is done before
+ * the leak scan which reads the cache of this thread as a root and
+ * would see its allocations as reachable.  The library should be
+ * locked.
+ */
+static	void	verify_forget(void)
+{
+  /* the caches of the other threads are no longer used after this */
+  _dmalloc_free_epoch++;
+  memset(verify_cache, 0, sizeof(verify_cache));
+  verify_cache_c = 0;
+}
+#endif
+
 /************************** startup/shutdown calls ***************************/
 
 #if SIGNAL_OKAY
@@ -348,11 +650,12 @@ static	int	dmalloc_startup(const char *debug_str)
     /* set this up here so if an error occurs below, it will not try again */
     some_up_b = 1;
     
+    _dmalloc_clock_startup();
 #if LOG_PNT_TIMEVAL
-    GET_TIMEVAL(_dmalloc_start);
+    _dmalloc_clock_timeval(&_dmalloc_start);
 #else
 #if HAVE_TIME /* NOT LOG_PNT_TIME */
-    _dmalloc_start = time(NULL);
+    _dmalloc_start = _dmalloc_clock_seconds();
 #endif
 #endif
     
@@ -409,6 +712,8 @@ static	int	dmalloc_startup(const char *debug_str)
    * will just give it to them.  We hope that atexit didn't start the
    * allocating.  Ugh.
    */
+  _dmalloc_clock_zone_startup();
+  
 #if AUTO_SHUTDOWN
   /* NOTE: I use the else here in case some dumb systems has both */
 #if HAVE_ATEXIT
@@ -447,25 +752,39 @@ static	int	dmalloc_startup(const char *debug_str)
 }
 
 /*
- * static int dmalloc_in
+ * static void fill_stats
  *
- * Call to the alloc routines has been made.  Do some initialization,
- * locking, and check some debug variables.
- *
- * Returns 1 on success or 0 on failure.
+ * Fill in a snapshot of all of the counters of the library.  The
+ * library should be locked.
  *
  * ARGUMENTS:
  *
- * file -> File-name or return-address of the caller.
+ * stats_p <- Pointer to the statistics that we are filling in.
  *
- * line -> Line-number of the caller.
+ * size -> Number of bytes of the statistics that the caller will use.
+ */
+static	void	fill_stats(dmalloc_stats_t *stats_p, const unsigned int size)
+{
+  memset(stats_p, 0, sizeof(*stats_p));
+  stats_p->ds_version = DMALLOC_STATS_VERSION;
+  stats_p->ds_size = size;
+  stats_p->ds_iter_c = _dmalloc_iter_c;
+  _dmalloc_chunk_stats_ex(stats_p);
+#if LOCK_THREADS && LOCK_TIMES
+  stats_p->ds_lock = lock_stats;
+#endif
+  stats_p->ds_cost = _dmalloc_cost;
+}
+
+/*
+ * static int lock_in
  *
- * check_heap_b -> Set to 1 if it is okay to check the heap.  If set
- * to 0 then the caller will check it itself or it is a non-invasive
- * call.
+ * Start the library if needed, lock it, and mark that we are inside
+ * of it.  This does not count an iteration.
+ *
+ * Returns 1 on success or 0 on failure.
  */
-static	int	dmalloc_in(const char *file, const int line,
-			   const int check_heap_b)
+static	int	lock_in(void)
 {
   if (_dmalloc_aborting_b) {
     return 0;
@@ -496,6 +815,34 @@ static	int	dmalloc_in(const char *file, const int line,
   
   in_alloc_b = 1;
   
+  return 1;
+}
+
+/*
+ * static int dmalloc_in
+ *
+ * Call to the alloc routines has been made.  Do some initialization,
+ * locking, and check some debug variables.
+ *
+ * Returns 1 on success or 0 on failure.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address of the caller.
+ *
+ * line -> Line-number of the caller.
+ *
+ * check_heap_b -> Set to 1 if it is okay to check the heap.  If set
+ * to 0 then the caller will check it itself or it is a non-invasive
+ * call.
+ */
+static	int	dmalloc_in(const char *file, const int line,
+			   const int check_heap_b)
+{
+  if (! lock_in()) {
+    return 0;
+  }
+  
   /* increment our interval */
   _dmalloc_iter_c++;
   
@@ -541,6 +888,11 @@ static	int	dmalloc_in(const char *file, const int line,
     }
   }
   
+  /* write a heap profile every X times */
+  if (profile_iter > 0 && _dmalloc_iter_c % profile_iter == 0) {
+    (void)write_profile(NULL);
+  }
+  
   /* after all that, do we need to check the heap? */
   if (check_heap_b && BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_CHECK_HEAP)) {
     (void)_dmalloc_chunk_heap_check();
@@ -549,15 +901,86 @@ static	int	dmalloc_in(const char *file, const int line,
   return 1;
 }
 
+/*
+ * Apply the settings from the control file if it has changed.  The
+ * library should be locked.
+ */
+static	void	control_apply(void)
+{
+  char	options[1024];
+  
+  if (! _dmalloc_control_changed(options, sizeof(options))) {
+    return;
+  }
+  
+  dmalloc_message("applying settings '%s' from the control file", options);
+  in_control_b = 1;
+  process_environ(options);
+  in_control_b = 0;
+}
+
+/*
+ * Log the statistics and the pointers that were allocated since the
+ * last dump and not freed because the dump signal was caught.  The
+ * library should be locked.
+ */
+static	void	signal_dump(void)
+{
+  dmalloc_message("dumping because of signal %d, changes since mark %lu",
+		  dump_sig, dump_mark);
+  _dmalloc_chunk_log_stats();
+  _dmalloc_chunk_log_changed(dump_mark, 1 /* not-freed */, 0 /* freed */,
+			     0 /* details */);
+  if (dump_check_b) {
+    (void)_dmalloc_chunk_heap_check();
+  }
+  
+  /* the next dump shows the changes since this one */
+  dump_mark = _dmalloc_iter_c;
+  dmalloc_message("dump finished at mark %lu", dump_mark);
+}
+
 /*
  * Going out of the alloc routines back to user space.
  */
 static	void	dmalloc_out(void)
 {
+  /* pick up new settings from the control file */
+  control_apply();
+  
+  /* do the dump now that we are at a safe point */
+  if (do_dump_b) {
+    do_dump_b = 0;
+    signal_dump();
+  }
+  
+  /* publish the live statistics at most once a second */
+  if (_dmalloc_live_due()) {
+    dmalloc_stats_t	stats;
+    
+    fill_stats(&stats, sizeof(stats));
+    _dmalloc_live_update(&stats);
+  }
+  
   in_alloc_b = 0;
   
 #if LOCK_THREADS
   unlock_thread();
+  
+  /*
+   * Start the log writer thread once we are locking.  This is done
+   * outside of the lock since the thread library may allocate.
+   */
+  if (_dmalloc_async_log != ASYNC_LOG_NONE && thread_lock_c == 0) {
+    _dmalloc_async_start();
+  }
+  /* the query server thread is started the same way */
+  if (thread_lock_c == 0) {
+    _dmalloc_server_run();
+  }
+#else
+  /* answer any waiting queries now that we are out of the library */
+  _dmalloc_server_run();
 #endif
   
   if (do_shutdown_b) {
@@ -567,6 +990,34 @@ static	void	dmalloc_out(void)
 
 /***************************** exported routines *****************************/
 
+/*
+ * int _dmalloc_call_locked
+ *
+ * Lock the library and call a function.  This is used by the query
+ * server to copy its snapshots out of the library's tables.  It does
+ * not count an iteration so the server does not move the marks, the
+ * check-heap interval, or the profile dumps.
+ *
+ * Returns 1 on success or 0 if the library could not be entered.
+ *
+ * ARGUMENTS:
+ *
+ * func -> Function to call while the library is locked.  It must not
+ * call back into the library.
+ *
+ * arg -> Argument passed through to the function.
+ */
+int	_dmalloc_call_locked(void (*func)(void *arg), void *arg)
+{
+  /* not a call from the program so it does not count an iteration */
+  if (! lock_in()) {
+    return 0;
+  }
+  func(arg);
+  dmalloc_out();
+  return 1;
+}
+
 /*
  * void dmalloc_shutdown
  *
@@ -623,8 +1074,20 @@ void	dmalloc_shutdown(void)
     _dmalloc_chunk_log_stats();
   }
   
-  /* report on non-freed pointers */
-  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_NONFREE)) {
+  /* report on non-freed pointers or only on the ones that are leaked */
+  if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_UNREACHABLE)) {
+#if USE_VERIFY_CACHE
+    verify_forget();
+#endif
+    (void)_dmalloc_leak_log(
+#if DUMP_UNFREED_SUMMARY_ONLY
+			    0
+#else
+			    1
+#endif
+			    );
+  }
+  else if (BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_NONFREE)) {
     _dmalloc_chunk_log_changed(0, 1, 0,
 #if DUMP_UNFREED_SUMMARY_ONLY
 		       0
@@ -634,11 +1097,25 @@ void	dmalloc_shutdown(void)
 		       );
   }
   
+  /* write the final heap profile */
+  if (profile_path != NULL) {
+    (void)write_profile(profile_path);
+  }
+  
+  /* write out the rest of the binary log */
+  if (binlog_path != NULL) {
+    _dmalloc_binlog_flush();
+  }
+  
+  /* the program is done so the live statistics file is no longer needed */
+  _dmalloc_live_shutdown();
+  _dmalloc_server_shutdown();
+  
 #if LOG_PNT_TIMEVAL
   {
     TIMEVAL_TYPE	now;
     char		time_buf1[64], time_buf2[64];
-    GET_TIMEVAL(now);
+    _dmalloc_clock_timeval(&now);
     dmalloc_message("ending time = %s, elapsed since start = %s",
 		    _dmalloc_ptimeval(&now, time_buf1, sizeof(time_buf1), 0),
 		    _dmalloc_ptimeval(&now, time_buf2, sizeof(time_buf2), 1));
@@ -648,7 +1125,7 @@ void	dmalloc_shutdown(void)
   {
     TIME_TYPE	now;
     char	time_buf1[64], time_buf2[64];
-    now = time(NULL);
+    now = _dmalloc_clock_seconds();
     dmalloc_message("ending time = %s, elapsed since start = %s",
 		    _dmalloc_ptime(&now, time_buf1, sizeof(time_buf1), 0),
 		    _dmalloc_ptime(&now, time_buf2, sizeof(time_buf2), 1));
@@ -656,6 +1133,9 @@ void	dmalloc_shutdown(void)
 #endif
 #endif
   
+  /* wait for the log writer to write out the messages */
+  _dmalloc_async_flush();
+  
   in_alloc_b = 0;
   
 #if LOCK_THREADS
@@ -1323,7 +1803,7 @@ int	dmalloc_verify(const DMALLOC_PNT pnt)
   else {
     ret = _dmalloc_chunk_pnt_check("dmalloc_verify", pnt,
 				   1 /* exact pointer */, 0 /* no strlen */,
-				   0 /* no min size */);
+				   0 /* no min size */, NULL, NULL);
   }
   
   dmalloc_out();
@@ -1353,6 +1833,54 @@ int	malloc_verify(const DMALLOC_PNT pnt)
   return dmalloc_verify(pnt);
 }
 
+/*
+ * int dmalloc_verify_many
+ *
+ * Verify an array of pointers which have previously been allocated by
+ * the library.  The library is locked once and the pointers are found
+ * in sorted order so this is much faster than calling dmalloc_verify
+ * on each of them.  Unlike dmalloc_verify, a NULL pointer does not
+ * check the heap and is counted as okay.
+ *
+ * Returns MALLOC_VERIFY_NOERROR if all of the pointers are okay or
+ * MALLOC_VERIFY_ERROR if any of them are not.
+ *
+ * ARGUMENTS:
+ *
+ * pnts -> Array of the pointers we are verifying.
+ *
+ * pnt_n -> Number of the pointers in the array.
+ *
+ * results <- Array of pnt_n entries that we set to
+ * MALLOC_VERIFY_NOERROR or MALLOC_VERIFY_ERROR for each pointer.  Can
+ * be NULL.
+ */
+int	dmalloc_verify_many(const DMALLOC_PNT *pnts, const DMALLOC_SIZE pnt_n,
+			    int *results)
+{
+  DMALLOC_SIZE	pnt_c, bad_n;
+  
+  if (! dmalloc_in(DMALLOC_DEFAULT_FILE, DMALLOC_DEFAULT_LINE, 0)) {
+    if (results != NULL) {
+      for (pnt_c = 0; pnt_c < pnt_n; pnt_c++) {
+	results[pnt_c] = MALLOC_VERIFY_NOERROR;
+      }
+    }
+    return MALLOC_VERIFY_NOERROR;
+  }
+  
+  bad_n = _dmalloc_chunk_pnt_check_many(pnts, pnt_n, results);
+  
+  dmalloc_out();
+  
+  if (bad_n == 0) {
+    return MALLOC_VERIFY_NOERROR;
+  }
+  else {
+    return MALLOC_VERIFY_ERROR;
+  }
+}
+
 /*
  * int dmalloc_verify_pnt
  *
@@ -1390,14 +1918,29 @@ int	dmalloc_verify_pnt_strsize(const char *file, const int line,
 				   const int exact_b, const int strlen_b,
 				   const int min_size)
 {
-  int	ret;
+  const void	*start, *bounds;
+  int		ret;
+  
+#if USE_VERIFY_CACHE
+  /* the checks are logged with the transactions so we cannot skip them */
+  if ((! BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_TRANS))
+      && verify_cached(pnt, exact_b, strlen_b, min_size)) {
+    return MALLOC_VERIFY_NOERROR;
+  }
+#endif
   
   if (! dmalloc_in(file, line, 0)) {
     return MALLOC_VERIFY_NOERROR;
   }
   
   /* call the pnt checking chunk code */
-  ret = _dmalloc_chunk_pnt_check(func, pnt, exact_b, strlen_b, min_size);
+  ret = _dmalloc_chunk_pnt_check(func, pnt, exact_b, strlen_b, min_size,
+				 &start, &bounds);
+#if USE_VERIFY_CACHE
+  if (ret && start != NULL) {
+    verify_remember(start, bounds);
+  }
+#endif
   dmalloc_out();
   
   if (ret) {
@@ -1452,6 +1995,109 @@ int	dmalloc_verify_pnt(const char *file, const int line, const char *func,
   }
 }
 
+/*
+ * int _dmalloc_verify_strlen
+ *
+ * This function is used by the arg_check.c functions to verify a
+ * string and get its length in one pass.  The string is only scanned
+ * up to the end of the allocation that holds it.
+ *
+ * Returns MALLOC_VERIFY_NOERROR on success or MALLOC_VERIFY_ERROR on failure.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address of the caller.
+ *
+ * line -> Line-number of the caller.
+ *
+ * func -> Function string which is checking the string.
+ *
+ * str -> String we are checking.
+ *
+ * strnlen_b -> Set to 1 to stop at max_len characters like strnlen.
+ *
+ * max_len -> Maximum length of the string if strnlen_b is 1.
+ *
+ * len_p <- Pointer to the length of the string that we set.
+ */
+int	_dmalloc_verify_strlen(const char *file, const int line,
+			       const char *func, const char *str,
+			       const int strnlen_b, const DMALLOC_SIZE max_len,
+			       DMALLOC_SIZE *len_p)
+{
+  const void	*start = NULL, *bounds = NULL;
+  const char	*end_p;
+  DMALLOC_SIZE	scan_len;
+  int		found_b = 0, ret = 1;
+  
+#if USE_VERIFY_CACHE
+  if (! BIT_IS_SET(_dmalloc_flags, DMALLOC_DEBUG_LOG_TRANS)) {
+    const verify_cache_t	*cache_p;
+    
+    if (! IS_IN_HEAP(str)) {
+      found_b = 1;
+    }
+    else {
+      cache_p = verify_find(str);
+      if (cache_p != NULL) {
+	bounds = cache_p->vc_bounds;
+	found_b = 1;
+      }
+    }
+  }
+#endif
+  
+  /* find the allocation that holds the string */
+  if ((! found_b) && dmalloc_in(file, line, 0)) {
+    ret = _dmalloc_chunk_pnt_check(func, str, 0 /* not exact */,
+				   0 /* no strlen */, 0 /* no min-size */,
+				   &start, &bounds);
+#if USE_VERIFY_CACHE
+    if (ret && start != NULL) {
+      verify_remember(start, bounds);
+    }
+#endif
+    dmalloc_out();
+  }
+  
+  if (ret && bounds != NULL) {
+    /* memchr is the fastest scan that libc has and it stops at the end */
+    scan_len = (const char *)bounds - str;
+    if (strnlen_b && max_len < scan_len) {
+      scan_len = max_len;
+    }
+    end_p = memchr(str, '\0', scan_len);
+    if (end_p != NULL) {
+      *len_p = end_p - str;
+      return MALLOC_VERIFY_NOERROR;
+    }
+    if (strnlen_b && scan_len == max_len) {
+      *len_p = max_len;
+      return MALLOC_VERIFY_NOERROR;
+    }
+    
+    /* the string runs off the end so the full check logs the error */
+    ret = dmalloc_verify_pnt_strsize(file, line, func, str, 0 /* not exact */,
+				     1 /* strlen */, 0 /* no min-size */);
+    ret = (ret == MALLOC_VERIFY_NOERROR);
+  }
+  
+  /* the string is not in one of our allocations or it is bad */
+  if (strnlen_b) {
+    *len_p = strnlen(str, max_len);
+  }
+  else {
+    *len_p = strlen(str);
+  }
+  
+  if (ret) {
+    return MALLOC_VERIFY_NOERROR;
+  }
+  else {
+    return MALLOC_VERIFY_ERROR;
+  }
+}
+
 /*
  * unsigned int dmalloc_debug
  *
@@ -1649,6 +2295,129 @@ void	dmalloc_track(const dmalloc_track_t track_func)
   tracking_func = track_func;
 }
 
+/*
+ * int dmalloc_budget
+ *
+ * Set, change, or remove a memory budget for a file or a file/line
+ * call-site.  When the memory in use by allocations from the
+ * location would go over the budget then the action is taken.  A
+ * budget for a specific line takes precedence over a budget for the
+ * whole file.
+ *
+ * Returns DMALLOC_NOERROR on success or DMALLOC_ERROR on failure.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name to match against the allocation file.  It is
+ * compared against the full path as well as the basename and may end
+ * in a '*' to match a prefix.
+ *
+ * line -> Line-number to match or 0 to match all lines in the file.
+ *
+ * limit -> Maximum number of bytes that can be in use by allocations
+ * from the location.  Set to 0 to remove the budget.
+ *
+ * action -> What to do when the budget is exceeded.  Set to
+ * DMALLOC_BUDGET_LOG to log a message, DMALLOC_BUDGET_ERROR to
+ * generate an ERROR_OVER_BUDGET error, or DMALLOC_BUDGET_FAIL to
+ * generate the error and fail the allocation.
+ */
+int	dmalloc_budget(const char *file, const int line,
+		       const unsigned long limit, const int action)
+{
+  int	ret;
+  
+  /* we need to lock */
+  if (! dmalloc_in(NULL /* no file-name */, 0 /* no line-number */,
+		   0 /* don't-check-heap */)) {
+    return DMALLOC_ERROR;
+  }
+  
+  if (_dmalloc_chunk_budget_set(file, line, limit, action)) {
+    ret = DMALLOC_NOERROR;
+  }
+  else {
+    ret = DMALLOC_ERROR;
+  }
+  
+  dmalloc_out();
+  
+  return ret;
+}
+
+/*
+ * int dmalloc_profile
+ *
+ * Write a pprof compatible heap profile of the allocations made by
+ * each file/line or return-address call-site.  The profile has the
+ * total objects and space allocated as well as the objects and space
+ * still in use.
+ *
+ * Returns DMALLOC_NOERROR on success or DMALLOC_ERROR on failure.
+ *
+ * ARGUMENTS:
+ *
+ * path -> Path of the file to write.  If NULL then the profile path
+ * from the options is used with the current mark appended.
+ */
+int	dmalloc_profile(const char *path)
+{
+  int	ret;
+  
+  /* we need to lock */
+  if (! dmalloc_in(NULL /* no file-name */, 0 /* no line-number */,
+		   0 /* don't-check-heap */)) {
+    return DMALLOC_ERROR;
+  }
+  
+  if (write_profile(path)) {
+    ret = DMALLOC_NOERROR;
+  }
+  else {
+    ret = DMALLOC_ERROR;
+  }
+  
+  dmalloc_out();
+  
+  return ret;
+}
+
+/*
+ * int dmalloc_snapshot
+ *
+ * Write a binary snapshot of the pointers in use with their sizes,
+ * call-sites, and the iterations they were last changed.  This is
+ * much faster to write than logging the unfreed pointers and two
+ * snapshots can be compared with dmalloc --diff-snapshot.
+ *
+ * Returns DMALLOC_NOERROR on success or DMALLOC_ERROR on failure.
+ *
+ * ARGUMENTS:
+ *
+ * path -> Path of the file to write.
+ */
+int	dmalloc_snapshot(const char *path)
+{
+  int	ret;
+  
+  /* we need to lock */
+  if (! dmalloc_in(NULL /* no file-name */, 0 /* no line-number */,
+		   0 /* don't-check-heap */)) {
+    return DMALLOC_ERROR;
+  }
+  
+  if (path != NULL && _dmalloc_snapshot_write(path)) {
+    ret = DMALLOC_NOERROR;
+  }
+  else {
+    ret = DMALLOC_ERROR;
+  }
+  
+  dmalloc_out();
+  
+  return ret;
+}
+
 /*
  * unsigned long dmalloc_mark
  *
@@ -1782,6 +2551,40 @@ void	dmalloc_log_unfreed(void)
   dmalloc_out();
 }
 
+/*
+ * int dmalloc_log_unreachable
+ *
+ * Dump the unfreed pointers that the program can no longer reach to
+ * the logfile.  The global variables, the stacks, and the registers
+ * are scanned for values which point into the allocated blocks and
+ * the blocks which are reached are scanned in turn.
+ *
+ * Returns the number of unreachable pointers or -1 on error.
+ */
+int	dmalloc_log_unreachable(void)
+{
+  int	ret;
+  
+  if (! dmalloc_in(DMALLOC_DEFAULT_FILE, DMALLOC_DEFAULT_LINE, 1)) {
+    return -1;
+  }
+  
+#if USE_VERIFY_CACHE
+  verify_forget();
+#endif
+  ret = _dmalloc_leak_log(
+#if DUMP_UNFREED_SUMMARY_ONLY
+			  0
+#else
+			  1
+#endif
+			  );
+  
+  dmalloc_out();
+  
+  return ret;
+}
+
 /*
  * void dmalloc_log_changed
  *
@@ -1905,6 +2708,133 @@ void	dmalloc_get_stats(DMALLOC_PNT *heap_low_p,
 			   max_allocated_p, max_pnt_np, max_one_p);
 }
 
+/*
+ * void dmalloc_get_frag_stats
+ *
+ * Get information about the fragmentation of the heap broken down by
+ * divided slot size and by the length of runs of basic-blocks.  It
+ * shows the space lost to rounding up to the size classes and to
+ * fence-posts, the free space that can and cannot be reused, and the
+ * administrative space.
+ *
+ * ARGUMENTS:
+ *
+ * frag_p <- Pointer to the fragmentation information to fill in.
+ */
+void	dmalloc_get_frag_stats(dmalloc_frag_t *frag_p)
+{
+  /* we need to lock since we walk the slot lists */
+  if (! dmalloc_in(NULL /* no file-name */, 0 /* no line-number */,
+		   0 /* don't-check-heap */)) {
+    memset(frag_p, 0, sizeof(*frag_p));
+    return;
+  }
+  
+  _dmalloc_chunk_frag_stats(frag_p);
+  
+  dmalloc_out();
+}
+
+/*
+ * void dmalloc_get_lock_stats
+ *
+ * Get the number of times that the threaded library was locked, how
+ * many times and how long threads had to wait for the lock, and how
+ * long it was held.  The times are only kept if LOCK_TIMES is set in
+ * settings.h and everything is 0 in the library without threads.
+ *
+ * ARGUMENTS:
+ *
+ * lock_p <- Pointer to the lock information to fill in.
+ */
+void	dmalloc_get_lock_stats(dmalloc_lock_t *lock_p)
+{
+  if (! dmalloc_in(NULL /* no file-name */, 0 /* no line-number */,
+		   0 /* don't-check-heap */)) {
+    memset(lock_p, 0, sizeof(*lock_p));
+    return;
+  }
+  
+#if LOCK_THREADS && LOCK_TIMES
+  *lock_p = lock_stats;
+#else
+  memset(lock_p, 0, sizeof(*lock_p));
+#endif
+  
+  dmalloc_out();
+}
+
+/*
+ * void dmalloc_get_cost_stats
+ *
+ * Get the number of calls to and the cycles spent in each of the
+ * costly features of the library and the number of system calls made
+ * to grow, release, and protect the heap.  The cycles are only kept if
+ * LOG_COST_CYCLES is set in settings.h.
+ *
+ * ARGUMENTS:
+ *
+ * cost_p <- Pointer to the cost information to fill in.
+ */
+void	dmalloc_get_cost_stats(dmalloc_cost_t *cost_p)
+{
+  if (! dmalloc_in(NULL /* no file-name */, 0 /* no line-number */,
+		   0 /* don't-check-heap */)) {
+    memset(cost_p, 0, sizeof(*cost_p));
+    return;
+  }
+  
+  *cost_p = _dmalloc_cost;
+  
+  dmalloc_out();
+}
+
+/*
+ * int dmalloc_get_stats_ex
+ *
+ * Get all of the counters of the library in one snapshot taken with
+ * the library locked.  This includes the heap, pointer, and function
+ * counters as well as the lock and cost information.  Only the first
+ * stats_size bytes of the structure are filled in so programs built
+ * with an older version of the structure will still work.
+ *
+ * Returns DMALLOC_NOERROR on success or DMALLOC_ERROR on failure.
+ *
+ * ARGUMENTS:
+ *
+ * stats_p <- Pointer to the statistics to fill in.
+ *
+ * stats_size -> Size of the statistics structure which should be
+ * sizeof(dmalloc_stats_t).
+ */
+int	dmalloc_get_stats_ex(dmalloc_stats_t *stats_p,
+			     const DMALLOC_SIZE stats_size)
+{
+  dmalloc_stats_t	stats;
+  unsigned int		size;
+  
+  /* we need at least the version and size fields */
+  if (stats_p == NULL || stats_size < sizeof(stats.ds_version) * 2) {
+    return DMALLOC_ERROR;
+  }
+  if (stats_size > sizeof(stats)) {
+    size = sizeof(stats);
+  }
+  else {
+    size = stats_size;
+  }
+  
+  if (! dmalloc_in(NULL /* no file-name */, 0 /* no line-number */,
+		   0 /* don't-check-heap */)) {
+    return DMALLOC_ERROR;
+  }
+  fill_stats(&stats, size);
+  dmalloc_out();
+  
+  memcpy(stats_p, &stats, size);
+  return DMALLOC_NOERROR;
+}
+
 /*
  * const char *dmalloc_strerror
  *
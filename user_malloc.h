@@ -7,6 +7,26 @@
 
 /*<<<<<<<<<<  The below prototypes are auto-generated by fillproto */
 
+/*
+ * int _dmalloc_call_locked
+ *
+ * Lock the library and call a function.  This is used by the query
+ * server to copy its snapshots out of the library's tables.  It does
+ * not count an iteration so the server does not move the marks, the
+ * check-heap interval, or the profile dumps.
+ *
+ * Returns 1 on success or 0 if the library could not be entered.
+ *
+ * ARGUMENTS:
+ *
+ * func -> Function to call while the library is locked.  It must not
+ * call back into the library.
+ *
+ * arg -> Argument passed through to the function.
+ */
+extern
+int	_dmalloc_call_locked(void (*func)(void *arg), void *arg);
+
 /* internal dmalloc error number for reference purposes only */
 extern
 int		dmalloc_errno;
@@ -344,6 +364,32 @@ int	dmalloc_verify(const DMALLOC_PNT pnt);
 extern
 int	malloc_verify(const DMALLOC_PNT pnt);
 
+/*
+ * int dmalloc_verify_many
+ *
+ * Verify an array of pointers which have previously been allocated by
+ * the library.  The library is locked once and the pointers are found
+ * in sorted order so this is much faster than calling dmalloc_verify
+ * on each of them.  Unlike dmalloc_verify, a NULL pointer does not
+ * check the heap and is counted as okay.
+ *
+ * Returns MALLOC_VERIFY_NOERROR if all of the pointers are okay or
+ * MALLOC_VERIFY_ERROR if any of them are not.
+ *
+ * ARGUMENTS:
+ *
+ * pnts -> Array of the pointers we are verifying.
+ *
+ * pnt_n -> Number of the pointers in the array.
+ *
+ * results <- Array of pnt_n entries that we set to
+ * MALLOC_VERIFY_NOERROR or MALLOC_VERIFY_ERROR for each pointer.  Can
+ * be NULL.
+ */
+extern
+int	dmalloc_verify_many(const DMALLOC_PNT *pnts, const DMALLOC_SIZE pnt_n,
+			    int *results);
+
 /*
  * int dmalloc_verify_pnt
  *
@@ -418,6 +464,37 @@ int	dmalloc_verify_pnt(const char *file, const int line, const char *func,
 			   const void *pnt, const int exact_b,
 			   const int min_size);
 
+/*
+ * int _dmalloc_verify_strlen
+ *
+ * This function is used by the arg_check.c functions to verify a
+ * string and get its length in one pass.  The string is only scanned
+ * up to the end of the allocation that holds it.
+ *
+ * Returns MALLOC_VERIFY_NOERROR on success or MALLOC_VERIFY_ERROR on failure.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name or return-address of the caller.
+ *
+ * line -> Line-number of the caller.
+ *
+ * func -> Function string which is checking the string.
+ *
+ * str -> String we are checking.
+ *
+ * strnlen_b -> Set to 1 to stop at max_len characters like strnlen.
+ *
+ * max_len -> Maximum length of the string if strnlen_b is 1.
+ *
+ * len_p <- Pointer to the length of the string that we set.
+ */
+extern
+int	_dmalloc_verify_strlen(const char *file, const int line,
+			       const char *func, const char *str,
+			       const int strnlen_b, const DMALLOC_SIZE max_len,
+			       DMALLOC_SIZE *len_p);
+
 /*
  * unsigned int dmalloc_debug
  *
@@ -538,6 +615,72 @@ int	dmalloc_examine(const DMALLOC_PNT pnt, DMALLOC_SIZE *user_size_p,
 extern
 void	dmalloc_track(const dmalloc_track_t track_func);
 
+/*
+ * int dmalloc_budget
+ *
+ * Set, change, or remove a memory budget for a file or a file/line
+ * call-site.  When the memory in use by allocations from the
+ * location would go over the budget then the action is taken.  A
+ * budget for a specific line takes precedence over a budget for the
+ * whole file.
+ *
+ * Returns DMALLOC_NOERROR on success or DMALLOC_ERROR on failure.
+ *
+ * ARGUMENTS:
+ *
+ * file -> File-name to match against the allocation file.  It is
+ * compared against the full path as well as the basename and may end
+ * in a '*' to match a prefix.
+ *
+ * line -> Line-number to match or 0 to match all lines in the file.
+ *
+ * limit -> Maximum number of bytes that can be in use by allocations
+ * from the location.  Set to 0 to remove the budget.
+ *
+ * action -> What to do when the budget is exceeded.  Set to
+ * DMALLOC_BUDGET_LOG to log a message, DMALLOC_BUDGET_ERROR to
+ * generate an ERROR_OVER_BUDGET error, or DMALLOC_BUDGET_FAIL to
+ * generate the error and fail the allocation.
+ */
+extern
+int	dmalloc_budget(const char *file, const int line,
+		       const unsigned long limit, const int action);
+
+/*
+ * int dmalloc_profile
+ *
+ * Write a pprof compatible heap profile of the allocations made by
+ * each file/line or return-address call-site.  The profile has the
+ * total objects and space allocated as well as the objects and space
+ * still in use.
+ *
+ * Returns DMALLOC_NOERROR on success or DMALLOC_ERROR on failure.
+ *
+ * ARGUMENTS:
+ *
+ * path -> Path of the file to write.  If NULL then the profile path
+ * from the options is used with the current mark appended.
+ */
+extern
+int	dmalloc_profile(const char *path);
+
+/*
+ * int dmalloc_snapshot
+ *
+ * Write a binary snapshot of the pointers in use with their sizes,
+ * call-sites, and the iterations they were last changed.  This is
+ * much faster to write than logging the unfreed pointers and two
+ * snapshots can be compared with dmalloc --diff-snapshot.
+ *
+ * Returns DMALLOC_NOERROR on success or DMALLOC_ERROR on failure.
+ *
+ * ARGUMENTS:
+ *
+ * path -> Path of the file to write.
+ */
+extern
+int	dmalloc_snapshot(const char *path);
+
 /*
  * unsigned long dmalloc_mark
  *
@@ -607,6 +750,19 @@ void	dmalloc_log_stats(void);
 extern
 void	dmalloc_log_unfreed(void);
 
+/*
+ * int dmalloc_log_unreachable
+ *
+ * Dump the unfreed pointers that the program can no longer reach to
+ * the logfile.  The global variables, the stacks, and the registers
+ * are scanned for values which point into the allocated blocks and
+ * the blocks which are reached are scanned in turn.
+ *
+ * Returns the number of unreachable pointers or -1 on error.
+ */
+extern
+int	dmalloc_log_unreachable(void);
+
 /*
  * void dmalloc_log_changed
  *
@@ -714,6 +870,74 @@ void	dmalloc_get_stats(DMALLOC_PNT *heap_low_p,
 			  unsigned long *max_pnt_np,
 			  unsigned long *max_one_p);
 
+/*
+ * void dmalloc_get_frag_stats
+ *
+ * Get information about the fragmentation of the heap broken down by
+ * divided slot size and by the length of runs of basic-blocks.  It
+ * shows the space lost to rounding up to the size classes and to
+ * fence-posts, the free space that can and cannot be reused, and the
+ * administrative space.
+ *
+ * ARGUMENTS:
+ *
+ * frag_p <- Pointer to the fragmentation information to fill in.
+ */
+extern
+void	dmalloc_get_frag_stats(dmalloc_frag_t *frag_p);
+
+/*
+ * void dmalloc_get_lock_stats
+ *
+ * Get the number of times that the threaded library was locked, how
+ * many times and how long threads had to wait for the lock, and how
+ * long it was held.  The times are only kept if LOCK_TIMES is set in
+ * settings.h and everything is 0 in the library without threads.
+ *
+ * ARGUMENTS:
+ *
+ * lock_p <- Pointer to the lock information to fill in.
+ */
+extern
+void	dmalloc_get_lock_stats(dmalloc_lock_t *lock_p);
+
+/*
+ * void dmalloc_get_cost_stats
+ *
+ * Get the number of calls to and the cycles spent in each of the
+ * costly features of the library and the number of system calls made
+ * to grow, release, and protect the heap.  The cycles are only kept if
+ * LOG_COST_CYCLES is set in settings.h.
+ *
+ * ARGUMENTS:
+ *
+ * cost_p <- Pointer to the cost information to fill in.
+ */
+extern
+void	dmalloc_get_cost_stats(dmalloc_cost_t *cost_p);
+
+/*
+ * int dmalloc_get_stats_ex
+ *
+ * Get all of the counters of the library in one snapshot taken with
+ * the library locked.  This includes the heap, pointer, and function
+ * counters as well as the lock and cost information.  Only the first
+ * stats_size bytes of the structure are filled in so programs built
+ * with an older version of the structure will still work.
+ *
+ * Returns DMALLOC_NOERROR on success or DMALLOC_ERROR on failure.
+ *
+ * ARGUMENTS:
+ *
+ * stats_p <- Pointer to the statistics to fill in.
+ *
+ * stats_size -> Size of the statistics structure which should be
+ * sizeof(dmalloc_stats_t).
+ */
+extern
+int	dmalloc_get_stats_ex(dmalloc_stats_t *stats_p,
+			     const DMALLOC_SIZE stats_size);
+
 /*
  * const char *dmalloc_strerror
  *